@@ -4,10 +4,38 @@
 #include "stdafx.h"
 #include "../PatrickMath/Vector4.h"
 #include "../PatrickMath/XmmFloat.h"
+#include "../PatrickMath/Vector4d.h"
+#include "../PatrickMath/Quantize.h"
+#include "../PatrickMath/XmmInt.h"
+#include "../PatrickMath/Sampling.h"
+#include "../PatrickMath/XmmRandom.h"
+#include "../PatrickMath/PointCloud.h"
+#include "../PatrickMath/Collision.h"
+#include "../PatrickMath/Quaternion.h"
+#include "../PatrickMath/Matrix4.h"
+#include "../PatrickMath/TransformHierarchy.h"
+#include "../PatrickMath/Animation.h"
+#include "../PatrickMath/Instrumentation.h"
+#include "../PatrickMath/Curve.h"
+#include "../PatrickMath/RadixSort.h"
+#include "../PatrickMath/Distance.h"
+#include "../PatrickMath/Affine3x4.h"
+#include "../PatrickMath/Stream.h"
+#include "../PatrickMath/Mesh.h"
+#include "../PatrickMath/Rotation.h"
+#include "../PatrickMath/Ring.h"
+#include "../PatrickMath/ParallelFor.h"
 
+#include <algorithm>
+#include <float.h>
 #include <iostream>
 #include <limits>
+#include <malloc.h>
+#include <math.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
 
 bool testAdd()
 {
@@ -123,46 +151,2794 @@ bool testCross()
 	return resultContainer.x == 0 && resultContainer.y == 0 && resultContainer.z == 1 && resultContainer.w == 0;
 }
 
-bool testSin()
+/*!
+* Property test harness: random inputs go through a SIMD kernel and a scalar double reference, every lane's error is
+* measured in ulp and both kernels are timed so that the speed and the accuracy of an operation are always reported
+* together.  The error is taken relative to a per lane scale (the magnitude that sets the precision of the result, the
+* result itself for element wise operations, |a||b| for products that can cancel).
+*/
+typedef void (*SimdKernel)(const Vector4::Container *a, const Vector4::Container *b, Vector4::Container *results,
+	size_t count);
+typedef void (*ReferenceKernel)(const Vector4::Container &a, const Vector4::Container &b, double results [4],
+	double scales [4]);
+
+static double seconds()
+{
+	LARGE_INTEGER counter, frequency;
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	return double(counter.QuadPart) / double(frequency.QuadPart);
+}
+
+/*!
+* \return the distance between value and reference in units in the last place of a float of magnitude scale
+*/
+static double ulpError(float value, double reference, double scale)
+{
+	int exponent;
+	frexp(scale > double(FLT_MIN) ? scale : double(FLT_MIN), &exponent);
+	return fabs(double(value) - reference) / ldexp(1.0, exponent - 24);
+}
+
+static void fillRandom(Vector4::Container *values, size_t count, float low, float high, uint64_t seed)
 {
-	float maxDeviance = 0.f;
-	float averageDeviance = 0.f;
+	XmmRandom random (seed);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		_mm_store_ps(values[i].elements, random.nextFloat(XmmFloat(low), XmmFloat(high)));
+	}
+}
+
+/*!
+* Runs one property check and prints max and mean ulp with the time per element of both kernels
+* \param maxUlp the largest error allowed on any lane
+* \param meanUlp the largest mean error allowed
+* \return false if a threshold is exceeded, any result is NaN, or (release builds only) the SIMD kernel is clearly
+* slower than the scalar double reference.  Each side is timed several times and the fastest run kept, so a run that
+* lost the CPU to something else does not count.
+*/
+static bool checkProperty(const char *name, SimdKernel simd, ReferenceKernel reference, float low, float high,
+	double maxUlp, double meanUlp)
+{
+	const size_t count = 4096;
+	const int repeats = 32;
+	const int trials = 5;
+	static Vector4::Container a[count], b[count], results[count];
+	static double referenceResults[count][4], scales[count][4];
+	fillRandom(a, count, low, high, 1);
+	fillRandom(b, count, low, high, 2);
 
-	for ( int32_t i = 0; i < 1024; i++ )
+	double simdTime = DBL_MAX, referenceTime = DBL_MAX;
+	for ( int trial = 0; trial < trials; trial++ )
 	{
-		float randValue = float(rand())/float(RAND_MAX);
-		randValue *= 3.14159265f - (3.14159265f/2.f);
+		double start = seconds();
+		for ( int repeat = 0; repeat < repeats; repeat++ )
+		{
+			simd(a, b, results, count);
+		}
+		simdTime = std::min(simdTime, (seconds() - start) / (repeats * count));
 
-		float sinValue = sinf(randValue);
-		XmmFloat xmmValue (randValue);
-		XmmFloat xmmSin = xmmValue.sin();
-		float xmmResult;
-		xmmSin.get(xmmResult);
+		start = seconds();
+		for ( int repeat = 0; repeat < repeats; repeat++ )
+		{
+			for ( size_t i = 0; i < count; i++ )
+			{
+				reference(a[i], b[i], referenceResults[i], scales[i]);
+			}
+		}
+		referenceTime = std::min(referenceTime, (seconds() - start) / (repeats * count));
+	}
 
-		float deviance = fabs(xmmResult - sinValue);
-		if ( deviance > maxDeviance )
+	double worst = 0.0, total = 0.0;
+	bool finite = true;
+	for ( size_t i = 0; i < count; i++ )
+	{
+		for ( int lane = 0; lane < 4; lane++ )
 		{
-			maxDeviance = deviance;
+			double error = ulpError(results[i].elements[lane], referenceResults[i][lane], scales[i][lane]);
+			finite = finite && error == error;
+			worst = error > worst ? error : worst;
+			total += error;
 		}
-		averageDeviance += deviance;
-		std::cout << "input: " << randValue << "; sin: " << sinValue << "; xmm sin: " << xmmResult << std::endl;
 	}
+	double mean = total / (count * 4);
 
-	averageDeviance /= 1024.f;
+	std::cout << "  " << name << ": max " << worst << " ulp, mean " << mean << " ulp, " << simdTime * 1.0e9 <<
+		" ns (reference " << referenceTime * 1.0e9 << " ns)" << std::endl;
 
-	std::cout << "Sin test, average deviance:" << averageDeviance << "; max deviance:" << maxDeviance << std::endl;;
+	bool pass = finite && worst <= maxUlp && mean <= meanUlp;
+#ifdef NDEBUG
+	pass = pass && simdTime <= referenceTime * 1.5;
+#endif
+	return pass;
+}
 
-	return true;
+static void elementScales(const double results [4], double scales [4])
+{
+	for ( int lane = 0; lane < 4; lane++ )
+	{
+		scales[lane] = fabs(results[lane]);
+	}
+}
+
+static void simdAdd(const Vector4::Container *a, const Vector4::Container *b, Vector4::Container *results, size_t count)
+{
+	for ( size_t i = 0; i < count; i++ )
+	{
+		(Vector4(a[i]) + Vector4(b[i])).get(results[i]);
+	}
+}
+
+static void referenceAdd(const Vector4::Container &a, const Vector4::Container &b, double results [4], double scales [4])
+{
+	for ( int lane = 0; lane < 4; lane++ )
+	{
+		results[lane] = double(a.elements[lane]) + b.elements[lane];
+	}
+	elementScales(results, scales);
+}
+
+static void simdSubtract(const Vector4::Container *a, const Vector4::Container *b, Vector4::Container *results, size_t count)
+{
+	for ( size_t i = 0; i < count; i++ )
+	{
+		(Vector4(a[i]) - Vector4(b[i])).get(results[i]);
+	}
+}
+
+static void referenceSubtract(const Vector4::Container &a, const Vector4::Container &b, double results [4], double scales [4])
+{
+	for ( int lane = 0; lane < 4; lane++ )
+	{
+		results[lane] = double(a.elements[lane]) - b.elements[lane];
+	}
+	elementScales(results, scales);
+}
+
+static void simdMultiply(const Vector4::Container *a, const Vector4::Container *b, Vector4::Container *results, size_t count)
+{
+	for ( size_t i = 0; i < count; i++ )
+	{
+		_mm_store_ps(results[i].elements, XmmFloat(_mm_load_ps(a[i].elements)) * XmmFloat(_mm_load_ps(b[i].elements)));
+	}
+}
+
+static void referenceMultiply(const Vector4::Container &a, const Vector4::Container &b, double results [4], double scales [4])
+{
+	for ( int lane = 0; lane < 4; lane++ )
+	{
+		results[lane] = double(a.elements[lane]) * b.elements[lane];
+	}
+	elementScales(results, scales);
+}
+
+static void simdDivide(const Vector4::Container *a, const Vector4::Container *b, Vector4::Container *results, size_t count)
+{
+	for ( size_t i = 0; i < count; i++ )
+	{
+		_mm_store_ps(results[i].elements, XmmFloat(_mm_load_ps(a[i].elements)) / XmmFloat(_mm_load_ps(b[i].elements)));
+	}
+}
+
+static void referenceDivide(const Vector4::Container &a, const Vector4::Container &b, double results [4], double scales [4])
+{
+	for ( int lane = 0; lane < 4; lane++ )
+	{
+		results[lane] = double(a.elements[lane]) / b.elements[lane];
+	}
+	elementScales(results, scales);
+}
+
+static void simdSqrt(const Vector4::Container *a, const Vector4::Container *, Vector4::Container *results, size_t count)
+{
+	for ( size_t i = 0; i < count; i++ )
+	{
+		_mm_store_ps(results[i].elements, XmmFloat(_mm_load_ps(a[i].elements)).sqrt());
+	}
+}
+
+static void referenceSqrt(const Vector4::Container &a, const Vector4::Container &, double results [4], double scales [4])
+{
+	for ( int lane = 0; lane < 4; lane++ )
+	{
+		results[lane] = sqrt(double(a.elements[lane]));
+	}
+	elementScales(results, scales);
+}
+
+static void simdInvSqrt(const Vector4::Container *a, const Vector4::Container *, Vector4::Container *results, size_t count)
+{
+	for ( size_t i = 0; i < count; i++ )
+	{
+		_mm_store_ps(results[i].elements, XmmFloat(_mm_load_ps(a[i].elements)).invSqrt());
+	}
+}
+
+static void referenceInvSqrt(const Vector4::Container &a, const Vector4::Container &, double results [4], double scales [4])
+{
+	for ( int lane = 0; lane < 4; lane++ )
+	{
+		results[lane] = 1.0 / sqrt(double(a.elements[lane]));
+	}
+	elementScales(results, scales);
+}
+
+static void simdInverse(const Vector4::Container *a, const Vector4::Container *, Vector4::Container *results, size_t count)
+{
+	for ( size_t i = 0; i < count; i++ )
+	{
+		_mm_store_ps(results[i].elements, XmmFloat(_mm_load_ps(a[i].elements)).inverse());
+	}
+}
+
+static void referenceInverse(const Vector4::Container &a, const Vector4::Container &, double results [4], double scales [4])
+{
+	for ( int lane = 0; lane < 4; lane++ )
+	{
+		results[lane] = 1.0 / a.elements[lane];
+	}
+	elementScales(results, scales);
+}
+
+// trig errors are absolute, in ulp of 1
+static void simdSin(const Vector4::Container *a, const Vector4::Container *, Vector4::Container *results, size_t count)
+{
+	for ( size_t i = 0; i < count; i++ )
+	{
+		_mm_store_ps(results[i].elements, XmmFloat(_mm_load_ps(a[i].elements)).sin());
+	}
+}
+
+static void referenceSin(const Vector4::Container &a, const Vector4::Container &, double results [4], double scales [4])
+{
+	for ( int lane = 0; lane < 4; lane++ )
+	{
+		results[lane] = sin(double(a.elements[lane]));
+		scales[lane] = 1.0;
+	}
+}
+
+static void simdCos(const Vector4::Container *a, const Vector4::Container *, Vector4::Container *results, size_t count)
+{
+	for ( size_t i = 0; i < count; i++ )
+	{
+		_mm_store_ps(results[i].elements, XmmFloat(_mm_load_ps(a[i].elements)).cos());
+	}
+}
+
+static void referenceCos(const Vector4::Container &a, const Vector4::Container &, double results [4], double scales [4])
+{
+	for ( int lane = 0; lane < 4; lane++ )
+	{
+		results[lane] = cos(double(a.elements[lane]));
+		scales[lane] = 1.0;
+	}
+}
+
+// sin of a in lanes x and y, cos of a in lanes z and w
+static void simdSinCos(const Vector4::Container *a, const Vector4::Container *, Vector4::Container *results, size_t count)
+{
+	for ( size_t i = 0; i < count; i++ )
+	{
+		XmmFloat sinResult, cosResult;
+		XmmFloat(_mm_load_ps(a[i].elements)).sinCos(sinResult, cosResult);
+		_mm_store_ps(results[i].elements, _mm_shuffle_ps(sinResult, cosResult, _MM_SHUFFLE(3,2,1,0)));
+	}
+}
+
+static void referenceSinCos(const Vector4::Container &a, const Vector4::Container &, double results [4], double scales [4])
+{
+	results[0] = sin(double(a.x));
+	results[1] = sin(double(a.y));
+	results[2] = cos(double(a.z));
+	results[3] = cos(double(a.w));
+	scales[0] = scales[1] = scales[2] = scales[3] = 1.0;
+}
+
+static void simdAtan2(const Vector4::Container *a, const Vector4::Container *b, Vector4::Container *results, size_t count)
+{
+	for ( size_t i = 0; i < count; i++ )
+	{
+		_mm_store_ps(results[i].elements, XmmFloat::atan2(_mm_load_ps(a[i].elements), _mm_load_ps(b[i].elements)));
+	}
+}
+
+static void referenceAtan2(const Vector4::Container &a, const Vector4::Container &b, double results [4], double scales [4])
+{
+	for ( int lane = 0; lane < 4; lane++ )
+	{
+		results[lane] = atan2(double(a.elements[lane]), double(b.elements[lane]));
+		scales[lane] = fabs(results[lane]);
+	}
+}
+
+static void simdDot(const Vector4::Container *a, const Vector4::Container *b, Vector4::Container *results, size_t count)
+{
+	for ( size_t i = 0; i < count; i++ )
+	{
+		_mm_store_ps(results[i].elements, Vector4(a[i]).dotProduct(Vector4(b[i])));
+	}
+}
+
+static void referenceDot(const Vector4::Container &a, const Vector4::Container &b, double results [4], double scales [4])
+{
+	double dot = 0.0, scale = 0.0;
+	for ( int lane = 0; lane < 4; lane++ )
+	{
+		dot += double(a.elements[lane]) * b.elements[lane];
+		scale += fabs(double(a.elements[lane]) * b.elements[lane]);
+	}
+	results[0] = results[1] = results[2] = results[3] = dot;
+	scales[0] = scales[1] = scales[2] = scales[3] = scale;
+}
+
+static void simdCross(const Vector4::Container *a, const Vector4::Container *b, Vector4::Container *results, size_t count)
+{
+	for ( size_t i = 0; i < count; i++ )
+	{
+		(Vector4(a[i]) ^ Vector4(b[i])).get(results[i]);
+	}
+}
+
+static void referenceCross(const Vector4::Container &a, const Vector4::Container &b, double results [4], double scales [4])
+{
+	results[0] = double(a.y) * b.z - double(a.z) * b.y;
+	results[1] = double(a.z) * b.x - double(a.x) * b.z;
+	results[2] = double(a.x) * b.y - double(a.y) * b.x;
+	// w is a.w b.w - b.w a.w, exactly 0 unless the compiler fuses one side of it
+	results[3] = 0.0;
+	scales[0] = fabs(double(a.y) * b.z) + fabs(double(a.z) * b.y);
+	scales[1] = fabs(double(a.z) * b.x) + fabs(double(a.x) * b.z);
+	scales[2] = fabs(double(a.x) * b.y) + fabs(double(a.y) * b.x);
+	scales[3] = 2.0 * fabs(double(a.w) * b.w);
+}
+
+static void simdNormalize(const Vector4::Container *a, const Vector4::Container *, Vector4::Container *results, size_t count)
+{
+	for ( size_t i = 0; i < count; i++ )
+	{
+		Vector4(a[i]).normalize().get(results[i]);
+	}
+}
+
+static void referenceNormalize(const Vector4::Container &a, const Vector4::Container &, double results [4], double scales [4])
+{
+	double length = 0.0;
+	for ( int lane = 0; lane < 4; lane++ )
+	{
+		length += double(a.elements[lane]) * a.elements[lane];
+	}
+	length = sqrt(length);
+	for ( int lane = 0; lane < 4; lane++ )
+	{
+		results[lane] = a.elements[lane] / length;
+		scales[lane] = 1.0;
+	}
+}
+
+static void simdQuaternionMultiply(const Vector4::Container *a, const Vector4::Container *b, Vector4::Container *results,
+	size_t count)
+{
+	for ( size_t i = 0; i < count; i++ )
+	{
+		__m128 product = Quaternion(_mm_load_ps(a[i].elements)) * Quaternion(_mm_load_ps(b[i].elements));
+		_mm_store_ps(results[i].elements, product);
+	}
+}
+
+static void referenceQuaternionMultiply(const Vector4::Container &a, const Vector4::Container &b, double results [4],
+	double scales [4])
+{
+	double ax = a.x, ay = a.y, az = a.z, aw = a.w;
+	double bx = b.x, by = b.y, bz = b.z, bw = b.w;
+	results[0] = aw * bx + ax * bw + ay * bz - az * by;
+	results[1] = aw * by - ax * bz + ay * bw + az * bx;
+	results[2] = aw * bz + ax * by - ay * bx + az * bw;
+	results[3] = aw * bw - ax * bx - ay * by - az * bz;
+	double scale = sqrt(ax * ax + ay * ay + az * az + aw * aw) * sqrt(bx * bx + by * by + bz * bz + bw * bw);
+	scales[0] = scales[1] = scales[2] = scales[3] = scale;
+}
+
+// a is turned into a unit quaternion, b is the point (w = 1) to rotate
+static void simdRotate(const Vector4::Container *a, const Vector4::Container *b, Vector4::Container *results, size_t count)
+{
+	const __m128 point = _mm_set_ps(1.f, 0.f, 0.f, 0.f);
+	const __m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	for ( size_t i = 0; i < count; i++ )
+	{
+		Quaternion rotation = Quaternion(_mm_load_ps(a[i].elements)).normalize();
+		Vector4 vector (_mm_or_ps(_mm_and_ps(_mm_load_ps(b[i].elements), xyzMask), point));
+		rotation.applyRotation(vector).get(results[i]);
+	}
+}
+
+static void referenceRotate(const Vector4::Container &a, const Vector4::Container &b, double results [4], double scales [4])
+{
+	double norm = sqrt(double(a.x) * a.x + double(a.y) * a.y + double(a.z) * a.z + double(a.w) * a.w);
+	double x = a.x / norm, y = a.y / norm, z = a.z / norm, w = a.w / norm;
+	double vx = b.x, vy = b.y, vz = b.z;
+
+	// t = 2 (u x v), v + w t + u x t
+	double tx = 2.0 * (y * vz - z * vy), ty = 2.0 * (z * vx - x * vz), tz = 2.0 * (x * vy - y * vx);
+	results[0] = vx + w * tx + (y * tz - z * ty);
+	results[1] = vy + w * ty + (z * tx - x * tz);
+	results[2] = vz + w * tz + (x * ty - y * tx);
+	results[3] = 1.0;
+	double scale = sqrt(vx * vx + vy * vy + vz * vz);
+	scales[0] = scales[1] = scales[2] = scale;
+	scales[3] = 1.0;
+}
+
+// the matrix is fromTransform(b, unit a, 1), applied to the point b
+static void simdTransform(const Vector4::Container *a, const Vector4::Container *b, Vector4::Container *results,
+	size_t count)
+{
+	const __m128 point = _mm_set_ps(1.f, 0.f, 0.f, 0.f);
+	const __m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	const Vector4 scale (_mm_set1_ps(1.f));
+	for ( size_t i = 0; i < count; i++ )
+	{
+		Vector4 vector (_mm_or_ps(_mm_and_ps(_mm_load_ps(b[i].elements), xyzMask), point));
+		Matrix4 transform = Matrix4::fromTransform(vector, Quaternion(_mm_load_ps(a[i].elements)).normalize(), scale);
+		transform.transform(vector).get(results[i]);
+	}
+}
+
+static void referenceTransform(const Vector4::Container &a, const Vector4::Container &b, double results [4],
+	double scales [4])
+{
+	referenceRotate(a, b, results, scales);
+	results[0] += b.x;
+	results[1] += b.y;
+	results[2] += b.z;
+	for ( int lane = 0; lane < 3; lane++ )
+	{
+		scales[lane] *= 2.0;
+	}
+}
+
+bool testAccuracyArithmetic()
+{
+	bool pass = true;
+	pass = checkProperty("add", simdAdd, referenceAdd, -1000.f, 1000.f, 0.5, 0.5) && pass;
+	pass = checkProperty("subtract", simdSubtract, referenceSubtract, -1000.f, 1000.f, 0.5, 0.5) && pass;
+	pass = checkProperty("multiply", simdMultiply, referenceMultiply, -1000.f, 1000.f, 0.5, 0.5) && pass;
+	pass = checkProperty("divide", simdDivide, referenceDivide, 0.001f, 1000.f, 0.5, 0.5) && pass;
+	pass = checkProperty("sqrt", simdSqrt, referenceSqrt, 0.f, 1000.f, 0.5, 0.5) && pass;
+
+	// the hardware estimates are good to 1.5 * 2^-12 relative, up to 6144 ulp at the bottom of a binade
+	pass = checkProperty("invSqrt", simdInvSqrt, referenceInvSqrt, 0.001f, 1000.f, 6144.0, 1536.0) && pass;
+	pass = checkProperty("inverse", simdInverse, referenceInverse, 0.001f, 1000.f, 6144.0, 1536.0) && pass;
+	return pass;
+}
+
+bool testAccuracyGeometry()
+{
+	bool pass = true;
+	pass = checkProperty("dotProduct", simdDot, referenceDot, -100.f, 100.f, 2.0, 0.5) && pass;
+	pass = checkProperty("crossProduct", simdCross, referenceCross, -100.f, 100.f, 2.0, 0.5) && pass;
+	pass = checkProperty("normalize", simdNormalize, referenceNormalize, -100.f, 100.f, 2.0, 1.0) && pass;
+	pass = checkProperty("Quaternion::multiply", simdQuaternionMultiply, referenceQuaternionMultiply, -10.f, 10.f, 4.0, 1.0) &&
+		pass;
+	pass = checkProperty("Quaternion::applyRotation", simdRotate, referenceRotate, -10.f, 10.f, 8.0, 2.0) && pass;
+	pass = checkProperty("Matrix4::transform", simdTransform, referenceTransform, -10.f, 10.f, 8.0, 2.0) && pass;
+	return pass;
+}
+
+bool testSin()
+{
+	bool pass = true;
+
+	// sin and cos are the fast parabola fit, about 0.001 absolute over [-pi/2, pi/2]
+	pass = checkProperty("sin", simdSin, referenceSin, -1.5707963f, 1.5707963f, 10000.0, 5000.0) && pass;
+	pass = checkProperty("cos", simdCos, referenceCos, -1.5707963f, 1.5707963f, 10000.0, 5000.0) && pass;
+	pass = checkProperty("sinCos", simdSinCos, referenceSinCos, -100.f, 100.f, 2.0, 0.5) && pass;
+	pass = checkProperty("atan2", simdAtan2, referenceAtan2, -100.f, 100.f, 4.0, 1.0) && pass;
+
+	// signed zeros pick the quadrant by their sign bit, down to the sign of a zero result
+	__declspec(align(16)) float y [4] = {0.f, -0.f, 0.f, -0.f};
+	__declspec(align(16)) float x [4] = {0.f, 0.f, -0.f, -0.f};
+	__declspec(align(16)) float angles [4];
+	_mm_store_ps(angles, XmmFloat::atan2(_mm_load_ps(y), _mm_load_ps(x)));
+	for ( int lane = 0; lane < 4; lane++ )
+	{
+		float expected = atan2f(y[lane], x[lane]);
+		pass = pass && memcmp(&angles[lane], &expected, sizeof(float)) == 0;
+	}
+	return pass;
 }
 
 bool testNormalize()
 {
-	return false;
+	bool pass = true;
+	XmmRandom random (7);
+	for ( int i = 0; i < 256; i++ )
+	{
+		Vector4 vector (random.nextFloat(XmmFloat(-100.f), XmmFloat(100.f)));
+		float length;
+		XmmFloat(_mm_sqrt_ps(vector.normalize().dotProduct(vector.normalize()))).get(length);
+		pass = pass && fabsf(length - 1.f) <= 1.0e-6f;
+	}
+
+	Vector4 zero (_mm_setzero_ps());
+	pass = pass && (zero.safeNormalize() == zero).getValue();
+	pass = pass && (zero.safeNormalizeSq() == zero).getValue();
+
+	// a short vector is still above the default epsilons and has to come back unit length
+	Vector4 shortVector (_mm_set_ps(0.f, 0.f, 0.3f, 0.4f));
+	Vector4 expected (_mm_set_ps(0.f, 0.f, 0.6f, 0.8f));
+	pass = pass && shortVector.safeNormalize().isEqual(expected, XmmFloat(1.0e-6f)).getValue();
+	pass = pass && shortVector.safeNormalizeSq().isEqual(expected, XmmFloat(1.0e-6f)).getValue();
+	return pass;
 }
 
 bool testEquality()
 {
-	return false;
+	bool pass = true;
+	XmmRandom random (11);
+	const XmmFloat epsilon (0.01f);
+	for ( int i = 0; i < 256; i++ )
+	{
+		Vector4 vector (random.nextFloat(XmmFloat(-100.f), XmmFloat(100.f)));
+		Vector4 inside (vector.add(Vector4(random.nextFloat(XmmFloat(-0.009f), XmmFloat(0.009f)))));
+		Vector4 below (vector.subtract(Vector4(_mm_set_ps(0.f, 0.02f, 0.f, 0.f))));
+		Vector4 above (vector.add(Vector4(_mm_set_ps(0.f, 0.f, 0.f, 0.02f))));
+
+		pass = pass && (vector == vector).getValue();
+		pass = pass && vector.isEqual(inside, epsilon).getValue();
+		pass = pass && !vector.isEqual(below, epsilon).getValue();
+		pass = pass && !vector.isEqual(above, epsilon).getValue();
+		pass = pass && !(vector == above).getValue();
+	}
+	return pass;
+}
+
+bool testVector4dDot()
+{
+	Vector4d::Container load = {1,2,3,4};
+	Vector4d test = Vector4d(load);
+	double result;
+
+	(test * Vector4d::UNIT_Z).get(result);
+	if ( result != 3 )
+	{
+		return false;
+	}
+
+	(test * test).get(result);
+	if ( result != 30 )
+	{
+		return false;
+	}
+
+	// a float can't represent this offset exactly, a double can
+	Vector4d::Container farLoad = {1.0e9 + 0.25, 0, 0, 0};
+	(Vector4d(farLoad) * Vector4d::UNIT_X).get(result);
+	return result == 1.0e9 + 0.25;
+}
+
+bool testVector4dCross()
+{
+	Vector4d::Container lhsLoad = {1,2,3,0};
+	Vector4d::Container rhsLoad = {4,5,6,0};
+	Vector4d result = Vector4d(lhsLoad) ^ Vector4d(rhsLoad);
+	Vector4d::Container resultContainer;
+	result.get(resultContainer);
+
+	return resultContainer.x == -3 && resultContainer.y == 6 && resultContainer.z == -3 && resultContainer.w == 0 &&
+		(Vector4d::UNIT_X ^ Vector4d::UNIT_Y).isEqual(Vector4d::UNIT_Z).getValue();
+}
+
+bool testVector4dNormalize()
+{
+	Vector4d::Container load = {3,0,4,0};
+	Vector4d::Container expected = {0.6,0,0.8,0};
+	Vector4d result = ~Vector4d(load);
+
+	return result.isEqual(Vector4d(expected), XmmDouble::EPSILON).getValue() &&
+		Vector4d::ZERO.safeNormalize().isEqual(Vector4d::ZERO).getValue() &&
+		!Vector4d(load).isEqual(Vector4d(expected), XmmDouble(0.5)).getValue();
+}
+
+bool testVector4dConvert()
+{
+	const size_t count = 5;
+	Vector4::Container floats[count];
+	Vector4d::Container doubles[count];
+	Vector4::Container roundTrip[count];
+	for ( size_t i = 0; i < count; i++ )
+	{
+		Vector4::Container load = {float(i), float(i) * 0.5f, -float(i), 1.f};
+		floats[i] = load;
+	}
+
+	Vector4d::convertBatch(floats, doubles, count);
+	Vector4d::convertBatch(doubles, roundTrip, count);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		if ( doubles[i].y != double(floats[i].y) || doubles[i].w != 1.0 ||
+			!Vector4(roundTrip[i]).isEqual(Vector4(floats[i])).getValue() )
+		{
+			return false;
+		}
+	}
+
+	// rebasing keeps the offset that a straight narrowing would lose
+	Vector4d::Container farLoad = {1.0e9 + 0.25, 0, 0, 1};
+	Vector4d::Container originLoad = {1.0e9, 0, 0, 0};
+	Vector4::Container local;
+	Vector4d::convertBatch(&farLoad, Vector4d(originLoad), &local, 1);
+	return local.x == 0.25f && local.w == 1.f;
+}
+
+bool testXmmInt()
+{
+	XmmInt::Container lhsLoad = {-7, 3, 100000, 65535};
+	XmmInt::Container rhsLoad = {3, -3, 100000, 65537};
+	XmmInt lhs (lhsLoad);
+	XmmInt rhs (rhsLoad);
+	XmmInt::Container result;
+
+	(lhs * rhs).get(result);
+	if ( result.elements[0] != -21 || result.elements[1] != -9 ||
+		result.elements[2] != int32_t(100000u * 100000u) || result.elements[3] != int32_t(65535u * 65537u) )
+	{
+		return false;
+	}
+
+	XmmInt::min(lhs, rhs).get(result);
+	if ( result.elements[0] != -7 || result.elements[1] != -3 || result.elements[3] != 65535 )
+	{
+		return false;
+	}
+
+	(lhs >> 1).get(result);
+	if ( result.elements[0] != -4 || result.elements[1] != 1 )
+	{
+		return false;
+	}
+
+	Vector4::Container floatLoad = {-1.5f, -0.5f, 0.5f, 2.f};
+	XmmInt::floor(XmmFloat(_mm_load_ps(floatLoad.elements))).get(result);
+	if ( result.elements[0] != -2 || result.elements[1] != -1 || result.elements[2] != 0 || result.elements[3] != 2 )
+	{
+		return false;
+	}
+
+	return (lhs == lhs).getValue() && !(lhs > lhs).getValue();
+}
+
+uint32_t referenceMorton30(uint32_t x, uint32_t y, uint32_t z)
+{
+	uint32_t code = 0;
+	for ( uint32_t bit = 0; bit < 10; bit++ )
+	{
+		code |= ((x >> bit) & 1) << (3 * bit);
+		code |= ((y >> bit) & 1) << (3 * bit + 1);
+		code |= ((z >> bit) & 1) << (3 * bit + 2);
+	}
+	return code;
+}
+
+bool testMortonEncode()
+{
+	const size_t count = 7;
+	Vector4::Container positions[count];
+	uint32_t cells[count][3] = {{0,0,0}, {1023,1023,1023}, {1,2,3}, {512,0,17}, {100,900,300}, {5,1000,0}, {77,77,77}};
+	for ( size_t i = 0; i < count; i++ )
+	{
+		// map cells onto [-1, 1] with the position in the middle of the cell
+		Vector4::Container position = {
+			(cells[i][0] + 0.5f) / 512.f - 1.f, (cells[i][1] + 0.5f) / 512.f - 1.f, (cells[i][2] + 0.5f) / 512.f - 1.f, 1.f};
+		positions[i] = position;
+	}
+
+	Vector4::Container minLoad = {-1,-1,-1,1};
+	Vector4::Container maxLoad = {1,1,1,1};
+	uint32_t codes[count];
+	Quantize::mortonEncode30(positions, Vector4(minLoad), Vector4(maxLoad), codes, count);
+
+	for ( size_t i = 0; i < count; i++ )
+	{
+		if ( codes[i] != referenceMorton30(cells[i][0], cells[i][1], cells[i][2]) )
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool testFixedPoint()
+{
+	float values[5] = {1.5f, -2.25f, 0.1f, 1.0e12f, -1.0e12f};
+	int32_t fixed[5];
+	float roundTrip[5];
+	Quantize::toFixedPoint(values, fixed, 5, 8);
+	Quantize::fromFixedPoint(fixed, roundTrip, 5, 8);
+
+	return fixed[0] == 384 && fixed[1] == -576 && fixed[2] == 26 &&
+		fixed[3] == std::numeric_limits<int32_t>::max() - 127 && fixed[4] == std::numeric_limits<int32_t>::min() &&
+		roundTrip[0] == 1.5f && roundTrip[1] == -2.25f;
+}
+
+bool testSinCos()
+{
+	float maxError = 0.f;
+	for ( int32_t i = -2000; i <= 2000; i++ )
+	{
+		float angle = float(i) * 0.01f;
+		XmmFloat sinResult, cosResult;
+		XmmFloat(angle).sinCos(sinResult, cosResult);
+		float sinValue, cosValue;
+		sinResult.get(sinValue);
+		cosResult.get(cosValue);
+
+		maxError = std::max(maxError, std::max(fabsf(sinValue - sinf(angle)), fabsf(cosValue - cosf(angle))));
+	}
+
+	return maxError < 1.0e-6f;
+}
+
+bool testRandom()
+{
+	XmmRandom first (1234, 0);
+	XmmRandom repeat (1234, 0);
+	XmmRandom otherStream (1234, 1);
+	XmmInt::Container a, b, c;
+	first.nextInt().get(a);
+	repeat.nextInt().get(b);
+	otherStream.nextInt().get(c);
+	if ( memcmp(&a, &b, sizeof(a)) != 0 || memcmp(&a, &c, sizeof(a)) == 0 )
+	{
+		return false;
+	}
+
+	Vector4::Container values;
+	double sum = 0.0;
+	for ( int32_t i = 0; i < 4096; i++ )
+	{
+		_mm_store_ps(values.elements, first.nextFloat());
+		for ( int32_t lane = 0; lane < 4; lane++ )
+		{
+			if ( values.elements[lane] < 0.f || values.elements[lane] >= 1.f )
+			{
+				return false;
+			}
+			sum += values.elements[lane];
+		}
+	}
+
+	return fabs(sum / (4096.0 * 4.0) - 0.5) < 0.01;
+}
+
+bool testSampling()
+{
+	const size_t count = 1023;
+	static Vector4::Container samples[count];
+	XmmRandom random (42);
+	float length;
+
+	Sampling::unitSphere(random, samples, count);
+	Vector4 sum;
+	for ( size_t i = 0; i < count; i++ )
+	{
+		Vector4 sample (samples[i]);
+		(sample * sample).get(length);
+		if ( fabsf(length - 1.f) > 1.0e-5f || samples[i].w != 0.f )
+		{
+			return false;
+		}
+		sum = sum + sample;
+	}
+	// uniform over the sphere, so the mean direction should be close to zero
+	(sum * sum).get(length);
+	if ( sqrtf(length) / count > 0.1f )
+	{
+		return false;
+	}
+
+	Sampling::cone(random, XmmFloat(0.9f), samples, count);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		if ( samples[i].z < 0.9f - 1.0e-6f )
+		{
+			return false;
+		}
+	}
+
+	Sampling::cosineHemisphere(random, samples, count);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		if ( samples[i].z < 0.f )
+		{
+			return false;
+		}
+	}
+
+	Sampling::unitDisk(random, samples, count);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		Vector4 sample (samples[i]);
+		(sample * sample).get(length);
+		if ( length > 1.f || samples[i].z != 0.f )
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool testPointCloud()
+{
+	// a box of 4x2x1 (half extents) rotated 30 degrees about z and moved away from the origin
+	const size_t count = 10007;
+	static Vector4::Container points[count];
+	const float angle = 3.14159265f / 6.f;
+	const float c = cosf(angle), s = sinf(angle);
+	XmmRandom random (7);
+	for ( size_t i = 0; i < count; i += 4 )
+	{
+		Vector4::Container u, v, w;
+		_mm_store_ps(u.elements, random.nextFloat(XmmFloat(-4.f), XmmFloat(4.f)));
+		_mm_store_ps(v.elements, random.nextFloat(XmmFloat(-2.f), XmmFloat(2.f)));
+		_mm_store_ps(w.elements, random.nextFloat(XmmFloat(-1.f), XmmFloat(1.f)));
+		for ( size_t lane = 0; lane < 4 && i + lane < count; lane++ )
+		{
+			// push the first points onto the corners so the extents are exact
+			float x = i == 0 ? (lane & 1 ? 4.f : -4.f) : u.elements[lane];
+			float y = i == 0 ? (lane & 2 ? 2.f : -2.f) : v.elements[lane];
+			float z = i == 0 ? (lane == 0 ? 1.f : -1.f) : w.elements[lane];
+			Vector4::Container point = {c * x - s * y + 1000.f, s * x + c * y - 500.f, z + 250.f, 1.f};
+			points[i + lane] = point;
+		}
+	}
+
+	// scalar double reference
+	double mean[3] = {0, 0, 0};
+	for ( size_t i = 0; i < count; i++ )
+	{
+		mean[0] += points[i].x;
+		mean[1] += points[i].y;
+		mean[2] += points[i].z;
+	}
+	mean[0] /= count;
+	mean[1] /= count;
+	mean[2] /= count;
+	double xy = 0;
+	for ( size_t i = 0; i < count; i++ )
+	{
+		xy += (points[i].x - mean[0]) * (points[i].y - mean[1]);
+	}
+	xy /= count;
+
+	PointCloud::Statistics single, threaded;
+	PointCloud::statistics(points, count, single, 1);
+	PointCloud::statistics(points, count, threaded, 4);
+	if ( memcmp(single.sum, threaded.sum, sizeof(single.sum)) != 0 ||
+		memcmp(&single.sumSq, &threaded.sumSq, sizeof(single.sumSq)) != 0 || single.count != threaded.count )
+	{
+		return false;
+	}
+
+	Vector4::Container centroid;
+	PointCloud::mean(single).get(centroid);
+	PointCloud::SymmetricMatrix3 covariance;
+	PointCloud::covariance(single, covariance);
+	if ( fabs(centroid.x - mean[0]) > 1.0e-3 || fabs(centroid.z - mean[2]) > 1.0e-3 || fabs(covariance.xy - xy) > 1.0e-3 )
+	{
+		return false;
+	}
+
+	Vector4 boundsMin, boundsMax;
+	PointCloud::bounds(points, count, boundsMin, boundsMax, 3);
+	Vector4::Container minContainer;
+	boundsMin.get(minContainer);
+	if ( minContainer.z != 249.f || minContainer.w != 1.f )
+	{
+		return false;
+	}
+
+	PointCloud::OrientedBox box;
+	PointCloud::orientedBox(points, count, box, 2);
+	Vector4::Container halfExtents, axis;
+	box.halfExtents.get(halfExtents);
+	box.axes[0].get(axis);
+	return fabsf(halfExtents.x - 4.f) < 1.0e-2f && fabsf(halfExtents.y - 2.f) < 1.0e-2f &&
+		fabsf(halfExtents.z - 1.f) < 1.0e-2f && fabsf(fabsf(axis.x) - c) < 1.0e-2f && fabsf(fabsf(axis.y) - s) < 1.0e-2f;
+}
+
+bool testEigenSymmetric()
+{
+	PointCloud::SymmetricMatrix3 matrix = {4.0, 3.0, 2.0, 1.0, 0.5, 0.25};
+	double eigenvalues[3];
+	Vector4 eigenvectors[3];
+	PointCloud::eigenSymmetric(matrix, eigenvalues, eigenvectors);
+
+	for ( int i = 0; i < 3; i++ )
+	{
+		Vector4::Container v;
+		eigenvectors[i].get(v);
+		double av[3] = {
+			matrix.xx * v.x + matrix.xy * v.y + matrix.xz * v.z,
+			matrix.xy * v.x + matrix.yy * v.y + matrix.yz * v.z,
+			matrix.xz * v.x + matrix.yz * v.y + matrix.zz * v.z};
+		if ( fabs(av[0] - eigenvalues[i] * v.x) > 1.0e-5 || fabs(av[1] - eigenvalues[i] * v.y) > 1.0e-5 ||
+			fabs(av[2] - eigenvalues[i] * v.z) > 1.0e-5 )
+		{
+			return false;
+		}
+	}
+
+	return eigenvalues[0] >= eigenvalues[1] && eigenvalues[1] >= eigenvalues[2] &&
+		fabs(eigenvalues[0] + eigenvalues[1] + eigenvalues[2] - 9.0) < 1.0e-9;
+}
+
+static Vector4 makePoint(float x, float y, float z)
+{
+	Vector4::Container point = {x, y, z, 1.f};
+	return Vector4(point);
+}
+
+static Vector4 makeDirection(float x, float y, float z)
+{
+	Vector4::Container direction = {x, y, z, 0.f};
+	return Vector4(direction);
+}
+
+static bool nearlyEqual(float lhs, float rhs, float epsilon)
+{
+	return fabsf(lhs - rhs) <= epsilon;
+}
+
+bool testCollision()
+{
+	Collision::Result result;
+	Vector4::Container a, b, normal;
+
+	// separated spheres
+	Collision::query(Collision::sphere(makePoint(0, 0, 0), 1.f), Collision::sphere(makePoint(3, 0, 0), 0.5f), result);
+	result.pointA.get(a);
+	result.normal.get(normal);
+	if ( result.intersecting || !nearlyEqual(result.distance, 1.5f, 1.0e-4f) || !nearlyEqual(a.x, 1.f, 1.0e-4f) ||
+		!nearlyEqual(normal.x, 1.f, 1.0e-4f) )
+	{
+		return false;
+	}
+
+	// overlapping spheres, the cores touch only through the radii
+	Collision::query(Collision::sphere(makePoint(0, 0, 0), 1.f), Collision::sphere(makePoint(0, 1.5f, 0), 1.f), result);
+	result.normal.get(normal);
+	if ( !result.intersecting || !nearlyEqual(result.distance, -0.5f, 1.0e-4f) || !nearlyEqual(normal.y, 1.f, 1.0e-4f) )
+	{
+		return false;
+	}
+
+	// unit boxes overlapping by 0.25 along y, EPA has to find the shallow axis
+	Collision::Shape boxA = Collision::box(makePoint(0, 0, 0), Vector4::UNIT_X, Vector4::UNIT_Y, Vector4::UNIT_Z);
+	Collision::Shape boxB = Collision::box(
+		makePoint(0.5f, 1.75f, 0.25f), makeDirection(2, 0, 0), makeDirection(0, 1, 0), makeDirection(0, 0, 1));
+	Collision::query(boxA, boxB, result);
+	result.normal.get(normal);
+	if ( !result.intersecting || !nearlyEqual(result.distance, -0.25f, 1.0e-3f) ||
+		!nearlyEqual(fabsf(normal.y), 1.f, 1.0e-3f) || !Collision::intersect(boxA, boxB) )
+	{
+		return false;
+	}
+
+	// capsule against sphere beside its middle
+	Collision::Shape capsule = Collision::capsule(makePoint(-2, 0, 0), makePoint(2, 0, 0), 0.5f);
+	Collision::query(capsule, Collision::sphere(makePoint(0.5f, 0, 2), 1.f), result);
+	result.pointA.get(a);
+	result.pointB.get(b);
+	if ( result.intersecting || !nearlyEqual(result.distance, 0.5f, 1.0e-4f) || !nearlyEqual(a.x, 0.5f, 1.0e-3f) ||
+		!nearlyEqual(a.z, 0.5f, 1.0e-4f) || !nearlyEqual(b.z, 1.f, 1.0e-4f) )
+	{
+		return false;
+	}
+
+	// hull support against brute force, odd vertex count to exercise the tail
+	const size_t vertexCount = 37;
+	static Vector4::Container vertices[vertexCount];
+	for ( size_t i = 0; i < vertexCount; i++ )
+	{
+		Vector4::Container vertex = {sinf(i * 1.3f) * 3.f, cosf(i * 2.1f) * 2.f, sinf(i * 0.7f + 1.f), 1.f};
+		vertices[i] = vertex;
+	}
+	for ( int trial = 0; trial < 16; trial++ )
+	{
+		Vector4 direction = makeDirection(cosf(trial * 0.4f), sinf(trial * 0.4f), trial * 0.1f - 0.8f);
+		Vector4::Container d;
+		direction.get(d);
+		float bestDot = -FLT_MAX;
+		for ( size_t i = 0; i < vertexCount; i++ )
+		{
+			float value = vertices[i].x * d.x + vertices[i].y * d.y + vertices[i].z * d.z;
+			if ( value > bestDot )
+			{
+				bestDot = value;
+			}
+		}
+		Collision::hullSupport(vertices, vertexCount, direction).get(a);
+		if ( !nearlyEqual(a.x * d.x + a.y * d.y + a.z * d.z, bestDot, 1.0e-5f) )
+		{
+			return false;
+		}
+	}
+
+	// rounded hulls of points spread over unit spheres with nearly the same center, EPA has to grow the polytope all
+	// round and runs out of room before it converges, it must still answer with the closest face it has
+	const size_t sphereCount = 4096;
+	static Vector4::Container sphereA[sphereCount], sphereB[sphereCount];
+	for ( size_t i = 0; i < sphereCount; i++ )
+	{
+		float z = 1.f - (2.f * i + 1.f) / sphereCount;
+		float radius = sqrtf(1.f - z * z);
+		Vector4::Container vertex = {radius * cosf(i * 2.39996323f), radius * sinf(i * 2.39996323f), z, 1.f};
+		sphereA[i] = vertex;
+		Vector4::Container turned = {0.2f - vertex.y, 0.1f + vertex.x, vertex.z, 1.f};
+		sphereB[i] = turned;
+	}
+#ifdef PATRICKMATH_INSTRUMENT
+	Instrumentation::reset();
+#endif
+	Collision::query(Collision::hull(sphereA, sphereCount, 0.25f), Collision::hull(sphereB, sphereCount, 0.25f), result);
+#ifdef PATRICKMATH_INSTRUMENT
+	// one iteration per vertex added after the tetrahedron, and the one that finds the polytope full
+	if ( Instrumentation::total(Instrumentation::COLLISION_EPA_ITERATION) != 61 )
+	{
+		return false;
+	}
+#endif
+	result.normal.get(normal);
+	float centerDistance = sqrtf(0.2f * 0.2f + 0.1f * 0.1f);
+	if ( !result.intersecting || !nearlyEqual(result.distance, centerDistance - 2.5f, 5.0e-2f) ||
+		normal.x * 0.2f + normal.y * 0.1f < 0.9f * centerDistance )
+	{
+		return false;
+	}
+
+	// batch: hull against spheres sliding through it must agree with the single queries
+	const size_t pairCount = 64;
+	static Collision::Shape shapesA[pairCount], shapesB[pairCount];
+	static Collision::Result results[pairCount];
+	for ( size_t i = 0; i < pairCount; i++ )
+	{
+		shapesA[i] = Collision::hull(vertices, vertexCount);
+		shapesB[i] = Collision::sphere(makePoint(i * 0.2f - 6.4f, 0.3f, -0.2f), 0.5f);
+	}
+	Collision::queryBatch(shapesA, shapesB, results, pairCount, 4);
+	for ( size_t i = 0; i < pairCount; i++ )
+	{
+		Collision::query(shapesA[i], shapesB[i], result);
+		if ( result.distance != results[i].distance || result.intersecting != results[i].intersecting ||
+			result.intersecting != Collision::intersect(shapesA[i], shapesB[i]) )
+		{
+			return false;
+		}
+
+		// moving b by -distance along the normal should leave the shapes just touching
+		Vector4 offset = Vector4(_mm_mul_ps(results[i].normal, _mm_set1_ps(-results[i].distance)));
+		Collision::Shape moved = shapesB[i];
+		moved.points[0] = moved.points[0] + offset;
+		Collision::query(shapesA[i], moved, result);
+		if ( !nearlyEqual(result.distance, 0.f, 2.0e-3f) )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool testQuaternion()
+{
+	// a quarter turn about z takes x to y, composing two of them takes x to -x
+	Quaternion quarter (Vector4::UNIT_Z, XmmFloat(3.14159265f * 0.5f));
+	XmmFloat epsilon (1.0e-5f);
+	if ( !quarter.applyRotation(Vector4::UNIT_X).isEqual(Vector4::UNIT_Y, epsilon).getValue() ||
+		!(quarter * quarter).applyRotation(Vector4::UNIT_X).isEqual(-Vector4::UNIT_X, epsilon).getValue() )
+	{
+		return false;
+	}
+
+	// the product applies rhs first, and dividing by a rotation undoes it
+	Vector4::Container axisContainer = {1.f, 2.f, -0.5f, 0.f};
+	Quaternion tilt (Vector4(axisContainer).normalize(), XmmFloat(0.7f));
+	Vector4::Container pointContainer = {0.3f, -1.2f, 2.f, 1.f};
+	Vector4 point (pointContainer);
+	Vector4 sequential = quarter.applyRotation(tilt.applyRotation(point));
+	if ( !(quarter * tilt).applyRotation(point).isEqual(sequential, epsilon).getValue() ||
+		!((quarter * tilt) / tilt).isEqual(quarter, epsilon).getValue() ||
+		!(tilt * tilt.conjugate()).isEqual(Quaternion::IDENTITY, epsilon).getValue() )
+	{
+		return false;
+	}
+
+	// matrices built from the same rotation agree, and w picks the translation up or not
+	Vector4::Container scaleContainer = {2.f, 3.f, 4.f, 0.f};
+	Vector4::Container translationContainer = {10.f, 20.f, 30.f, 1.f};
+	Vector4 scale (scaleContainer), translation (translationContainer);
+	Matrix4 transform = Matrix4::fromTransform(translation, tilt, scale);
+	Vector4 expected = tilt.applyRotation(Vector4(_mm_mul_ps(point, _mm_set_ps(1.f, 4.f, 3.f, 2.f)))) +
+		Vector4(_mm_set_ps(0.f, 30.f, 20.f, 10.f));
+	Vector4 direction = Vector4::UNIT_Y;
+	if ( !(transform * point).isEqual(expected, XmmFloat(1.0e-4f)).getValue() ||
+		!(transform * direction).isEqual(tilt.applyRotation(Vector4(_mm_set_ps(0.f, 0.f, 3.f, 0.f))), epsilon).getValue() ||
+		!(transform * Matrix4::IDENTITY).isEqual(transform, XmmFloat(0.f)).getValue() ||
+		!transform.transpose().transpose().isEqual(transform, XmmFloat(0.f)).getValue() )
+	{
+		return false;
+	}
+	return true;
+}
+
+static Matrix4 referenceWorld(const uint32_t *parents, const Matrix4 *locals, uint32_t node)
+{
+	if ( parents[node] == TransformHierarchy::NO_PARENT )
+	{
+		return locals[node];
+	}
+	return referenceWorld(parents, locals, parents[node]) * locals[node];
+}
+
+bool testTransformHierarchy()
+{
+	// a random forest, every node picks a parent among the nodes before it
+	const size_t count = 20000;
+	static uint32_t parents[count];
+	static Matrix4 locals[count];
+	XmmRandom random (31);
+	TransformHierarchy hierarchy;
+	for ( size_t i = 0; i < count; i++ )
+	{
+		XmmInt::Container bits;
+		random.nextInt().get(bits);
+		parents[i] = i < 4 || bits.elements[0] % 16 == 0 ? TransformHierarchy::NO_PARENT : bits.elements[1] % i;
+	}
+	if ( !hierarchy.build(parents, count) || hierarchy.levelBegin(hierarchy.levelCount()) != count )
+	{
+		return false;
+	}
+
+	for ( size_t i = 0; i < count; i++ )
+	{
+		Vector4::Container values;
+		_mm_store_ps(values.elements, random.nextFloat(XmmFloat(-1.f), XmmFloat(1.f)));
+		Vector4::Container axis = {values.x, values.y, values.z + 2.f, 0.f};
+		Vector4::Container translation = {values.y, values.z, values.x, 1.f};
+		Vector4::Container scale = {1.f + values.w * 0.1f, 1.f, 1.f - values.w * 0.1f, 0.f};
+		Quaternion rotation (Vector4(axis).normalize(), XmmFloat(values.w));
+		locals[i] = Matrix4::fromTransform(Vector4(translation), rotation, Vector4(scale));
+		hierarchy.setLocal(hierarchy.nodeIndex(uint32_t(i)), Vector4(translation), rotation, Vector4(scale));
+	}
+	if ( hierarchy.update(4) != count || hierarchy.update(4) != 0 )
+	{
+		return false;
+	}
+
+	// parents come first and every level is contiguous
+	for ( size_t i = 0; i < count; i++ )
+	{
+		uint32_t parent = hierarchy.parent(uint32_t(i));
+		if ( parent != TransformHierarchy::NO_PARENT && parent >= i )
+		{
+			return false;
+		}
+	}
+
+	// move a few nodes, only they and their descendants may be recomputed
+	const Vector4 offset (_mm_set_ps(0.f, 0.f, 0.f, 1.f));
+	static bool moved[count];
+	size_t expected = 0;
+	for ( size_t i = 0; i < count; i++ )
+	{
+		moved[i] = i % 997 == 0 || (parents[i] != TransformHierarchy::NO_PARENT && moved[parents[i]]);
+		expected += moved[i] ? 1 : 0;
+		if ( i % 997 == 0 )
+		{
+			uint32_t node = hierarchy.nodeIndex(uint32_t(i));
+			hierarchy.setTranslation(node, hierarchy.translation(node) + offset);
+			locals[i].setColumn(3, locals[i].getColumn(3) + offset);
+		}
+	}
+	if ( hierarchy.update(4) != expected )
+	{
+		return false;
+	}
+
+	for ( size_t i = 0; i < count; i++ )
+	{
+		Matrix4 reference = referenceWorld(parents, locals, uint32_t(i));
+		if ( !hierarchy.world(hierarchy.nodeIndex(uint32_t(i))).isEqual(reference, XmmFloat(1.0e-3f)).getValue() )
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool testAnimation()
+{
+	// uneven key times, a translation track, and the same rotations as nlerp, slerp and step tracks
+	const size_t keyCount = 41;
+	static float times[keyCount];
+	static Vector4::Container translations[keyCount];
+	static Quaternion::Container rotations[keyCount];
+	double angles[keyCount];
+	for ( size_t i = 0; i < keyCount; i++ )
+	{
+		times[i] = i * 0.25f + (i % 3) * 0.05f;
+		Vector4::Container translation = {float(i), float(i * i) * 0.1f, -float(i), 1.f};
+		translations[i] = translation;
+
+		// rotations about one axis with alternating signs, which build has to undo
+		angles[i] = i * 0.3;
+		float sign = i % 2 ? -1.f : 1.f;
+		Quaternion::Container rotation = {0.f, 0.f, sign * float(sin(angles[i] * 0.5)), sign * float(cos(angles[i] * 0.5))};
+		rotations[i] = rotation;
+	}
+
+	Animation::TrackSource sources[4] = {
+		{times, translations, NULL, keyCount, Animation::LINEAR},
+		{times, NULL, rotations, keyCount, Animation::LINEAR},
+		{times, NULL, rotations, keyCount, Animation::SLERP},
+		{times, NULL, rotations, keyCount, Animation::STEP}};
+	Animation animation;
+	if ( !animation.build(sources, 4) || animation.duration() != times[keyCount - 1] )
+	{
+		return false;
+	}
+
+	uint32_t cursors[4];
+	animation.resetCursors(cursors);
+	Vector4::Container results[4];
+
+	// forward playback, then a jump back to the start (a loop) and a seek into the middle
+	for ( int step = 0; step < 140; step++ )
+	{
+		float time = step < 120 ? step * 0.09f - 0.3f : (step - 120) * 0.4f;
+		animation.sampleBatch(time, cursors, results, 2);
+
+		// scalar reference, last key at or before time
+		size_t key = 0;
+		while ( key + 1 < keyCount && times[key + 1] <= time )
+		{
+			key++;
+		}
+		size_t next = key + 1 < keyCount ? key + 1 : key;
+		double factor = next == key ? 0.0 : (time - times[key]) / double(times[next] - times[key]);
+		factor = factor < 0.0 ? 0.0 : factor;
+
+		if ( cursors[0] != key || !nearlyEqual(results[0].x, float(key + factor), 1.0e-4f) )
+		{
+			return false;
+		}
+
+		// build made the keys continuous, slerp about a fixed axis then interpolates the angle exactly
+		double angle = angles[key] + (angles[next] - angles[key]) * factor;
+		double stepAngle = angles[key];
+		if ( !nearlyEqual(results[2].z, float(sin(angle * 0.5)), 1.0e-5f) ||
+			!nearlyEqual(results[2].w, float(cos(angle * 0.5)), 1.0e-5f) ||
+			!nearlyEqual(results[1].z, float(sin(angle * 0.5)), 2.0e-3f) ||
+			!nearlyEqual(results[3].z, float(sin(stepAngle * 0.5)), 1.0e-6f) ||
+			!nearlyEqual(results[1].z * results[1].z + results[1].w * results[1].w, 1.f, 1.0e-5f) )
+		{
+			return false;
+		}
+	}
+
+	// the key search on its own, from every cursor to every time, the times need their padding
+	float padded[keyCount + 4];
+	memcpy(padded, times, sizeof(times));
+	std::fill(padded + keyCount, padded + keyCount + 4, FLT_MAX);
+	for ( uint32_t cursor = 0; cursor < keyCount; cursor++ )
+	{
+		for ( size_t key = 0; key < keyCount; key++ )
+		{
+			if ( Animation::findKey(padded, keyCount, times[key] + 0.01f, cursor) != key )
+			{
+				return false;
+			}
+		}
+		if ( Animation::findKey(padded, keyCount, std::numeric_limits<float>::infinity(), cursor) != keyCount - 1 ||
+			Animation::findKey(padded, keyCount, FLT_MAX, cursor) != keyCount - 1 )
+		{
+			return false;
+		}
+	}
+
+	// sampling past the end holds the last key, even at the padding value and beyond it
+	const float lateTimes[2] = {FLT_MAX, std::numeric_limits<float>::infinity()};
+	for ( size_t i = 0; i < 2; i++ )
+	{
+		animation.sampleBatch(lateTimes[i], cursors, results, 2);
+		if ( cursors[0] != keyCount - 1 || results[0].x != translations[keyCount - 1].x ||
+			!nearlyEqual(results[2].z, float(sin(angles[keyCount - 1] * 0.5)), 1.0e-5f) )
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool testInstrumentation()
+{
+#ifdef PATRICKMATH_INSTRUMENT
+	// counts on this thread are exact
+	Instrumentation::reset();
+	Vector4::Container container = {1.f, 2.f, 3.f, 0.f};
+	Vector4 vector (container);
+	bool equal = vector.isEqual(vector.normalize().normalize()).getValue();
+	vector.get(container);
+	if ( equal || Instrumentation::total(Instrumentation::VECTOR4_SET) != 1 ||
+		Instrumentation::total(Instrumentation::VECTOR4_GET) != 1 ||
+		Instrumentation::total(Instrumentation::VECTOR4_NORMALIZE) != 2 ||
+		Instrumentation::total(Instrumentation::XMMBOOL_GET_VALUE) != 1 )
+	{
+		return false;
+	}
+
+	// batch kernels time every task on whichever thread runs it, the caller included, four blocks make four tasks
+	const size_t count = PointCloud::BLOCK_SIZE * 4;
+	static Vector4::Container points[count];
+	for ( size_t i = 0; i < count; i++ )
+	{
+		Vector4::Container point = {float(i), float(i % 7), 1.f, 1.f};
+		points[i] = point;
+	}
+	PointCloud::Statistics statistics;
+	PointCloud::statistics(points, count, statistics, 4);
+	uint64_t tasks = 0;
+	for ( const Instrumentation::ThreadCounters *thread = Instrumentation::threads(); thread != NULL; thread = thread->next )
+	{
+		tasks += thread->timerCalls[Instrumentation::PARALLEL_TASK];
+	}
+	if ( tasks != 4 || Instrumentation::totalCycles(Instrumentation::POINT_CLOUD) == 0 )
+	{
+		return false;
+	}
+
+	FILE *report = tmpfile();
+	Instrumentation::report(report);
+	bool reported = ftell(report) > 0;
+	fclose(report);
+	return reported;
+#else
+	return true;
+#endif
+}
+
+static bool nearlyEqual(const Vector4::Container &lhs, const Vector4::Container &rhs, float epsilon)
+{
+	return nearlyEqual(lhs.x, rhs.x, epsilon) && nearlyEqual(lhs.y, rhs.y, epsilon) && nearlyEqual(lhs.z, rhs.z, epsilon) &&
+		nearlyEqual(lhs.w, rhs.w, epsilon);
+}
+
+bool testCurve()
+{
+	bool pass = true;
+	Vector4::Container points [7] =
+	{
+		{0.f, 0.f, 0.f, 1.f}, {1.f, 2.f, 0.f, 1.f}, {2.f, -1.f, 1.f, 1.f}, {4.f, 0.f, 3.f, 1.f},
+		{5.f, 2.f, 2.f, 1.f}, {7.f, 1.f, 0.f, 1.f}, {8.f, 0.f, 1.f, 1.f}
+	};
+	Curve curve;
+
+	// Catmull-Rom passes through the inner points with tangent (p[i+1] - p[i-1]) / 2
+	pass = pass && curve.build(Curve::CATMULL_ROM, points, 7) && curve.segmentCount() == 4;
+	float knots [5] = {0.f, 1.f, 2.f, 3.f, 4.f};
+	Vector4::Container positions [5], tangents [5];
+	curve.evaluate(knots, positions, tangents, 0, 5);
+	for ( int i = 0; i < 5; i++ )
+	{
+		Vector4::Container expected;
+		((Vector4(points[i + 2]) - Vector4(points[i])).get(expected));
+		expected.x *= 0.5f; expected.y *= 0.5f; expected.z *= 0.5f;
+		pass = pass && nearlyEqual(positions[i], points[i + 1], 1.0e-5f) && nearlyEqual(tangents[i], expected, 1.0e-5f);
+	}
+
+	// Bezier: the knots, tangents 3 (p1 - p0) and, entering the second segment, 3 (p4 - p3), and the midpoint
+	// (p0 + 3 p1 + 3 p2 + p3) / 8
+	pass = pass && curve.build(Curve::BEZIER, points, 7) && curve.segmentCount() == 2;
+	float bezierParameters [3] = {0.f, 0.5f, 1.f};
+	curve.evaluate(bezierParameters, positions, tangents, 0, 3);
+	Vector4::Container start = {3.f, 6.f, 0.f, 0.f}, middle = {1.625f, 0.375f, 0.75f, 1.f}, next = {3.f, 6.f, -3.f, 0.f};
+	pass = pass && nearlyEqual(positions[0], points[0], 1.0e-5f) && nearlyEqual(tangents[0], start, 1.0e-5f);
+	pass = pass && nearlyEqual(positions[1], middle, 1.0e-5f);
+	pass = pass && nearlyEqual(positions[2], points[3], 1.0e-5f) && nearlyEqual(tangents[2], next, 1.0e-5f);
+	pass = pass && !curve.build(Curve::BEZIER, points, 6) && curve.segmentCount() == 0;
+
+	// Hermite: (position, tangent) pairs are met exactly at the knots
+	Vector4::Container pairs [6] =
+	{
+		{0.f, 0.f, 0.f, 1.f}, {1.f, 0.f, 0.f, 0.f}, {1.f, 1.f, 0.f, 1.f}, {0.f, 2.f, 0.f, 0.f},
+		{2.f, 2.f, 2.f, 1.f}, {0.f, 0.f, -1.f, 0.f}
+	};
+	pass = pass && curve.build(Curve::HERMITE, pairs, 6) && curve.segmentCount() == 2;
+	curve.evaluate(knots, positions, tangents, 0, 3);
+	for ( int i = 0; i < 3; i++ )
+	{
+		pass = pass && nearlyEqual(positions[i], pairs[i * 2], 1.0e-5f) && nearlyEqual(tangents[i], pairs[i * 2 + 1], 1.0e-5f);
+	}
+	pass = pass && !curve.build(Curve::HERMITE, pairs, 5);
+
+	// batches match single evaluation, with a tail and clamped parameters
+	curve.build(Curve::CATMULL_ROM, points, 7);
+	const size_t count = 1003;
+	float *parameters = new float [count];
+	Vector4::Container *batch = static_cast<Vector4::Container*>(_aligned_malloc(count * sizeof(Vector4::Container), 16));
+	for ( size_t i = 0; i < count; i++ )
+	{
+		parameters[i] = float(i) * 0.005f - 0.5f;
+	}
+	curve.evaluateBatch(parameters, batch, NULL, count, 4);
+	for ( size_t i = 0; i < count; i += 7 )
+	{
+		float clamped = std::min(std::max(parameters[i], 0.f), 4.f);
+		curve.evaluate(&clamped, positions, NULL, 0, 1);
+		pass = pass && nearlyEqual(batch[i], positions[0], 0.f);
+	}
+
+	// arc length on a straight line with very uneven speed: distance d has to land at x = d
+	Vector4::Container line [4] = {{0.f, 0.f, 0.f, 1.f}, {0.1f, 0.f, 0.f, 1.f}, {0.2f, 0.f, 0.f, 1.f}, {3.f, 0.f, 0.f, 1.f}};
+	curve.build(Curve::BEZIER, line, 4);
+	pass = pass && curve.length() == 0.f && curve.buildArcLength(256) && nearlyEqual(curve.length(), 3.f, 1.0e-5f);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		parameters[i] = 3.f * float(i) / float(count - 1);
+	}
+	curve.evaluateAtDistancesBatch(parameters, batch, NULL, count, 4);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		pass = pass && nearlyEqual(batch[i].x, parameters[i], 1.0e-3f);
+	}
+	pass = pass && curve.parameterAtDistance(-1.f) == 0.f && curve.parameterAtDistance(10.f) == 1.f;
+
+	delete [] parameters;
+	_aligned_free(batch);
+	return pass;
+}
+
+uint64_t referenceMorton63(uint64_t x, uint64_t y, uint64_t z)
+{
+	uint64_t code = 0;
+	for ( uint64_t bit = 0; bit < 21; bit++ )
+	{
+		code |= ((x >> bit) & 1) << (3 * bit);
+		code |= ((y >> bit) & 1) << (3 * bit + 1);
+		code |= ((z >> bit) & 1) << (3 * bit + 2);
+	}
+	return code;
+}
+
+bool testMortonEncode63()
+{
+	const size_t count = 7;
+	Vector4::Container positions[count];
+	uint32_t cells[count][3] = {
+		{0,0,0}, {2097151,2097151,2097151}, {1,2,3}, {1048576,0,17}, {100000,1900000,300}, {5,2000000,0}, {77,77,77}};
+	for ( size_t i = 0; i < count; i++ )
+	{
+		// cells of 1 unit, the position in the middle of the cell
+		Vector4::Container position = {cells[i][0] + 0.5f, cells[i][1] + 0.5f, cells[i][2] + 0.5f, 1.f};
+		positions[i] = position;
+	}
+
+	Vector4::Container minLoad = {0,0,0,1};
+	Vector4::Container maxLoad = {2097152.f,2097152.f,2097152.f,1};
+	uint64_t codes[count];
+	Quantize::mortonEncode63(positions, Vector4(minLoad), Vector4(maxLoad), codes, count);
+
+	for ( size_t i = 0; i < count; i++ )
+	{
+		if ( codes[i] != referenceMorton63(cells[i][0], cells[i][1], cells[i][2]) )
+		{
+			return false;
+		}
+	}
+	return codes[1] == (uint64_t(1) << 63) - 1;
+}
+
+bool testRadixSort()
+{
+	bool pass = true;
+	const size_t count = 100003;
+	XmmRandom random (5);
+	uint32_t *keys = new uint32_t [count];
+	uint32_t *original = new uint32_t [count];
+	uint32_t *values = new uint32_t [count];
+	uint64_t *wideKeys = new uint64_t [count];
+	uint64_t *wideExpected = new uint64_t [count];
+	for ( size_t i = 0; i < count; i += 4 )
+	{
+		XmmInt::Container low, high;
+		random.nextInt().get(low);
+		random.nextInt().get(high);
+		for ( size_t lane = 0; lane < 4 && i + lane < count; lane++ )
+		{
+			// bits above keyBits are ignored, the low 14 bits give plenty of equal keys to check stability
+			original[i + lane] = keys[i + lane] = uint32_t(low.elements[lane]);
+			values[i + lane] = uint32_t(i + lane);
+			wideKeys[i + lane] = (uint64_t(uint32_t(high.elements[lane])) << 32) | uint32_t(low.elements[lane]);
+			wideExpected[i + lane] = wideKeys[i + lane] & ((uint64_t(1) << 63) - 1);
+		}
+	}
+
+	RadixSort::sort(keys, values, count, 14, 4);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		pass = pass && keys[i] == original[values[i]];
+		if ( i > 0 )
+		{
+			uint32_t previous = keys[i - 1] & 0x3FFF, current = keys[i] & 0x3FFF;
+			pass = pass && (previous < current || (previous == current && values[i - 1] < values[i]));
+		}
+	}
+
+	for ( size_t i = 0; i < count; i++ )
+	{
+		wideKeys[i] = wideExpected[i];
+	}
+	RadixSort::sort(wideKeys, NULL, count, 63, 3);
+	std::sort(wideExpected, wideExpected + count);
+	pass = pass && memcmp(wideKeys, wideExpected, count * sizeof(uint64_t)) == 0;
+
+	// morton order, then reorder the positions into it
+	Vector4::Container *positions = static_cast<Vector4::Container*>(_aligned_malloc(count * sizeof(Vector4::Container), 16));
+	Vector4::Container *sorted = static_cast<Vector4::Container*>(_aligned_malloc(count * sizeof(Vector4::Container), 16));
+	for ( size_t i = 0; i < count; i++ )
+	{
+		random.nextFloat(XmmFloat(-10.f), XmmFloat(10.f)).get(positions[i].x);
+		random.nextFloat(XmmFloat(-10.f), XmmFloat(10.f)).get(positions[i].y);
+		random.nextFloat(XmmFloat(-10.f), XmmFloat(10.f)).get(positions[i].z);
+		positions[i].w = 1.f;
+		sorted[i] = positions[i];
+	}
+	Vector4::Container minLoad = {-10,-10,-10,1};
+	Vector4::Container maxLoad = {10,10,10,1};
+	RadixSort::mortonOrder30(positions, Vector4(minLoad), Vector4(maxLoad), values, keys, count, 4);
+	RadixSort::reorder(values, sorted, count, 4);
+	Quantize::mortonEncode30(sorted, Vector4(minLoad), Vector4(maxLoad), original, count);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		pass = pass && memcmp(&sorted[i], &positions[values[i]], sizeof(Vector4::Container)) == 0;
+		pass = pass && original[i] == keys[i] && (i == 0 || keys[i - 1] <= keys[i]);
+	}
+
+	RadixSort::mortonOrder63(positions, Vector4(minLoad), Vector4(maxLoad), values, wideKeys, count, 4);
+	for ( size_t i = 1; i < count; i++ )
+	{
+		pass = pass && wideKeys[i - 1] <= wideKeys[i] && values[i] < count;
+	}
+
+	delete [] keys;
+	delete [] original;
+	delete [] values;
+	delete [] wideKeys;
+	delete [] wideExpected;
+	_aligned_free(positions);
+	_aligned_free(sorted);
+	return pass;
+}
+
+static double referenceSegmentDistance(const double p [3], const double a [3], const double b [3])
+{
+	double ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+	double lengthSq = ab[0] * ab[0] + ab[1] * ab[1] + ab[2] * ab[2];
+	double t = lengthSq > 0.0 ? ((p[0] - a[0]) * ab[0] + (p[1] - a[1]) * ab[1] + (p[2] - a[2]) * ab[2]) / lengthSq : 0.0;
+	t = std::min(std::max(t, 0.0), 1.0);
+	double d[3] = {p[0] - a[0] - t * ab[0], p[1] - a[1] - t * ab[1], p[2] - a[2] - t * ab[2]};
+	return sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+}
+
+/*!
+* The projection onto the plane when it lands inside the triangle, otherwise the nearest edge
+*/
+static double referenceTriangleDistance(const double p [3], const double a [3], const double b [3], const double c [3])
+{
+	double ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+	double ac[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+	double n[3] = {ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0]};
+	double nn = n[0] * n[0] + n[1] * n[1] + n[2] * n[2];
+	double ap[3] = {p[0] - a[0], p[1] - a[1], p[2] - a[2]};
+	double height = (ap[0] * n[0] + ap[1] * n[1] + ap[2] * n[2]) / nn;
+	double q[3] = {ap[0] - height * n[0], ap[1] - height * n[1], ap[2] - height * n[2]};
+
+	// barycentric coordinates of the projection from the sub triangle areas
+	double u = ((ab[1] * q[2] - ab[2] * q[1]) * n[0] + (ab[2] * q[0] - ab[0] * q[2]) * n[1] + (ab[0] * q[1] - ab[1] * q[0]) * n[2]) / nn;
+	double v = ((q[1] * ac[2] - q[2] * ac[1]) * n[0] + (q[2] * ac[0] - q[0] * ac[2]) * n[1] + (q[0] * ac[1] - q[1] * ac[0]) * n[2]) / nn;
+	if ( u >= 0.0 && v >= 0.0 && u + v <= 1.0 )
+	{
+		return fabs(height) * sqrt(nn);
+	}
+	return std::min(referenceSegmentDistance(p, a, b), std::min(referenceSegmentDistance(p, b, c), referenceSegmentDistance(p, c, a)));
+}
+
+bool testDistance()
+{
+	bool pass = true;
+	const size_t count = 1001;
+	XmmRandom random (9);
+	Vector4::Container *points = static_cast<Vector4::Container*>(_aligned_malloc(count * 5 * sizeof(Vector4::Container), 16));
+	Vector4::Container *a = points + count, *b = a + count, *c = b + count, *closest = c + count;
+	float *distances = new float [count];
+	float *radiiA = new float [count];
+	float *radiiB = new float [count];
+	for ( size_t i = 0; i < count; i++ )
+	{
+		Vector4::Container *targets [4] = {points + i, a + i, b + i, c + i};
+		for ( int j = 0; j < 4; j++ )
+		{
+			_mm_store_ps(targets[j]->elements, random.nextFloat(XmmFloat(-2.f), XmmFloat(2.f)));
+			targets[j]->w = 1.f;
+		}
+		random.nextFloat(XmmFloat(0.f), XmmFloat(0.5f)).get(radiiA[i]);
+		random.nextFloat(XmmFloat(0.f), XmmFloat(0.5f)).get(radiiB[i]);
+	}
+
+	// triangles: every distance matches the reference, and the closest point is that far away
+	Distance::pointTriangle(points, a, b, c, distances, closest, count, 4);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		double p[3] = {points[i].x, points[i].y, points[i].z};
+		double ta[3] = {a[i].x, a[i].y, a[i].z}, tb[3] = {b[i].x, b[i].y, b[i].z}, tc[3] = {c[i].x, c[i].y, c[i].z};
+		float expected = float(referenceTriangleDistance(p, ta, tb, tc));
+		float dx = closest[i].x - points[i].x, dy = closest[i].y - points[i].y, dz = closest[i].z - points[i].z;
+		pass = pass && nearlyEqual(distances[i], expected, 1.0e-4f) &&
+			nearlyEqual(sqrtf(dx * dx + dy * dy + dz * dz), expected, 1.0e-4f) && closest[i].w == 1.f;
+	}
+
+	// segments
+	Distance::pointSegment(points, a, b, distances, closest, count, 3);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		double p[3] = {points[i].x, points[i].y, points[i].z};
+		double sa[3] = {a[i].x, a[i].y, a[i].z}, sb[3] = {b[i].x, b[i].y, b[i].z};
+		pass = pass && nearlyEqual(distances[i], float(referenceSegmentDistance(p, sa, sb)), 1.0e-4f);
+	}
+
+	// planes through c with normal a: the closest point is on the plane and the offset is the distance
+	for ( size_t i = 0; i < count; i++ )
+	{
+		Vector4::Container direction = {a[i].x, a[i].y, a[i].z, 0.f};
+		Vector4(direction).normalize().get(b[i]);
+		b[i].w = -(b[i].x * c[i].x + b[i].y * c[i].y + b[i].z * c[i].z);
+	}
+	Distance::pointPlane(points, b, distances, closest, count);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		float expected = b[i].x * (points[i].x - c[i].x) + b[i].y * (points[i].y - c[i].y) + b[i].z * (points[i].z - c[i].z);
+		float onPlane = b[i].x * closest[i].x + b[i].y * closest[i].y + b[i].z * closest[i].z + b[i].w;
+		pass = pass && nearlyEqual(distances[i], expected, 1.0e-4f) && nearlyEqual(onPlane, 0.f, 1.0e-4f);
+	}
+
+	// sphere against capsule is the segment distance less both radii, normals are unit and point at the capsule
+	Distance::pointSegment(points, a, c, distances, NULL, count);
+	float *surface = new float [count];
+	Distance::sphereCapsule(points, radiiA, a, c, radiiB, surface, closest, count, 2);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		float normalLength = sqrtf(closest[i].x * closest[i].x + closest[i].y * closest[i].y + closest[i].z * closest[i].z);
+		pass = pass && nearlyEqual(surface[i], distances[i] - radiiA[i] - radiiB[i], 1.0e-5f) &&
+			nearlyEqual(normalLength, 1.f, 1.0e-5f) && closest[i].w == 0.f;
+	}
+
+	// a sphere centered on its capsule still gets a unit normal
+	Distance::sphereCapsule(a, radiiA, a, c, radiiB, surface, closest, 1);
+	pass = pass && nearlyEqual(surface[0], -radiiA[0] - radiiB[0], 1.0e-6f) && closest[0].x == 1.f;
+
+	delete [] distances;
+	delete [] radiiA;
+	delete [] radiiB;
+	delete [] surface;
+	_aligned_free(points);
+	return pass;
+}
+
+bool testAffine3x4()
+{
+	bool pass = true;
+	const size_t count = 203;
+	const XmmFloat epsilon (1.0e-4f);
+	XmmRandom random (11);
+	Vector4::Container *source = static_cast<Vector4::Container*>(_aligned_malloc(count * 2 * sizeof(Vector4::Container), 16));
+	Vector4::Container *destination = source + count;
+	Affine3x4::Container *transforms = static_cast<Affine3x4::Container*>(_aligned_malloc(count * 3 * sizeof(Affine3x4::Container), 16));
+	Affine3x4::Container *others = transforms + count, *composed = others + count;
+	Quaternion::Container *rotations = static_cast<Quaternion::Container*>(_aligned_malloc(count * sizeof(Quaternion::Container), 16));
+
+	for ( size_t i = 0; i < count; i++ )
+	{
+		Quaternion rotation = Quaternion(random.nextFloat(XmmFloat(-1.f), XmmFloat(1.f))).normalize();
+		Vector4 translation (random.nextFloat(XmmFloat(-5.f), XmmFloat(5.f)));
+		Vector4 scale (random.nextFloat(XmmFloat(0.5f), XmmFloat(2.f)));
+		rotation.get(rotations[i]);
+		translation.get(source[i]);
+		source[i].w = float(i & 1);
+
+		// matches the Matrix4 built from the same parts, and converts back to it
+		Matrix4 matrix = Matrix4::fromTransform(translation, rotation, scale);
+		Affine3x4 affine = Affine3x4::fromTransform(translation, rotation, scale);
+		affine.get(transforms[i]);
+		Affine3x4(matrix).get(others[i]);
+		pass = pass && affine.isEqual(Affine3x4(others[i]), epsilon).allTrue();
+		pass = pass && Affine3x4(affine.toMatrix4()).isEqual(affine, epsilon).allTrue();
+
+		// points pick up the translation, directions do not, w is kept
+		Vector4 point = makePoint(1.f, -2.f, 3.f), direction = makeDirection(1.f, -2.f, 3.f);
+		pass = pass && affine.transformPoint(point).isEqual(matrix.transform(point), epsilon).allTrue();
+		pass = pass && affine.transformVector(point).isEqual(matrix.transform(direction), epsilon).allTrue();
+		pass = pass && (affine * direction).isEqual(matrix * direction, epsilon).allTrue();
+
+		// the inverse undoes the transform, and the rigid fast path agrees with the general one
+		pass = pass && affine.compose(affine.inverse()).isEqual(Affine3x4::IDENTITY, XmmFloat(1.0e-3f)).allTrue();
+		Affine3x4 rigid = Affine3x4::fromRotationTranslation(rotation, translation);
+		pass = pass && rigid.inverseOrthonormal().isEqual(rigid.inverse(), epsilon).allTrue();
+		pass = pass && rigid.getTranslation().isEqual(makePoint(source[i].x, source[i].y, source[i].z), epsilon).allTrue();
+
+		// the rotation comes back (up to sign) with the scale divided out
+		Quaternion recovered = affine.getRotation();
+		pass = pass && (recovered.isEqual(rotation, epsilon).allTrue() || recovered.isEqual(Quaternion(_mm_sub_ps(_mm_setzero_ps(), rotation)), epsilon).allTrue());
+	}
+
+	// composition matches the matrix product, batches match the single calls including the tail
+	Affine3x4::composeBatch(transforms, others, composed, count, 4);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		Matrix4 product = Affine3x4(transforms[i]).toMatrix4() * Affine3x4(others[i]).toMatrix4();
+		pass = pass && Affine3x4(composed[i]).isEqual(Affine3x4(product), XmmFloat(1.0e-3f)).allTrue();
+	}
+	Affine3x4 transform (transforms[0]);
+	Affine3x4::transformBatch(transform, source, destination, count, 3);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		pass = pass && Vector4(destination[i]).isEqual(transform.transform(source[i]), epsilon).allTrue();
+	}
+	Affine3x4::fromRotationTranslationBatch(rotations, source, composed, count, 2);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		Affine3x4 expected = Affine3x4::fromRotationTranslation(rotations[i], source[i]);
+		pass = pass && Affine3x4(composed[i]).isEqual(expected, epsilon).allTrue();
+	}
+
+	_aligned_free(rotations);
+	_aligned_free(transforms);
+	_aligned_free(source);
+	return pass;
+}
+
+struct MemoryStream
+{
+	Vector4::Container *data;
+	size_t count;
+	size_t cursor;
+	size_t failAt;
+};
+
+static size_t readMemory(void *context, Vector4::Container *destination, size_t capacity)
+{
+	MemoryStream &stream = *static_cast<MemoryStream*>(context);
+	// short reads, like a pipe, to check that partial chunks go through whole
+	size_t count = stream.count - stream.cursor < capacity - 1 ? stream.count - stream.cursor : capacity - 1;
+	if ( stream.cursor + count > stream.failAt )
+	{
+		return Stream::READ_ERROR;
+	}
+	memcpy(destination, stream.data + stream.cursor, count * sizeof(Vector4::Container));
+	stream.cursor += count;
+	return count;
+}
+
+static bool writeMemory(void *context, const Vector4::Container *source, size_t count)
+{
+	MemoryStream &stream = *static_cast<MemoryStream*>(context);
+	if ( stream.cursor + count > stream.failAt )
+	{
+		return false;
+	}
+	memcpy(stream.data + stream.cursor, source, count * sizeof(Vector4::Container));
+	stream.cursor += count;
+	return true;
+}
+
+bool testStream()
+{
+	bool pass = true;
+	const size_t count = 10007;
+	XmmRandom random (13);
+	Vector4::Container *source = static_cast<Vector4::Container*>(_aligned_malloc(count * 3 * sizeof(Vector4::Container), 16));
+	Vector4::Container *destination = source + count, *expected = destination + count;
+	for ( size_t i = 0; i < count; i++ )
+	{
+		_mm_store_ps(source[i].elements, random.nextFloat(XmmFloat(-10.f), XmmFloat(10.f)));
+		source[i].w = float(i & 1);
+	}
+	Affine3x4 transform = Affine3x4::fromRotationTranslation(
+		Quaternion(makeDirection(1.f, 2.f, 3.f).normalize(), XmmFloat(0.7f)), makePoint(4.f, -5.f, 6.f));
+
+	// transform then normalize, chunk by chunk, matches the whole array done at once
+	Affine3x4::transformBatch(transform, source, expected, count);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		float length = sqrtf(expected[i].x * expected[i].x + expected[i].y * expected[i].y + expected[i].z * expected[i].z);
+		expected[i].x /= length;
+		expected[i].y /= length;
+		expected[i].z /= length;
+	}
+	size_t bufferCounts [3] = {1, 2, 3};
+	for ( int b = 0; b < 3; b++ )
+	{
+		Stream stream;
+		pass = pass && stream.create(1000, bufferCounts[b], 2);
+		pass = pass && stream.addStage(Stream::transformStage, &transform);
+		pass = pass && stream.addStage(Stream::normalizeStage, NULL);
+		MemoryStream reader = {source, count, 0, count};
+		MemoryStream writer = {destination, count, 0, count};
+		pass = pass && stream.run(readMemory, &reader, writeMemory, &writer);
+		pass = pass && stream.elementCount() == count && writer.cursor == count;
+		for ( size_t i = 0; i < count; i++ )
+		{
+			pass = pass && nearlyEqual(destination[i], expected[i], 1.0e-5f);
+		}
+	}
+
+	// vectors too short to normalize come out as zero, w is kept either way
+	{
+		__declspec(align(16)) Vector4::Container chunk [3] = {
+			{0.f, 0.f, 0.f, 1.f}, {1.0e-8f, 0.f, 0.f, 1.f}, {0.f, 3.f, 4.f, 0.f}};
+		Stream::normalizeStage(NULL, chunk, 3, 1);
+		pass = pass && chunk[0].x == 0.f && chunk[0].w == 1.f && chunk[1].x == 0.f && chunk[1].w == 1.f;
+		pass = pass && nearlyEqual(chunk[2].y, 0.6f, 1.0e-6f) && nearlyEqual(chunk[2].z, 0.8f, 1.0e-6f);
+		pass = pass && chunk[2].w == 0.f;
+	}
+
+	// a failing writer stops the stream early and is reported
+	{
+		Stream stream;
+		pass = pass && stream.create(1000);
+		MemoryStream reader = {source, count, 0, count};
+		MemoryStream writer = {destination, count, 0, 2500};
+		pass = pass && !stream.run(readMemory, &reader, writeMemory, &writer);
+		pass = pass && stream.elementCount() == 1998 && reader.cursor < count;
+	}
+
+	// so does a failing reader, the chunks read before it failed may or may not get written
+	{
+		Stream stream;
+		pass = pass && stream.create(1000);
+		MemoryStream reader = {source, count, 0, 2500};
+		MemoryStream writer = {destination, count, 0, count};
+		pass = pass && !stream.run(readMemory, &reader, writeMemory, &writer);
+		pass = pass && stream.elementCount() <= 1998 && reader.cursor == 1998;
+	}
+
+	// raw files go through unchanged, morton files hold the same codes as Quantize
+	FILE *input = tmpfile();
+	FILE *output = tmpfile();
+	pass = pass && input != NULL && output != NULL;
+	if ( input != NULL && output != NULL )
+	{
+		fwrite(source, sizeof(Vector4::Container), count, input);
+		rewind(input);
+		Stream stream;
+		pass = pass && stream.create(4096, 2);
+		pass = pass && stream.run(Stream::readFile, input, Stream::writeFile, output);
+		rewind(output);
+		pass = pass && fread(destination, sizeof(Vector4::Container), count, output) == count;
+		pass = pass && memcmp(source, destination, count * sizeof(Vector4::Container)) == 0;
+
+		Stream::MortonFile morton;
+		morton.file = output;
+		makePoint(-10.f, -10.f, -10.f).get(morton.boundsMin);
+		makePoint(10.f, 10.f, 10.f).get(morton.boundsMax);
+		rewind(input);
+		rewind(output);
+		pass = pass && stream.run(Stream::readFile, input, Stream::writeMortonFile, &morton);
+		uint64_t *codes = new uint64_t [count * 2];
+		Quantize::mortonEncode63(source, morton.boundsMin, morton.boundsMax, codes, count);
+		rewind(output);
+		pass = pass && fread(codes + count, sizeof(uint64_t), count, output) == count;
+		pass = pass && memcmp(codes, codes + count, count * sizeof(uint64_t)) == 0;
+		delete [] codes;
+	}
+	if ( input != NULL )
+	{
+		fclose(input);
+	}
+	if ( output != NULL )
+	{
+		fclose(output);
+	}
+
+	_aligned_free(source);
+	return pass;
+}
+
+bool testMesh()
+{
+	bool pass = true;
+
+	// a height field grid, uv = (x, y)
+	const size_t columns = 61, rows = 47;
+	const size_t vertexCount = columns * rows, triangleCount = (columns - 1) * (rows - 1) * 2;
+	Vector4::Container *positions = static_cast<Vector4::Container*>(_aligned_malloc((vertexCount * 4 + triangleCount) * sizeof(Vector4::Container), 16));
+	Vector4::Container *normals = positions + vertexCount, *serial = normals + vertexCount;
+	Vector4::Container *tangents = serial + vertexCount, *faceNormals = tangents + vertexCount;
+	float *uvs = new float [vertexCount * 2];
+	float *areas = new float [triangleCount];
+	uint32_t *indices = new uint32_t [triangleCount * 3];
+	for ( size_t row = 0; row < rows; row++ )
+	{
+		for ( size_t column = 0; column < columns; column++ )
+		{
+			size_t v = row * columns + column;
+			float x = float(column) * 0.1f, y = float(row) * 0.1f;
+			makePoint(x, y, 0.3f * sinf(x * 2.f) * cosf(y * 3.f)).get(positions[v]);
+			uvs[v * 2] = x;
+			uvs[v * 2 + 1] = y;
+		}
+	}
+	for ( size_t row = 0, t = 0; row + 1 < rows; row++ )
+	{
+		for ( size_t column = 0; column + 1 < columns; column++, t += 2 )
+		{
+			uint32_t a = uint32_t(row * columns + column), b = a + 1, c = a + uint32_t(columns), d = c + 1;
+			uint32_t quad [6] = {a, b, d, a, d, c};
+			memcpy(indices + t * 3, quad, sizeof(quad));
+		}
+	}
+
+	// adjacency: every vertex lists the triangles that use it, in order, however many tasks filled it
+	Mesh::Adjacency adjacency;
+	pass = pass && adjacency.create(indices, triangleCount, vertexCount, 4) && adjacency.vertexCount() == vertexCount;
+	const uint32_t *offsets = adjacency.offsets(), *faces = adjacency.faces();
+	pass = pass && offsets[0] == 0 && offsets[vertexCount] == triangleCount * 3;
+	uint32_t *serialOffsets = new uint32_t [vertexCount + 1];
+	uint32_t *serialFaces = new uint32_t [triangleCount * 3];
+	Mesh::vertexFaces(indices, triangleCount, vertexCount, serialOffsets, serialFaces);
+	pass = pass && memcmp(offsets, serialOffsets, (vertexCount + 1) * sizeof(uint32_t)) == 0;
+	pass = pass && memcmp(faces, serialFaces, triangleCount * 3 * sizeof(uint32_t)) == 0;
+	for ( size_t v = 0; v < vertexCount; v++ )
+	{
+		for ( uint32_t k = offsets[v]; k < offsets[v + 1]; k++ )
+		{
+			const uint32_t *corners = indices + faces[k] * 3;
+			pass = pass && (corners[0] == v || corners[1] == v || corners[2] == v);
+			pass = pass && (k == offsets[v] || faces[k - 1] < faces[k]);
+		}
+	}
+
+	// area weighted normals against a double precision scatter; the gather order makes them independent of taskCount
+	Mesh::faceNormals(positions, indices, triangleCount, faceNormals, areas, 3);
+	double *sums = new double [vertexCount * 3];
+	memset(sums, 0, vertexCount * 3 * sizeof(double));
+	for ( size_t t = 0; t < triangleCount; t++ )
+	{
+		for ( int corner = 0; corner < 3; corner++ )
+		{
+			for ( int axis = 0; axis < 3; axis++ )
+			{
+				sums[indices[t * 3 + corner] * 3 + axis] += double(faceNormals[t].elements[axis]) * areas[t];
+			}
+		}
+	}
+	Mesh::vertexNormals(positions, indices, triangleCount, adjacency, serial);
+	Mesh::vertexNormals(positions, indices, triangleCount, adjacency, normals, 4);
+	pass = pass && memcmp(serial, normals, vertexCount * sizeof(Vector4::Container)) == 0;
+	for ( size_t v = 0; v < vertexCount; v++ )
+	{
+		double *sum = sums + v * 3;
+		double length = sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+		Vector4::Container expected = {float(sum[0] / length), float(sum[1] / length), float(sum[2] / length), 0.f};
+		pass = pass && nearlyEqual(normals[v], expected, 1.0e-5f) && normals[v].z > 0.f;
+	}
+
+	// tangents: unit, orthogonal to the normal, along +x where the surface is flat in x, right handed
+	Mesh::vertexTangents(positions, uvs, normals, indices, triangleCount, adjacency, tangents, 2);
+	for ( size_t v = 0; v < vertexCount; v++ )
+	{
+		Vector4 tangent = makeDirection(tangents[v].x, tangents[v].y, tangents[v].z);
+		float lengthSq, alongNormal;
+		(tangent * tangent).get(lengthSq);
+		(tangent * Vector4(normals[v])).get(alongNormal);
+		pass = pass && nearlyEqual(lengthSq, 1.f, 1.0e-5f) && nearlyEqual(alongNormal, 0.f, 1.0e-5f);
+		pass = pass && tangents[v].x > 0.5f && tangents[v].w == 1.f;
+	}
+
+	// mirroring u flips the tangent and the handedness
+	for ( size_t v = 0; v < vertexCount; v++ )
+	{
+		uvs[v * 2] = -uvs[v * 2];
+	}
+	Mesh::vertexTangents(positions, uvs, normals, indices, triangleCount, adjacency, tangents, 2);
+	for ( size_t v = 0; v < vertexCount; v++ )
+	{
+		pass = pass && tangents[v].x < -0.5f && tangents[v].w == -1.f;
+	}
+
+	delete [] sums;
+	delete [] serialFaces;
+	delete [] serialOffsets;
+	delete [] indices;
+	delete [] areas;
+	delete [] uvs;
+	_aligned_free(positions);
+	return pass;
+}
+
+bool testFloat3()
+{
+	bool pass = true;
+	const size_t count = 103;
+
+	// loads and stores of single elements, unaligned
+	float raw [9] = {1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f, 8.f, 9.f};
+	Vector4::Container expected = {2.f, 3.f, 4.f, 5.f};
+	pass = pass && Vector4::loadUnaligned(raw + 1).isEqual(expected).allTrue();
+	Vector4::Container point = {7.f, 8.f, 9.f, 1.f};
+	pass = pass && Vector4::loadFloat3(raw + 6, 1.f).isEqual(point).allTrue();
+	Vector4(point).storeFloat3(raw + 1);
+	pass = pass && raw[0] == 1.f && raw[1] == 7.f && raw[2] == 8.f && raw[3] == 9.f && raw[4] == 5.f;
+	Vector4(expected).storeUnaligned(raw + 5);
+	pass = pass && raw[5] == 2.f && raw[8] == 5.f;
+
+	// tightly packed and interleaved (position then uv, 20 bytes) float3s
+	float *packed = new float [count * 3];
+	float *interleaved = new float [count * 5];
+	for ( size_t i = 0; i < count * 3; i++ )
+	{
+		packed[i] = float(i) * 0.5f - 7.f;
+	}
+	for ( size_t i = 0; i < count * 5; i++ )
+	{
+		interleaved[i] = -1.f;
+	}
+
+	Vector4::Container *vectors = static_cast<Vector4::Container*>(_aligned_malloc(count * sizeof(Vector4::Container), 16));
+	Vector4::fromFloat3Batch(packed, 12, 1.f, vectors, count);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		pass = pass && vectors[i].x == packed[i * 3] && vectors[i].y == packed[i * 3 + 1] &&
+			vectors[i].z == packed[i * 3 + 2] && vectors[i].w == 1.f;
+	}
+
+	// out to the interleaved layout, the uvs in between stay untouched; and back
+	Vector4::toFloat3Batch(vectors, interleaved, 20, count);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		const float *vertex = interleaved + i * 5;
+		pass = pass && vertex[0] == vectors[i].x && vertex[1] == vectors[i].y && vertex[2] == vectors[i].z;
+		pass = pass && vertex[3] == -1.f && vertex[4] == -1.f;
+	}
+	Vector4::Container *copies = static_cast<Vector4::Container*>(_aligned_malloc(count * sizeof(Vector4::Container), 16));
+	Vector4::fromFloat3Batch(interleaved, 20, 1.f, copies, count);
+	pass = pass && memcmp(vectors, copies, count * sizeof(Vector4::Container)) == 0;
+
+	// component arrays and back, packed and interleaved
+	float *x = new float [count * 3];
+	float *y = x + count, *z = y + count;
+	float *restored = new float [count * 3];
+	Vector4::float3ToSoa(packed, 12, x, y, z, count);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		pass = pass && x[i] == packed[i * 3] && y[i] == packed[i * 3 + 1] && z[i] == packed[i * 3 + 2];
+	}
+	Vector4::soaToFloat3(x, y, z, restored, 12, count);
+	pass = pass && memcmp(packed, restored, count * 3 * sizeof(float)) == 0;
+	Vector4::float3ToSoa(interleaved, 20, x, y, z, count);
+	Vector4::soaToFloat3(x, y, z, restored, 12, count);
+	pass = pass && memcmp(packed, restored, count * 3 * sizeof(float)) == 0;
+	Vector4::toFloat3Batch(vectors, restored, 12, count);
+	pass = pass && memcmp(packed, restored, count * 3 * sizeof(float)) == 0;
+
+	delete [] restored;
+	delete [] x;
+	_aligned_free(copies);
+	_aligned_free(vectors);
+	delete [] interleaved;
+	delete [] packed;
+	return pass;
+}
+
+bool testRotation()
+{
+	bool pass = true;
+	const size_t count = 1003;
+	const XmmFloat epsilon (2.0e-5f);
+	XmmRandom random (17);
+	Quaternion::Container *rotations = static_cast<Quaternion::Container*>(_aligned_malloc(count * 2 * sizeof(Quaternion::Container), 16));
+	Quaternion::Container *results = rotations + count;
+	Matrix4::Container *matrices = static_cast<Matrix4::Container*>(_aligned_malloc(count * sizeof(Matrix4::Container), 16));
+	Vector4::Container *vectors = static_cast<Vector4::Container*>(_aligned_malloc(count * 2 * sizeof(Vector4::Container), 16));
+	Vector4::Container *eulers = vectors + count;
+	float *angles = new float [count];
+	for ( size_t i = 0; i < count; i++ )
+	{
+		Quaternion(random.nextFloat(XmmFloat(-1.f), XmmFloat(1.f))).normalize().get(rotations[i]);
+	}
+	// the four Shepperd cases and the identity
+	Quaternion::Container special [5] = {{0.f, 0.f, 0.f, 1.f}, {1.f, 0.f, 0.f, 0.f}, {0.f, 1.f, 0.f, 0.f}, {0.f, 0.f, 1.f, 0.f},
+		{0.f, 0.f, 0.f, -1.f}};
+	memcpy(rotations, special, sizeof(special));
+
+	// matrices match Matrix4::fromTransform, and come back as the same rotation with w >= 0
+	Rotation::quaternionsToMatrices(rotations, matrices, count, 3);
+	Rotation::matricesToQuaternions(matrices, results, count, 2);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		Matrix4 expected = Matrix4::fromTransform(Vector4::ZERO, rotations[i], makeDirection(1.f, 1.f, 1.f));
+		pass = pass && Matrix4(matrices[i]).isEqual(expected, epsilon).allTrue();
+		Quaternion rotation (rotations[i]);
+		Quaternion flipped (_mm_sub_ps(_mm_setzero_ps(), rotation));
+		Quaternion result (results[i]);
+		pass = pass && (result.isEqual(rotation, epsilon).allTrue() || result.isEqual(flipped, epsilon).allTrue());
+		pass = pass && results[i].w >= 0.f;
+	}
+
+	// axis angle both ways, against the Quaternion constructor
+	Rotation::quaternionsToAxisAngles(rotations, vectors, angles, count);
+	pass = pass && angles[0] == 0.f && vectors[0].x == 1.f;
+	for ( size_t i = 0; i < count; i++ )
+	{
+		// q and -q are the same rotation
+		Quaternion rebuilt (Vector4(vectors[i]), XmmFloat(angles[i]));
+		Quaternion flipped (_mm_sub_ps(_mm_setzero_ps(), rebuilt));
+		pass = pass && (rebuilt.isEqual(rotations[i], epsilon).allTrue() || flipped.isEqual(rotations[i], epsilon).allTrue());
+		pass = pass && angles[i] >= 0.f && angles[i] <= 6.2831855f;
+	}
+	Rotation::axisAnglesToQuaternions(vectors, angles, results, count, 4);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		Quaternion expected (Vector4(vectors[i]), XmmFloat(angles[i]));
+		pass = pass && Quaternion(results[i]).isEqual(expected, epsilon).allTrue();
+	}
+
+	// Euler angles are qz * qy * qx, and convert back to the same angles away from the poles
+	for ( size_t i = 0; i < count; i++ )
+	{
+		_mm_store_ps(eulers[i].elements, random.nextFloat(XmmFloat(-3.1f), XmmFloat(3.1f)));
+		eulers[i].y *= 0.48f;
+		eulers[i].w = 0.f;
+	}
+	Rotation::eulerToQuaternions(eulers, results, count, 2);
+	Rotation::quaternionsToEuler(results, vectors, count, 3);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		Quaternion qx (makeDirection(1.f, 0.f, 0.f), XmmFloat(eulers[i].x));
+		Quaternion qy (makeDirection(0.f, 1.f, 0.f), XmmFloat(eulers[i].y));
+		Quaternion qz (makeDirection(0.f, 0.f, 1.f), XmmFloat(eulers[i].z));
+		pass = pass && Quaternion(results[i]).isEqual(qz * qy * qx, epsilon).allTrue();
+		pass = pass && nearlyEqual(vectors[i], eulers[i], 1.0e-4f);
+	}
+
+	delete [] angles;
+	_aligned_free(vectors);
+	_aligned_free(matrices);
+	_aligned_free(rotations);
+	return pass;
+}
+
+static double referenceAngle(const Vector4::Container &a, const Vector4::Container &b)
+{
+	double cx = double(a.y) * b.z - double(a.z) * b.y;
+	double cy = double(a.z) * b.x - double(a.x) * b.z;
+	double cz = double(a.x) * b.y - double(a.y) * b.x;
+	double dot = double(a.x) * b.x + double(a.y) * b.y + double(a.z) * b.z;
+	return atan2(sqrt(cx * cx + cy * cy + cz * cz), dot);
+}
+
+bool testOrientation()
+{
+	bool pass = true;
+	const size_t count = 103;
+	const XmmFloat epsilon (1.0e-5f);
+	const __m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	XmmRandom random (23);
+	Vector4::Container *vectors = static_cast<Vector4::Container*>(_aligned_malloc(count * 2 * sizeof(Vector4::Container), 16));
+	Vector4::Container *others = vectors + count;
+	Quaternion::Container *rotations = static_cast<Quaternion::Container*>(_aligned_malloc(count * sizeof(Quaternion::Container), 16));
+	float *angles = new float [count];
+	for ( size_t i = 0; i < count; i++ )
+	{
+		_mm_store_ps(vectors[i].elements, _mm_and_ps(random.nextFloat(XmmFloat(-10.f), XmmFloat(10.f)), xyzMask));
+		_mm_store_ps(others[i].elements, _mm_and_ps(random.nextFloat(XmmFloat(-10.f), XmmFloat(10.f)), xyzMask));
+	}
+	// parallel, opposite, along x, nearly parallel and zero pairs
+	others[0] = makeDirection(2.f, 4.f, -6.f).get(vectors[0]);
+	makeDirection(-1.f, -2.f, 3.f).get(others[1]);
+	makeDirection(1.f, 2.f, -3.f).get(vectors[1]);
+	makeDirection(3.f, 0.f, 0.f).get(vectors[2]);
+	makeDirection(-1.f, 0.f, 0.f).get(others[2]);
+	makeDirection(1.f, 0.f, 0.f).get(vectors[3]);
+	makeDirection(1.f, 1.0e-4f, 0.f).get(others[3]);
+	makeDirection(0.f, 0.f, 0.f).get(vectors[4]);
+
+	// angles against double precision, the nearly parallel pair is where acos of the dot product fails
+	Vector4::angleBetweenBatch(vectors, others, angles, count, 3);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		float angle;
+		Vector4(vectors[i]).angleBetween(others[i]).get(angle);
+		double reference = referenceAngle(vectors[i], others[i]);
+		// the batch sums the products in another order, so both are held to the reference rather than to each other
+		pass = pass && fabs(angle - reference) <= 2.0e-6 + 1.0e-6 * reference;
+		pass = pass && fabs(angles[i] - reference) <= 2.0e-6 + 1.0e-6 * reference;
+	}
+	pass = pass && nearlyEqual(angles[3], 1.0e-4f, 1.0e-9f) && angles[4] == 0.f;
+
+	// shortest arcs take the normalized from onto the normalized to, turning through the angle between them
+	Quaternion::rotationBetweenBatch(vectors, others, rotations, count, 2);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		Quaternion rotation (rotations[i]);
+		pass = pass && rotation.isEqual(Quaternion::rotationBetween(vectors[i], others[i])).allTrue();
+		float normSq;
+		rotation.normSq().get(normSq);
+		pass = pass && nearlyEqual(normSq, 1.f, 1.0e-5f);
+		if ( i == 4 )
+		{
+			pass = pass && rotation.isEqual(Quaternion::IDENTITY).allTrue();
+			continue;
+		}
+		Vector4 from = Vector4(vectors[i]).normalize();
+		Vector4 to = Vector4(others[i]).normalize();
+		pass = pass && rotation.applyRotation(from).isEqual(to, epsilon).allTrue();
+		float cosHalf = rotations[i].w;
+		pass = pass && nearlyEqual(cosHalf, float(cos(referenceAngle(vectors[i], others[i]) * 0.5)), 1.0e-5f);
+	}
+
+	// look at: +z onto forward, +y onto up made perpendicular to forward
+	for ( size_t i = 0; i < count; i++ )
+	{
+		_mm_store_ps(vectors[i].elements, _mm_and_ps(random.nextFloat(XmmFloat(-10.f), XmmFloat(10.f)), xyzMask));
+	}
+	makeDirection(0.f, 0.f, 1.f).get(vectors[0]);
+	makeDirection(0.f, -1.f, 0.f).get(others[0]);
+	makeDirection(0.f, 0.f, -2.f).get(vectors[1]);
+	makeDirection(0.f, 1.f, 0.f).get(others[1]);
+	makeDirection(1.f, 2.f, 3.f).get(vectors[2]);
+	makeDirection(-2.f, -4.f, -6.f).get(others[2]);
+	Quaternion::lookAtBatch(vectors, others, rotations, count, 3);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		Quaternion rotation (rotations[i]);
+		pass = pass && rotation.isEqual(Quaternion::lookAt(vectors[i], others[i])).allTrue();
+		Vector4 forward = Vector4(vectors[i]).normalize();
+		pass = pass && rotation.applyRotation(Vector4::UNIT_Z).isEqual(forward, epsilon).allTrue();
+		if ( i != 2 )
+		{
+			Vector4 up (others[i]);
+			Vector4 expected = (up - Vector4(_mm_mul_ps(forward, up * forward))).normalize();
+			pass = pass && rotation.applyRotation(Vector4::UNIT_Y).isEqual(expected, XmmFloat(1.0e-4f)).allTrue();
+		}
+	}
+
+	delete [] angles;
+	_aligned_free(rotations);
+	_aligned_free(vectors);
+	return pass;
+}
+
+/*!
+* Ring handoff tests and benchmarks.  A channel is an SpscRing, an MpmcRing or, as the baseline the rings replace, a
+* mutex protected array of batches that is copied into and out of under the lock.
+*/
+enum ChannelKind
+{
+	CHANNEL_SPSC,
+	CHANNEL_MPMC,
+	CHANNEL_MUTEX
+};
+
+struct Channel
+{
+	ChannelKind kind;
+	SpscRing spsc;
+	MpmcRing mpmc;
+
+	CRITICAL_SECTION lock;
+	Vector4::Container *batches;
+	size_t *counts;
+	size_t capacity;
+	size_t slotSize;
+	size_t head;
+	size_t tail;
+};
+
+static void channelCreate(Channel &channel, ChannelKind kind, size_t slotCount, size_t slotSize)
+{
+	channel.kind = kind;
+	channel.spsc.create(kind == CHANNEL_SPSC ? slotCount : 0, slotSize);
+	channel.mpmc.create(kind == CHANNEL_MPMC ? slotCount : 0, slotSize);
+	InitializeCriticalSection(&channel.lock);
+	channel.batches = static_cast<Vector4::Container*>(
+		_aligned_malloc(slotCount * slotSize * sizeof(Vector4::Container), 16));
+	channel.counts = new size_t [slotCount];
+	channel.capacity = slotCount;
+	channel.slotSize = slotSize;
+	channel.head = 0;
+	channel.tail = 0;
+}
+
+static void channelDestroy(Channel &channel)
+{
+	DeleteCriticalSection(&channel.lock);
+	_aligned_free(channel.batches);
+	delete [] channel.counts;
+}
+
+// the mutex channel fills and drains the caller's local batch, the rings hand out their slots
+static Vector4::Container *channelAcquireWrite(Channel &channel, long &ticket, Vector4::Container *local)
+{
+	switch ( channel.kind )
+	{
+	case CHANNEL_SPSC:
+		return channel.spsc.acquireWrite();
+	case CHANNEL_MPMC:
+		return channel.mpmc.acquireWrite(ticket);
+	default:
+		return local;
+	}
+}
+
+static void channelCommitWrite(Channel &channel, long ticket, const Vector4::Container *local, size_t count)
+{
+	switch ( channel.kind )
+	{
+	case CHANNEL_SPSC:
+		channel.spsc.commitWrite(count);
+		return;
+	case CHANNEL_MPMC:
+		channel.mpmc.commitWrite(ticket, count);
+		return;
+	default:
+		for ( ;; )
+		{
+			EnterCriticalSection(&channel.lock);
+			if ( channel.head - channel.tail < channel.capacity )
+			{
+				size_t index = channel.head % channel.capacity;
+				memcpy(channel.batches + index * channel.slotSize, local, count * sizeof(Vector4::Container));
+				channel.counts[index] = count;
+				channel.head++;
+				LeaveCriticalSection(&channel.lock);
+				return;
+			}
+			LeaveCriticalSection(&channel.lock);
+			SwitchToThread();
+		}
+	}
+}
+
+static const Vector4::Container *channelAcquireRead(
+	Channel &channel, long &ticket, size_t &count, Vector4::Container *local)
+{
+	switch ( channel.kind )
+	{
+	case CHANNEL_SPSC:
+		return channel.spsc.acquireRead(count);
+	case CHANNEL_MPMC:
+		return channel.mpmc.acquireRead(ticket, count);
+	default:
+		for ( ;; )
+		{
+			EnterCriticalSection(&channel.lock);
+			if ( channel.head != channel.tail )
+			{
+				size_t index = channel.tail % channel.capacity;
+				count = channel.counts[index];
+				memcpy(local, channel.batches + index * channel.slotSize, count * sizeof(Vector4::Container));
+				channel.tail++;
+				LeaveCriticalSection(&channel.lock);
+				return local;
+			}
+			LeaveCriticalSection(&channel.lock);
+			SwitchToThread();
+		}
+	}
+}
+
+static void channelCommitRead(Channel &channel, long ticket)
+{
+	if ( channel.kind == CHANNEL_SPSC )
+	{
+		channel.spsc.commitRead();
+	}
+	else if ( channel.kind == CHANNEL_MPMC )
+	{
+		channel.mpmc.commitRead(ticket);
+	}
+}
+
+struct Handoff
+{
+	Channel *channels;
+	size_t channelCount;
+	size_t batchCount;
+	size_t slotSize;
+	size_t producerCount;
+};
+
+struct HandoffWorker
+{
+	Handoff *handoff;
+	size_t index;
+	char *seen;
+	bool valid;
+};
+
+/*!
+* Every producer sends batchCount batches of between slotSize - 3 and slotSize elements, element j of batch b from
+* producer p is (p, b, j, 1); with several channels (one SpscRing per consumer) batches are dealt round robin
+*/
+static DWORD WINAPI handoffProducer(LPVOID parameter)
+{
+	HandoffWorker &worker = *static_cast<HandoffWorker*>(parameter);
+	Handoff &handoff = *worker.handoff;
+	Vector4::Container *local = static_cast<Vector4::Container*>(
+		_aligned_malloc(handoff.slotSize * sizeof(Vector4::Container), 16));
+	for ( size_t batch = 0; batch < handoff.batchCount; batch++ )
+	{
+		Channel &channel = handoff.channels[batch % handoff.channelCount];
+		long ticket = 0;
+		size_t count = handoff.slotSize - batch % 4;
+		Vector4::Container *slot = channelAcquireWrite(channel, ticket, local);
+		for ( size_t j = 0; j < count; j++ )
+		{
+			_mm_store_ps(slot[j].elements, _mm_set_ps(1.f, float(j), float(batch), float(worker.index)));
+		}
+		channelCommitWrite(channel, ticket, local, count);
+	}
+	_aligned_free(local);
+	return 0;
+}
+
+/*!
+* Drains its channel until a batch of 0 elements, checking every element and counting every batch it sees
+*/
+static DWORD WINAPI handoffConsumer(LPVOID parameter)
+{
+	HandoffWorker &worker = *static_cast<HandoffWorker*>(parameter);
+	Handoff &handoff = *worker.handoff;
+	Channel &channel = handoff.channels[worker.index % handoff.channelCount];
+	Vector4::Container *local = static_cast<Vector4::Container*>(
+		_aligned_malloc(handoff.slotSize * sizeof(Vector4::Container), 16));
+	worker.valid = true;
+	for ( ;; )
+	{
+		long ticket = 0;
+		size_t count = 0;
+		const Vector4::Container *slot = channelAcquireRead(channel, ticket, count, local);
+		if ( count == 0 )
+		{
+			channelCommitRead(channel, ticket);
+			break;
+		}
+		size_t producer = size_t(slot[0].x), batch = size_t(slot[0].y);
+		bool valid = producer < handoff.producerCount && batch < handoff.batchCount &&
+			count == handoff.slotSize - batch % 4;
+		for ( size_t j = 0; valid && j < count; j++ )
+		{
+			valid = slot[j].x == float(producer) && slot[j].y == float(batch) && slot[j].z == float(j) &&
+				slot[j].w == 1.f;
+		}
+		if ( valid )
+		{
+			worker.seen[producer * handoff.batchCount + batch]++;
+		}
+		worker.valid = worker.valid && valid;
+		channelCommitRead(channel, ticket);
+	}
+	_aligned_free(local);
+	return 0;
+}
+
+/*!
+* Runs producerCount producers and consumerCount consumers over one channel of the given kind (one per consumer for
+* SpscRings), prints the throughput and checks that every batch arrived exactly once and intact
+*/
+static bool testHandoff(const char *name, ChannelKind kind, size_t producerCount, size_t consumerCount)
+{
+	const size_t batchCount = 2000;
+	const size_t slotSize = 64;
+	Handoff handoff;
+	handoff.channelCount = kind == CHANNEL_SPSC ? consumerCount : 1;
+	handoff.channels = new Channel [handoff.channelCount];
+	for ( size_t i = 0; i < handoff.channelCount; i++ )
+	{
+		channelCreate(handoff.channels[i], kind, 16, slotSize);
+	}
+	handoff.batchCount = batchCount;
+	handoff.slotSize = slotSize;
+	handoff.producerCount = producerCount;
+
+	HandoffWorker workers [8];
+	HANDLE threads [8];
+	size_t threadCount = producerCount + consumerCount;
+	char *seen = new char [consumerCount * producerCount * batchCount];
+	memset(seen, 0, consumerCount * producerCount * batchCount);
+
+	double start = seconds();
+	for ( size_t i = 0; i < threadCount; i++ )
+	{
+		bool producer = i < producerCount;
+		workers[i].handoff = &handoff;
+		workers[i].index = producer ? i : i - producerCount;
+		workers[i].seen = producer ? NULL : seen + (i - producerCount) * producerCount * batchCount;
+		workers[i].valid = true;
+		threads[i] = CreateThread(NULL, 0, producer ? handoffProducer : handoffConsumer, &workers[i], 0, NULL);
+	}
+	WaitForMultipleObjects(DWORD(producerCount), threads, TRUE, INFINITE);
+
+	// the producers are done, so this thread can be the producer of the end markers
+	for ( size_t i = 0; i < consumerCount; i++ )
+	{
+		Channel &channel = handoff.channels[i % handoff.channelCount];
+		__declspec(align(16)) Vector4::Container local;
+		long ticket = 0;
+		channelCommitWrite(channel, ticket, channelAcquireWrite(channel, ticket, &local), 0);
+	}
+	WaitForMultipleObjects(DWORD(consumerCount), threads + producerCount, TRUE, INFINITE);
+	double elapsed = seconds() - start;
+
+	bool pass = true;
+	for ( size_t i = 0; i < threadCount; i++ )
+	{
+		CloseHandle(threads[i]);
+		pass = pass && workers[i].valid;
+	}
+	for ( size_t batch = 0; batch < producerCount * batchCount; batch++ )
+	{
+		int total = 0;
+		for ( size_t consumer = 0; consumer < consumerCount; consumer++ )
+		{
+			total += seen[consumer * producerCount * batchCount + batch];
+		}
+		pass = pass && total == 1;
+	}
+
+	double vectors = double(producerCount * batchCount) * (slotSize - 1.5);
+	std::cout << "  " << name << ": " << vectors / elapsed * 1.0e-6 << " M vectors/s, " <<
+		elapsed / (producerCount * batchCount) * 1.0e9 << " ns per batch" << std::endl;
+
+	delete [] seen;
+	for ( size_t i = 0; i < handoff.channelCount; i++ )
+	{
+		channelDestroy(handoff.channels[i]);
+	}
+	delete [] handoff.channels;
+	return pass;
+}
+
+struct PingPong
+{
+	Channel *forward;
+	Channel *back;
+};
+
+// echoes every batch on forward back on back until a batch of 0 elements, which it echoes too
+static DWORD WINAPI pingPongEcho(LPVOID parameter)
+{
+	PingPong &pingPong = *static_cast<PingPong*>(parameter);
+	__declspec(align(16)) Vector4::Container local [2];
+	size_t count;
+	do
+	{
+		long readTicket = 0, writeTicket = 0;
+		const Vector4::Container *source = channelAcquireRead(*pingPong.forward, readTicket, count, local);
+		Vector4::Container *destination = channelAcquireWrite(*pingPong.back, writeTicket, local + 1);
+		if ( count > 0 )
+		{
+			destination[0] = source[0];
+		}
+		channelCommitRead(*pingPong.forward, readTicket);
+		channelCommitWrite(*pingPong.back, writeTicket, destination, count);
+	}
+	while ( count > 0 );
+	return 0;
+}
+
+/*!
+* One batch in flight between two threads at a time, half the round trip is the handoff latency
+*/
+static bool testPingPong(const char *name, ChannelKind kind)
+{
+	const size_t roundTrips = 2000;
+	Channel forward, back;
+	channelCreate(forward, kind, 4, 1);
+	channelCreate(back, kind, 4, 1);
+	PingPong pingPong = {&forward, &back};
+	HANDLE thread = CreateThread(NULL, 0, pingPongEcho, &pingPong, 0, NULL);
+
+	bool pass = true;
+	__declspec(align(16)) Vector4::Container local [2];
+	double start = seconds();
+	for ( size_t i = 0; i <= roundTrips; i++ )
+	{
+		long ticket = 0;
+		size_t count = 0;
+		Vector4::Container *destination = channelAcquireWrite(forward, ticket, local);
+		destination[0].x = float(i);
+		channelCommitWrite(forward, ticket, destination, i < roundTrips ? 1 : 0);
+		const Vector4::Container *source = channelAcquireRead(back, ticket, count, local + 1);
+		pass = pass && (i < roundTrips ? count == 1 && source[0].x == float(i) : count == 0);
+		channelCommitRead(back, ticket);
+	}
+	double elapsed = seconds() - start;
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+	std::cout << "  " << name << ": " << elapsed / (2 * roundTrips) * 1.0e9 << " ns one way" << std::endl;
+
+	channelDestroy(forward);
+	channelDestroy(back);
+	return pass;
+}
+
+bool testRing()
+{
+	bool pass = true;
+
+	// sizes, alignment and order on one thread
+	SpscRing spsc;
+	pass = pass && !spsc.create(0, 4) && spsc.create(5, 10) && spsc.slotCount() == 8 && spsc.slotSize() == 10;
+	size_t count = 0;
+	pass = pass && spsc.tryAcquireRead(count) == NULL;
+	for ( size_t i = 0; i < 8; i++ )
+	{
+		Vector4::Container *slot = spsc.tryAcquireWrite();
+		pass = pass && slot != NULL && (reinterpret_cast<size_t>(slot) & 63) == 0;
+		if ( slot != NULL )
+		{
+			slot[9].x = float(i);
+			spsc.commitWrite(i + 1);
+		}
+	}
+	pass = pass && spsc.tryAcquireWrite() == NULL;
+	for ( size_t i = 0; i < 8; i++ )
+	{
+		const Vector4::Container *slot = spsc.tryAcquireRead(count);
+		pass = pass && slot != NULL && count == i + 1 && slot[9].x == float(i);
+		spsc.commitRead();
+	}
+	pass = pass && spsc.tryAcquireRead(count) == NULL && spsc.tryAcquireWrite() != NULL;
+
+	// MPMC slots are only readable once committed, whatever order the commits come in
+	MpmcRing mpmc;
+	pass = pass && mpmc.create(1, 3) && mpmc.slotCount() == 2;
+	pass = pass && mpmc.create(3, 3) && mpmc.slotCount() == 4;
+	long first, second, ticket;
+	Vector4::Container *slot0 = mpmc.tryAcquireWrite(first);
+	Vector4::Container *slot1 = mpmc.tryAcquireWrite(second);
+	pass = pass && slot0 != NULL && slot1 != NULL && slot0 != slot1 && (reinterpret_cast<size_t>(slot1) & 63) == 0;
+	slot0[0].x = 0.f;
+	slot1[0].x = 1.f;
+	mpmc.commitWrite(second, 2);
+	pass = pass && mpmc.tryAcquireRead(ticket, count) == NULL;
+	mpmc.commitWrite(first, 1);
+	const Vector4::Container *read = mpmc.tryAcquireRead(ticket, count);
+	pass = pass && read == slot0 && count == 1 && read[0].x == 0.f;
+	mpmc.commitRead(ticket);
+	read = mpmc.tryAcquireRead(ticket, count);
+	pass = pass && read == slot1 && count == 2 && read[0].x == 1.f;
+	mpmc.commitRead(ticket);
+	for ( size_t i = 0; i < 4; i++ )
+	{
+		pass = pass && mpmc.tryAcquireWrite(ticket) != NULL;
+		mpmc.commitWrite(ticket, 0);
+	}
+	pass = pass && mpmc.tryAcquireWrite(ticket) == NULL;
+
+	// throughput and latency against the mutex protected baseline
+	pass = testHandoff("1 to 1 SpscRing", CHANNEL_SPSC, 1, 1) && pass;
+	pass = testHandoff("1 to 3 SpscRing each", CHANNEL_SPSC, 1, 3) && pass;
+	pass = testHandoff("1 to 3 MpmcRing", CHANNEL_MPMC, 1, 3) && pass;
+	pass = testHandoff("1 to 3 mutex", CHANNEL_MUTEX, 1, 3) && pass;
+	pass = testHandoff("3 to 3 MpmcRing", CHANNEL_MPMC, 3, 3) && pass;
+	pass = testHandoff("3 to 3 mutex", CHANNEL_MUTEX, 3, 3) && pass;
+	pass = testPingPong("latency SpscRing", CHANNEL_SPSC) && pass;
+	pass = testPingPong("latency MpmcRing", CHANNEL_MPMC) && pass;
+	pass = testPingPong("latency mutex", CHANNEL_MUTEX) && pass;
+	return pass;
+}
+
+struct ParallelSum
+{
+	const uint32_t *values;
+	volatile long *visits;
+	uint64_t sums [ParallelFor::MAX_TASKS];
+	bool nested;
+};
+
+static void parallelSumKernel(void *context, size_t taskIndex, size_t begin, size_t end)
+{
+	ParallelSum &sum = *static_cast<ParallelSum*>(context);
+	sum.sums[taskIndex] = 0;
+	for ( size_t i = begin; i < end; i++ )
+	{
+		sum.sums[taskIndex] += sum.values[i];
+		sum.visits[i]++;
+	}
+	if ( sum.nested )
+	{
+		// a kernel may run a batch of its own on the pool it is running on
+		ParallelSum inner;
+		inner.values = sum.values + begin;
+		inner.visits = sum.visits + begin;
+		inner.nested = false;
+		ParallelFor::run(parallelSumKernel, &inner, end - begin, 3);
+	}
+}
+
+bool testParallelFor()
+{
+	bool pass = true;
+	const size_t count = 1000;
+	uint32_t *values = new uint32_t [count];
+	volatile long *visits = new long [count];
+	for ( size_t i = 0; i < count; i++ )
+	{
+		values[i] = uint32_t(i * 7 + 1);
+	}
+	uint64_t expected = 0;
+	for ( size_t i = 0; i < count; i++ )
+	{
+		expected += values[i];
+	}
+
+	// every element visited exactly once for any taskCount, also when the kernels run batches of their own
+	size_t taskCounts [5] = {1, 2, 7, ParallelFor::MAX_TASKS, 1000};
+	for ( int nested = 0; nested < 2; nested++ )
+	{
+		for ( int t = 0; t < 5; t++ )
+		{
+			memset(const_cast<long*>(visits), 0, count * sizeof(long));
+			ParallelSum sum;
+			sum.values = values;
+			sum.visits = visits;
+			sum.nested = nested != 0;
+			ParallelFor::run(parallelSumKernel, &sum, count, taskCounts[t]);
+			size_t used = taskCounts[t] < ParallelFor::MAX_TASKS ? taskCounts[t] : ParallelFor::MAX_TASKS;
+			uint64_t total = 0;
+			for ( size_t i = 0; i < used; i++ )
+			{
+				total += sum.sums[i];
+			}
+			pass = pass && total == expected;
+			for ( size_t i = 0; i < count; i++ )
+			{
+				pass = pass && visits[i] == 1 + nested;
+			}
+		}
+	}
+
+	// ranges cover the batch in order, and no tasks at all is one task like run takes it
+	size_t next = 0;
+	for ( size_t i = 0; i < 7; i++ )
+	{
+		size_t begin;
+		size_t length = ParallelFor::taskRange(count, 7, i, begin);
+		pass = pass && begin == next;
+		next = begin + length;
+	}
+	size_t begin;
+	pass = pass && next == count && ParallelFor::taskRange(count, 0, 0, begin) == count && begin == 0;
+
+	// the pool is reused, so many small batches cost a wakeup each rather than a thread each
+	const int repeats = 2000;
+	ParallelSum sum;
+	sum.values = values;
+	sum.visits = visits;
+	sum.nested = false;
+	double start = seconds();
+	for ( int repeat = 0; repeat < repeats; repeat++ )
+	{
+		ParallelFor::run(parallelSumKernel, &sum, count, 4);
+	}
+	std::cout << "  4 task batch: " << (seconds() - start) / repeats * 1.0e9 << " ns" << std::endl;
+
+	delete [] const_cast<long*>(visits);
+	delete [] values;
+	return pass;
 }
 
 int _tmain(int argc, _TCHAR* argv[])
@@ -172,7 +2948,40 @@ int _tmain(int argc, _TCHAR* argv[])
 	std::cout << "Negation: " << testNegate() << std::endl;
 	std::cout << "Dot Product: " << testDot() << std::endl;
 	std::cout << "Cross Product: " << testCross() << std::endl;
-	std::cout << "Test Sin: " << testSin() << std::endl;
+	std::cout << "Sin: " << testSin() << std::endl;
+	std::cout << "Normalize: " << testNormalize() << std::endl;
+	std::cout << "Equality: " << testEquality() << std::endl;
+	std::cout << "Accuracy Arithmetic: " << testAccuracyArithmetic() << std::endl;
+	std::cout << "Accuracy Geometry: " << testAccuracyGeometry() << std::endl;
+	std::cout << "Vector4d Dot Product: " << testVector4dDot() << std::endl;
+	std::cout << "Vector4d Cross Product: " << testVector4dCross() << std::endl;
+	std::cout << "Vector4d Normalize: " << testVector4dNormalize() << std::endl;
+	std::cout << "Vector4d Conversion: " << testVector4dConvert() << std::endl;
+	std::cout << "XmmInt: " << testXmmInt() << std::endl;
+	std::cout << "Morton Encode: " << testMortonEncode() << std::endl;
+	std::cout << "Fixed Point: " << testFixedPoint() << std::endl;
+	std::cout << "SinCos: " << testSinCos() << std::endl;
+	std::cout << "Random: " << testRandom() << std::endl;
+	std::cout << "Sampling: " << testSampling() << std::endl;
+	std::cout << "Point Cloud: " << testPointCloud() << std::endl;
+	std::cout << "Eigen Symmetric: " << testEigenSymmetric() << std::endl;
+	std::cout << "Collision: " << testCollision() << std::endl;
+	std::cout << "Quaternion: " << testQuaternion() << std::endl;
+	std::cout << "TransformHierarchy: " << testTransformHierarchy() << std::endl;
+	std::cout << "Animation: " << testAnimation() << std::endl;
+	std::cout << "Instrumentation: " << testInstrumentation() << std::endl;
+	std::cout << "Curve: " << testCurve() << std::endl;
+	std::cout << "Morton Encode 63: " << testMortonEncode63() << std::endl;
+	std::cout << "Radix Sort: " << testRadixSort() << std::endl;
+	std::cout << "Distance: " << testDistance() << std::endl;
+	std::cout << "Affine3x4: " << testAffine3x4() << std::endl;
+	std::cout << "Stream: " << testStream() << std::endl;
+	std::cout << "Mesh: " << testMesh() << std::endl;
+	std::cout << "Float3: " << testFloat3() << std::endl;
+	std::cout << "Rotation: " << testRotation() << std::endl;
+	std::cout << "Orientation: " << testOrientation() << std::endl;
+	std::cout << "Ring: " << testRing() << std::endl;
+	std::cout << "ParallelFor: " << testParallelFor() << std::endl;
 	return 0;
 }
 
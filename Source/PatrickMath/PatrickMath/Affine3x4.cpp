@@ -0,0 +1,173 @@
+/*!
+* \file Affine3x4.cpp
+* \author Patrick Martin
+* \date 2010
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "stdafx.h"
+#include "Affine3x4.h"
+
+#include "ParallelFor.h"
+#include "Rotation.h"
+#include "Soa.h"
+
+const Affine3x4 Affine3x4::IDENTITY = Affine3x4();
+
+/*!
+* The operands of a batch, unused ones are NULL
+*/
+struct AffineBatch
+{
+	const Affine3x4 *transform;
+	const Affine3x4::Container *lhs;
+	const Affine3x4::Container *rhs;
+	const Quaternion::Container *rotations;
+	const Vector4::Container *vectors;
+	Affine3x4::Container *results;
+	Vector4::Container *destination;
+};
+
+/*!
+* The rotation of the transform with any scale divided out of the axes, see Rotation::matricesToQuaternions
+* \return the unit rotation quaternion, with w >= 0
+*/
+Quaternion Affine3x4::getRotation() const
+{
+	__m128 c0 = rows[0], c1 = rows[1], c2 = rows[2], c3 = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+	Matrix4::Container axes;
+	_mm_store_ps(axes.columns[0].elements, Vector4(c0).normalize());
+	_mm_store_ps(axes.columns[1].elements, Vector4(c1).normalize());
+	_mm_store_ps(axes.columns[2].elements, Vector4(c2).normalize());
+	_mm_store_ps(axes.columns[3].elements, c3);
+	Quaternion::Container rotation;
+	Rotation::matricesToQuaternions(&axes, &rotation, 1);
+	return Quaternion(rotation);
+}
+
+static void composeKernel(void *context, size_t, size_t begin, size_t end)
+{
+	AffineBatch &batch = *static_cast<AffineBatch *>(context);
+	for ( size_t i = begin; i < end; i++ )
+	{
+		Affine3x4(batch.lhs[i]).compose(Affine3x4(batch.rhs[i])).get(batch.results[i]);
+	}
+}
+
+/*!
+* The transform's twelve elements are broadcast once and four vectors are transposed at a time, so every result
+* component is three multiplies and three adds on four vectors.  The tail repeats the last vector and only writes back
+* what is in range.
+*/
+static void transformKernel(void *context, size_t, size_t begin, size_t end)
+{
+	AffineBatch &batch = *static_cast<AffineBatch *>(context);
+	Affine3x4::Container m;
+	batch.transform->get(m);
+	__m128 elements [12];
+	for ( int i = 0; i < 12; i++ )
+	{
+		elements[i] = _mm_set1_ps(m.elements[i]);
+	}
+
+	for ( size_t i = begin; i < end; i += 4 )
+	{
+		__m128 v [4];
+		Soa::loadTransposed(batch.vectors, i, end, v);
+
+		__m128 result [4];
+		for ( int row = 0; row < 3; row++ )
+		{
+			const __m128 *r = elements + row * 4;
+			__m128 sum = _mm_add_ps(_mm_mul_ps(r[0], v[0]), _mm_mul_ps(r[1], v[1]));
+			result[row] = _mm_add_ps(sum, _mm_add_ps(_mm_mul_ps(r[2], v[2]), _mm_mul_ps(r[3], v[3])));
+		}
+		result[3] = v[3];
+		Soa::storeTransposed(batch.destination, i, end, result);
+	}
+}
+
+static void fromRotationTranslationKernel(void *context, size_t, size_t begin, size_t end)
+{
+	AffineBatch &batch = *static_cast<AffineBatch *>(context);
+	for ( size_t i = begin; i < end; i++ )
+	{
+		Affine3x4::fromRotationTranslation(Quaternion(batch.rotations[i]), Vector4(batch.vectors[i])).get(
+			batch.results[i]);
+	}
+}
+
+/*!
+* Composes pairs of transforms, results[i] = lhs[i] * rhs[i]; results may alias either input
+* \param lhs the transforms applied last
+* \param rhs the transforms applied first
+* \param results receives the compositions
+* \param count the number of transforms
+* \param taskCount the number of tasks the batch is split into
+*/
+void Affine3x4::composeBatch(
+	const Container *lhs, const Container *rhs, Container *results, size_t count, size_t taskCount)
+{
+	PATRICKMATH_TIME(AFFINE_BATCH);
+	AffineBatch batch = {NULL, lhs, rhs, NULL, NULL, results, NULL};
+	ParallelFor::run(composeKernel, &batch, count, taskCount);
+}
+
+/*!
+* Transforms an array of Vector4s by one transform, honoring w like transform
+* \param transform the transform
+* \param source the vectors to transform
+* \param destination receives the transformed vectors, may be source
+* \param count the number of vectors
+* \param taskCount the number of tasks the batch is split into
+*/
+void Affine3x4::transformBatch(
+	const Affine3x4 &transform, const Vector4::Container *source, Vector4::Container *destination, size_t count,
+	size_t taskCount)
+{
+	PATRICKMATH_TIME(AFFINE_BATCH);
+	AffineBatch batch = {&transform, NULL, NULL, NULL, source, NULL, destination};
+	ParallelFor::run(transformKernel, &batch, count, taskCount);
+}
+
+/*!
+* Builds rigid transforms from rotations and translations, see fromRotationTranslation
+* \param rotations the unit rotations
+* \param translations the translations, w is ignored
+* \param results receives the transforms
+* \param count the number of transforms
+* \param taskCount the number of tasks the batch is split into
+*/
+void Affine3x4::fromRotationTranslationBatch(
+	const Quaternion::Container *rotations, const Vector4::Container *translations, Container *results, size_t count,
+	size_t taskCount)
+{
+	PATRICKMATH_TIME(AFFINE_BATCH);
+	AffineBatch batch = {NULL, NULL, NULL, rotations, translations, results, NULL};
+	ParallelFor::run(fromRotationTranslationKernel, &batch, count, taskCount);
+}
@@ -0,0 +1,380 @@
+/*!
+* \file Affine3x4.h
+* \author Patrick Martin
+* \date 2010
+* \brief Compact 3x4 affine transforms stored as three rows
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <xmmintrin.h>
+
+#include "Instrumentation.h"
+#include "Matrix4.h"
+#include "Quaternion.h"
+#include "Vector4.h"
+#include "XmmBool.h"
+#include "XmmFloat.h"
+
+/*!
+* An affine transform stored as the top three rows of a 4x4 matrix, (m00, m01, m02, tx) and so on.  The bottom row of
+* an affine Matrix4 is always (0, 0, 0, 1), so leaving it out saves a quarter of the memory and bandwidth of every
+* transform array.  Transforms apply to column vectors like Matrix4: (a * b) * v applies b first.
+*
+* Row storage makes a single transform a row dot product (three multiplies and a transpose), but batches of vectors
+* are transposed four at a time and then cost no more than with columns; see transformBatch.
+*/
+__declspec(align(16))
+class Affine3x4
+{
+public:
+	__declspec(align(16))
+	struct Container
+	{
+		union
+		{
+			Vector4::Container rows [3];
+			float elements [12];
+		};
+	};
+
+public:
+	// constructors
+	Affine3x4();
+	Affine3x4(const Affine3x4 &copy);
+	Affine3x4(const Container &container);
+	Affine3x4(const Vector4 &row0, const Vector4 &row1, const Vector4 &row2);
+	explicit Affine3x4(const Matrix4 &matrix);
+
+	Affine3x4 &operator=(const Affine3x4 &copy);
+
+	// named
+	Affine3x4 compose(const Affine3x4 &rhs) const;
+	Affine3x4 inverse() const;
+	Affine3x4 inverseOrthonormal() const;
+	Vector4 transform(const Vector4 &rhs) const;
+	Vector4 transformPoint(const Vector4 &point) const;
+	Vector4 transformVector(const Vector4 &vector) const;
+
+	XmmBool isEqual(const Affine3x4 &rhs, const XmmFloat &epsilon) const;
+
+	// operators
+	inline Affine3x4 operator* (const Affine3x4 &rhs) const	{return compose(rhs);}
+	inline Vector4 operator* (const Vector4 &rhs) const		{return transform(rhs);}
+
+	Vector4 getRow(int index) const;
+	Affine3x4 &setRow(int index, const Vector4 &row);
+	Vector4 getTranslation() const;
+	Quaternion getRotation() const;
+	Matrix4 toMatrix4() const;
+
+	Container &get(Container &destination) const;
+	Affine3x4 &set(const Container &source);
+
+	// scale first, then rotate, then translate
+	static Affine3x4 fromTransform(const Vector4 &translation, const Quaternion &rotation, const Vector4 &scale);
+	static Affine3x4 fromRotationTranslation(const Quaternion &rotation, const Vector4 &translation);
+
+	// batches
+	static void composeBatch(
+		const Container *lhs, const Container *rhs, Container *results, size_t count, size_t taskCount = 1);
+	static void transformBatch(
+		const Affine3x4 &transform, const Vector4::Container *source, Vector4::Container *destination, size_t count,
+		size_t taskCount = 1);
+	static void fromRotationTranslationBatch(
+		const Quaternion::Container *rotations, const Vector4::Container *translations, Container *results, size_t count,
+		size_t taskCount = 1);
+
+public:
+	static const Affine3x4 IDENTITY;
+
+private:
+	__m128 rows [3];
+};
+
+/*!
+* Default constructor initializes to the identity
+*/
+inline Affine3x4::Affine3x4()
+{
+	rows[0] = _mm_set_ps(0.f, 0.f, 0.f, 1.f);
+	rows[1] = _mm_set_ps(0.f, 0.f, 1.f, 0.f);
+	rows[2] = _mm_set_ps(0.f, 1.f, 0.f, 0.f);
+}
+
+inline Affine3x4::Affine3x4(const Affine3x4 &copy)
+{
+	rows[0] = copy.rows[0];
+	rows[1] = copy.rows[1];
+	rows[2] = copy.rows[2];
+}
+
+/*!
+* Initializes an Affine3x4 from a row major Container
+* \param container the twelve floats to load
+*/
+inline Affine3x4::Affine3x4(const Container &container)
+{
+	set(container);
+}
+
+/*!
+* Initializes an Affine3x4 from its rows, the w of each row is the translation along that axis
+*/
+inline Affine3x4::Affine3x4(const Vector4 &row0, const Vector4 &row1, const Vector4 &row2)
+{
+	rows[0] = row0;
+	rows[1] = row1;
+	rows[2] = row2;
+}
+
+/*!
+* Takes the top three rows of an affine Matrix4, the bottom row is assumed to be (0, 0, 0, 1)
+*/
+inline Affine3x4::Affine3x4(const Matrix4 &matrix)
+{
+	__m128 c0 = matrix.getColumn(0), c1 = matrix.getColumn(1), c2 = matrix.getColumn(2), c3 = matrix.getColumn(3);
+	_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+	rows[0] = c0;
+	rows[1] = c1;
+	rows[2] = c2;
+}
+
+inline Affine3x4 &Affine3x4::operator=(const Affine3x4 &copy)
+{
+	rows[0] = copy.rows[0];
+	rows[1] = copy.rows[1];
+	rows[2] = copy.rows[2];
+	return *this;
+}
+
+/*!
+* Composition, every result row is a row of this transform combining the rows of rhs; the translation lane of this
+* transform is carried over as if rhs had its implicit (0, 0, 0, 1) row
+* \param rhs the right hand side, applied first
+* \return this * rhs
+*/
+inline Affine3x4 Affine3x4::compose(const Affine3x4 &rhs) const
+{
+	PATRICKMATH_COUNT(AFFINE3X4_COMPOSE);
+	const __m128 wMask = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+	Affine3x4 result;
+	for ( int i = 0; i < 3; i++ )
+	{
+		__m128 row = rows[i];
+		__m128 combined = _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(0,0,0,0)), rhs.rows[0]);
+		combined = _mm_add_ps(combined, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(1,1,1,1)), rhs.rows[1]));
+		combined = _mm_add_ps(combined, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(2,2,2,2)), rhs.rows[2]));
+		result.rows[i] = _mm_add_ps(combined, _mm_and_ps(row, wMask));
+	}
+	return result;
+}
+
+/*!
+* General inverse.  The inverse of the 3x3 part has the cross products of its rows as columns, divided by the
+* determinant, and the translation is the inverted translation run through it.  The transform must not be singular.
+* \return the inverse transform
+*/
+inline Affine3x4 Affine3x4::inverse() const
+{
+	PATRICKMATH_COUNT(AFFINE3X4_INVERSE);
+	const __m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	Vector4 r0 (_mm_and_ps(rows[0], xyzMask)), r1 (_mm_and_ps(rows[1], xyzMask)), r2 (_mm_and_ps(rows[2], xyzMask));
+	__m128 c0 = _mm_and_ps(r1.crossProduct(r2), xyzMask);
+	__m128 c1 = _mm_and_ps(r2.crossProduct(r0), xyzMask);
+	__m128 c2 = _mm_and_ps(r0.crossProduct(r1), xyzMask);
+	__m128 inverseDeterminant = _mm_div_ps(_mm_set1_ps(1.f), r0.dotProduct(Vector4(c0)));
+	c0 = _mm_mul_ps(c0, inverseDeterminant);
+	c1 = _mm_mul_ps(c1, inverseDeterminant);
+	c2 = _mm_mul_ps(c2, inverseDeterminant);
+
+	// -M^-1 t from the columns, then transposed into the w lane of the rows
+	__m128 t0 = rows[0], t1 = rows[1], t2 = rows[2];
+	__m128 c3 = _mm_mul_ps(c0, _mm_shuffle_ps(t0, t0, _MM_SHUFFLE(3,3,3,3)));
+	c3 = _mm_add_ps(c3, _mm_mul_ps(c1, _mm_shuffle_ps(t1, t1, _MM_SHUFFLE(3,3,3,3))));
+	c3 = _mm_add_ps(c3, _mm_mul_ps(c2, _mm_shuffle_ps(t2, t2, _MM_SHUFFLE(3,3,3,3))));
+	c3 = _mm_sub_ps(_mm_setzero_ps(), c3);
+	_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+	Affine3x4 result;
+	result.rows[0] = c0;
+	result.rows[1] = c1;
+	result.rows[2] = c2;
+	return result;
+}
+
+/*!
+* Inverse of a rotation plus translation (no scale or shear): the transposed rotation and the translation rotated back
+* \return the inverse transform
+*/
+inline Affine3x4 Affine3x4::inverseOrthonormal() const
+{
+	PATRICKMATH_COUNT(AFFINE3X4_INVERSE);
+	__m128 c0 = rows[0], c1 = rows[1], c2 = rows[2], c3 = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+	// c0 .. c2 are now the rows of the transposed rotation (w = 0) and c3 the translation
+	Affine3x4 transposed;
+	transposed.rows[0] = c0;
+	transposed.rows[1] = c1;
+	transposed.rows[2] = c2;
+	__m128 translation = transposed.transform(Vector4(c3));
+	translation = _mm_sub_ps(_mm_setzero_ps(), translation);
+
+	// put -R^T t into the w lanes
+	__m128 x = _mm_shuffle_ps(translation, translation, _MM_SHUFFLE(0,0,0,0));
+	__m128 y = _mm_shuffle_ps(translation, translation, _MM_SHUFFLE(1,1,1,1));
+	__m128 z = _mm_shuffle_ps(translation, translation, _MM_SHUFFLE(2,2,2,2));
+	transposed.rows[0] = _mm_shuffle_ps(c0, _mm_unpackhi_ps(c0, x), _MM_SHUFFLE(1,0,1,0));
+	transposed.rows[1] = _mm_shuffle_ps(c1, _mm_unpackhi_ps(c1, y), _MM_SHUFFLE(1,0,1,0));
+	transposed.rows[2] = _mm_shuffle_ps(c2, _mm_unpackhi_ps(c2, z), _MM_SHUFFLE(1,0,1,0));
+	return transposed;
+}
+
+/*!
+* Transforms a Vector4, w is honored so points (w = 1) pick up the translation and directions (w = 0) do not
+* \param rhs the Vector4 to transform
+* \return this * rhs, with the w of rhs
+*/
+inline Vector4 Affine3x4::transform(const Vector4 &rhs) const
+{
+	PATRICKMATH_COUNT(AFFINE3X4_TRANSFORM);
+	__m128 v = rhs;
+	__m128 p0 = _mm_mul_ps(rows[0], v);
+	__m128 p1 = _mm_mul_ps(rows[1], v);
+	__m128 p2 = _mm_mul_ps(rows[2], v);
+	__m128 p3 = _mm_and_ps(v, _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0)));
+
+	// the sums of p0, p1, p2 (and w) land in x, y, z (and w)
+	_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+	return Vector4(_mm_add_ps(_mm_add_ps(p0, p1), _mm_add_ps(p2, p3)));
+}
+
+/*!
+* Transforms a point, the w of point is ignored and taken as 1
+* \return the transformed point, w = 1
+*/
+inline Vector4 Affine3x4::transformPoint(const Vector4 &point) const
+{
+	const __m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	return transform(Vector4(_mm_or_ps(_mm_and_ps(point, xyzMask), _mm_set_ps(1.f, 0.f, 0.f, 0.f))));
+}
+
+/*!
+* Transforms a direction, the w of vector is ignored and taken as 0
+* \return the transformed direction, w = 0
+*/
+inline Vector4 Affine3x4::transformVector(const Vector4 &vector) const
+{
+	const __m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	return transform(Vector4(_mm_and_ps(vector, xyzMask)));
+}
+
+/*!
+* Comparison within epsilon, every element must be within epsilon
+* \param rhs the right hand side of the comparison
+* \param epsilon the epsilon for the comparison
+* \return all high if equal within epsilon, all bits low otherwise
+*/
+inline XmmBool Affine3x4::isEqual(const Affine3x4 &rhs, const XmmFloat &epsilon) const
+{
+	return Vector4(rows[0]).isEqual(rhs.rows[0], epsilon) & Vector4(rows[1]).isEqual(rhs.rows[1], epsilon) &
+		Vector4(rows[2]).isEqual(rhs.rows[2], epsilon);
+}
+
+inline Vector4 Affine3x4::getRow(int index) const
+{
+	return Vector4(rows[index]);
+}
+
+inline Affine3x4 &Affine3x4::setRow(int index, const Vector4 &row)
+{
+	rows[index] = row;
+	return *this;
+}
+
+/*!
+* \return the translation as a point (w = 1)
+*/
+inline Vector4 Affine3x4::getTranslation() const
+{
+	__m128 xy = _mm_unpackhi_ps(rows[0], rows[1]); // z0, z1, t0, t1
+	__m128 z1 = _mm_unpackhi_ps(rows[2], _mm_set1_ps(1.f)); // z2, 1, t2, 1
+	return Vector4(_mm_shuffle_ps(xy, z1, _MM_SHUFFLE(3,2,3,2)));
+}
+
+/*!
+* \return the equivalent Matrix4, with the (0, 0, 0, 1) row restored
+*/
+inline Matrix4 Affine3x4::toMatrix4() const
+{
+	__m128 c0 = rows[0], c1 = rows[1], c2 = rows[2], c3 = _mm_set_ps(1.f, 0.f, 0.f, 0.f);
+	_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+	return Matrix4(Vector4(c0), Vector4(c1), Vector4(c2), Vector4(c3));
+}
+
+inline Affine3x4::Container &Affine3x4::get(Affine3x4::Container &destination) const
+{
+	PATRICKMATH_COUNT(AFFINE3X4_GET);
+	_mm_store_ps(destination.elements, rows[0]);
+	_mm_store_ps(destination.elements + 4, rows[1]);
+	_mm_store_ps(destination.elements + 8, rows[2]);
+	return destination;
+}
+
+inline Affine3x4 &Affine3x4::set(const Affine3x4::Container &source)
+{
+	PATRICKMATH_COUNT(AFFINE3X4_SET);
+	rows[0] = _mm_load_ps(source.elements);
+	rows[1] = _mm_load_ps(source.elements + 4);
+	rows[2] = _mm_load_ps(source.elements + 8);
+	return *this;
+}
+
+/*!
+* Builds translation * rotation * scale, see Matrix4::fromTransform
+* \param translation the translation, w is ignored
+* \param rotation a unit quaternion
+* \param scale the scale along each local axis, w is ignored
+* \return the affine transform
+*/
+inline Affine3x4 Affine3x4::fromTransform(const Vector4 &translation, const Quaternion &rotation, const Vector4 &scale)
+{
+	return Affine3x4(Matrix4::fromTransform(translation, rotation, scale));
+}
+
+/*!
+* Builds translation * rotation
+* \param rotation a unit quaternion
+* \param translation the translation, w is ignored
+* \return the rigid transform
+*/
+inline Affine3x4 Affine3x4::fromRotationTranslation(const Quaternion &rotation, const Vector4 &translation)
+{
+	return Affine3x4(Matrix4::fromTransform(translation, rotation, Vector4(_mm_set1_ps(1.f))));
+}
@@ -0,0 +1,370 @@
+/*!
+* \file Animation.cpp
+* \author Patrick Martin
+* \date 2010
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "stdafx.h"
+#include "Animation.h"
+
+#include <float.h>
+#include <malloc.h>
+#include <string.h>
+
+#include "ParallelFor.h"
+#include "XmmBool.h"
+#include "XmmFloat.h"
+
+/*!
+* Slerp tracks are collected four at a time so that the acos and sines are done once for four tracks
+*/
+struct SlerpGroup
+{
+	const Vector4::Container *from [4];
+	const Vector4::Container *to [4];
+	Vector4::Container *results [4];
+	float dots [4];
+	float factors [4];
+	size_t count;
+};
+
+struct AnimationBatch
+{
+	const Animation *animation;
+	float time;
+	uint32_t *cursors;
+	Vector4::Container *results;
+};
+
+/*!
+* acos for x in [0, 1], Abramowitz and Stegun 4.4.46 (absolute error 2e-8)
+*/
+static inline __m128 acosPositive(__m128 x)
+{
+	__m128 p = _mm_set1_ps(-0.0012624911f);
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(0.0066700901f));
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(-0.0170881256f));
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(0.0308918810f));
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(-0.0501743046f));
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(0.0889789874f));
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(-0.2145988016f));
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(1.5707963050f));
+	return _mm_mul_ps(p, _mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.f), x)));
+}
+
+/*!
+* Slerps every track in the group: theta = acos(dot), weights sin((1 - t) theta) / sin(theta) and sin(t theta) /
+* sin(theta), falling back to lerp weights when the keys are too close for the division
+*/
+static void flushSlerp(SlerpGroup &group)
+{
+	if ( group.count == 0 )
+	{
+		return;
+	}
+	for ( size_t lane = group.count; lane < 4; lane++ )
+	{
+		group.dots[lane] = 1.f;
+		group.factors[lane] = 0.f;
+	}
+
+	const __m128 one = _mm_set1_ps(1.f);
+	__m128 dots = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(group.dots), _mm_setzero_ps()), one);
+	__m128 factors = _mm_loadu_ps(group.factors);
+	__m128 theta = acosPositive(dots);
+
+	XmmFloat sinTheta, sinFrom, sinTo, cosIgnored;
+	XmmFloat(theta).sinCos(sinTheta, cosIgnored);
+	XmmFloat(_mm_mul_ps(_mm_sub_ps(one, factors), theta)).sinCos(sinFrom, cosIgnored);
+	XmmFloat(_mm_mul_ps(factors, theta)).sinCos(sinTo, cosIgnored);
+
+	XmmBool nearlyEqual = _mm_cmplt_ps(sinTheta, _mm_set1_ps(1.0e-4f));
+	__m128 inverse = _mm_div_ps(one, _mm_max_ps(sinTheta, _mm_set1_ps(1.0e-4f)));
+	__m128 weightsFrom = nearlyEqual.select(_mm_sub_ps(one, factors), _mm_mul_ps(sinFrom, inverse));
+	__m128 weightsTo = nearlyEqual.select(factors, _mm_mul_ps(sinTo, inverse));
+
+	Vector4::Container from, to;
+	_mm_store_ps(from.elements, weightsFrom);
+	_mm_store_ps(to.elements, weightsTo);
+	for ( size_t lane = 0; lane < group.count; lane++ )
+	{
+		__m128 result = _mm_mul_ps(_mm_load_ps(group.from[lane]->elements), _mm_set1_ps(from.elements[lane]));
+		result = _mm_add_ps(result, _mm_mul_ps(_mm_load_ps(group.to[lane]->elements), _mm_set1_ps(to.elements[lane])));
+		_mm_store_ps(group.results[lane]->elements, result);
+	}
+	group.count = 0;
+}
+
+static void animationKernel(void *context, size_t, size_t begin, size_t end)
+{
+	AnimationBatch *batch = static_cast<AnimationBatch*>(context);
+	batch->animation->sample(batch->time, batch->cursors, batch->results, begin, end);
+}
+
+Animation::Animation()
+:	m_times(NULL), m_keys(NULL), m_tracks(NULL), m_trackCount(0), m_duration(0.f)
+{
+}
+
+Animation::~Animation()
+{
+	clear();
+}
+
+void Animation::clear()
+{
+	_aligned_free(m_times);
+	_aligned_free(m_keys);
+	delete [] m_tracks;
+	m_times = NULL;
+	m_keys = NULL;
+	m_tracks = NULL;
+	m_trackCount = 0;
+	m_duration = 0.f;
+}
+
+/*!
+* Packs the tracks.  Rotation keys have their signs flipped where needed so that neighboring keys are in the same
+* hemisphere, which makes every interpolation take the short way without a per sample check.
+* \param sources the tracks
+* \param trackCount the number of tracks
+* \return false if a track has no keys, no values, or unsorted times; the animation is then empty
+*/
+bool Animation::build(const TrackSource *sources, size_t trackCount)
+{
+	clear();
+
+	size_t timeCount = 0, keyCount = 0;
+	for ( size_t i = 0; i < trackCount; i++ )
+	{
+		const TrackSource &source = sources[i];
+		if ( source.keyCount == 0 || (source.translations == NULL) == (source.rotations == NULL) )
+		{
+			return false;
+		}
+		for ( size_t key = 1; key < source.keyCount; key++ )
+		{
+			if ( !(source.times[key] >= source.times[key - 1]) )
+			{
+				return false;
+			}
+		}
+
+		// at least four padding times after the last key so the search can always load four past the cursor
+		timeCount += (source.keyCount + 4 + 3) & ~size_t(3);
+		keyCount += source.keyCount;
+	}
+
+	m_times = static_cast<float*>(_aligned_malloc((timeCount > 0 ? timeCount : 1) * sizeof(float), 16));
+	m_keys = static_cast<Vector4::Container*>(_aligned_malloc((keyCount > 0 ? keyCount : 1) * sizeof(Vector4::Container), 16));
+	m_tracks = new Track [trackCount > 0 ? trackCount : 1];
+	m_trackCount = trackCount;
+
+	size_t timeOffset = 0, keyOffset = 0;
+	for ( size_t i = 0; i < trackCount; i++ )
+	{
+		const TrackSource &source = sources[i];
+		Track &track = m_tracks[i];
+		track.timeOffset = uint32_t(timeOffset);
+		track.keyOffset = uint32_t(keyOffset);
+		track.keyCount = uint32_t(source.keyCount);
+		track.isRotation = source.rotations != NULL;
+		track.interpolation = uint8_t(source.interpolation == SLERP && !track.isRotation ? LINEAR : source.interpolation);
+
+		size_t paddedCount = (source.keyCount + 4 + 3) & ~size_t(3);
+		memcpy(m_times + timeOffset, source.times, source.keyCount * sizeof(float));
+		for ( size_t key = source.keyCount; key < paddedCount; key++ )
+		{
+			m_times[timeOffset + key] = FLT_MAX;
+		}
+		if ( source.times[source.keyCount - 1] > m_duration )
+		{
+			m_duration = source.times[source.keyCount - 1];
+		}
+
+		for ( size_t key = 0; key < source.keyCount; key++ )
+		{
+			Vector4::Container &value = m_keys[keyOffset + key];
+			if ( track.isRotation )
+			{
+				Quaternion rotation (source.rotations[key]);
+				if ( key > 0 )
+				{
+					XmmBool opposite = rotation.dotProduct(Quaternion(_mm_load_ps(m_keys[keyOffset + key - 1].elements))) <
+						XmmFloat(0.f);
+					rotation = Quaternion(opposite.select(_mm_sub_ps(_mm_setzero_ps(), rotation), rotation));
+				}
+				_mm_store_ps(value.elements, rotation);
+			}
+			else
+			{
+				value = source.translations[key];
+			}
+		}
+
+		timeOffset += paddedCount;
+		keyOffset += source.keyCount;
+	}
+	return true;
+}
+
+/*!
+* Sets every cursor to the first key, for a new playback
+* \param cursors one cursor per track
+*/
+void Animation::resetCursors(uint32_t *cursors) const
+{
+	memset(cursors, 0, m_trackCount * sizeof(uint32_t));
+}
+
+/*!
+* Finds the last key at or before time.  Going forward it scans four keys per compare from the cursor, so with the
+* usual small time steps it is one compare.  Going backward (a loop or a seek) a binary search narrows the keys before
+* the cursor to a few and the scan finishes.
+* \param times a track's key times, padded with at least four FLT_MAX
+* \param keyCount the number of keys in the track, at or after the last key (even FLT_MAX or INFINITY) gives the last
+* \param time the sample time, before the first key gives key 0
+* \param cursor the key found by the previous search, or 0
+* \return the key index
+*/
+uint32_t Animation::findKey(const float *times, uint32_t keyCount, float time, uint32_t cursor)
+{
+	PATRICKMATH_COUNT(ANIMATION_KEY_SEARCH);
+	static const uint32_t raisedCounts [16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+
+	// the padding would pass the compare too, so the scan only runs while time is before the last key
+	uint32_t last = keyCount - 1;
+	if ( time >= times[last] )
+	{
+		return last;
+	}
+
+	if ( time < times[cursor] )
+	{
+		PATRICKMATH_COUNT(ANIMATION_REWIND);
+		uint32_t low = 0, high = cursor;
+		while ( high - low > 8 )
+		{
+			uint32_t middle = (low + high) / 2;
+			if ( times[middle] <= time )
+			{
+				low = middle;
+			}
+			else
+			{
+				high = middle;
+			}
+		}
+		cursor = low;
+	}
+
+	// sorted times make the mask a run of low bits so its population is how far to move
+	__m128 t = _mm_set1_ps(time);
+	for ( ;; )
+	{
+		uint32_t advance = raisedCounts[_mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(times + cursor + 1), t))];
+		cursor += advance;
+		if ( advance < 4 )
+		{
+			return cursor;
+		}
+	}
+}
+
+/*!
+* Samples tracks [begin, end) at time.  Times before the first key or after the last clamp to that key.
+* \param time the sample time
+* \param cursors one cursor per track (indexed by track), read and updated
+* \param results one result per track (indexed by track), rotations are stored x, y, z, w
+* \param begin the first track to sample
+* \param end one past the last track to sample
+*/
+void Animation::sample(float time, uint32_t *cursors, Vector4::Container *results, size_t begin, size_t end) const
+{
+	PATRICKMATH_TIME(ANIMATION_SAMPLE);
+	SlerpGroup group;
+	group.count = 0;
+
+	for ( size_t i = begin; i < end; i++ )
+	{
+		const Track &track = m_tracks[i];
+		const float *times = m_times + track.timeOffset;
+		uint32_t key = findKey(times, track.keyCount, time, cursors[i] < track.keyCount ? cursors[i] : 0);
+		cursors[i] = key;
+
+		uint32_t next = key + 1 < track.keyCount ? key + 1 : key;
+		const Vector4::Container &from = m_keys[track.keyOffset + key];
+		const Vector4::Container &to = m_keys[track.keyOffset + next];
+		float span = times[next] - times[key];
+		float factor = span > 0.f ? (time - times[key]) / span : 0.f;
+		factor = factor < 0.f ? 0.f : (factor > 1.f ? 1.f : factor);
+
+		if ( track.interpolation == STEP || next == key )
+		{
+			results[i] = from;
+		}
+		else if ( track.interpolation == LINEAR )
+		{
+			__m128 a = _mm_load_ps(from.elements);
+			__m128 result = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(to.elements), a), _mm_set1_ps(factor)));
+			if ( track.isRotation )
+			{
+				result = Quaternion(result).normalize();
+			}
+			_mm_store_ps(results[i].elements, result);
+		}
+		else
+		{
+			float dot;
+			Quaternion(_mm_load_ps(from.elements)).dotProduct(Quaternion(_mm_load_ps(to.elements))).get(dot);
+			group.from[group.count] = &from;
+			group.to[group.count] = &to;
+			group.results[group.count] = &results[i];
+			group.dots[group.count] = dot;
+			group.factors[group.count] = factor;
+			if ( ++group.count == 4 )
+			{
+				flushSlerp(group);
+			}
+		}
+	}
+	flushSlerp(group);
+}
+
+/*!
+* Samples every track, spread over ParallelFor
+* \param time the sample time
+* \param cursors one cursor per track
+* \param results one result per track
+* \param taskCount the number of threads to split the tracks over
+*/
+void Animation::sampleBatch(float time, uint32_t *cursors, Vector4::Container *results, size_t taskCount) const
+{
+	AnimationBatch batch = {this, time, cursors, results};
+	ParallelFor::run(animationKernel, &batch, m_trackCount, taskCount);
+}
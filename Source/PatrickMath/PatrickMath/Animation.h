@@ -0,0 +1,120 @@
+/*!
+* \file Animation.h
+* \author Patrick Martin
+* \date 2010
+* \brief Batched keyframe sampling of translation and rotation tracks
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Quaternion.h"
+#include "Vector4.h"
+
+/*!
+* A set of keyframe tracks sampled all at once.  Every track's key times are packed in one float array, padded to a
+* multiple of four with FLT_MAX so a key search is a run of four wide compares, and key values are packed in a second
+* array in the same order.  Translation tracks hold Vector4 keys and rotation tracks hold Quaternion keys (x, y, z, w),
+* both sample into Vector4::Container.
+*
+* Playback state is a cursor per track (the last key used) owned by the caller, so many instances can play one
+* Animation.  Moving forward in time the search starts at the cursor, which makes normal playback O(1) per track.
+*/
+class Animation
+{
+public:
+	enum Interpolation
+	{
+		STEP,	// hold the previous key
+		LINEAR,	// lerp, rotations are normalized afterwards (nlerp)
+		SLERP	// constant angular velocity, rotations only (translations fall back to LINEAR)
+	};
+
+	/*!
+	* One track's input, set either translations or rotations.  times must be non decreasing.
+	*/
+	struct TrackSource
+	{
+		const float *times;
+		const Vector4::Container *translations;
+		const Quaternion::Container *rotations;
+		size_t keyCount;
+		Interpolation interpolation;
+	};
+
+	Animation();
+	~Animation();
+
+	bool build(const TrackSource *sources, size_t trackCount);
+	void clear();
+
+	size_t trackCount() const;
+	float duration() const;
+	void resetCursors(uint32_t *cursors) const;
+
+	// sampling
+	void sample(float time, uint32_t *cursors, Vector4::Container *results, size_t begin, size_t end) const;
+	void sampleBatch(float time, uint32_t *cursors, Vector4::Container *results, size_t taskCount = 1) const;
+
+	static uint32_t findKey(const float *times, uint32_t keyCount, float time, uint32_t cursor);
+
+private:
+	struct Track
+	{
+		uint32_t timeOffset;
+		uint32_t keyOffset;
+		uint32_t keyCount;
+		uint8_t interpolation;
+		uint8_t isRotation;
+	};
+
+	// not copyable, the arrays are owned
+	Animation(const Animation &);
+	Animation &operator=(const Animation &);
+
+	float *m_times;
+	Vector4::Container *m_keys;
+	Track *m_tracks;
+	size_t m_trackCount;
+	float m_duration;
+};
+
+inline size_t Animation::trackCount() const
+{
+	return m_trackCount;
+}
+
+/*!
+* \return the time of the last key of the longest track
+*/
+inline float Animation::duration() const
+{
+	return m_duration;
+}
@@ -0,0 +1,840 @@
+/*!
+* \file Collision.cpp
+* \author Patrick Martin
+* \date 2010
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "stdafx.h"
+#include "Collision.h"
+
+#include <float.h>
+#include <math.h>
+
+#include "ParallelFor.h"
+#include "Soa.h"
+#include "XmmBool.h"
+#include "XmmInt.h"
+
+static const int GJK_MAX_ITERATIONS = 64;
+static const int EPA_MAX_ITERATIONS = 64;
+static const int EPA_MAX_VERTICES = 64;
+static const int EPA_MAX_FACES = 128;
+
+// relative convergence tolerance on the squared distance
+static const float GJK_TOLERANCE = 1.0e-5f;
+static const float EPA_TOLERANCE = 1.0e-4f;
+
+/*!
+* A point of the Minkowski difference a - b along with the two support points that made it, so that barycentric
+* coordinates on the difference can be turned back into points on the shapes
+*/
+struct SupportPoint
+{
+	Vector4 w;
+	Vector4 a;
+	Vector4 b;
+};
+
+struct Simplex
+{
+	SupportPoint points [4];
+	XmmFloat lambda [4];
+	int count;
+};
+
+struct EpaFace
+{
+	Vector4 normal;
+	XmmFloat distance;
+	int index [3];
+};
+
+static void minkowskiSupport(
+	const Collision::Shape &a, const Collision::Shape &b, const Vector4 &direction, SupportPoint &result)
+{
+	result.a = Collision::support(a, direction);
+	result.b = Collision::support(b, -direction);
+	result.w = result.a - result.b;
+}
+
+static void setSimplex(Simplex &simplex, const SupportPoint &p0, const XmmFloat &l0)
+{
+	simplex.points[0] = p0;
+	simplex.lambda[0] = l0;
+	simplex.count = 1;
+}
+
+static void setSimplex(
+	Simplex &simplex, const SupportPoint &p0, const SupportPoint &p1, const XmmFloat &l0, const XmmFloat &l1)
+{
+	SupportPoint copy1 = p1;
+	simplex.points[0] = p0;
+	simplex.points[1] = copy1;
+	simplex.lambda[0] = l0;
+	simplex.lambda[1] = l1;
+	simplex.count = 2;
+}
+
+static void setSimplex(
+	Simplex &simplex, const SupportPoint &p0, const SupportPoint &p1, const SupportPoint &p2, const XmmFloat &l0,
+	const XmmFloat &l1, const XmmFloat &l2)
+{
+	SupportPoint copy1 = p1, copy2 = p2;
+	simplex.points[0] = p0;
+	simplex.points[1] = copy1;
+	simplex.points[2] = copy2;
+	simplex.lambda[0] = l0;
+	simplex.lambda[1] = l1;
+	simplex.lambda[2] = l2;
+	simplex.count = 3;
+}
+
+/*!
+* Reduces simplex to the feature of segment ab closest to the origin
+*/
+static void closestOnSegment(const SupportPoint &a, const SupportPoint &b, Simplex &result)
+{
+	const XmmFloat zero, one = _mm_set1_ps(1.f);
+	Vector4 ab = b.w - a.w;
+	XmmFloat lengthSq = ab.dotProduct(ab);
+	XmmFloat t = (lengthSq > zero).select(-a.w.dotProduct(ab) / lengthSq, zero);
+	if ( (t <= zero).getValue() )
+	{
+		SupportPoint copy = a;
+		setSimplex(result, copy, one);
+	}
+	else if ( (t >= one).getValue() )
+	{
+		SupportPoint copy = b;
+		setSimplex(result, copy, one);
+	}
+	else
+	{
+		SupportPoint copyA = a, copyB = b;
+		setSimplex(result, copyA, copyB, one - t, t);
+	}
+}
+
+/*!
+* Reduces simplex to the feature of triangle abc closest to the origin (Ericson, Real-Time Collision Detection 5.1.5)
+*/
+static void closestOnTriangle(const SupportPoint &a, const SupportPoint &b, const SupportPoint &c, Simplex &result)
+{
+	SupportPoint pa = a, pb = b, pc = c; // result may alias the inputs
+	const XmmFloat zero, one = _mm_set1_ps(1.f);
+	Vector4 ab = pb.w - pa.w;
+	Vector4 ac = pc.w - pa.w;
+
+	XmmFloat d1 = -ab.dotProduct(pa.w);
+	XmmFloat d2 = -ac.dotProduct(pa.w);
+	if ( (d1 <= zero).getValue() && (d2 <= zero).getValue() )
+	{
+		setSimplex(result, pa, one);
+		return;
+	}
+
+	XmmFloat d3 = -ab.dotProduct(pb.w);
+	XmmFloat d4 = -ac.dotProduct(pb.w);
+	if ( (d3 >= zero).getValue() && (d4 <= d3).getValue() )
+	{
+		setSimplex(result, pb, one);
+		return;
+	}
+
+	XmmFloat vc = d1 * d4 - d3 * d2;
+	if ( (vc <= zero).getValue() && (d1 >= zero).getValue() && (d3 <= zero).getValue() )
+	{
+		XmmFloat v = d1 / (d1 - d3);
+		setSimplex(result, pa, pb, one - v, v);
+		return;
+	}
+
+	XmmFloat d5 = -ab.dotProduct(pc.w);
+	XmmFloat d6 = -ac.dotProduct(pc.w);
+	if ( (d6 >= zero).getValue() && (d5 <= d6).getValue() )
+	{
+		setSimplex(result, pc, one);
+		return;
+	}
+
+	XmmFloat vb = d5 * d2 - d1 * d6;
+	if ( (vb <= zero).getValue() && (d2 >= zero).getValue() && (d6 <= zero).getValue() )
+	{
+		XmmFloat w = d2 / (d2 - d6);
+		setSimplex(result, pa, pc, one - w, w);
+		return;
+	}
+
+	XmmFloat va = d3 * d6 - d5 * d4;
+	if ( (va <= zero).getValue() && (d4 - d3 >= zero).getValue() && (d5 - d6 >= zero).getValue() )
+	{
+		XmmFloat w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		setSimplex(result, pb, pc, one - w, w);
+		return;
+	}
+
+	XmmFloat sum = va + vb + vc;
+	if ( (sum <= zero).getValue() )
+	{
+		// degenerate (collinear) triangle, the closest point is on its longest edge
+		Vector4 bc = pc.w - pb.w;
+		XmmFloat abSq = ab.dotProduct(ab), acSq = ac.dotProduct(ac), bcSq = bc.dotProduct(bc);
+		if ( (abSq >= acSq).getValue() && (abSq >= bcSq).getValue() )
+		{
+			closestOnSegment(pa, pb, result);
+		}
+		else if ( (acSq >= bcSq).getValue() )
+		{
+			closestOnSegment(pa, pc, result);
+		}
+		else
+		{
+			closestOnSegment(pb, pc, result);
+		}
+		return;
+	}
+
+	XmmFloat denominator = one / sum;
+	XmmFloat v = vb * denominator;
+	XmmFloat w = vc * denominator;
+	setSimplex(result, pa, pb, pc, one - v - w, v, w);
+}
+
+/*!
+* True if the origin is on the opposite side of plane abc from d.  A flat tetrahedron counts as outside on every face
+* so that the triangles get tested instead.
+*/
+static bool originOutsideFace(const Vector4 &a, const Vector4 &b, const Vector4 &c, const Vector4 &d)
+{
+	Vector4 normal = (b - a).crossProduct(c - a);
+	Vector4 opposite = d - a;
+	XmmFloat signOrigin = -a.dotProduct(normal);
+	XmmFloat signOpposite = opposite.dotProduct(normal);
+	XmmFloat flat = XmmFloat(1.0e-12f) * normal.dotProduct(normal) * opposite.dotProduct(opposite);
+	if ( (signOpposite * signOpposite <= flat).getValue() )
+	{
+		return true;
+	}
+	return (signOrigin * signOpposite < XmmFloat()).getValue();
+}
+
+static Vector4 simplexClosest(const Simplex &simplex)
+{
+	Vector4 closest;
+	for ( int i = 0; i < simplex.count; i++ )
+	{
+		closest = closest + Vector4(_mm_mul_ps(simplex.points[i].w, simplex.lambda[i]));
+	}
+	return closest;
+}
+
+/*!
+* Reduces the simplex to its feature closest to the origin and fills in the barycentric coordinates
+* \return true if the simplex is a tetrahedron containing the origin
+*/
+static bool solveSimplex(Simplex &simplex)
+{
+	switch ( simplex.count )
+	{
+	case 1:
+		simplex.lambda[0] = _mm_set1_ps(1.f);
+		return false;
+	case 2:
+		closestOnSegment(simplex.points[0], simplex.points[1], simplex);
+		return false;
+	case 3:
+		closestOnTriangle(simplex.points[0], simplex.points[1], simplex.points[2], simplex);
+		return false;
+	}
+
+	static const int faces [4][4] = {{0, 1, 2, 3}, {0, 2, 3, 1}, {0, 3, 1, 2}, {1, 3, 2, 0}};
+	Simplex best;
+	XmmFloat bestDistanceSq = _mm_set1_ps(FLT_MAX);
+	bool inside = true;
+	for ( int face = 0; face < 4; face++ )
+	{
+		const SupportPoint &a = simplex.points[faces[face][0]];
+		const SupportPoint &b = simplex.points[faces[face][1]];
+		const SupportPoint &c = simplex.points[faces[face][2]];
+		if ( !originOutsideFace(a.w, b.w, c.w, simplex.points[faces[face][3]].w) )
+		{
+			continue;
+		}
+
+		inside = false;
+		Simplex candidate;
+		closestOnTriangle(a, b, c, candidate);
+		Vector4 closest = simplexClosest(candidate);
+		XmmFloat distanceSq = closest.dotProduct(closest);
+		if ( (distanceSq < bestDistanceSq).getValue() )
+		{
+			bestDistanceSq = distanceSq;
+			best = candidate;
+		}
+	}
+
+	if ( inside )
+	{
+		return true;
+	}
+	simplex = best;
+	return false;
+}
+
+static void simplexWitness(const Simplex &simplex, Vector4 &pointA, Vector4 &pointB)
+{
+	pointA = Vector4();
+	pointB = Vector4();
+	for ( int i = 0; i < simplex.count; i++ )
+	{
+		pointA = pointA + Vector4(_mm_mul_ps(simplex.points[i].a, simplex.lambda[i]));
+		pointB = pointB + Vector4(_mm_mul_ps(simplex.points[i].b, simplex.lambda[i]));
+	}
+}
+
+/*!
+* GJK on the cores of a and b
+* \param simplex receives the final simplex, its closest point is the closest point of a - b to the origin
+* \return true if the cores overlap (or touch closer than the tolerance)
+*/
+static bool gjk(const Collision::Shape &a, const Collision::Shape &b, Simplex &simplex)
+{
+	const XmmFloat zero, tolerance = _mm_set1_ps(GJK_TOLERANCE), touching = _mm_set1_ps(1.0e-12f);
+	Vector4 v = a.points[0] - b.points[0];
+	if ( (v.dotProduct(v) <= zero).getValue() )
+	{
+		v = Vector4::UNIT_X;
+	}
+	simplex.count = 0;
+
+	XmmFloat previousDistanceSq = _mm_set1_ps(FLT_MAX);
+	for ( int iteration = 0; iteration < GJK_MAX_ITERATIONS; iteration++ )
+	{
+		PATRICKMATH_COUNT(COLLISION_GJK_ITERATION);
+		SupportPoint point;
+		minkowskiSupport(a, b, -v, point);
+
+		if ( simplex.count > 0 )
+		{
+			XmmFloat distanceSq = v.dotProduct(v);
+			if ( (distanceSq - v.dotProduct(point.w) <= tolerance * distanceSq).getValue() )
+			{
+				return false;
+			}
+			for ( int i = 0; i < simplex.count; i++ )
+			{
+				if ( point.w.isEqual(simplex.points[i].w).getValue() )
+				{
+					return false;
+				}
+			}
+		}
+
+		simplex.points[simplex.count++] = point;
+		if ( solveSimplex(simplex) )
+		{
+			return true;
+		}
+
+		v = simplexClosest(simplex);
+		XmmFloat distanceSq = v.dotProduct(v);
+		if ( (distanceSq <= touching).getValue() )
+		{
+			return true;
+		}
+		if ( (distanceSq >= previousDistanceSq).getValue() )
+		{
+			return false;
+		}
+		previousDistanceSq = distanceSq;
+	}
+	return false;
+}
+
+/*!
+* Adds support points until the simplex is a non degenerate tetrahedron.  GJK can stop on a lower dimensional simplex
+* when the origin lies on its boundary (touching contact).
+* \return false if the Minkowski difference is flat and no tetrahedron exists
+*/
+static bool expandSimplex(const Collision::Shape &a, const Collision::Shape &b, Simplex &simplex)
+{
+	static const Vector4 *axes [3] = {&Vector4::UNIT_X, &Vector4::UNIT_Y, &Vector4::UNIT_Z};
+	const XmmFloat degenerate = _mm_set1_ps(1.0e-10f);
+
+	for ( int axis = 0; simplex.count == 1 && axis < 6; axis++ )
+	{
+		Vector4 direction = axis < 3 ? *axes[axis] : -*axes[axis - 3];
+		minkowskiSupport(a, b, direction, simplex.points[1]);
+		Vector4 edge = simplex.points[1].w - simplex.points[0].w;
+		if ( (edge.dotProduct(edge) > degenerate).getValue() )
+		{
+			simplex.count = 2;
+		}
+	}
+
+	if ( simplex.count == 2 )
+	{
+		Vector4 edge = simplex.points[1].w - simplex.points[0].w;
+		for ( int axis = 0; simplex.count == 2 && axis < 3; axis++ )
+		{
+			Vector4 perpendicular = edge.crossProduct(*axes[axis]);
+			if ( (perpendicular.dotProduct(perpendicular) <= degenerate).getValue() )
+			{
+				continue;
+			}
+			for ( int sign = 0; simplex.count == 2 && sign < 2; sign++ )
+			{
+				minkowskiSupport(a, b, sign ? -perpendicular : perpendicular, simplex.points[2]);
+				Vector4 normal = edge.crossProduct(simplex.points[2].w - simplex.points[0].w);
+				if ( (normal.dotProduct(normal) > degenerate).getValue() )
+				{
+					simplex.count = 3;
+				}
+			}
+		}
+	}
+
+	if ( simplex.count == 3 )
+	{
+		Vector4 normal = (simplex.points[1].w - simplex.points[0].w).crossProduct(simplex.points[2].w - simplex.points[0].w);
+		for ( int sign = 0; simplex.count == 3 && sign < 2; sign++ )
+		{
+			minkowskiSupport(a, b, sign ? -normal : normal, simplex.points[3]);
+			XmmFloat height = (simplex.points[3].w - simplex.points[0].w).dotProduct(normal);
+			if ( (height * height > degenerate * normal.dotProduct(normal)).getValue() )
+			{
+				simplex.count = 4;
+			}
+		}
+	}
+
+	return simplex.count == 4;
+}
+
+/*!
+* Builds a face with its normal pointing away from interior
+*/
+static bool makeFace(const SupportPoint *vertices, int i0, int i1, int i2, const Vector4 &interior, EpaFace &face)
+{
+	Vector4 normal = (vertices[i1].w - vertices[i0].w).crossProduct(vertices[i2].w - vertices[i0].w);
+	if ( (normal.dotProduct(normal) <= XmmFloat(1.0e-20f)).getValue() )
+	{
+		return false;
+	}
+
+	normal = normal.normalize();
+	face.index[0] = i0;
+	if ( (normal.dotProduct(vertices[i0].w - interior) < XmmFloat()).getValue() )
+	{
+		normal = -normal;
+		face.index[1] = i2;
+		face.index[2] = i1;
+	}
+	else
+	{
+		face.index[1] = i1;
+		face.index[2] = i2;
+	}
+	face.normal = normal;
+	face.distance = normal.dotProduct(vertices[i0].w);
+	return true;
+}
+
+static int closestFace(const EpaFace *faces, int faceCount)
+{
+	int closest = 0;
+	for ( int i = 1; i < faceCount; i++ )
+	{
+		if ( (faces[i].distance < faces[closest].distance).getValue() )
+		{
+			closest = i;
+		}
+	}
+	return closest;
+}
+
+/*!
+* EPA, expands the GJK tetrahedron toward the boundary of a - b until the face closest to the origin is on it
+* \return false if the penetration could not be resolved (flat shapes), the outputs are then a best guess
+*/
+static bool epa(
+	const Collision::Shape &a, const Collision::Shape &b, Simplex &simplex, Vector4 &normal, XmmFloat &depth,
+	Vector4 &pointA, Vector4 &pointB)
+{
+	const XmmFloat zero, one = _mm_set1_ps(1.f), tolerance = _mm_set1_ps(EPA_TOLERANCE);
+	normal = Vector4::UNIT_Z;
+	depth = zero;
+	simplexWitness(simplex, pointA, pointB);
+	if ( !expandSimplex(a, b, simplex) )
+	{
+		return false;
+	}
+
+	SupportPoint vertices [EPA_MAX_VERTICES];
+	EpaFace faces [EPA_MAX_FACES];
+	int vertexCount = 4;
+	int faceCount = 0;
+	for ( int i = 0; i < 4; i++ )
+	{
+		vertices[i] = simplex.points[i];
+	}
+	Vector4 interior = _mm_mul_ps(vertices[0].w + vertices[1].w + vertices[2].w + vertices[3].w, _mm_set1_ps(0.25f));
+
+	static const int tetrahedron [4][3] = {{0, 1, 2}, {0, 3, 1}, {0, 2, 3}, {1, 3, 2}};
+	for ( int i = 0; i < 4; i++ )
+	{
+		if ( makeFace(vertices, tetrahedron[i][0], tetrahedron[i][1], tetrahedron[i][2], interior, faces[faceCount]) )
+		{
+			faceCount++;
+		}
+	}
+
+	for ( int iteration = 0; iteration < EPA_MAX_ITERATIONS && faceCount > 0; iteration++ )
+	{
+		PATRICKMATH_COUNT(COLLISION_EPA_ITERATION);
+		int closest = closestFace(faces, faceCount);
+
+		SupportPoint point;
+		minkowskiSupport(a, b, faces[closest].normal, point);
+		XmmFloat growth = point.w.dotProduct(faces[closest].normal) - faces[closest].distance;
+		if ( (growth <= tolerance * XmmFloat::max(faces[closest].distance, one)).getValue() ||
+			vertexCount == EPA_MAX_VERTICES )
+		{
+			break;
+		}
+
+		// find every face the new point can see and the horizon around them, nothing is removed until the new faces
+		// are known to fit so that stopping here leaves the polytope whole
+		bool visible [EPA_MAX_FACES];
+		int visibleCount = 0;
+		int horizon [EPA_MAX_FACES * 3][2];
+		int horizonCount = 0;
+		for ( int i = 0; i < faceCount; i++ )
+		{
+			visible[i] = (faces[i].normal.dotProduct(point.w - vertices[faces[i].index[0]].w) > zero).getValue();
+			if ( !visible[i] )
+			{
+				continue;
+			}
+			visibleCount++;
+
+			for ( int edge = 0; edge < 3; edge++ )
+			{
+				int from = faces[i].index[edge];
+				int to = faces[i].index[(edge + 1) % 3];
+				bool shared = false;
+				for ( int j = 0; j < horizonCount; j++ )
+				{
+					if ( horizon[j][0] == to && horizon[j][1] == from )
+					{
+						horizon[j][0] = horizon[horizonCount - 1][0];
+						horizon[j][1] = horizon[horizonCount - 1][1];
+						horizonCount--;
+						shared = true;
+						break;
+					}
+				}
+				if ( !shared )
+				{
+					horizon[horizonCount][0] = from;
+					horizon[horizonCount][1] = to;
+					horizonCount++;
+				}
+			}
+		}
+
+		if ( horizonCount == 0 || faceCount - visibleCount + horizonCount > EPA_MAX_FACES )
+		{
+			break;
+		}
+
+		int kept = 0;
+		for ( int i = 0; i < faceCount; i++ )
+		{
+			if ( !visible[i] )
+			{
+				faces[kept++] = faces[i];
+			}
+		}
+		faceCount = kept;
+
+		vertices[vertexCount] = point;
+		for ( int i = 0; i < horizonCount; i++ )
+		{
+			if ( makeFace(vertices, horizon[i][0], horizon[i][1], vertexCount, interior, faces[faceCount]) )
+			{
+				faceCount++;
+			}
+		}
+		vertexCount++;
+	}
+
+	if ( faceCount == 0 )
+	{
+		return false;
+	}
+
+	// barycentric coordinates of the origin's projection onto the closest face
+	const EpaFace &face = faces[closestFace(faces, faceCount)];
+	const SupportPoint &v0 = vertices[face.index[0]];
+	const SupportPoint &v1 = vertices[face.index[1]];
+	const SupportPoint &v2 = vertices[face.index[2]];
+	Vector4 projection = _mm_mul_ps(face.normal, face.distance);
+	Vector4 e0 = v1.w - v0.w, e1 = v2.w - v0.w, e2 = projection - v0.w;
+	XmmFloat d00 = e0.dotProduct(e0), d01 = e0.dotProduct(e1), d11 = e1.dotProduct(e1);
+	XmmFloat d20 = e2.dotProduct(e0), d21 = e2.dotProduct(e1);
+	XmmFloat denominator = d00 * d11 - d01 * d01;
+	XmmBool solvable = denominator != zero;
+	XmmFloat l1 = solvable.select((d11 * d20 - d01 * d21) / denominator, zero);
+	XmmFloat l2 = solvable.select((d00 * d21 - d01 * d20) / denominator, zero);
+	XmmFloat l0 = one - l1 - l2;
+
+	pointA = Vector4(_mm_mul_ps(v0.a, l0)) + Vector4(_mm_mul_ps(v1.a, l1)) + Vector4(_mm_mul_ps(v2.a, l2));
+	pointB = Vector4(_mm_mul_ps(v0.b, l0)) + Vector4(_mm_mul_ps(v1.b, l1)) + Vector4(_mm_mul_ps(v2.b, l2));
+	normal = face.normal;
+	depth = face.distance;
+	return true;
+}
+
+/*!
+* \param center the sphere's center (w = 1)
+* \param radius the sphere's radius
+*/
+Collision::Shape Collision::sphere(const Vector4 &center, float radius)
+{
+	Shape shape;
+	shape.type = SPHERE;
+	shape.points[0] = center;
+	shape.vertices = NULL;
+	shape.vertexCount = 0;
+	shape.radius = radius;
+	return shape;
+}
+
+/*!
+* \param start one end of the capsule's segment (w = 1)
+* \param end the other end of the capsule's segment (w = 1)
+* \param radius the capsule's radius
+*/
+Collision::Shape Collision::capsule(const Vector4 &start, const Vector4 &end, float radius)
+{
+	Shape shape = sphere(start, radius);
+	shape.type = CAPSULE;
+	shape.points[1] = end;
+	return shape;
+}
+
+/*!
+* An oriented box, the half axes are the box's local axes scaled by its half extents
+* \param center the box's center (w = 1)
+* \param halfAxisX half of the box's first edge (w = 0)
+* \param halfAxisY half of the box's second edge (w = 0)
+* \param halfAxisZ half of the box's third edge (w = 0)
+*/
+Collision::Shape Collision::box(
+	const Vector4 &center, const Vector4 &halfAxisX, const Vector4 &halfAxisY, const Vector4 &halfAxisZ)
+{
+	Shape shape = sphere(center, 0.f);
+	shape.type = BOX;
+	shape.points[1] = halfAxisX;
+	shape.points[2] = halfAxisY;
+	shape.points[3] = halfAxisZ;
+	return shape;
+}
+
+/*!
+* The convex hull of a point set, the points do not need to be on the hull and no hull is computed
+* \param vertices the points (w = 1), referenced not copied
+* \param vertexCount the number of points, at least 1
+* \param radius optional rounding radius
+*/
+Collision::Shape Collision::hull(const Vector4::Container *vertices, size_t vertexCount, float radius)
+{
+	Shape shape = sphere(Vector4(vertices[0]), radius);
+	shape.type = HULL;
+	shape.vertices = vertices;
+	shape.vertexCount = vertexCount;
+	return shape;
+}
+
+/*!
+* Finds the vertex furthest along direction four vertices at a time.  Each lane keeps its own best dot product and
+* index, updated with masks, and the lanes are only compared at the end.
+* \param vertices the points to search
+* \param vertexCount the number of points, at least 1
+* \param direction the search direction (w = 0)
+* \return the furthest vertex
+*/
+Vector4 Collision::hullSupport(const Vector4::Container *vertices, size_t vertexCount, const Vector4 &direction)
+{
+	__m128 d = direction;
+	Soa::Vector directions = {
+		_mm_shuffle_ps(d, d, _MM_SHUFFLE(0,0,0,0)), _mm_shuffle_ps(d, d, _MM_SHUFFLE(1,1,1,1)),
+		_mm_shuffle_ps(d, d, _MM_SHUFFLE(2,2,2,2))};
+
+	__m128 bestDot = _mm_set1_ps(-FLT_MAX);
+	__m128 bestIndex = _mm_setzero_ps();
+	__m128i index = _mm_set_epi32(3, 2, 1, 0);
+	const __m128i step = _mm_set1_epi32(4);
+
+	for ( size_t i = 0; i < vertexCount; i += 4 )
+	{
+		// lanes past the end hold copies of the last vertex with indices past the end, but the lane holding the real
+		// one is lower and wins the tie below
+		Soa::Vector rows;
+		Soa::loadVector(vertices, i, vertexCount, rows);
+		__m128 dots = Soa::dot(rows, directions);
+
+		XmmBool better = _mm_cmpgt_ps(dots, bestDot);
+		bestDot = better.select(dots, bestDot);
+		bestIndex = better.select(_mm_castsi128_ps(index), bestIndex);
+		index = _mm_add_epi32(index, step);
+	}
+
+	__m128 maximum = _mm_max_ps(bestDot, _mm_shuffle_ps(bestDot, bestDot, _MM_SHUFFLE(1,0,3,2)));
+	maximum = _mm_max_ps(maximum, _mm_shuffle_ps(maximum, maximum, _MM_SHUFFLE(2,3,0,1)));
+	int lanes = XmmBool(_mm_cmpeq_ps(bestDot, maximum)).laneMask();
+	int lane = lanes & 1 ? 0 : lanes & 2 ? 1 : lanes & 4 ? 2 : 3;
+
+	XmmInt::Container indices;
+	XmmInt(_mm_castps_si128(bestIndex)).get(indices);
+	return Vector4(vertices[indices.elements[lane]]);
+}
+
+/*!
+* \param shape the shape to query
+* \param direction the search direction (w = 0), does not need to be normalized
+* \return the point of the shape's core furthest along direction
+*/
+Vector4 Collision::support(const Shape &shape, const Vector4 &direction)
+{
+	switch ( shape.type )
+	{
+	case CAPSULE:
+		{
+			XmmBool endFurther = shape.points[1].dotProduct(direction) > shape.points[0].dotProduct(direction);
+			return Vector4(endFurther.select(shape.points[1], shape.points[0]));
+		}
+	case BOX:
+		{
+			const XmmFloat zero = _mm_setzero_ps();
+			Vector4 result = shape.points[0];
+			for ( int axis = 1; axis < 4; axis++ )
+			{
+				XmmBool positive = shape.points[axis].dotProduct(direction) >= zero;
+				result = result + Vector4(positive.select(shape.points[axis], -shape.points[axis]));
+			}
+			return result;
+		}
+	case HULL:
+		return hullSupport(shape.vertices, shape.vertexCount, direction);
+	default:
+		return shape.points[0];
+	}
+}
+
+/*!
+* Overlap test only, cheaper than query since no penetration depth is computed
+* \return true if the shapes touch or overlap
+*/
+bool Collision::intersect(const Shape &a, const Shape &b)
+{
+	Simplex simplex;
+	if ( gjk(a, b, simplex) )
+	{
+		return true;
+	}
+
+	Vector4 closest = simplexClosest(simplex);
+	XmmFloat radius (a.radius + b.radius);
+	return (closest.dotProduct(closest) <= radius * radius).getValue();
+}
+
+/*!
+* Full query: closest points and distance when separated, deepest points and penetration depth when overlapping
+* \param a the first shape
+* \param b the second shape
+* \param result receives the query result, see Result
+*/
+void Collision::query(const Shape &a, const Shape &b, Result &result)
+{
+	PATRICKMATH_COUNT(COLLISION_QUERY);
+	Simplex simplex;
+	Vector4 coreA, coreB;
+	XmmFloat coreDistance;
+
+	if ( !gjk(a, b, simplex) )
+	{
+		simplexWitness(simplex, coreA, coreB);
+		Vector4 separation = coreB - coreA;
+		coreDistance = separation.dotProduct(separation).sqrt();
+		result.normal = (coreDistance > XmmFloat()).select(_mm_div_ps(separation, coreDistance), Vector4::UNIT_Z);
+	}
+	else
+	{
+		XmmFloat depth;
+		epa(a, b, simplex, result.normal, depth, coreA, coreB);
+		coreDistance = -depth;
+	}
+
+	(coreDistance - XmmFloat(a.radius + b.radius)).get(result.distance);
+	result.intersecting = result.distance <= 0.f;
+	result.pointA = coreA + Vector4(_mm_mul_ps(result.normal, _mm_set1_ps(a.radius)));
+	result.pointB = coreB - Vector4(_mm_mul_ps(result.normal, _mm_set1_ps(b.radius)));
+}
+
+struct CollisionBatch
+{
+	const Collision::Shape *shapesA;
+	const Collision::Shape *shapesB;
+	Collision::Result *results;
+};
+
+static void collisionKernel(void *context, size_t, size_t begin, size_t end)
+{
+	CollisionBatch *batch = static_cast<CollisionBatch*>(context);
+	for ( size_t i = begin; i < end; i++ )
+	{
+		Collision::query(batch->shapesA[i], batch->shapesB[i], batch->results[i]);
+	}
+}
+
+/*!
+* Runs query on count pairs, pair i being shapesA[i] and shapesB[i]
+* \param shapesA the first shape of every pair
+* \param shapesB the second shape of every pair
+* \param results receives one result per pair
+* \param count the number of pairs
+* \param taskCount the number of threads to spread the pairs over
+*/
+void Collision::queryBatch(const Shape *shapesA, const Shape *shapesB, Result *results, size_t count, size_t taskCount)
+{
+	PATRICKMATH_TIME(COLLISION_BATCH);
+	CollisionBatch batch = {shapesA, shapesB, results};
+	ParallelFor::run(collisionKernel, &batch, count, taskCount);
+}
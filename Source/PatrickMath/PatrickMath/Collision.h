@@ -0,0 +1,101 @@
+/*!
+* \file Collision.h
+* \author Patrick Martin
+* \date 2010
+* \brief Convex collision queries (GJK distance and overlap, EPA penetration) built on Vector4
+*
+* Every shape is a convex core plus a radius: a sphere is a point core, a capsule a segment core, a box or hull a
+* polytope core with an optional rounding radius.  GJK runs on the cores only, which converges in a few iterations
+* even for round shapes, and the radii are applied at the end.  EPA is only needed when the cores themselves overlap.
+*
+* Shapes are given in world space.  Hulls reference their vertex array rather than copying it, the array must stay
+* alive as long as the shape is used.  Support functions are branch free: box and capsule pick their extreme point with
+* XmmBool masks and hulls are searched four vertices at a time.
+*
+* This project is governed by the MIT licence:
+*
+*  Copyright (c) 2010 Patrick Martin
+*
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+*
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include "Vector4.h"
+#include "XmmFloat.h"
+
+class Collision
+{
+public:
+	enum ShapeType
+	{
+		SPHERE,
+		CAPSULE,
+		BOX,
+		HULL
+	};
+
+	/*!
+	* Use the factory functions below to fill these in.  points holds the core: the sphere center, the two capsule
+	* end points, or the box center followed by its three half extent axes.
+	*/
+	struct Shape
+	{
+		Vector4 points [4];
+		const Vector4::Container *vertices;
+		size_t vertexCount;
+		float radius;
+		ShapeType type;
+	};
+
+	/*!
+	* distance is positive when separated and negative (minus the penetration depth) when overlapping.  normal is the
+	* unit direction from a to b: moving b by -distance * normal separates the shapes.  pointA and pointB are the
+	* closest (or deepest) points on each shape.
+	*/
+	struct Result
+	{
+		Vector4 pointA;
+		Vector4 pointB;
+		Vector4 normal;
+		float distance;
+		bool intersecting;
+	};
+
+	// shapes
+	static Shape sphere(const Vector4 &center, float radius);
+	static Shape capsule(const Vector4 &start, const Vector4 &end, float radius);
+	static Shape box(const Vector4 &center, const Vector4 &halfAxisX, const Vector4 &halfAxisY, const Vector4 &halfAxisZ);
+	static Shape hull(const Vector4::Container *vertices, size_t vertexCount, float radius = 0.f);
+
+	// support point of the core (without radius) furthest along direction
+	static Vector4 support(const Shape &shape, const Vector4 &direction);
+	static Vector4 hullSupport(const Vector4::Container *vertices, size_t vertexCount, const Vector4 &direction);
+
+	// queries
+	static bool intersect(const Shape &a, const Shape &b);
+	static void query(const Shape &a, const Shape &b, Result &result);
+	static void queryBatch(
+		const Shape *shapesA, const Shape *shapesB, Result *results, size_t count, size_t taskCount = 1);
+};
@@ -0,0 +1,431 @@
+/*!
+* \file Curve.cpp
+* \author Patrick Martin
+* \date 2010
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "stdafx.h"
+#include "Curve.h"
+
+#if !defined(PATRICKMATH_USE_FMA) && (defined(__FMA__) || defined(__AVX2__))
+#define PATRICKMATH_USE_FMA
+#endif
+
+#include <malloc.h>
+#include <emmintrin.h>
+#ifdef PATRICKMATH_USE_FMA
+#include <immintrin.h>
+#endif
+
+#include "Instrumentation.h"
+#include "ParallelFor.h"
+#include "XmmFloat.h"
+
+struct CurveBatch
+{
+	const Curve *curve;
+	const float *values;
+	Vector4::Container *positions;
+	Vector4::Container *tangents;
+};
+
+// distances are turned into parameters this many at a time on the stack before evaluation
+static const size_t DISTANCE_CHUNK = 64;
+
+/*!
+* \return a * b + c, fused when FMA is available
+*/
+static inline __m128 multiplyAdd(const __m128 &a, const __m128 &b, const __m128 &c)
+{
+#ifdef PATRICKMATH_USE_FMA
+	return _mm_fmadd_ps(a, b, c);
+#else
+	return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+}
+
+/*!
+* Writes the power form of one segment.  Every basis is a 4x4 matrix applied to the segment's four control values.
+*/
+static void powerForm(const Vector4::Container *control, const float basis [4][4], Vector4::Container *coefficients)
+{
+	__m128 p0 = _mm_load_ps(control[0].elements);
+	__m128 p1 = _mm_load_ps(control[1].elements);
+	__m128 p2 = _mm_load_ps(control[2].elements);
+	__m128 p3 = _mm_load_ps(control[3].elements);
+	for ( int row = 0; row < 4; row++ )
+	{
+		__m128 coefficient = _mm_mul_ps(p0, _mm_set1_ps(basis[row][0]));
+		coefficient = multiplyAdd(p1, _mm_set1_ps(basis[row][1]), coefficient);
+		coefficient = multiplyAdd(p2, _mm_set1_ps(basis[row][2]), coefficient);
+		coefficient = multiplyAdd(p3, _mm_set1_ps(basis[row][3]), coefficient);
+		_mm_store_ps(coefficients[row].elements, coefficient);
+	}
+}
+
+static void curveKernel(void *context, size_t, size_t begin, size_t end)
+{
+	CurveBatch *batch = static_cast<CurveBatch*>(context);
+	batch->curve->evaluate(batch->values, batch->positions, batch->tangents, begin, end);
+}
+
+static void curveDistanceKernel(void *context, size_t, size_t begin, size_t end)
+{
+	CurveBatch *batch = static_cast<CurveBatch*>(context);
+	batch->curve->evaluateAtDistances(batch->values, batch->positions, batch->tangents, begin, end);
+}
+
+Curve::Curve()
+:	m_coefficients(NULL), m_segmentCount(0), m_arcLengths(NULL), m_arcSampleCount(0), m_arcSamplesPerSegment(0)
+{
+}
+
+Curve::~Curve()
+{
+	clear();
+}
+
+void Curve::clear()
+{
+	_aligned_free(m_coefficients);
+	delete [] m_arcLengths;
+	m_coefficients = NULL;
+	m_segmentCount = 0;
+	m_arcLengths = NULL;
+	m_arcSampleCount = 0;
+	m_arcSamplesPerSegment = 0;
+}
+
+/*!
+* Converts the control points to per segment power form.  Any arc length table is dropped.
+* \param type how the points are interpreted
+* \param points the control points; Hermite curves alternate position and tangent (w = 0)
+* \param pointCount at least 4; Bezier curves need 3k + 1 points and Hermite curves an even count
+* \return false if the point count does not fit the type; the curve is then empty
+*/
+bool Curve::build(Type type, const Vector4::Container *points, size_t pointCount)
+{
+	// rows give the t^3, t^2, t and 1 coefficients from the four control values
+	static const float catmullRom [4][4] =
+	{
+		{-0.5f,  1.5f, -1.5f,  0.5f},
+		{ 1.0f, -2.5f,  2.0f, -0.5f},
+		{-0.5f,  0.0f,  0.5f,  0.0f},
+		{ 0.0f,  1.0f,  0.0f,  0.0f}
+	};
+	static const float bezier [4][4] =
+	{
+		{-1.f,  3.f, -3.f, 1.f},
+		{ 3.f, -6.f,  3.f, 0.f},
+		{-3.f,  3.f,  0.f, 0.f},
+		{ 1.f,  0.f,  0.f, 0.f}
+	};
+	// Hermite values are ordered p0, m0, p1, m1
+	static const float hermite [4][4] =
+	{
+		{ 2.f,  1.f, -2.f,  1.f},
+		{-3.f, -2.f,  3.f, -1.f},
+		{ 0.f,  1.f,  0.f,  0.f},
+		{ 1.f,  0.f,  0.f,  0.f}
+	};
+
+	clear();
+
+	if ( points == NULL || pointCount < 4 )
+	{
+		return false;
+	}
+
+	size_t segmentCount, stride;
+	const float (*basis)[4];
+	switch ( type )
+	{
+	case CATMULL_ROM:
+		segmentCount = pointCount - 3;
+		stride = 1;
+		basis = catmullRom;
+		break;
+	case BEZIER:
+		if ( (pointCount - 1) % 3 != 0 )
+		{
+			return false;
+		}
+		segmentCount = (pointCount - 1) / 3;
+		stride = 3;
+		basis = bezier;
+		break;
+	case HERMITE:
+		if ( pointCount % 2 != 0 )
+		{
+			return false;
+		}
+		segmentCount = pointCount / 2 - 1;
+		stride = 2;
+		basis = hermite;
+		break;
+	default:
+		return false;
+	}
+
+	m_coefficients = static_cast<Vector4::Container*>(_aligned_malloc(segmentCount * 4 * sizeof(Vector4::Container), 16));
+	m_segmentCount = segmentCount;
+	for ( size_t segment = 0; segment < segmentCount; segment++ )
+	{
+		powerForm(points + segment * stride, basis, m_coefficients + segment * 4);
+	}
+	return true;
+}
+
+/*!
+* Evaluates positions and tangents for parameters [begin, end).  Parameters are split into segment and local t four at
+* a time, then each point is one Horner evaluation on a full register.
+* \param parameters global parameters in [0, segmentCount], indexed like the results
+* \param positions receives the points
+* \param tangents receives the derivatives with respect to the parameter, may be NULL
+* \param begin the first parameter to evaluate
+* \param end one past the last parameter to evaluate
+*/
+void Curve::evaluate(const float *parameters, Vector4::Container *positions, Vector4::Container *tangents, size_t begin,
+	size_t end) const
+{
+	PATRICKMATH_TIME(CURVE_EVALUATE);
+	if ( m_segmentCount == 0 )
+	{
+		return;
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 segmentCount = _mm_set1_ps(float(m_segmentCount));
+	const __m128 lastSegment = _mm_set1_ps(float(m_segmentCount - 1));
+	const __m128 two = _mm_set1_ps(2.f);
+	const __m128 three = _mm_set1_ps(3.f);
+
+	__declspec(align(16)) float locals [4];
+	__declspec(align(16)) int32_t segments [4];
+
+	for ( size_t i = begin; i < end; i += 4 )
+	{
+		size_t laneCount = end - i < 4 ? end - i : 4;
+		__m128 u;
+		if ( laneCount == 4 )
+		{
+			u = _mm_loadu_ps(parameters + i);
+		}
+		else
+		{
+			__declspec(align(16)) float tail [4] = {0.f, 0.f, 0.f, 0.f};
+			for ( size_t lane = 0; lane < laneCount; lane++ )
+			{
+				tail[lane] = parameters[i + lane];
+			}
+			u = _mm_load_ps(tail);
+		}
+
+		// NaN clamps to 0 as _mm_max_ps returns its second operand on unordered input
+		u = _mm_min_ps(_mm_max_ps(u, zero), segmentCount);
+		__m128 segment = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(u)), lastSegment);
+		_mm_store_ps(locals, _mm_sub_ps(u, segment));
+		_mm_store_si128(reinterpret_cast<__m128i*>(segments), _mm_cvttps_epi32(segment));
+
+		for ( size_t lane = 0; lane < laneCount; lane++ )
+		{
+			const Vector4::Container *coefficients = m_coefficients + segments[lane] * 4;
+			__m128 a = _mm_load_ps(coefficients[0].elements);
+			__m128 b = _mm_load_ps(coefficients[1].elements);
+			__m128 c = _mm_load_ps(coefficients[2].elements);
+			__m128 d = _mm_load_ps(coefficients[3].elements);
+			__m128 t = _mm_set1_ps(locals[lane]);
+
+			__m128 position = multiplyAdd(multiplyAdd(multiplyAdd(a, t, b), t, c), t, d);
+			_mm_store_ps(positions[i + lane].elements, position);
+			if ( tangents != NULL )
+			{
+				__m128 tangent = multiplyAdd(multiplyAdd(_mm_mul_ps(a, three), t, _mm_mul_ps(b, two)), t, c);
+				_mm_store_ps(tangents[i + lane].elements, tangent);
+			}
+		}
+	}
+}
+
+/*!
+* Evaluates every parameter, split over taskCount tasks
+*/
+void Curve::evaluateBatch(const float *parameters, Vector4::Container *positions, Vector4::Container *tangents,
+	size_t count, size_t taskCount) const
+{
+	CurveBatch batch = {this, parameters, positions, tangents};
+	ParallelFor::run(curveKernel, &batch, count, taskCount);
+}
+
+/*!
+* Measures the curve with chords between evenly spaced parameters.  The table maps distance back to parameter, so more
+* samples per segment give more even spacing for curves whose speed changes quickly.
+* \param samplesPerSegment the number of chords per segment, at least 1
+* \return false if the curve is empty or samplesPerSegment is 0
+*/
+bool Curve::buildArcLength(size_t samplesPerSegment)
+{
+	delete [] m_arcLengths;
+	m_arcLengths = NULL;
+	m_arcSampleCount = 0;
+	m_arcSamplesPerSegment = 0;
+
+	if ( m_segmentCount == 0 || samplesPerSegment == 0 )
+	{
+		return false;
+	}
+
+	size_t sampleCount = m_segmentCount * samplesPerSegment + 1;
+	float *parameters = new float [sampleCount];
+	Vector4::Container *points = static_cast<Vector4::Container*>(_aligned_malloc(sampleCount * sizeof(Vector4::Container), 16));
+	for ( size_t i = 0; i < sampleCount; i++ )
+	{
+		parameters[i] = float(i / samplesPerSegment) + float(i % samplesPerSegment) / float(samplesPerSegment);
+	}
+	evaluate(parameters, points, NULL, 0, sampleCount);
+
+	m_arcLengths = new float [sampleCount];
+	m_arcLengths[0] = 0.f;
+	const __m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	double total = 0.0;
+	for ( size_t i = 1; i < sampleCount; i++ )
+	{
+		Vector4 chord (_mm_and_ps(_mm_sub_ps(_mm_load_ps(points[i].elements), _mm_load_ps(points[i - 1].elements)),
+			xyzMask));
+		float chordLength;
+		XmmFloat(chord.dotProduct(chord)).sqrt().get(chordLength);
+		total += chordLength;
+		m_arcLengths[i] = float(total);
+	}
+
+	delete [] parameters;
+	_aligned_free(points);
+	m_arcSampleCount = sampleCount;
+	m_arcSamplesPerSegment = samplesPerSegment;
+	return true;
+}
+
+/*!
+* \return the table interval i with length i <= distance < length i + 1, searched after cursor when distance is past it
+*/
+size_t Curve::findArcSample(float distance, size_t cursor) const
+{
+	size_t low = 0, high = m_arcSampleCount - 1;
+	if ( cursor < high && m_arcLengths[cursor] <= distance )
+	{
+		low = cursor;
+	}
+
+	// invariant: lengths[low] <= distance (or low = 0), the answer is below high
+	while ( high - low > 1 )
+	{
+		size_t middle = (low + high) / 2;
+		if ( m_arcLengths[middle] <= distance )
+		{
+			low = middle;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	return low;
+}
+
+/*!
+* \param distance the distance along the curve, clamped to [0, length]
+* \return the parameter at that distance, 0 if there is no arc length table
+*/
+float Curve::parameterAtDistance(float distance) const
+{
+	float parameter;
+	parametersAtDistances(&distance, &parameter, 1);
+	return parameter;
+}
+
+/*!
+* Converts distances along the curve to parameters.  Each search starts from the previous result when the distances
+* increase, as they do when walking the curve.
+* \param distances the distances, clamped to [0, length]
+* \param parameters receives the parameters, 0 if there is no arc length table
+* \param count the number of distances
+*/
+void Curve::parametersAtDistances(const float *distances, float *parameters, size_t count) const
+{
+	if ( m_arcSampleCount == 0 )
+	{
+		for ( size_t i = 0; i < count; i++ )
+		{
+			parameters[i] = 0.f;
+		}
+		return;
+	}
+
+	const float totalLength = length();
+	const float step = 1.f / float(m_arcSamplesPerSegment);
+	size_t cursor = 0;
+	for ( size_t i = 0; i < count; i++ )
+	{
+		float distance = distances[i] > 0.f ? (distances[i] < totalLength ? distances[i] : totalLength) : 0.f;
+		cursor = findArcSample(distance, cursor);
+		float span = m_arcLengths[cursor + 1] - m_arcLengths[cursor];
+		float fraction = span > 0.f ? (distance - m_arcLengths[cursor]) / span : 0.f;
+		fraction = fraction < 1.f ? fraction : 1.f;
+		parameters[i] = float(cursor / m_arcSamplesPerSegment) + (float(cursor % m_arcSamplesPerSegment) + fraction) * step;
+	}
+}
+
+/*!
+* Evaluates positions and tangents at distances [begin, end) along the curve.  Needs buildArcLength.
+* \param distances the distances along the curve, indexed like the results
+* \param positions receives the points
+* \param tangents receives the derivatives with respect to the parameter, may be NULL
+* \param begin the first distance to evaluate
+* \param end one past the last distance to evaluate
+*/
+void Curve::evaluateAtDistances(const float *distances, Vector4::Container *positions, Vector4::Container *tangents,
+	size_t begin, size_t end) const
+{
+	float parameters [DISTANCE_CHUNK];
+	for ( size_t chunkBegin = begin; chunkBegin < end; chunkBegin += DISTANCE_CHUNK )
+	{
+		size_t chunkCount = end - chunkBegin < DISTANCE_CHUNK ? end - chunkBegin : DISTANCE_CHUNK;
+		parametersAtDistances(distances + chunkBegin, parameters, chunkCount);
+		evaluate(parameters, positions + chunkBegin, tangents != NULL ? tangents + chunkBegin : NULL, 0, chunkCount);
+	}
+}
+
+/*!
+* Evaluates every distance, split over taskCount tasks
+*/
+void Curve::evaluateAtDistancesBatch(const float *distances, Vector4::Container *positions, Vector4::Container *tangents,
+	size_t count, size_t taskCount) const
+{
+	CurveBatch batch = {this, distances, positions, tangents};
+	ParallelFor::run(curveDistanceKernel, &batch, count, taskCount);
+}
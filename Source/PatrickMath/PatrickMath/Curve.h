@@ -0,0 +1,110 @@
+/*!
+* \file Curve.h
+* \author Patrick Martin
+* \date 2010
+* \brief Catmull-Rom, Bezier and Hermite curves evaluated in batches, with arc length tables
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include "Vector4.h"
+
+/*!
+* A piecewise cubic curve through Vector4 control points.  At build time every segment is converted from its basis
+* (Catmull-Rom, Bezier or Hermite) to power form a*t^3 + b*t^2 + c*t + d, so evaluation is the same Horner scheme for
+* every curve type: three multiply-adds per point, all four components at once, plus three for the tangent.
+*
+* Curves are evaluated at a global parameter u in [0, segmentCount]; segment floor(u) at local t = u - floor(u).
+* Parameters outside the range clamp to the end points.  For constant speed sampling build an arc length table, after
+* which positions can be requested by distance along the curve instead of by parameter.
+*/
+class Curve
+{
+public:
+	enum Type
+	{
+		CATMULL_ROM,	// uniform, passes through points 1 to n - 2; segment i uses points i to i + 3
+		BEZIER,			// cubic, 3k + 1 points; segment i uses points 3i to 3i + 3 and passes through its ends
+		HERMITE			// position, tangent pairs; segment i goes from pair i to pair i + 1
+	};
+
+	Curve();
+	~Curve();
+
+	bool build(Type type, const Vector4::Container *points, size_t pointCount);
+	void clear();
+
+	size_t segmentCount() const;
+
+	// evaluation by parameter, tangents (d/du) may be NULL
+	void evaluate(const float *parameters, Vector4::Container *positions, Vector4::Container *tangents, size_t begin,
+		size_t end) const;
+	void evaluateBatch(const float *parameters, Vector4::Container *positions, Vector4::Container *tangents, size_t count,
+		size_t taskCount = 1) const;
+
+	// arc length reparameterization
+	bool buildArcLength(size_t samplesPerSegment);
+	float length() const;
+	float parameterAtDistance(float distance) const;
+	void parametersAtDistances(const float *distances, float *parameters, size_t count) const;
+	void evaluateAtDistances(const float *distances, Vector4::Container *positions, Vector4::Container *tangents,
+		size_t begin, size_t end) const;
+	void evaluateAtDistancesBatch(const float *distances, Vector4::Container *positions, Vector4::Container *tangents,
+		size_t count, size_t taskCount = 1) const;
+
+private:
+	// not copyable, the arrays are owned
+	Curve(const Curve &);
+	Curve &operator=(const Curve &);
+
+	size_t findArcSample(float distance, size_t cursor) const;
+
+	// four coefficients per segment: t^3, t^2, t, 1
+	Vector4::Container *m_coefficients;
+	size_t m_segmentCount;
+
+	// cumulative chord length at u = i / m_arcSamplesPerSegment
+	float *m_arcLengths;
+	size_t m_arcSampleCount;
+	size_t m_arcSamplesPerSegment;
+};
+
+inline size_t Curve::segmentCount() const
+{
+	return m_segmentCount;
+}
+
+/*!
+* \return the length of the curve as measured by buildArcLength, 0 if there is no table
+*/
+inline float Curve::length() const
+{
+	return m_arcSampleCount > 0 ? m_arcLengths[m_arcSampleCount - 1] : 0.f;
+}
@@ -0,0 +1,290 @@
+/*!
+* \file Distance.cpp
+* \author Patrick Martin
+* \date 2010
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "stdafx.h"
+#include "Distance.h"
+
+#include <float.h>
+
+#include "Instrumentation.h"
+#include "ParallelFor.h"
+#include "Soa.h"
+#include "XmmBool.h"
+
+/*!
+* The operands of every query, unused ones are NULL
+*/
+struct DistanceBatch
+{
+	const Vector4::Container *points;
+	const Vector4::Container *operands [3];
+	const float *radii [2];
+	float *distances;
+	Vector4::Container *vectors;
+};
+
+/*!
+* Closest point on the segments [start, end] to point, degenerate segments give their start
+*/
+static Soa::Vector closestOnSegment(const Soa::Vector &point, const Soa::Vector &start, const Soa::Vector &end)
+{
+	Soa::Vector direction = Soa::subtract(end, start);
+	__m128 lengthSq = _mm_max_ps(Soa::lengthSq(direction), _mm_set1_ps(FLT_MIN));
+	__m128 t = _mm_div_ps(Soa::dot(Soa::subtract(point, start), direction), lengthSq);
+	t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), _mm_set1_ps(1.f));
+	return Soa::multiplyAdd(direction, t, start);
+}
+
+/*!
+* Closest point on the triangles abc to point, after Ericson's ClosestPtPointTriangle.  Every Voronoi region is tested
+* and the answer is kept as barycentric weights (v, w) on ab and ac; the regions are selected from the interior out to
+* the vertices, so where Ericson returns early the later (higher priority) select wins instead.
+*/
+static Soa::Vector closestOnTriangle(
+	const Soa::Vector &point, const Soa::Vector &a, const Soa::Vector &b, const Soa::Vector &c)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.f);
+
+	Soa::Vector ab = Soa::subtract(b, a);
+	Soa::Vector ac = Soa::subtract(c, a);
+	Soa::Vector ap = Soa::subtract(point, a);
+	Soa::Vector bp = Soa::subtract(point, b);
+	Soa::Vector cp = Soa::subtract(point, c);
+	__m128 d1 = Soa::dot(ab, ap), d2 = Soa::dot(ac, ap);
+	__m128 d3 = Soa::dot(ab, bp), d4 = Soa::dot(ac, bp);
+	__m128 d5 = Soa::dot(ab, cp), d6 = Soa::dot(ac, cp);
+	__m128 va = _mm_sub_ps(_mm_mul_ps(d3, d6), _mm_mul_ps(d5, d4));
+	__m128 vb = _mm_sub_ps(_mm_mul_ps(d5, d2), _mm_mul_ps(d1, d6));
+	__m128 vc = _mm_sub_ps(_mm_mul_ps(d1, d4), _mm_mul_ps(d3, d2));
+
+	// interior
+	__m128 denominator = _mm_div_ps(one, _mm_add_ps(_mm_add_ps(va, vb), vc));
+	__m128 v = _mm_mul_ps(vb, denominator);
+	__m128 w = _mm_mul_ps(vc, denominator);
+
+	// edge bc
+	__m128 d43 = _mm_sub_ps(d4, d3), d56 = _mm_sub_ps(d5, d6);
+	XmmBool region = XmmBool(_mm_cmple_ps(va, zero)) & XmmBool(_mm_cmpge_ps(d43, zero)) & XmmBool(_mm_cmpge_ps(d56, zero));
+	__m128 t = _mm_div_ps(d43, _mm_add_ps(d43, d56));
+	v = region.select(_mm_sub_ps(one, t), v);
+	w = region.select(t, w);
+
+	// edge ac
+	region = XmmBool(_mm_cmple_ps(vb, zero)) & XmmBool(_mm_cmpge_ps(d2, zero)) & XmmBool(_mm_cmple_ps(d6, zero));
+	v = region.select(zero, v);
+	w = region.select(_mm_div_ps(d2, _mm_sub_ps(d2, d6)), w);
+
+	// vertex c
+	region = XmmBool(_mm_cmpge_ps(d6, zero)) & XmmBool(_mm_cmple_ps(d5, d6));
+	v = region.select(zero, v);
+	w = region.select(one, w);
+
+	// edge ab
+	region = XmmBool(_mm_cmple_ps(vc, zero)) & XmmBool(_mm_cmpge_ps(d1, zero)) & XmmBool(_mm_cmple_ps(d3, zero));
+	v = region.select(_mm_div_ps(d1, _mm_sub_ps(d1, d3)), v);
+	w = region.select(zero, w);
+
+	// vertex b
+	region = XmmBool(_mm_cmpge_ps(d3, zero)) & XmmBool(_mm_cmple_ps(d4, d3));
+	v = region.select(one, v);
+	w = region.select(zero, w);
+
+	// vertex a
+	region = XmmBool(_mm_cmple_ps(d1, zero)) & XmmBool(_mm_cmple_ps(d2, zero));
+	v = region.select(zero, v);
+	w = region.select(zero, w);
+
+	return Soa::multiplyAdd(ac, w, Soa::multiplyAdd(ab, v, a));
+}
+
+static void pointPlaneKernel(void *context, size_t, size_t begin, size_t end)
+{
+	DistanceBatch *batch = static_cast<DistanceBatch*>(context);
+	for ( size_t i = begin; i < end; i += 4 )
+	{
+		Soa::Vector point, normal;
+		Soa::loadVector(batch->points, i, end, point);
+		__m128 offset = Soa::loadVector(batch->operands[0], i, end, normal);
+		__m128 distance = _mm_add_ps(Soa::dot(point, normal), offset);
+		Soa::storeLanes(batch->distances, i, end, distance);
+		if ( batch->vectors != NULL )
+		{
+			Soa::Vector projection = Soa::multiplyAdd(normal, _mm_sub_ps(_mm_setzero_ps(), distance), point);
+			Soa::storeVector(batch->vectors, i, end, projection, _mm_set1_ps(1.f));
+		}
+	}
+}
+
+static void pointSegmentKernel(void *context, size_t, size_t begin, size_t end)
+{
+	DistanceBatch *batch = static_cast<DistanceBatch*>(context);
+	for ( size_t i = begin; i < end; i += 4 )
+	{
+		Soa::Vector point, start, finish;
+		Soa::loadVector(batch->points, i, end, point);
+		Soa::loadVector(batch->operands[0], i, end, start);
+		Soa::loadVector(batch->operands[1], i, end, finish);
+		Soa::Vector closest = closestOnSegment(point, start, finish);
+		Soa::storeLanes(batch->distances, i, end, _mm_sqrt_ps(Soa::lengthSq(Soa::subtract(point, closest))));
+		if ( batch->vectors != NULL )
+		{
+			Soa::storeVector(batch->vectors, i, end, closest, _mm_set1_ps(1.f));
+		}
+	}
+}
+
+static void pointTriangleKernel(void *context, size_t, size_t begin, size_t end)
+{
+	DistanceBatch *batch = static_cast<DistanceBatch*>(context);
+	for ( size_t i = begin; i < end; i += 4 )
+	{
+		Soa::Vector point, a, b, c;
+		Soa::loadVector(batch->points, i, end, point);
+		Soa::loadVector(batch->operands[0], i, end, a);
+		Soa::loadVector(batch->operands[1], i, end, b);
+		Soa::loadVector(batch->operands[2], i, end, c);
+		Soa::Vector closest = closestOnTriangle(point, a, b, c);
+		Soa::storeLanes(batch->distances, i, end, _mm_sqrt_ps(Soa::lengthSq(Soa::subtract(point, closest))));
+		if ( batch->vectors != NULL )
+		{
+			Soa::storeVector(batch->vectors, i, end, closest, _mm_set1_ps(1.f));
+		}
+	}
+}
+
+static void sphereCapsuleKernel(void *context, size_t, size_t begin, size_t end)
+{
+	DistanceBatch *batch = static_cast<DistanceBatch*>(context);
+	for ( size_t i = begin; i < end; i += 4 )
+	{
+		Soa::Vector center, start, finish;
+		Soa::loadVector(batch->points, i, end, center);
+		Soa::loadVector(batch->operands[0], i, end, start);
+		Soa::loadVector(batch->operands[1], i, end, finish);
+		__m128 radii = _mm_add_ps(Soa::loadLanes(batch->radii[0], i, end), Soa::loadLanes(batch->radii[1], i, end));
+
+		Soa::Vector delta = Soa::subtract(closestOnSegment(center, start, finish), center);
+		__m128 centerDistance = _mm_sqrt_ps(Soa::lengthSq(delta));
+		Soa::storeLanes(batch->distances, i, end, _mm_sub_ps(centerDistance, radii));
+		if ( batch->vectors != NULL )
+		{
+			// concentric lanes have no direction, they report +x
+			XmmBool separated = _mm_cmpgt_ps(centerDistance, _mm_setzero_ps());
+			__m128 inverse = _mm_div_ps(_mm_set1_ps(1.f), _mm_max_ps(centerDistance, _mm_set1_ps(FLT_MIN)));
+			Soa::Vector normal = {
+				separated.select(_mm_mul_ps(delta.x, inverse), _mm_set1_ps(1.f)),
+				separated.select(_mm_mul_ps(delta.y, inverse), _mm_setzero_ps()),
+				separated.select(_mm_mul_ps(delta.z, inverse), _mm_setzero_ps())};
+			Soa::storeVector(batch->vectors, i, end, normal, _mm_setzero_ps());
+		}
+	}
+}
+
+/*!
+* Signed distances from points to planes and, optionally, the projections of the points onto the planes
+* \param points the points
+* \param planes one (nx, ny, nz, d) plane per point, unit normals
+* \param distances receives n.p + d
+* \param closest receives p - distance * n, may be NULL
+* \param count the number of queries
+* \param taskCount the number of tasks the batch is split into
+*/
+void Distance::pointPlane(
+	const Vector4::Container *points, const Vector4::Container *planes, float *distances, Vector4::Container *closest,
+	size_t count, size_t taskCount)
+{
+	PATRICKMATH_TIME(DISTANCE_BATCH);
+	DistanceBatch batch = {points, {planes, NULL, NULL}, {NULL, NULL}, distances, closest};
+	ParallelFor::run(pointPlaneKernel, &batch, count, taskCount);
+}
+
+/*!
+* Distances from points to segments and, optionally, the closest points on the segments
+* \param points the points
+* \param starts the first end point of every segment
+* \param ends the second end point of every segment
+* \param distances receives the distances
+* \param closest receives the closest points, may be NULL
+* \param count the number of queries
+* \param taskCount the number of tasks the batch is split into
+*/
+void Distance::pointSegment(
+	const Vector4::Container *points, const Vector4::Container *starts, const Vector4::Container *ends,
+	float *distances, Vector4::Container *closest, size_t count, size_t taskCount)
+{
+	PATRICKMATH_TIME(DISTANCE_BATCH);
+	DistanceBatch batch = {points, {starts, ends, NULL}, {NULL, NULL}, distances, closest};
+	ParallelFor::run(pointSegmentKernel, &batch, count, taskCount);
+}
+
+/*!
+* Distances from points to solid triangles and, optionally, the closest points on the triangles
+* \param points the points
+* \param cornersA the first corner of every triangle
+* \param cornersB the second corner of every triangle
+* \param cornersC the third corner of every triangle
+* \param distances receives the distances
+* \param closest receives the closest points, may be NULL
+* \param count the number of queries
+* \param taskCount the number of tasks the batch is split into
+*/
+void Distance::pointTriangle(
+	const Vector4::Container *points, const Vector4::Container *cornersA, const Vector4::Container *cornersB,
+	const Vector4::Container *cornersC, float *distances, Vector4::Container *closest, size_t count, size_t taskCount)
+{
+	PATRICKMATH_TIME(DISTANCE_BATCH);
+	DistanceBatch batch = {points, {cornersA, cornersB, cornersC}, {NULL, NULL}, distances, closest};
+	ParallelFor::run(pointTriangleKernel, &batch, count, taskCount);
+}
+
+/*!
+* Surface distances between spheres and capsules, the distance between the sphere center and the capsule segment minus
+* both radii
+* \param centers the sphere centers
+* \param sphereRadii the sphere radii
+* \param starts the first end point of every capsule segment
+* \param ends the second end point of every capsule segment
+* \param capsuleRadii the capsule radii
+* \param distances receives the distances, negative when overlapping (minus the penetration depth)
+* \param normals receives the unit directions from the sphere center to the closest point of the segment, may be NULL
+* \param count the number of queries
+* \param taskCount the number of tasks the batch is split into
+*/
+void Distance::sphereCapsule(
+	const Vector4::Container *centers, const float *sphereRadii, const Vector4::Container *starts,
+	const Vector4::Container *ends, const float *capsuleRadii, float *distances, Vector4::Container *normals,
+	size_t count, size_t taskCount)
+{
+	PATRICKMATH_TIME(DISTANCE_BATCH);
+	DistanceBatch batch = {centers, {starts, ends, NULL}, {sphereRadii, capsuleRadii}, distances, normals};
+	ParallelFor::run(sphereCapsuleKernel, &batch, count, taskCount);
+}
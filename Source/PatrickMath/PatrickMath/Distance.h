@@ -0,0 +1,72 @@
+/*!
+* \file Distance.h
+* \author Patrick Martin
+* \date 2010
+* \brief Batched point, plane, segment, triangle and capsule distance queries
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include "Vector4.h"
+
+/*!
+* Batched closest point and distance queries between simple primitives.  Every query takes one array per operand and
+* pairs them up by index: element i of the result is the query between element i of every input.  Inputs are
+* transposed four at a time so each kernel works on x, y and z registers holding four queries, and every region test is
+* an XmmBool select, so a batch runs without a single data dependent branch.
+*
+* Planes are (nx, ny, nz, d) with a unit normal, the points on the plane satisfy n.p + d = 0.  Closest points are
+* written with w = 1 and normals with w = 0.  Output arrays marked optional may be NULL.
+*/
+class Distance
+{
+public:
+	// signed distance, positive on the side the normal points to; closest is optional
+	static void pointPlane(
+		const Vector4::Container *points, const Vector4::Container *planes, float *distances, Vector4::Container *closest,
+		size_t count, size_t taskCount = 1);
+
+	// closest is optional
+	static void pointSegment(
+		const Vector4::Container *points, const Vector4::Container *starts, const Vector4::Container *ends,
+		float *distances, Vector4::Container *closest, size_t count, size_t taskCount = 1);
+
+	// closest is optional
+	static void pointTriangle(
+		const Vector4::Container *points, const Vector4::Container *cornersA, const Vector4::Container *cornersB,
+		const Vector4::Container *cornersC, float *distances, Vector4::Container *closest, size_t count,
+		size_t taskCount = 1);
+
+	// surface distance, negative when overlapping; normals (optional) point from the sphere to the capsule
+	static void sphereCapsule(
+		const Vector4::Container *centers, const float *sphereRadii, const Vector4::Container *starts,
+		const Vector4::Container *ends, const float *capsuleRadii, float *distances, Vector4::Container *normals,
+		size_t count, size_t taskCount = 1);
+};
@@ -0,0 +1,216 @@
+/*!
+* \file Instrumentation.cpp
+* \author Patrick Martin
+* \date 2010
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "stdafx.h"
+#include "Instrumentation.h"
+
+#ifdef PATRICKMATH_INSTRUMENT
+
+#include <string.h>
+#include <windows.h>
+
+__declspec(thread) Instrumentation::ThreadCounters *Instrumentation::s_threadCounters = NULL;
+
+static Instrumentation::ThreadCounters *volatile s_threadList = NULL;
+
+static const char *counterNames [Instrumentation::COUNTER_COUNT] = {
+	"Vector4::get",
+	"Vector4::set",
+	"XmmFloat::get",
+	"XmmFloat::set",
+	"XmmBool::getValue",
+	"XmmBool::laneMask",
+	"XmmInt::get",
+	"XmmInt::set",
+	"XmmDouble::get",
+	"XmmDouble::set",
+	"Vector4d::get",
+	"Vector4d::set",
+	"Quaternion::get",
+	"Quaternion::set",
+	"Matrix4::get",
+	"Matrix4::set",
+	"Affine3x4::get",
+	"Affine3x4::set",
+	"Vector4::dotProduct",
+	"Vector4::crossProduct",
+	"Vector4::normalize",
+	"Vector4::isEqual",
+	"XmmFloat::sqrt",
+	"XmmFloat::divide",
+	"XmmFloat::sin/cos",
+	"Quaternion::multiply",
+	"Quaternion::applyRotation",
+	"Quaternion::normalize",
+	"Matrix4::multiply",
+	"Matrix4::transform",
+	"Matrix4::fromTransform",
+	"Affine3x4::compose",
+	"Affine3x4::transform",
+	"Affine3x4::inverse",
+	"Collision::query",
+	"Collision gjk iteration",
+	"Collision epa iteration",
+	"Animation::findKey",
+	"Animation::findKey rewind",
+	"TransformHierarchy node update"
+};
+
+static const char *timerNames [Instrumentation::TIMER_COUNT] = {
+	"ParallelFor task",
+	"PointCloud",
+	"Collision::queryBatch",
+	"Animation::sample",
+	"TransformHierarchy::update",
+	"Quantize",
+	"Sampling",
+	"Vector4d::convertBatch",
+	"Curve::evaluate",
+	"RadixSort",
+	"Distance",
+	"Affine3x4 batch",
+	"Stream read",
+	"Stream stages",
+	"Stream write",
+	"Mesh",
+	"Float3 convert",
+	"Rotation convert",
+	"Orientation batch"
+};
+
+/*!
+* Creates the calling thread's counters and pushes them on the global list.  Blocks are never freed so the report can
+* still show threads that have exited.
+*/
+Instrumentation::ThreadCounters *Instrumentation::registerThread()
+{
+	ThreadCounters *counters = new ThreadCounters;
+	memset(counters, 0, sizeof(ThreadCounters));
+	counters->threadId = uint32_t(GetCurrentThreadId());
+
+	ThreadCounters *head;
+	do
+	{
+		head = s_threadList;
+		counters->next = head;
+	}
+	while ( _InterlockedCompareExchangePointer(reinterpret_cast<void *volatile*>(&s_threadList), counters, head) != head );
+
+	s_threadCounters = counters;
+	return counters;
+}
+
+/*!
+* \return the most recently registered thread's counters, follow next for the rest
+*/
+const Instrumentation::ThreadCounters *Instrumentation::threads()
+{
+	return s_threadList;
+}
+
+/*!
+* \return the counter summed over every thread
+*/
+uint64_t Instrumentation::total(Counter counter)
+{
+	uint64_t result = 0;
+	for ( const ThreadCounters *counters = s_threadList; counters != NULL; counters = counters->next )
+	{
+		result += counters->counts[counter];
+	}
+	return result;
+}
+
+/*!
+* \return the timer's cycles summed over every thread
+*/
+uint64_t Instrumentation::totalCycles(Timer timer)
+{
+	uint64_t result = 0;
+	for ( const ThreadCounters *counters = s_threadList; counters != NULL; counters = counters->next )
+	{
+		result += counters->timerCycles[timer];
+	}
+	return result;
+}
+
+const char *Instrumentation::counterName(Counter counter)
+{
+	return counterNames[counter];
+}
+
+const char *Instrumentation::timerName(Timer timer)
+{
+	return timerNames[timer];
+}
+
+/*!
+* Prints every thread's non zero counters and timers
+* \param destination where to print, stdout for instance
+*/
+void Instrumentation::report(FILE *destination)
+{
+	for ( const ThreadCounters *counters = s_threadList; counters != NULL; counters = counters->next )
+	{
+		fprintf(destination, "thread %u\n", counters->threadId);
+		for ( int i = 0; i < COUNTER_COUNT; i++ )
+		{
+			if ( counters->counts[i] != 0 )
+			{
+				fprintf(destination, "  %-32s %12llu\n", counterNames[i], (unsigned long long)counters->counts[i]);
+			}
+		}
+		for ( int i = 0; i < TIMER_COUNT; i++ )
+		{
+			if ( counters->timerCalls[i] != 0 )
+			{
+				fprintf(destination, "  %-32s %12llu calls %16llu cycles %12llu per call\n", timerNames[i],
+					(unsigned long long)counters->timerCalls[i], (unsigned long long)counters->timerCycles[i],
+					(unsigned long long)(counters->timerCycles[i] / counters->timerCalls[i]));
+			}
+		}
+	}
+}
+
+/*!
+* Zeroes every thread's counters, threads counting at the same time may lose or keep a few counts
+*/
+void Instrumentation::reset()
+{
+	for ( ThreadCounters *counters = s_threadList; counters != NULL; counters = counters->next )
+	{
+		memset(counters->counts, 0, sizeof(counters->counts));
+		memset(counters->timerCalls, 0, sizeof(counters->timerCalls));
+		memset(counters->timerCycles, 0, sizeof(counters->timerCycles));
+	}
+}
+
+#endif
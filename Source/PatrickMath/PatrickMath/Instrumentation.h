@@ -0,0 +1,208 @@
+/*!
+* \file Instrumentation.h
+* \author Patrick Martin
+* \date 2010
+* \brief Opt in per thread counters and cycle timers
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+/*!
+* Opt in instrumentation.  Define PATRICKMATH_INSTRUMENT project wide (the library and everything including it) and
+* every library operation and register <-> memory transfer bumps a per thread counter, and batch kernels record rdtsc
+* cycles.  Without the define the PATRICKMATH_COUNT and PATRICKMATH_TIME hooks expand to nothing and none of this is
+* compiled, so the hooks can stay in the hot paths.
+*
+* Counters are per thread and never shared, each thread's block is linked into a global list the first time it counts
+* so that report() can walk every thread that ever touched the library (including finished ParallelFor workers).
+*/
+
+#ifdef PATRICKMATH_INSTRUMENT
+
+#include <intrin.h>
+#include <stdint.h>
+#include <stdio.h>
+
+class Instrumentation
+{
+public:
+	enum Counter
+	{
+		// register <-> memory transfers, the slow operations the class comments warn about
+		VECTOR4_GET,
+		VECTOR4_SET,
+		XMMFLOAT_GET,
+		XMMFLOAT_SET,
+		XMMBOOL_GET_VALUE,
+		XMMBOOL_LANE_MASK,
+		XMMINT_GET,
+		XMMINT_SET,
+		XMMDOUBLE_GET,
+		XMMDOUBLE_SET,
+		VECTOR4D_GET,
+		VECTOR4D_SET,
+		QUATERNION_GET,
+		QUATERNION_SET,
+		MATRIX4_GET,
+		MATRIX4_SET,
+		AFFINE3X4_GET,
+		AFFINE3X4_SET,
+
+		// operations
+		VECTOR4_DOT_PRODUCT,
+		VECTOR4_CROSS_PRODUCT,
+		VECTOR4_NORMALIZE,
+		VECTOR4_COMPARE,
+		XMMFLOAT_SQRT,
+		XMMFLOAT_DIVIDE,
+		XMMFLOAT_TRIG,
+		QUATERNION_MULTIPLY,
+		QUATERNION_ROTATE,
+		QUATERNION_NORMALIZE,
+		MATRIX4_MULTIPLY,
+		MATRIX4_TRANSFORM,
+		MATRIX4_FROM_TRANSFORM,
+		AFFINE3X4_COMPOSE,
+		AFFINE3X4_TRANSFORM,
+		AFFINE3X4_INVERSE,
+		COLLISION_QUERY,
+		COLLISION_GJK_ITERATION,
+		COLLISION_EPA_ITERATION,
+		ANIMATION_KEY_SEARCH,
+		ANIMATION_REWIND,
+		TRANSFORM_NODE_UPDATE,
+
+		COUNTER_COUNT
+	};
+
+	enum Timer
+	{
+		PARALLEL_TASK,
+		POINT_CLOUD,
+		COLLISION_BATCH,
+		ANIMATION_SAMPLE,
+		TRANSFORM_UPDATE,
+		QUANTIZE,
+		SAMPLING,
+		VECTOR4D_CONVERT,
+		CURVE_EVALUATE,
+		RADIX_SORT,
+		DISTANCE_BATCH,
+		AFFINE_BATCH,
+		STREAM_READ,
+		STREAM_STAGE,
+		STREAM_WRITE,
+		MESH_BATCH,
+		FLOAT3_CONVERT,
+		ROTATION_CONVERT,
+		ORIENTATION_BATCH,
+
+		TIMER_COUNT
+	};
+
+	struct ThreadCounters
+	{
+		uint32_t threadId;
+		uint64_t counts [COUNTER_COUNT];
+		uint64_t timerCalls [TIMER_COUNT];
+		uint64_t timerCycles [TIMER_COUNT];
+		ThreadCounters *next;
+	};
+
+	/*!
+	* Adds the cycles between construction and destruction to a timer
+	*/
+	class ScopedTimer
+	{
+	public:
+		explicit ScopedTimer(Timer timer);
+		~ScopedTimer();
+
+	private:
+		Timer m_timer;
+		uint64_t m_start;
+	};
+
+	static void count(Counter counter);
+	static void addCycles(Timer timer, uint64_t cycles);
+
+	// reading, safe while other threads count but the numbers are then approximate
+	static const ThreadCounters *threads();
+	static uint64_t total(Counter counter);
+	static uint64_t totalCycles(Timer timer);
+	static const char *counterName(Counter counter);
+	static const char *timerName(Timer timer);
+	static void report(FILE *destination);
+	static void reset();
+
+private:
+	static ThreadCounters *registerThread();
+
+	static __declspec(thread) ThreadCounters *s_threadCounters;
+};
+
+inline void Instrumentation::count(Counter counter)
+{
+	ThreadCounters *counters = s_threadCounters;
+	if ( counters == NULL )
+	{
+		counters = registerThread();
+	}
+	counters->counts[counter]++;
+}
+
+inline void Instrumentation::addCycles(Timer timer, uint64_t cycles)
+{
+	ThreadCounters *counters = s_threadCounters;
+	if ( counters == NULL )
+	{
+		counters = registerThread();
+	}
+	counters->timerCalls[timer]++;
+	counters->timerCycles[timer] += cycles;
+}
+
+inline Instrumentation::ScopedTimer::ScopedTimer(Timer timer)
+:	m_timer(timer), m_start(__rdtsc())
+{
+}
+
+inline Instrumentation::ScopedTimer::~ScopedTimer()
+{
+	addCycles(m_timer, __rdtsc() - m_start);
+}
+
+#define PATRICKMATH_COUNT(counter) Instrumentation::count(Instrumentation::counter)
+#define PATRICKMATH_TIME(timer) Instrumentation::ScopedTimer patrickMathTimer(Instrumentation::timer)
+
+#else
+
+#define PATRICKMATH_COUNT(counter) ((void)0)
+#define PATRICKMATH_TIME(timer) ((void)0)
+
+#endif
@@ -0,0 +1,264 @@
+/*!
+* \file Matrix4.h
+* \author Patrick Martin
+* \date 2010
+* \brief A column major 4x4 matrix held in four SSE registers
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <xmmintrin.h>
+
+#include "Instrumentation.h"
+#include "Quaternion.h"
+#include "Vector4.h"
+#include "XmmFloat.h"
+
+/*!
+* A 4x4 matrix stored as four column __m128's, so transforming a Vector4 is four broadcasts and three adds with no
+* horizontal work.  Matrices multiply column vectors: (a * b) * v applies b first.
+*/
+__declspec(align(16))
+class Matrix4
+{
+public:
+	__declspec(align(16))
+	struct Container
+	{
+		union
+		{
+			Vector4::Container columns [4];
+			float elements [16];
+		};
+	};
+
+public:
+	// constructors
+	Matrix4();
+	Matrix4(const Matrix4 &copy);
+	Matrix4(const Container &container);
+	Matrix4(const Vector4 &column0, const Vector4 &column1, const Vector4 &column2, const Vector4 &column3);
+
+	Matrix4 &operator=(const Matrix4 &copy);
+
+	// named
+	Matrix4 multiply(const Matrix4 &rhs) const;
+	Vector4 transform(const Vector4 &rhs) const;
+	Matrix4 transpose() const;
+
+	XmmBool isEqual(const Matrix4 &rhs, const XmmFloat &epsilon) const;
+
+	// operators
+	inline Matrix4 operator* (const Matrix4 &rhs) const	{return multiply(rhs);}
+	inline Vector4 operator* (const Vector4 &rhs) const	{return transform(rhs);}
+
+	Vector4 getColumn(int index) const;
+	Matrix4 &setColumn(int index, const Vector4 &column);
+
+	Container &get(Container &destination) const;
+	Matrix4 &set(const Container &source);
+
+	// scale first, then rotate, then translate
+	static Matrix4 fromTransform(const Vector4 &translation, const Quaternion &rotation, const Vector4 &scale);
+
+public:
+	static const Matrix4 IDENTITY;
+
+private:
+	__m128 columns [4];
+};
+
+/*!
+* Default constructor initializes to the identity
+*/
+inline Matrix4::Matrix4()
+{
+	columns[0] = _mm_set_ps(0.f, 0.f, 0.f, 1.f);
+	columns[1] = _mm_set_ps(0.f, 0.f, 1.f, 0.f);
+	columns[2] = _mm_set_ps(0.f, 1.f, 0.f, 0.f);
+	columns[3] = _mm_set_ps(1.f, 0.f, 0.f, 0.f);
+}
+
+inline Matrix4::Matrix4(const Matrix4 &copy)
+{
+	columns[0] = copy.columns[0];
+	columns[1] = copy.columns[1];
+	columns[2] = copy.columns[2];
+	columns[3] = copy.columns[3];
+}
+
+/*!
+* Initializes a Matrix4 from a column major Container
+* \param container the sixteen floats to load
+*/
+inline Matrix4::Matrix4(const Container &container)
+{
+	set(container);
+}
+
+/*!
+* Initializes a Matrix4 from its columns, for an affine transform the first three are the axes and the last is the
+* translation
+*/
+inline Matrix4::Matrix4(const Vector4 &column0, const Vector4 &column1, const Vector4 &column2, const Vector4 &column3)
+{
+	columns[0] = column0;
+	columns[1] = column1;
+	columns[2] = column2;
+	columns[3] = column3;
+}
+
+inline Matrix4 &Matrix4::operator=(const Matrix4 &copy)
+{
+	columns[0] = copy.columns[0];
+	columns[1] = copy.columns[1];
+	columns[2] = copy.columns[2];
+	columns[3] = copy.columns[3];
+	return *this;
+}
+
+/*!
+* Matrix product, every result column is this matrix transforming a column of rhs
+* \param rhs the right hand side, applied first
+* \return this * rhs
+*/
+inline Matrix4 Matrix4::multiply(const Matrix4 &rhs) const
+{
+	PATRICKMATH_COUNT(MATRIX4_MULTIPLY);
+	Matrix4 result;
+	result.columns[0] = transform(rhs.columns[0]);
+	result.columns[1] = transform(rhs.columns[1]);
+	result.columns[2] = transform(rhs.columns[2]);
+	result.columns[3] = transform(rhs.columns[3]);
+	return result;
+}
+
+/*!
+* Transforms a Vector4, w is honored so points (w = 1) pick up the translation and directions (w = 0) do not
+* \param rhs the Vector4 to transform
+* \return this * rhs
+*/
+inline Vector4 Matrix4::transform(const Vector4 &rhs) const
+{
+	PATRICKMATH_COUNT(MATRIX4_TRANSFORM);
+	__m128 v = rhs;
+	__m128 result = _mm_mul_ps(columns[0], _mm_shuffle_ps(v, v, _MM_SHUFFLE(0,0,0,0)));
+	result = _mm_add_ps(result, _mm_mul_ps(columns[1], _mm_shuffle_ps(v, v, _MM_SHUFFLE(1,1,1,1))));
+	result = _mm_add_ps(result, _mm_mul_ps(columns[2], _mm_shuffle_ps(v, v, _MM_SHUFFLE(2,2,2,2))));
+	result = _mm_add_ps(result, _mm_mul_ps(columns[3], _mm_shuffle_ps(v, v, _MM_SHUFFLE(3,3,3,3))));
+	return Vector4(result);
+}
+
+inline Matrix4 Matrix4::transpose() const
+{
+	Matrix4 result (*this);
+	_MM_TRANSPOSE4_PS(result.columns[0], result.columns[1], result.columns[2], result.columns[3]);
+	return result;
+}
+
+/*!
+* Comparison within epsilon, every element must be within epsilon
+* \param rhs the right hand side of the comparison
+* \param epsilon the epsilon for the comparison
+* \return all high if equal within epsilon, all bits low otherwise
+*/
+inline XmmBool Matrix4::isEqual(const Matrix4 &rhs, const XmmFloat &epsilon) const
+{
+	return Vector4(columns[0]).isEqual(rhs.columns[0], epsilon) & Vector4(columns[1]).isEqual(rhs.columns[1], epsilon) &
+		Vector4(columns[2]).isEqual(rhs.columns[2], epsilon) & Vector4(columns[3]).isEqual(rhs.columns[3], epsilon);
+}
+
+inline Vector4 Matrix4::getColumn(int index) const
+{
+	return Vector4(columns[index]);
+}
+
+inline Matrix4 &Matrix4::setColumn(int index, const Vector4 &column)
+{
+	columns[index] = column;
+	return *this;
+}
+
+inline Matrix4::Container &Matrix4::get(Matrix4::Container &destination) const
+{
+	PATRICKMATH_COUNT(MATRIX4_GET);
+	_mm_store_ps(destination.elements, columns[0]);
+	_mm_store_ps(destination.elements + 4, columns[1]);
+	_mm_store_ps(destination.elements + 8, columns[2]);
+	_mm_store_ps(destination.elements + 12, columns[3]);
+	return destination;
+}
+
+inline Matrix4 &Matrix4::set(const Matrix4::Container &source)
+{
+	PATRICKMATH_COUNT(MATRIX4_SET);
+	columns[0] = _mm_load_ps(source.elements);
+	columns[1] = _mm_load_ps(source.elements + 4);
+	columns[2] = _mm_load_ps(source.elements + 8);
+	columns[3] = _mm_load_ps(source.elements + 12);
+	return *this;
+}
+
+/*!
+* Builds translation * rotation * scale without any scalar math, the rotation columns come straight out of the
+* quaternion's lanes with shuffles
+* \param translation the translation, w is forced to 1
+* \param rotation a unit quaternion
+* \param scale the scale along each local axis, w is ignored
+* \return the affine transform
+*/
+inline Matrix4 Matrix4::fromTransform(const Vector4 &translation, const Quaternion &rotation, const Vector4 &scale)
+{
+	PATRICKMATH_COUNT(MATRIX4_FROM_TRANSFORM);
+	const __m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	const __m128 one = _mm_set_ps(0.f, 1.f, 1.f, 1.f);
+
+	__m128 q = rotation;
+	__m128 q2 = _mm_add_ps(q, q); // 2x, 2y, 2z, 2w
+	__m128 squares = _mm_mul_ps(q, q2); // 2xx, 2yy, 2zz, 2ww
+
+	// 1 - 2yy - 2zz, 1 - 2xx - 2zz, 1 - 2xx - 2yy, 0
+	__m128 diagonal = _mm_sub_ps(one, _mm_and_ps(_mm_shuffle_ps(squares, squares, _MM_SHUFFLE(3,0,0,1)), xyzMask));
+	diagonal = _mm_sub_ps(diagonal, _mm_and_ps(_mm_shuffle_ps(squares, squares, _MM_SHUFFLE(3,1,2,2)), xyzMask));
+
+	__m128 a = _mm_mul_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(3,1,0,0)), _mm_shuffle_ps(q2, q2, _MM_SHUFFLE(3,2,2,1))); // 2xy, 2xz, 2yz
+	__m128 b = _mm_mul_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(3,3,3,3)), _mm_shuffle_ps(q2, q2, _MM_SHUFFLE(3,0,1,2))); // 2wz, 2wy, 2wx
+	__m128 sum = _mm_and_ps(_mm_add_ps(a, b), xyzMask); // 2xy + 2wz, 2xz + 2wy, 2yz + 2wx, 0
+	__m128 difference = _mm_and_ps(_mm_sub_ps(a, b), xyzMask); // 2xy - 2wz, 2xz - 2wy, 2yz - 2wx, 0
+
+	__m128 s = scale;
+	Matrix4 result;
+	__m128 column = _mm_shuffle_ps(_mm_unpacklo_ps(diagonal, sum), difference, _MM_SHUFFLE(3,1,1,0));
+	result.columns[0] = _mm_mul_ps(column, _mm_shuffle_ps(s, s, _MM_SHUFFLE(0,0,0,0)));
+	column = _mm_shuffle_ps(_mm_shuffle_ps(difference, diagonal, _MM_SHUFFLE(1,1,0,0)), sum, _MM_SHUFFLE(3,2,2,0));
+	result.columns[1] = _mm_mul_ps(column, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1,1,1,1)));
+	column = _mm_shuffle_ps(_mm_shuffle_ps(sum, difference, _MM_SHUFFLE(2,2,1,1)), diagonal, _MM_SHUFFLE(3,2,2,0));
+	result.columns[2] = _mm_mul_ps(column, _mm_shuffle_ps(s, s, _MM_SHUFFLE(2,2,2,2)));
+	result.columns[3] = _mm_or_ps(_mm_and_ps(translation, xyzMask), _mm_set_ps(1.f, 0.f, 0.f, 0.f));
+	return result;
+}
@@ -0,0 +1,381 @@
+/*!
+* \file Mesh.cpp
+* \author Patrick Martin
+* \date 2010
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "stdafx.h"
+#include "Mesh.h"
+
+#include <float.h>
+#include <intrin.h>
+#include <malloc.h>
+#include <string.h>
+
+#include "Instrumentation.h"
+#include "ParallelFor.h"
+
+/*!
+* The operands of a mesh batch, unused ones are NULL.  Face passes write faceVectors (and faceVectors2), vertex passes
+* gather them through offsets and faces.
+*/
+struct MeshBatch
+{
+	const Vector4::Container *positions;
+	const float *uvs;
+	const Vector4::Container *normals;
+	const uint32_t *indices;
+	Vector4::Container *faceVectors;
+	Vector4::Container *faceVectors2;
+	float *areas;
+	const uint32_t *offsets;
+	const uint32_t *faces;
+	Vector4::Container *results;
+};
+
+/*!
+* \return direction (w = 0) scaled to unit length, zero if it is too short to have one
+*/
+static inline Vector4 normalizeDirection(const Vector4 &direction)
+{
+	return direction.safeNormalizeSq(XmmFloat(FLT_MIN));
+}
+
+/*!
+* \return the edges b - a and c - a of triangle, w = 0
+*/
+static inline void triangleEdges(const MeshBatch &batch, size_t triangle, Vector4 &edge1, Vector4 &edge2)
+{
+	const __m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	const uint32_t *corners = batch.indices + triangle * 3;
+	__m128 a = _mm_load_ps(batch.positions[corners[0]].elements);
+	edge1 = _mm_and_ps(_mm_sub_ps(_mm_load_ps(batch.positions[corners[1]].elements), a), xyzMask);
+	edge2 = _mm_and_ps(_mm_sub_ps(_mm_load_ps(batch.positions[corners[2]].elements), a), xyzMask);
+}
+
+static void faceNormalKernel(void *context, size_t, size_t begin, size_t end)
+{
+	MeshBatch &batch = *static_cast<MeshBatch*>(context);
+	for ( size_t i = begin; i < end; i++ )
+	{
+		Vector4 edge1, edge2;
+		triangleEdges(batch, i, edge1, edge2);
+		Vector4 normal = edge1.crossProduct(edge2);
+		_mm_store_ps(batch.faceVectors[i].elements, normalizeDirection(normal));
+		if ( batch.areas != NULL )
+		{
+			_mm_store_ss(batch.areas + i, _mm_mul_ss(_mm_sqrt_ss(normal.dotProduct(normal)), _mm_set_ss(0.5f)));
+		}
+	}
+}
+
+/*!
+* The unnormalized cross product, its length is twice the area so summing them weights the faces by area
+*/
+static void faceCrossKernel(void *context, size_t, size_t begin, size_t end)
+{
+	MeshBatch &batch = *static_cast<MeshBatch*>(context);
+	for ( size_t i = begin; i < end; i++ )
+	{
+		Vector4 edge1, edge2;
+		triangleEdges(batch, i, edge1, edge2);
+		_mm_store_ps(batch.faceVectors[i].elements, edge1.crossProduct(edge2));
+	}
+}
+
+/*!
+* The directions of increasing u and v across every face (Lengyel), solved from the edges and their uv deltas.  Faces
+* whose uvs are degenerate contribute nothing.
+*/
+static void faceTangentKernel(void *context, size_t, size_t begin, size_t end)
+{
+	MeshBatch &batch = *static_cast<MeshBatch*>(context);
+	for ( size_t i = begin; i < end; i++ )
+	{
+		Vector4 edge1, edge2;
+		triangleEdges(batch, i, edge1, edge2);
+		const uint32_t *corners = batch.indices + i * 3;
+		const float *uv0 = batch.uvs + corners[0] * 2, *uv1 = batch.uvs + corners[1] * 2, *uv2 = batch.uvs + corners[2] * 2;
+		float du1 = uv1[0] - uv0[0], dv1 = uv1[1] - uv0[1];
+		float du2 = uv2[0] - uv0[0], dv2 = uv2[1] - uv0[1];
+		float determinant = du1 * dv2 - du2 * dv1;
+		float r = determinant > FLT_MIN || determinant < -FLT_MIN ? 1.f / determinant : 0.f;
+
+		__m128 uDirection = _mm_sub_ps(_mm_mul_ps(edge1, _mm_set1_ps(dv2 * r)), _mm_mul_ps(edge2, _mm_set1_ps(dv1 * r)));
+		__m128 vDirection = _mm_sub_ps(_mm_mul_ps(edge2, _mm_set1_ps(du1 * r)), _mm_mul_ps(edge1, _mm_set1_ps(du2 * r)));
+		_mm_store_ps(batch.faceVectors[i].elements, uDirection);
+		_mm_store_ps(batch.faceVectors2[i].elements, vDirection);
+	}
+}
+
+static void vertexNormalKernel(void *context, size_t, size_t begin, size_t end)
+{
+	MeshBatch &batch = *static_cast<MeshBatch*>(context);
+	for ( size_t v = begin; v < end; v++ )
+	{
+		__m128 sum = _mm_setzero_ps();
+		for ( uint32_t k = batch.offsets[v]; k < batch.offsets[v + 1]; k++ )
+		{
+			sum = _mm_add_ps(sum, _mm_load_ps(batch.faceVectors[batch.faces[k]].elements));
+		}
+		_mm_store_ps(batch.results[v].elements, normalizeDirection(Vector4(sum)));
+	}
+}
+
+/*!
+* Sums the face directions around every vertex, removes the normal component from the u direction (Gram-Schmidt) and
+* takes the handedness from which side of the normal, tangent plane the v direction is on
+*/
+static void vertexTangentKernel(void *context, size_t, size_t begin, size_t end)
+{
+	MeshBatch &batch = *static_cast<MeshBatch*>(context);
+	const __m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	for ( size_t v = begin; v < end; v++ )
+	{
+		__m128 uSum = _mm_setzero_ps(), vSum = _mm_setzero_ps();
+		for ( uint32_t k = batch.offsets[v]; k < batch.offsets[v + 1]; k++ )
+		{
+			uSum = _mm_add_ps(uSum, _mm_load_ps(batch.faceVectors[batch.faces[k]].elements));
+			vSum = _mm_add_ps(vSum, _mm_load_ps(batch.faceVectors2[batch.faces[k]].elements));
+		}
+		Vector4 normal (_mm_and_ps(_mm_load_ps(batch.normals[v].elements), xyzMask));
+		Vector4 tangent = normalizeDirection(_mm_sub_ps(uSum, _mm_mul_ps(normal, normal.dotProduct(Vector4(uSum)))));
+
+		// w = -1 where the v direction is behind cross(normal, tangent)
+		__m128 handedness = _mm_cmplt_ps(normal.crossProduct(tangent).dotProduct(Vector4(vSum)), _mm_setzero_ps());
+		__m128 w = _mm_or_ps(_mm_set_ss(1.f), _mm_and_ps(handedness, _mm_set_ss(-0.f)));
+		w = _mm_shuffle_ps(w, w, _MM_SHUFFLE(0,1,1,1)); // w lane only
+		_mm_store_ps(batch.results[v].elements, _mm_or_ps(tangent, w));
+	}
+}
+
+/*!
+* Unit normals of every triangle, right handed: counter clockwise corners face the viewer
+* \param positions the vertex positions
+* \param indices three vertex indices per triangle
+* \param triangleCount the number of triangles
+* \param normals receives one normal per triangle, zero for degenerate triangles
+* \param areas receives the triangle areas, may be NULL
+* \param taskCount the number of tasks the batch is split into
+*/
+void Mesh::faceNormals(
+	const Vector4::Container *positions, const uint32_t *indices, size_t triangleCount, Vector4::Container *normals,
+	float *areas, size_t taskCount)
+{
+	PATRICKMATH_TIME(MESH_BATCH);
+	MeshBatch batch = {positions, NULL, NULL, indices, normals, NULL, areas, NULL, NULL, NULL};
+	ParallelFor::run(faceNormalKernel, &batch, triangleCount, taskCount);
+}
+
+/*!
+* Area weighted vertex normals
+* \param positions the vertex positions
+* \param indices three vertex indices per triangle
+* \param triangleCount the number of triangles
+* \param adjacency the adjacency of the same indices, its vertexCount is the number of normals
+* \param normals receives one normal per vertex
+* \param taskCount the number of tasks the batch is split into
+*/
+void Mesh::vertexNormals(
+	const Vector4::Container *positions, const uint32_t *indices, size_t triangleCount, const Adjacency &adjacency,
+	Vector4::Container *normals, size_t taskCount)
+{
+	PATRICKMATH_TIME(MESH_BATCH);
+	Vector4::Container *faceVectors = static_cast<Vector4::Container*>(
+		_aligned_malloc(triangleCount * sizeof(Vector4::Container), 16));
+
+	MeshBatch batch = {
+		positions, NULL, NULL, indices, faceVectors, NULL, NULL, adjacency.offsets(), adjacency.faces(), normals};
+	ParallelFor::run(faceCrossKernel, &batch, triangleCount, taskCount);
+	ParallelFor::run(vertexNormalKernel, &batch, adjacency.vertexCount(), taskCount);
+
+	_aligned_free(faceVectors);
+}
+
+/*!
+* Per vertex tangent frames for normal mapping
+* \param positions the vertex positions
+* \param uvs the texture coordinates, u and v per vertex
+* \param normals the unit vertex normals the tangents are made orthogonal to
+* \param indices three vertex indices per triangle
+* \param triangleCount the number of triangles
+* \param adjacency the adjacency of the same indices, its vertexCount is the number of tangents
+* \param tangents receives one tangent per vertex, w holds the handedness
+* \param taskCount the number of tasks the batch is split into
+*/
+void Mesh::vertexTangents(
+	const Vector4::Container *positions, const float *uvs, const Vector4::Container *normals,
+	const uint32_t *indices, size_t triangleCount, const Adjacency &adjacency, Vector4::Container *tangents,
+	size_t taskCount)
+{
+	PATRICKMATH_TIME(MESH_BATCH);
+	Vector4::Container *faceVectors = static_cast<Vector4::Container*>(
+		_aligned_malloc(triangleCount * 2 * sizeof(Vector4::Container), 16));
+
+	MeshBatch batch = {
+		positions, uvs, normals, indices, faceVectors, faceVectors + triangleCount, NULL, adjacency.offsets(),
+		adjacency.faces(), tangents};
+	ParallelFor::run(faceTangentKernel, &batch, triangleCount, taskCount);
+	ParallelFor::run(vertexTangentKernel, &batch, adjacency.vertexCount(), taskCount);
+
+	_aligned_free(faceVectors);
+}
+
+struct AdjacencyBatch
+{
+	const uint32_t *indices;
+	volatile long *cursors;
+	const uint32_t *offsets;
+	uint32_t *faces;
+};
+
+static void countCornersKernel(void *context, size_t, size_t begin, size_t end)
+{
+	AdjacencyBatch &batch = *static_cast<AdjacencyBatch*>(context);
+	for ( size_t i = begin; i < end; i++ )
+	{
+		_InterlockedIncrement(batch.cursors + batch.indices[i]);
+	}
+}
+
+/*!
+* Claims the next free slot of every corner's vertex, the slots of one vertex are filled in whatever order the tasks
+* reach them
+*/
+static void fillFacesKernel(void *context, size_t, size_t begin, size_t end)
+{
+	AdjacencyBatch &batch = *static_cast<AdjacencyBatch*>(context);
+	for ( size_t i = begin; i < end; i++ )
+	{
+		uint32_t v = batch.indices[i];
+		uint32_t slot = uint32_t(_InterlockedIncrement(batch.cursors + v) - 1);
+		batch.faces[batch.offsets[v] + slot] = uint32_t(i / 3);
+	}
+}
+
+/*!
+* Puts the faces of every vertex back in ascending order, an insertion sort since a vertex only has a handful and a
+* single task already filled them in order
+*/
+static void sortFacesKernel(void *context, size_t, size_t begin, size_t end)
+{
+	AdjacencyBatch &batch = *static_cast<AdjacencyBatch*>(context);
+	for ( size_t v = begin; v < end; v++ )
+	{
+		uint32_t *faces = batch.faces + batch.offsets[v];
+		uint32_t count = batch.offsets[v + 1] - batch.offsets[v];
+		for ( uint32_t k = 1; k < count; k++ )
+		{
+			uint32_t face = faces[k];
+			uint32_t j = k;
+			for ( ; j > 0 && faces[j - 1] > face; j-- )
+			{
+				faces[j] = faces[j - 1];
+			}
+			faces[j] = face;
+		}
+	}
+}
+
+/*!
+* Builds the vertex to face adjacency with a counting sort over the corners.  The counts and the fill are spread over
+* the corners with an atomic per vertex, then every vertex sorts its own faces so the result is the same for any
+* taskCount.
+* \param indices three vertex indices per triangle, every index less than vertexCount
+* \param triangleCount the number of triangles
+* \param vertexCount the number of vertices
+* \param offsets receives vertexCount + 1 offsets into faces
+* \param faces receives 3 * triangleCount triangle indices
+* \param taskCount the number of tasks the batch is split into
+*/
+void Mesh::vertexFaces(
+	const uint32_t *indices, size_t triangleCount, size_t vertexCount, uint32_t *offsets, uint32_t *faces,
+	size_t taskCount)
+{
+	PATRICKMATH_TIME(MESH_BATCH);
+	long *cursors = new long [vertexCount > 0 ? vertexCount : 1];
+	memset(cursors, 0, vertexCount * sizeof(long));
+	AdjacencyBatch batch = {indices, cursors, offsets, faces};
+	ParallelFor::run(countCornersKernel, &batch, triangleCount * 3, taskCount);
+
+	// exclusive prefix sum, offsets[v] is then where the faces of v start, and the cursors go back to 0 for the fill
+	uint32_t total = 0;
+	for ( size_t v = 0; v < vertexCount; v++ )
+	{
+		offsets[v] = total;
+		total += uint32_t(cursors[v]);
+		cursors[v] = 0;
+	}
+	offsets[vertexCount] = total;
+
+	ParallelFor::run(fillFacesKernel, &batch, triangleCount * 3, taskCount);
+	ParallelFor::run(sortFacesKernel, &batch, vertexCount, taskCount);
+	delete [] cursors;
+}
+
+Mesh::Adjacency::Adjacency()
+:	m_offsets(NULL), m_faces(NULL), m_vertexCount(0)
+{
+}
+
+Mesh::Adjacency::~Adjacency()
+{
+	clear();
+}
+
+/*!
+* Builds the adjacency of a mesh, replacing any previous one
+* \param indices three vertex indices per triangle, every index less than vertexCount
+* \param triangleCount the number of triangles
+* \param vertexCount the number of vertices
+* \param taskCount the number of tasks the build is split into
+* \return false if there are no vertices
+*/
+bool Mesh::Adjacency::create(const uint32_t *indices, size_t triangleCount, size_t vertexCount, size_t taskCount)
+{
+	clear();
+	if ( vertexCount == 0 )
+	{
+		return false;
+	}
+
+	m_offsets = new uint32_t [vertexCount + 1];
+	m_faces = new uint32_t [triangleCount > 0 ? triangleCount * 3 : 1];
+	m_vertexCount = vertexCount;
+	vertexFaces(indices, triangleCount, vertexCount, m_offsets, m_faces, taskCount);
+	return true;
+}
+
+void Mesh::Adjacency::clear()
+{
+	delete [] m_offsets;
+	delete [] m_faces;
+	m_offsets = NULL;
+	m_faces = NULL;
+	m_vertexCount = 0;
+}
@@ -0,0 +1,126 @@
+/*!
+* \file Mesh.h
+* \author Patrick Martin
+* \date 2010
+* \brief Parallel face normals, vertex normals and tangents of indexed triangle meshes
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Vector4.h"
+
+/*!
+* Normal and tangent generation for indexed triangle meshes: three uint32_t vertex indices per triangle, positions as
+* Vector4 points.  Per vertex results are gathered rather than scattered: the faces are done first, one task per range
+* of triangles, then a vertex to face adjacency (a Mesh::Adjacency, built once per mesh and shared by the vertex passes)
+* lets every task sum the faces around its own range of vertices.  No two tasks write the same vertex, so the vertex
+* passes need no atomics; only building the adjacency does, with one counter per vertex.  The faces are always summed in
+* ascending order so the results do not depend on taskCount.
+*
+* Normals and tangents are written with w = 0, except that the w of a tangent holds the handedness of the frame (1 or
+* -1) so the bitangent is cross(normal, tangent) * w.  Vertices without any usable face get zero vectors.
+*/
+class Mesh
+{
+public:
+	/*!
+	* The triangles around every vertex, see vertexFaces.  It only depends on the indices, so one build serves every
+	* vertex pass over the mesh until the topology changes.
+	*/
+	class Adjacency
+	{
+	public:
+		Adjacency();
+		~Adjacency();
+
+		bool create(const uint32_t *indices, size_t triangleCount, size_t vertexCount, size_t taskCount = 1);
+		void clear();
+
+		size_t vertexCount() const;
+		const uint32_t *offsets() const;
+		const uint32_t *faces() const;
+
+	private:
+		// not copyable, the arrays are owned
+		Adjacency(const Adjacency &);
+		Adjacency &operator=(const Adjacency &);
+
+		uint32_t *m_offsets;
+		uint32_t *m_faces;
+		size_t m_vertexCount;
+	};
+
+	// unit face normals, areas (optional) receives the triangle areas
+	static void faceNormals(
+		const Vector4::Container *positions, const uint32_t *indices, size_t triangleCount, Vector4::Container *normals,
+		float *areas, size_t taskCount = 1);
+
+	// unit vertex normals, the sum of the adjacent face normals weighted by area
+	static void vertexNormals(
+		const Vector4::Container *positions, const uint32_t *indices, size_t triangleCount, const Adjacency &adjacency,
+		Vector4::Container *normals, size_t taskCount = 1);
+
+	// unit tangents along +u orthogonalized against the normals, uvs holds u, v pairs per vertex
+	static void vertexTangents(
+		const Vector4::Container *positions, const float *uvs, const Vector4::Container *normals,
+		const uint32_t *indices, size_t triangleCount, const Adjacency &adjacency, Vector4::Container *tangents,
+		size_t taskCount = 1);
+
+	// the triangles around vertex v are faces[offsets[v]] to faces[offsets[v + 1] - 1], in ascending order; offsets
+	// has vertexCount + 1 entries and faces 3 * triangleCount
+	static void vertexFaces(
+		const uint32_t *indices, size_t triangleCount, size_t vertexCount, uint32_t *offsets, uint32_t *faces,
+		size_t taskCount = 1);
+};
+
+/*!
+* \return the number of vertices the adjacency was created for
+*/
+inline size_t Mesh::Adjacency::vertexCount() const
+{
+	return m_vertexCount;
+}
+
+/*!
+* \return vertexCount + 1 offsets into faces
+*/
+inline const uint32_t *Mesh::Adjacency::offsets() const
+{
+	return m_offsets;
+}
+
+/*!
+* \return the triangles around each vertex in turn, 3 * triangleCount of them
+*/
+inline const uint32_t *Mesh::Adjacency::faces() const
+{
+	return m_faces;
+}
@@ -0,0 +1,255 @@
+/*!
+* \file ParallelFor.cpp
+* \author Patrick Martin
+* \date 2010
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "stdafx.h"
+#include "ParallelFor.h"
+
+#include <intrin.h>
+#include <windows.h>
+
+#include "Instrumentation.h"
+
+/*!
+* One call to run.  It lives on the caller's stack and is on the pool's queue while it still has ranges nobody has
+* claimed; remaining counts the ranges not yet finished and whoever finishes the last one wakes the caller.
+*/
+struct ParallelBatch
+{
+	ParallelFor::Kernel kernel;
+	void *context;
+	size_t count;
+	size_t taskCount;
+	size_t nextTask;
+	volatile long remaining;
+	HANDLE done;
+	ParallelBatch *next;
+};
+
+/*!
+* The worker threads, created on first use and kept (handles included) for the life of the process.  Workers sleep on one semaphore that
+* run releases once per range it wants help with; a woken worker claims the oldest unclaimed range on the queue, or
+* goes back to sleep if the callers have already taken them all.
+*/
+struct ParallelPool
+{
+	CRITICAL_SECTION lock;
+	HANDLE work;
+	HANDLE workers [ParallelFor::MAX_TASKS];
+	size_t workerCount;
+	ParallelBatch *head;
+	ParallelBatch *tail;
+
+	ParallelPool()
+	:	work(CreateSemaphore(NULL, 0, LONG(0x7fffffff), NULL)), workerCount(0), head(NULL), tail(NULL)
+	{
+		InitializeCriticalSection(&lock);
+	}
+};
+
+static ParallelPool pool;
+
+// the semaphore a thread waits on for its own batches, never closed like the instrumentation blocks
+static __declspec(thread) HANDLE threadDone = NULL;
+
+/*!
+* Claims the next range of batch, taking the batch off the queue with its last range; call with the pool locked
+* \return the task index, or taskCount if every range is already claimed
+*/
+static size_t claimTask(ParallelBatch *batch)
+{
+	size_t taskIndex = batch->nextTask;
+	if ( taskIndex == batch->taskCount )
+	{
+		return taskIndex;
+	}
+	batch->nextTask++;
+	if ( batch->nextTask == batch->taskCount )
+	{
+		ParallelBatch *previous = NULL;
+		for ( ParallelBatch *entry = pool.head; entry != batch; entry = entry->next )
+		{
+			previous = entry;
+		}
+		(previous != NULL ? previous->next : pool.head) = batch->next;
+		if ( pool.tail == batch )
+		{
+			pool.tail = previous;
+		}
+	}
+	return taskIndex;
+}
+
+/*!
+* Runs one range and counts it off
+* \return true if it was the last range of the batch to finish
+*/
+static bool runTask(ParallelBatch *batch, size_t taskIndex)
+{
+	{
+		PATRICKMATH_TIME(PARALLEL_TASK);
+		size_t begin;
+		size_t length = ParallelFor::taskRange(batch->count, batch->taskCount, taskIndex, begin);
+		batch->kernel(batch->context, taskIndex, begin, begin + length);
+	}
+	return _InterlockedDecrement(&batch->remaining) == 0;
+}
+
+static DWORD WINAPI parallelWorkerEntry(LPVOID)
+{
+	for ( ;; )
+	{
+		WaitForSingleObject(pool.work, INFINITE);
+		EnterCriticalSection(&pool.lock);
+		ParallelBatch *batch = pool.head;
+		size_t taskIndex = batch != NULL ? claimTask(batch) : 0;
+		LeaveCriticalSection(&pool.lock);
+		if ( batch == NULL )
+		{
+			continue;
+		}
+
+		// the caller may return as soon as the last range is done, so nothing of the batch is touched after that
+		HANDLE done = batch->done;
+		if ( runTask(batch, taskIndex) )
+		{
+			ReleaseSemaphore(done, 1, NULL);
+		}
+	}
+}
+
+/*!
+* Computes the range of one task.  Ranges are contiguous, in task order, and differ in size by at most one element.
+* \param count the size of the whole batch
+* \param taskCount the number of tasks the batch is split into, 0 is taken as 1 like run does
+* \param taskIndex the task to compute the range for
+* \param begin receives the first index of the range
+* \return the number of elements in the range
+*/
+size_t ParallelFor::taskRange(size_t count, size_t taskCount, size_t taskIndex, size_t &begin)
+{
+	taskCount = taskCount < 1 ? 1 : taskCount;
+	size_t base = count / taskCount;
+	size_t extra = count % taskCount;
+	begin = taskIndex * base + (taskIndex < extra ? taskIndex : extra);
+	return base + (taskIndex < extra ? 1 : 0);
+}
+
+/*!
+* Runs kernel over [0, count) split into taskCount ranges and returns once every range is done.  The ranges go to a
+* pool of worker threads that is created on first use and reused by every later call, and the calling thread works
+* through the ranges of its own batch alongside them, so a call never waits on ranges nobody is running and calls from
+* several threads (or from inside a kernel) are safe.  taskCount is clamped to [1, min(count, MAX_TASKS)].
+* \param kernel the kernel to run
+* \param context passed through to every kernel call
+* \param count the size of the batch
+* \param taskCount the number of ranges to split the batch into
+*/
+void ParallelFor::run(Kernel kernel, void *context, size_t count, size_t taskCount)
+{
+	if ( count == 0 )
+	{
+		return;
+	}
+	if ( taskCount > count )
+	{
+		taskCount = count;
+	}
+	if ( taskCount > MAX_TASKS )
+	{
+		taskCount = MAX_TASKS;
+	}
+	if ( taskCount <= 1 )
+	{
+		kernel(context, 0, 0, count);
+		return;
+	}
+	if ( threadDone == NULL )
+	{
+		threadDone = CreateSemaphore(NULL, 0, 1, NULL);
+	}
+
+	ParallelBatch batch;
+	batch.kernel = kernel;
+	batch.context = context;
+	batch.count = count;
+	batch.taskCount = taskCount;
+	batch.nextTask = 0;
+	batch.remaining = long(taskCount);
+	batch.done = threadDone;
+	batch.next = NULL;
+
+	EnterCriticalSection(&pool.lock);
+	// grow the pool to the largest taskCount asked for so far, a failed thread only means less help
+	while ( pool.workerCount < taskCount - 1 )
+	{
+		HANDLE thread = CreateThread(NULL, 0, parallelWorkerEntry, NULL, 0, NULL);
+		if ( thread == NULL )
+		{
+			break;
+		}
+		pool.workers[pool.workerCount++] = thread;
+	}
+	(pool.tail != NULL ? pool.tail->next : pool.head) = &batch;
+	pool.tail = &batch;
+	size_t helpers = pool.workerCount < taskCount - 1 ? pool.workerCount : taskCount - 1;
+	LeaveCriticalSection(&pool.lock);
+	if ( helpers > 0 )
+	{
+		ReleaseSemaphore(pool.work, LONG(helpers), NULL);
+	}
+
+	bool finished = false;
+	for ( ;; )
+	{
+		EnterCriticalSection(&pool.lock);
+		size_t taskIndex = claimTask(&batch);
+		LeaveCriticalSection(&pool.lock);
+		if ( taskIndex == taskCount )
+		{
+			break;
+		}
+		finished = runTask(&batch, taskIndex);
+	}
+	if ( !finished )
+	{
+		WaitForSingleObject(threadDone, INFINITE);
+	}
+}
+
+/*!
+* \return the number of logical processors, a sensible taskCount for large batches
+*/
+size_t ParallelFor::hardwareTaskCount()
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? size_t(info.dwNumberOfProcessors) : 1;
+}
@@ -0,0 +1,56 @@
+/*!
+* \file ParallelFor.h
+* \author Patrick Martin
+* \date 2010
+* \brief Splits a batch kernel over contiguous ranges and runs the ranges on worker threads
+*
+* This is deliberately minimal: one call creates its threads, runs every range and joins before returning.  Kernels
+* must only write to data owned by their own range (or their own task slot), so the batch kernels in this library
+* never need locks.  If you already have a job system, skip this class and hand the same ranges to your own workers,
+* every kernel that uses ParallelFor also exposes the single range version it runs.
+*
+* This project is governed by the MIT licence:
+*
+*  Copyright (c) 2010 Patrick Martin
+*
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+*
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+class ParallelFor
+{
+public:
+	/*!
+	* A kernel processes [begin, end) of the batch.  taskIndex is the index of the range (0 to taskCount - 1) so that
+	* kernels can write per task partial results without sharing anything.
+	*/
+	typedef void (*Kernel)(void *context, size_t taskIndex, size_t begin, size_t end);
+
+	static const size_t MAX_TASKS = 64;
+
+	static void run(Kernel kernel, void *context, size_t count, size_t taskCount);
+	static size_t taskRange(size_t count, size_t taskCount, size_t taskIndex, size_t &begin);
+	static size_t hardwareTaskCount();
+};
@@ -0,0 +1,583 @@
+/*!
+* \file PointCloud.cpp
+* \author Patrick Martin
+* \date 2010
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "stdafx.h"
+#include "PointCloud.h"
+
+#include <limits>
+#include <math.h>
+
+#include "ParallelFor.h"
+
+// float sums are folded into the double sums this often (in points) to keep float rounding out of large clouds
+static const size_t FLUSH_SIZE = 256;
+
+struct BoundsPartial
+{
+	float minimum [4];
+	float maximum [4];
+};
+
+/*!
+* Adds the four lanes in a fixed order, in double precision
+*/
+static double horizontalSum(const __m128 &value)
+{
+	__declspec(align(16)) float lanes [4];
+	_mm_store_ps(lanes, value);
+	return (double(lanes[0]) + double(lanes[1])) + (double(lanes[2]) + double(lanes[3]));
+}
+
+/*!
+* Loads the four points starting at index.  Past count the padding value is used instead, the caller picks a padding
+* value that contributes nothing to its reduction.
+*/
+static void loadGroup(
+	const Vector4::Container *points, size_t index, size_t count, const __m128 &padding, __m128 rows [4])
+{
+	for ( size_t lane = 0; lane < 4; lane++ )
+	{
+		rows[lane] = index + lane < count ? _mm_load_ps(points[index + lane].elements) : padding;
+	}
+}
+
+static void initializeBounds(__m128 &boundsMin, __m128 &boundsMax)
+{
+	boundsMin = _mm_set1_ps(std::numeric_limits<float>::infinity());
+	boundsMax = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+}
+
+/*!
+* Single pass over a range of points.  Bounds are taken on the untransposed points (two operations per point, no
+* horizontal work) and the sums on the transposed ones.
+* \param points the points to reduce
+* \param count the number of points
+* \param reference the point every sum is taken relative to, pass the same reference for partials you want to merge
+* \param result receives the partial statistics
+*/
+void PointCloud::accumulate(
+	const Vector4::Container *points, size_t count, const Vector4::Container &reference, Statistics &result)
+{
+	const __m128 origin = _mm_load_ps(reference.elements);
+	const __m128 originX = _mm_shuffle_ps(origin, origin, _MM_SHUFFLE(0,0,0,0));
+	const __m128 originY = _mm_shuffle_ps(origin, origin, _MM_SHUFFLE(1,1,1,1));
+	const __m128 originZ = _mm_shuffle_ps(origin, origin, _MM_SHUFFLE(2,2,2,2));
+
+	__m128 boundsMin, boundsMax;
+	initializeBounds(boundsMin, boundsMax);
+	_mm_storeu_ps(result.reference, origin);
+	result.sum[0] = result.sum[1] = result.sum[2] = 0.0;
+	result.sumSq.xx = result.sumSq.yy = result.sumSq.zz = 0.0;
+	result.sumSq.xy = result.sumSq.xz = result.sumSq.yz = 0.0;
+	result.count = count;
+
+	for ( size_t flushStart = 0; flushStart < count; flushStart += FLUSH_SIZE )
+	{
+		size_t flushEnd = flushStart + FLUSH_SIZE < count ? flushStart + FLUSH_SIZE : count;
+		__m128 sumX = _mm_setzero_ps(), sumY = _mm_setzero_ps(), sumZ = _mm_setzero_ps();
+		__m128 sumXX = _mm_setzero_ps(), sumYY = _mm_setzero_ps(), sumZZ = _mm_setzero_ps();
+		__m128 sumXY = _mm_setzero_ps(), sumXZ = _mm_setzero_ps(), sumYZ = _mm_setzero_ps();
+
+		for ( size_t i = flushStart; i < flushEnd; i += 4 )
+		{
+			// padding with the reference point adds exactly zero to every sum
+			__m128 rows [4];
+			loadGroup(points, i, flushEnd, origin, rows);
+			for ( size_t lane = 0; lane < 4 && i + lane < flushEnd; lane++ )
+			{
+				boundsMin = _mm_min_ps(boundsMin, rows[lane]);
+				boundsMax = _mm_max_ps(boundsMax, rows[lane]);
+			}
+
+			_MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+			__m128 dx = _mm_sub_ps(rows[0], originX);
+			__m128 dy = _mm_sub_ps(rows[1], originY);
+			__m128 dz = _mm_sub_ps(rows[2], originZ);
+
+			sumX = _mm_add_ps(sumX, dx);
+			sumY = _mm_add_ps(sumY, dy);
+			sumZ = _mm_add_ps(sumZ, dz);
+			sumXX = _mm_add_ps(sumXX, _mm_mul_ps(dx, dx));
+			sumYY = _mm_add_ps(sumYY, _mm_mul_ps(dy, dy));
+			sumZZ = _mm_add_ps(sumZZ, _mm_mul_ps(dz, dz));
+			sumXY = _mm_add_ps(sumXY, _mm_mul_ps(dx, dy));
+			sumXZ = _mm_add_ps(sumXZ, _mm_mul_ps(dx, dz));
+			sumYZ = _mm_add_ps(sumYZ, _mm_mul_ps(dy, dz));
+		}
+
+		result.sum[0] += horizontalSum(sumX);
+		result.sum[1] += horizontalSum(sumY);
+		result.sum[2] += horizontalSum(sumZ);
+		result.sumSq.xx += horizontalSum(sumXX);
+		result.sumSq.yy += horizontalSum(sumYY);
+		result.sumSq.zz += horizontalSum(sumZZ);
+		result.sumSq.xy += horizontalSum(sumXY);
+		result.sumSq.xz += horizontalSum(sumXZ);
+		result.sumSq.yz += horizontalSum(sumYZ);
+	}
+
+	_mm_storeu_ps(result.boundsMin, boundsMin);
+	_mm_storeu_ps(result.boundsMax, boundsMax);
+}
+
+/*!
+* Merges a partial result into result.  Both must have been accumulated against the same reference.
+* \param result the running result, updated in place
+* \param partial the partial result to fold in
+*/
+void PointCloud::merge(Statistics &result, const Statistics &partial)
+{
+	if ( partial.count == 0 )
+	{
+		return;
+	}
+	if ( result.count == 0 )
+	{
+		result = partial;
+		return;
+	}
+
+	_mm_storeu_ps(result.boundsMin, _mm_min_ps(_mm_loadu_ps(result.boundsMin), _mm_loadu_ps(partial.boundsMin)));
+	_mm_storeu_ps(result.boundsMax, _mm_max_ps(_mm_loadu_ps(result.boundsMax), _mm_loadu_ps(partial.boundsMax)));
+	for ( int axis = 0; axis < 3; axis++ )
+	{
+		result.sum[axis] += partial.sum[axis];
+	}
+	result.sumSq.xx += partial.sumSq.xx;
+	result.sumSq.yy += partial.sumSq.yy;
+	result.sumSq.zz += partial.sumSq.zz;
+	result.sumSq.xy += partial.sumSq.xy;
+	result.sumSq.xz += partial.sumSq.xz;
+	result.sumSq.yz += partial.sumSq.yz;
+	result.count += partial.count;
+}
+
+/*!
+* \return the mean of the accumulated points as a point (w = 1)
+*/
+Vector4 PointCloud::mean(const Statistics &statistics)
+{
+	double inverseCount = statistics.count > 0 ? 1.0 / double(statistics.count) : 0.0;
+	Vector4::Container result = {
+		float(statistics.reference[0] + statistics.sum[0] * inverseCount),
+		float(statistics.reference[1] + statistics.sum[1] * inverseCount),
+		float(statistics.reference[2] + statistics.sum[2] * inverseCount),
+		1.f};
+	return Vector4(result);
+}
+
+/*!
+* Computes the (population) covariance of the accumulated points: E[(p - mean)(p - mean)^T]
+*/
+void PointCloud::covariance(const Statistics &statistics, SymmetricMatrix3 &result)
+{
+	if ( statistics.count == 0 )
+	{
+		result.xx = result.yy = result.zz = result.xy = result.xz = result.yz = 0.0;
+		return;
+	}
+
+	double inverseCount = 1.0 / double(statistics.count);
+	const double *sum = statistics.sum;
+	result.xx = (statistics.sumSq.xx - sum[0] * sum[0] * inverseCount) * inverseCount;
+	result.yy = (statistics.sumSq.yy - sum[1] * sum[1] * inverseCount) * inverseCount;
+	result.zz = (statistics.sumSq.zz - sum[2] * sum[2] * inverseCount) * inverseCount;
+	result.xy = (statistics.sumSq.xy - sum[0] * sum[1] * inverseCount) * inverseCount;
+	result.xz = (statistics.sumSq.xz - sum[0] * sum[2] * inverseCount) * inverseCount;
+	result.yz = (statistics.sumSq.yz - sum[1] * sum[2] * inverseCount) * inverseCount;
+}
+
+struct StatisticsContext
+{
+	const Vector4::Container *points;
+	size_t count;
+	PointCloud::Statistics *partials;
+};
+
+static void statisticsKernel(void *context, size_t, size_t beginBlock, size_t endBlock)
+{
+	StatisticsContext *data = static_cast<StatisticsContext*>(context);
+	for ( size_t block = beginBlock; block < endBlock; block++ )
+	{
+		size_t begin = block * PointCloud::BLOCK_SIZE;
+		size_t length = data->count - begin < PointCloud::BLOCK_SIZE ? data->count - begin : PointCloud::BLOCK_SIZE;
+		PointCloud::accumulate(data->points + begin, length, data->points[0], data->partials[block]);
+	}
+}
+
+/*!
+* Reduces the whole cloud in one pass.  Blocks are spread over taskCount threads and merged in block order, so the
+* result does not depend on taskCount.
+* \param points the points to reduce
+* \param count the number of points
+* \param result receives the statistics, count is 0 for an empty cloud
+* \param taskCount the number of threads to use
+*/
+void PointCloud::statistics(const Vector4::Container *points, size_t count, Statistics &result, size_t taskCount)
+{
+	PATRICKMATH_TIME(POINT_CLOUD);
+	result.count = 0;
+	if ( count == 0 )
+	{
+		return;
+	}
+
+	size_t blockCount = (count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	StatisticsContext context = {points, count, new Statistics [blockCount]};
+	ParallelFor::run(statisticsKernel, &context, blockCount, taskCount);
+
+	result = context.partials[0];
+	for ( size_t block = 1; block < blockCount; block++ )
+	{
+		merge(result, context.partials[block]);
+	}
+	delete [] context.partials;
+}
+
+struct BoundsContext
+{
+	const Vector4::Container *points;
+	size_t count;
+	BoundsPartial *partials;
+};
+
+static void boundsKernel(void *context, size_t, size_t beginBlock, size_t endBlock)
+{
+	BoundsContext *data = static_cast<BoundsContext*>(context);
+	for ( size_t block = beginBlock; block < endBlock; block++ )
+	{
+		size_t begin = block * PointCloud::BLOCK_SIZE;
+		size_t end = begin + PointCloud::BLOCK_SIZE < data->count ? begin + PointCloud::BLOCK_SIZE : data->count;
+
+		// two independent chains so consecutive min/max do not wait on each other
+		__m128 min0, max0, min1, max1;
+		initializeBounds(min0, max0);
+		initializeBounds(min1, max1);
+		size_t i = begin;
+		for ( ; i + 2 <= end; i += 2 )
+		{
+			__m128 r0 = _mm_load_ps(data->points[i].elements);
+			__m128 r1 = _mm_load_ps(data->points[i + 1].elements);
+			min0 = _mm_min_ps(min0, r0);
+			max0 = _mm_max_ps(max0, r0);
+			min1 = _mm_min_ps(min1, r1);
+			max1 = _mm_max_ps(max1, r1);
+		}
+		if ( i < end )
+		{
+			__m128 r0 = _mm_load_ps(data->points[i].elements);
+			min0 = _mm_min_ps(min0, r0);
+			max0 = _mm_max_ps(max0, r0);
+		}
+
+		_mm_storeu_ps(data->partials[block].minimum, _mm_min_ps(min0, min1));
+		_mm_storeu_ps(data->partials[block].maximum, _mm_max_ps(max0, max1));
+	}
+}
+
+/*!
+* Computes the axis aligned bounds of the cloud, all four components are reduced.  An empty cloud gives +inf/-inf.
+* \param points the points to bound
+* \param count the number of points
+* \param boundsMin receives the minimum corner
+* \param boundsMax receives the maximum corner
+* \param taskCount the number of threads to use
+*/
+void PointCloud::bounds(
+	const Vector4::Container *points, size_t count, Vector4 &boundsMin, Vector4 &boundsMax, size_t taskCount)
+{
+	PATRICKMATH_TIME(POINT_CLOUD);
+	__m128 minimum, maximum;
+	initializeBounds(minimum, maximum);
+
+	size_t blockCount = (count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	if ( blockCount > 0 )
+	{
+		BoundsContext context = {points, count, new BoundsPartial [blockCount]};
+		ParallelFor::run(boundsKernel, &context, blockCount, taskCount);
+		for ( size_t block = 0; block < blockCount; block++ )
+		{
+			minimum = _mm_min_ps(minimum, _mm_loadu_ps(context.partials[block].minimum));
+			maximum = _mm_max_ps(maximum, _mm_loadu_ps(context.partials[block].maximum));
+		}
+		delete [] context.partials;
+	}
+
+	boundsMin = Vector4(minimum);
+	boundsMax = Vector4(maximum);
+}
+
+/*!
+* \return the mean position of the cloud (w = 1)
+*/
+Vector4 PointCloud::centroid(const Vector4::Container *points, size_t count, size_t taskCount)
+{
+	Statistics result;
+	statistics(points, count, result, taskCount);
+	return mean(result);
+}
+
+/*!
+* Computes the mean and covariance of the cloud in a single pass
+* \param points the points to reduce
+* \param count the number of points
+* \param mean receives the mean position (w = 1)
+* \param result receives the covariance
+* \param taskCount the number of threads to use
+*/
+void PointCloud::covariance(
+	const Vector4::Container *points, size_t count, Vector4 &mean, SymmetricMatrix3 &result, size_t taskCount)
+{
+	Statistics reduced;
+	statistics(points, count, reduced, taskCount);
+	mean = PointCloud::mean(reduced);
+	covariance(reduced, result);
+}
+
+/*!
+* Eigen decomposition of a symmetric 3x3 matrix with cyclic Jacobi rotations.  Each rotation zeroes one off diagonal
+* term, three or four sweeps are enough for full double precision on covariance matrices and degenerate (repeated)
+* eigenvalues are handled without special cases.
+* \param matrix the matrix to decompose
+* \param eigenvalues receives the eigenvalues in decreasing order
+* \param eigenvectors receives the matching unit eigenvectors (w = 0), forming a right handed basis
+*/
+void PointCloud::eigenSymmetric(const SymmetricMatrix3 &matrix, double eigenvalues [3], Vector4 eigenvectors [3])
+{
+	double a [3][3] = {
+		{matrix.xx, matrix.xy, matrix.xz},
+		{matrix.xy, matrix.yy, matrix.yz},
+		{matrix.xz, matrix.yz, matrix.zz}};
+	double v [3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+	static const int pairs [3][2] = {{0, 1}, {0, 2}, {1, 2}};
+
+	for ( int sweep = 0; sweep < 32; sweep++ )
+	{
+		double offDiagonal = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+		double diagonal = a[0][0] * a[0][0] + a[1][1] * a[1][1] + a[2][2] * a[2][2];
+		if ( offDiagonal <= diagonal * 1.0e-30 || offDiagonal == 0.0 )
+		{
+			break;
+		}
+
+		for ( int pair = 0; pair < 3; pair++ )
+		{
+			int p = pairs[pair][0];
+			int q = pairs[pair][1];
+			if ( a[p][q] == 0.0 )
+			{
+				continue;
+			}
+
+			double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+			double t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+			double c = 1.0 / sqrt(t * t + 1.0);
+			double s = t * c;
+
+			for ( int k = 0; k < 3; k++ )
+			{
+				double akp = a[k][p], akq = a[k][q];
+				a[k][p] = c * akp - s * akq;
+				a[k][q] = s * akp + c * akq;
+			}
+			for ( int k = 0; k < 3; k++ )
+			{
+				double apk = a[p][k], aqk = a[q][k];
+				a[p][k] = c * apk - s * aqk;
+				a[q][k] = s * apk + c * aqk;
+			}
+			for ( int k = 0; k < 3; k++ )
+			{
+				double vkp = v[k][p], vkq = v[k][q];
+				v[k][p] = c * vkp - s * vkq;
+				v[k][q] = s * vkp + c * vkq;
+			}
+		}
+	}
+
+	// sort decreasing, the columns of v are the eigenvectors
+	int order [3] = {0, 1, 2};
+	for ( int i = 0; i < 2; i++ )
+	{
+		for ( int j = i + 1; j < 3; j++ )
+		{
+			if ( a[order[j]][order[j]] > a[order[i]][order[i]] )
+			{
+				int swap = order[i];
+				order[i] = order[j];
+				order[j] = swap;
+			}
+		}
+	}
+
+	for ( int i = 0; i < 3; i++ )
+	{
+		int column = order[i];
+		eigenvalues[i] = a[column][column];
+		Vector4::Container axis = {float(v[0][column]), float(v[1][column]), float(v[2][column]), 0.f};
+		eigenvectors[i] = Vector4(axis);
+	}
+	eigenvectors[2] = eigenvectors[0].crossProduct(eigenvectors[1]);
+}
+
+struct ProjectionContext
+{
+	const Vector4::Container *points;
+	size_t count;
+	__m128 origin;
+	__m128 axes [3];
+	BoundsPartial *partials;
+};
+
+static void projectionKernel(void *context, size_t, size_t beginBlock, size_t endBlock)
+{
+	ProjectionContext *data = static_cast<ProjectionContext*>(context);
+	__m128 axisComponents [3][3];
+	for ( int axis = 0; axis < 3; axis++ )
+	{
+		axisComponents[axis][0] = _mm_shuffle_ps(data->axes[axis], data->axes[axis], _MM_SHUFFLE(0,0,0,0));
+		axisComponents[axis][1] = _mm_shuffle_ps(data->axes[axis], data->axes[axis], _MM_SHUFFLE(1,1,1,1));
+		axisComponents[axis][2] = _mm_shuffle_ps(data->axes[axis], data->axes[axis], _MM_SHUFFLE(2,2,2,2));
+	}
+	__m128 originX = _mm_shuffle_ps(data->origin, data->origin, _MM_SHUFFLE(0,0,0,0));
+	__m128 originY = _mm_shuffle_ps(data->origin, data->origin, _MM_SHUFFLE(1,1,1,1));
+	__m128 originZ = _mm_shuffle_ps(data->origin, data->origin, _MM_SHUFFLE(2,2,2,2));
+
+	for ( size_t block = beginBlock; block < endBlock; block++ )
+	{
+		size_t begin = block * PointCloud::BLOCK_SIZE;
+		size_t end = begin + PointCloud::BLOCK_SIZE < data->count ? begin + PointCloud::BLOCK_SIZE : data->count;
+
+		__m128 minimum [3], maximum [3];
+		for ( int axis = 0; axis < 3; axis++ )
+		{
+			initializeBounds(minimum[axis], maximum[axis]);
+		}
+
+		// padding repeats the first point of the block, which is already inside the extents
+		__m128 padding = _mm_load_ps(data->points[begin].elements);
+		for ( size_t i = begin; i < end; i += 4 )
+		{
+			__m128 rows [4];
+			loadGroup(data->points, i, end, padding, rows);
+			_MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+			__m128 dx = _mm_sub_ps(rows[0], originX);
+			__m128 dy = _mm_sub_ps(rows[1], originY);
+			__m128 dz = _mm_sub_ps(rows[2], originZ);
+
+			for ( int axis = 0; axis < 3; axis++ )
+			{
+				__m128 projection = _mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(dx, axisComponents[axis][0]), _mm_mul_ps(dy, axisComponents[axis][1])),
+					_mm_mul_ps(dz, axisComponents[axis][2]));
+				minimum[axis] = _mm_min_ps(minimum[axis], projection);
+				maximum[axis] = _mm_max_ps(maximum[axis], projection);
+			}
+		}
+
+		// fold the lanes once per block
+		for ( int axis = 0; axis < 3; axis++ )
+		{
+			__m128 lo = minimum[axis], hi = maximum[axis];
+			lo = _mm_min_ps(lo, _mm_shuffle_ps(lo, lo, _MM_SHUFFLE(1,0,3,2)));
+			lo = _mm_min_ps(lo, _mm_shuffle_ps(lo, lo, _MM_SHUFFLE(2,3,0,1)));
+			hi = _mm_max_ps(hi, _mm_shuffle_ps(hi, hi, _MM_SHUFFLE(1,0,3,2)));
+			hi = _mm_max_ps(hi, _mm_shuffle_ps(hi, hi, _MM_SHUFFLE(2,3,0,1)));
+			_mm_store_ss(&data->partials[block].minimum[axis], lo);
+			_mm_store_ss(&data->partials[block].maximum[axis], hi);
+		}
+	}
+}
+
+/*!
+* Fits an oriented bounding box along the principal axes of the cloud.  The statistics pass gives the axes, a second
+* pass projects the points onto them for the extents.
+* \param points the points to bound
+* \param count the number of points
+* \param result receives the box, axes are unit length and right handed, halfExtents has w = 0
+* \param taskCount the number of threads to use
+*/
+void PointCloud::orientedBox(const Vector4::Container *points, size_t count, OrientedBox &result, size_t taskCount)
+{
+	if ( count == 0 )
+	{
+		result.center = Vector4::ZERO;
+		result.axes[0] = Vector4::UNIT_X;
+		result.axes[1] = Vector4::UNIT_Y;
+		result.axes[2] = Vector4::UNIT_Z;
+		result.halfExtents = Vector4::ZERO;
+		return;
+	}
+
+	Vector4 center;
+	SymmetricMatrix3 matrix;
+	double eigenvalues [3];
+	covariance(points, count, center, matrix, taskCount);
+	eigenSymmetric(matrix, eigenvalues, result.axes);
+
+	size_t blockCount = (count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	ProjectionContext context;
+	context.points = points;
+	context.count = count;
+	context.origin = center;
+	for ( int axis = 0; axis < 3; axis++ )
+	{
+		context.axes[axis] = result.axes[axis];
+	}
+	context.partials = new BoundsPartial [blockCount];
+	ParallelFor::run(projectionKernel, &context, blockCount, taskCount);
+
+	float minimum [3], maximum [3];
+	for ( int axis = 0; axis < 3; axis++ )
+	{
+		minimum[axis] = context.partials[0].minimum[axis];
+		maximum[axis] = context.partials[0].maximum[axis];
+		for ( size_t block = 1; block < blockCount; block++ )
+		{
+			minimum[axis] = context.partials[block].minimum[axis] < minimum[axis] ?
+				context.partials[block].minimum[axis] : minimum[axis];
+			maximum[axis] = context.partials[block].maximum[axis] > maximum[axis] ?
+				context.partials[block].maximum[axis] : maximum[axis];
+		}
+	}
+	delete [] context.partials;
+
+	Vector4 boxCenter = center;
+	for ( int axis = 0; axis < 3; axis++ )
+	{
+		float middle = 0.5f * (minimum[axis] + maximum[axis]);
+		boxCenter = boxCenter + Vector4(_mm_mul_ps(result.axes[axis], _mm_set1_ps(middle)));
+	}
+	Vector4::Container halfExtents = {
+		0.5f * (maximum[0] - minimum[0]), 0.5f * (maximum[1] - minimum[1]), 0.5f * (maximum[2] - minimum[2]), 0.f};
+	result.center = boxCenter;
+	result.halfExtents = Vector4(halfExtents);
+}
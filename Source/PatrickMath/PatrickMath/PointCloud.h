@@ -0,0 +1,100 @@
+/*!
+* \file PointCloud.h
+* \author Patrick Martin
+* \date 2010
+* \brief Reductions over arrays of Vector4 points: bounds, centroid, covariance, principal axes and oriented boxes
+*
+* The reductions read each point once.  Points are transposed four at a time so that the sums are accumulated one
+* component per register instead of doing a horizontal add per point (the way Vector4::dotProduct would), and the four
+* lanes are only folded together when a block is finished.
+*
+* For the parallel versions the points are cut into fixed blocks of BLOCK_SIZE points.  Every block produces its own
+* partial result and the partials are merged in block order on the calling thread, so the result is bit for bit the
+* same whatever taskCount is.
+*
+* This project is governed by the MIT licence:
+*
+*  Copyright (c) 2010 Patrick Martin
+*
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+*
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include "Vector4.h"
+
+class PointCloud
+{
+public:
+	/*!
+	* The six unique terms of a symmetric 3x3 matrix
+	*/
+	struct SymmetricMatrix3
+	{
+		double xx, yy, zz;
+		double xy, xz, yz;
+	};
+
+	/*!
+	* A mergeable partial result.  Sums are taken relative to a reference point (the first point of the whole cloud)
+	* so that clouds far from the origin do not lose their precision to cancellation.
+	*/
+	struct Statistics
+	{
+		float boundsMin [4];
+		float boundsMax [4];
+		float reference [4];
+		double sum [3];
+		SymmetricMatrix3 sumSq;
+		size_t count;
+	};
+
+	struct OrientedBox
+	{
+		Vector4 center;
+		Vector4 axes [3];
+		Vector4 halfExtents;
+	};
+
+	static const size_t BLOCK_SIZE = 4096;
+
+	// whole cloud, split over taskCount threads
+	static void bounds(
+		const Vector4::Container *points, size_t count, Vector4 &boundsMin, Vector4 &boundsMax, size_t taskCount = 1);
+	static void statistics(const Vector4::Container *points, size_t count, Statistics &result, size_t taskCount = 1);
+	static Vector4 centroid(const Vector4::Container *points, size_t count, size_t taskCount = 1);
+	static void covariance(
+		const Vector4::Container *points, size_t count, Vector4 &mean, SymmetricMatrix3 &result, size_t taskCount = 1);
+	static void orientedBox(const Vector4::Container *points, size_t count, OrientedBox &result, size_t taskCount = 1);
+
+	// building blocks for callers with their own job system
+	static void accumulate(
+		const Vector4::Container *points, size_t count, const Vector4::Container &reference, Statistics &result);
+	static void merge(Statistics &result, const Statistics &partial);
+	static Vector4 mean(const Statistics &statistics);
+	static void covariance(const Statistics &statistics, SymmetricMatrix3 &result);
+
+	// principal axes
+	static void eigenSymmetric(const SymmetricMatrix3 &matrix, double eigenvalues [3], Vector4 eigenvectors [3]);
+};
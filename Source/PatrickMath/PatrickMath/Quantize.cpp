@@ -0,0 +1,236 @@
+/*!
+* \file Quantize.cpp
+* \author Patrick Martin
+* \date 2010
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "stdafx.h"
+#include "Quantize.h"
+#include "Soa.h"
+
+#include <math.h>
+
+// the largest float below 2^31, anything larger overflows _mm_cvtps_epi32
+static const float MAX_FIXED_POINT = 2147483520.f;
+
+/*!
+* Converts floats to fixed point: round(value * 2^fractionBits), saturating instead of wrapping when out of range.
+* \param source the floats to convert, no alignment required
+* \param destination the fixed point values, no alignment required
+* \param count the number of values
+* \param fractionBits the number of bits after the binary point
+*/
+void Quantize::toFixedPoint(const float *source, int32_t *destination, size_t count, int32_t fractionBits)
+{
+	PATRICKMATH_TIME(QUANTIZE);
+	const __m128 scale = _mm_set1_ps(ldexpf(1.f, fractionBits));
+	const __m128 upper = _mm_set1_ps(MAX_FIXED_POINT);
+	const __m128 lower = _mm_set1_ps(-MAX_FIXED_POINT - 128.f); // exactly -2^31
+
+	size_t i = 0;
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		__m128 scaled = _mm_mul_ps(_mm_loadu_ps(source + i), scale);
+		scaled = _mm_max_ps(_mm_min_ps(scaled, upper), lower);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), _mm_cvtps_epi32(scaled));
+	}
+
+	for ( ; i < count; i++ )
+	{
+		__m128 scaled = _mm_mul_ss(_mm_load_ss(source + i), scale);
+		scaled = _mm_max_ss(_mm_min_ss(scaled, upper), lower);
+		destination[i] = _mm_cvtss_si32(scaled);
+	}
+}
+
+/*!
+* Converts fixed point back to floats: value / 2^fractionBits.  Values with more than 24 significant bits round.
+* \param source the fixed point values, no alignment required
+* \param destination the floats, no alignment required
+* \param count the number of values
+* \param fractionBits the number of bits after the binary point
+*/
+void Quantize::fromFixedPoint(const int32_t *source, float *destination, size_t count, int32_t fractionBits)
+{
+	PATRICKMATH_TIME(QUANTIZE);
+	const __m128 scale = _mm_set1_ps(ldexpf(1.f, -fractionBits));
+
+	size_t i = 0;
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		__m128i fixed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+		_mm_storeu_ps(destination + i, _mm_mul_ps(_mm_cvtepi32_ps(fixed), scale));
+	}
+
+	for ( ; i < count; i++ )
+	{
+		_mm_store_ss(destination + i, _mm_mul_ss(_mm_cvtsi32_ss(_mm_setzero_ps(), source[i]), scale));
+	}
+}
+
+/*!
+* Quantizes positions onto a 2^bitsPerAxis grid spanning [boundsMin, boundsMax].  Positions outside the bounds are
+* clamped to the border cells, w of every cell is 0.
+* \param positions the positions to quantize
+* \param boundsMin the minimum corner of the grid
+* \param boundsMax the maximum corner of the grid
+* \param bitsPerAxis the resolution of each axis in bits
+* \param cells one x, y, z, 0 cell per position
+* \param count the number of positions
+*/
+void Quantize::toGrid(
+	const Vector4::Container *positions, const Vector4 &boundsMin, const Vector4 &boundsMax, int32_t bitsPerAxis,
+	XmmInt::Container *cells, size_t count)
+{
+	PATRICKMATH_TIME(QUANTIZE);
+	const __m128 scale = gridScale(boundsMin, boundsMax, bitsPerAxis);
+	const __m128 minimum = boundsMin;
+	const __m128i maxCell = _mm_set_epi32(0, (1 << bitsPerAxis) - 1, (1 << bitsPerAxis) - 1, (1 << bitsPerAxis) - 1);
+
+	for ( size_t i = 0; i < count; i++ )
+	{
+		__m128 position = _mm_load_ps(positions[i].elements);
+		toGridAxis(position, minimum, scale, maxCell).get(cells[i]);
+	}
+}
+
+/*!
+* Computes 30 bit morton codes for positions within [boundsMin, boundsMax].  Positions outside the bounds are clamped.
+* \param positions the positions to encode
+* \param boundsMin the minimum corner of the encoded volume
+* \param boundsMax the maximum corner of the encoded volume
+* \param codes one code per position, no alignment required
+* \param count the number of positions
+*/
+void Quantize::mortonEncode30(
+	const Vector4::Container *positions, const Vector4 &boundsMin, const Vector4 &boundsMax, uint32_t *codes,
+	size_t count)
+{
+	PATRICKMATH_TIME(QUANTIZE);
+	const __m128 scale = gridScale(boundsMin, boundsMax, 10);
+	const __m128 minimum = boundsMin;
+	const XmmFloat scaleX = _mm_shuffle_ps(scale, scale, _MM_SHUFFLE(0,0,0,0));
+	const XmmFloat scaleY = _mm_shuffle_ps(scale, scale, _MM_SHUFFLE(1,1,1,1));
+	const XmmFloat scaleZ = _mm_shuffle_ps(scale, scale, _MM_SHUFFLE(2,2,2,2));
+	const XmmFloat minX = _mm_shuffle_ps(minimum, minimum, _MM_SHUFFLE(0,0,0,0));
+	const XmmFloat minY = _mm_shuffle_ps(minimum, minimum, _MM_SHUFFLE(1,1,1,1));
+	const XmmFloat minZ = _mm_shuffle_ps(minimum, minimum, _MM_SHUFFLE(2,2,2,2));
+	const XmmInt maxCell(1023);
+
+	for ( size_t i = 0; i < count; i += 4 )
+	{
+		__m128 v [4];
+		Soa::loadTransposed(positions, i, count, v);
+		XmmInt code = mortonCombine3(toGridAxis(v[0], minX, scaleX, maxCell), toGridAxis(v[1], minY, scaleY, maxCell),
+			toGridAxis(v[2], minZ, scaleZ, maxCell));
+		Soa::storeLanes(codes, i, count, code);
+	}
+}
+
+/*!
+* Computes 63 bit morton codes for positions within [boundsMin, boundsMax].  Positions outside the bounds are clamped.
+* The grid coordinates are computed four at a time like mortonEncode30 and then widened to 64 bit lanes two at a time.
+* \param positions the positions to encode
+* \param boundsMin the minimum corner of the encoded volume
+* \param boundsMax the maximum corner of the encoded volume
+* \param codes one code per position, no alignment required
+* \param count the number of positions
+*/
+void Quantize::mortonEncode63(
+	const Vector4::Container *positions, const Vector4 &boundsMin, const Vector4 &boundsMax, uint64_t *codes,
+	size_t count)
+{
+	PATRICKMATH_TIME(QUANTIZE);
+	const __m128 scale = gridScale(boundsMin, boundsMax, 21);
+	const __m128 minimum = boundsMin;
+	const XmmFloat scaleX = _mm_shuffle_ps(scale, scale, _MM_SHUFFLE(0,0,0,0));
+	const XmmFloat scaleY = _mm_shuffle_ps(scale, scale, _MM_SHUFFLE(1,1,1,1));
+	const XmmFloat scaleZ = _mm_shuffle_ps(scale, scale, _MM_SHUFFLE(2,2,2,2));
+	const XmmFloat minX = _mm_shuffle_ps(minimum, minimum, _MM_SHUFFLE(0,0,0,0));
+	const XmmFloat minY = _mm_shuffle_ps(minimum, minimum, _MM_SHUFFLE(1,1,1,1));
+	const XmmFloat minZ = _mm_shuffle_ps(minimum, minimum, _MM_SHUFFLE(2,2,2,2));
+	const XmmInt maxCell((1 << 21) - 1);
+	const __m128i zero = _mm_setzero_si128();
+
+	for ( size_t i = 0; i < count; i += 4 )
+	{
+		__m128 v [4];
+		Soa::loadTransposed(positions, i, count, v);
+		__m128i cellX = toGridAxis(v[0], minX, scaleX, maxCell);
+		__m128i cellY = toGridAxis(v[1], minY, scaleY, maxCell);
+		__m128i cellZ = toGridAxis(v[2], minZ, scaleZ, maxCell);
+
+		// lanes 0 and 1, then 2 and 3, zero extended to 64 bits
+		__m128i low = mortonCombine3Wide(
+			_mm_unpacklo_epi32(cellX, zero), _mm_unpacklo_epi32(cellY, zero), _mm_unpacklo_epi32(cellZ, zero));
+		__m128i high = mortonCombine3Wide(
+			_mm_unpackhi_epi32(cellX, zero), _mm_unpackhi_epi32(cellY, zero), _mm_unpackhi_epi32(cellZ, zero));
+		if ( i + 4 <= count )
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(codes + i), low);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(codes + i + 2), high);
+		}
+		else
+		{
+			__declspec(align(16)) uint64_t lanes [4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(lanes), low);
+			_mm_store_si128(reinterpret_cast<__m128i*>(lanes + 2), high);
+			for ( size_t lane = 0; i + lane < count; lane++ )
+			{
+				codes[i + lane] = lanes[lane];
+			}
+		}
+	}
+}
+
+/*!
+* Hashes the grid cell of every position with the usual large prime xor hash (Teschner et al.), suitable for spatial
+* hash tables where the world is unbounded.
+* \param positions the positions to hash
+* \param cellSize the edge length of a cell in every lane
+* \param hashes one hash per position, no alignment required
+* \param count the number of positions
+*/
+void Quantize::hashGridCells(const Vector4::Container *positions, const XmmFloat &cellSize, uint32_t *hashes, size_t count)
+{
+	PATRICKMATH_TIME(QUANTIZE);
+	const __m128 inverseCellSize = _mm_div_ps(_mm_set1_ps(1.f), cellSize);
+	const XmmInt primeX(73856093);
+	const XmmInt primeY(19349663);
+	const XmmInt primeZ(83492791);
+
+	for ( size_t i = 0; i < count; i += 4 )
+	{
+		__m128 v [4];
+		Soa::loadTransposed(positions, i, count, v);
+		XmmInt cellX = XmmInt::floor(_mm_mul_ps(v[0], inverseCellSize));
+		XmmInt cellY = XmmInt::floor(_mm_mul_ps(v[1], inverseCellSize));
+		XmmInt cellZ = XmmInt::floor(_mm_mul_ps(v[2], inverseCellSize));
+		Soa::storeLanes(hashes, i, count, (cellX * primeX) ^ (cellY * primeY) ^ (cellZ * primeZ));
+	}
+}
@@ -0,0 +1,153 @@
+/*!
+* \file Quantize.h
+* \author Patrick Martin
+* \date 2010
+* \brief Batch conversions from float data to integer grids, fixed point values, morton codes and cell hashes
+*
+* Everything here works four elements per register: Vector4 positions are transposed into x, y and z registers so that
+* each lane of an XmmInt belongs to a different position.  The batch functions take plain arrays and handle any
+* count, the inline building blocks are exposed for callers that already hold transposed data.
+*
+* This project is governed by the MIT licence:
+*
+*  Copyright (c) 2010 Patrick Martin
+*
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+*
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Vector4.h"
+#include "XmmFloat.h"
+#include "XmmInt.h"
+
+class Quantize
+{
+public:
+	// fixed point, value * 2^fractionBits rounded to nearest and saturated to int32 range
+	static void toFixedPoint(const float *source, int32_t *destination, size_t count, int32_t fractionBits);
+	static void fromFixedPoint(const int32_t *source, float *destination, size_t count, int32_t fractionBits);
+
+	// grid cells within [boundsMin, boundsMax], bitsPerAxis must be between 1 and 23
+	static void toGrid(
+		const Vector4::Container *positions, const Vector4 &boundsMin, const Vector4 &boundsMax, int32_t bitsPerAxis,
+		XmmInt::Container *cells, size_t count);
+
+	// 30 bit morton codes, 10 bits per axis within [boundsMin, boundsMax]
+	static void mortonEncode30(
+		const Vector4::Container *positions, const Vector4 &boundsMin, const Vector4 &boundsMax, uint32_t *codes,
+		size_t count);
+
+	// 63 bit morton codes, 21 bits per axis within [boundsMin, boundsMax]
+	static void mortonEncode63(
+		const Vector4::Container *positions, const Vector4 &boundsMin, const Vector4 &boundsMax, uint64_t *codes,
+		size_t count);
+
+	// spatial hash of the unbounded grid with cubic cells of cellSize
+	static void hashGridCells(const Vector4::Container *positions, const XmmFloat &cellSize, uint32_t *hashes, size_t count);
+
+	// building blocks
+	static XmmFloat gridScale(const Vector4 &boundsMin, const Vector4 &boundsMax, int32_t bitsPerAxis);
+	static XmmInt toGridAxis(const XmmFloat &value, const XmmFloat &axisMin, const XmmFloat &axisScale, const XmmInt &maxCell);
+	static XmmInt spreadBits3(const XmmInt &value);
+	static XmmInt mortonCombine3(const XmmInt &x, const XmmInt &y, const XmmInt &z);
+	static XmmInt spreadBits3Wide(const XmmInt &value);
+	static XmmInt mortonCombine3Wide(const XmmInt &x, const XmmInt &y, const XmmInt &z);
+};
+
+/*!
+* Computes the per axis scale that maps [boundsMin, boundsMax] onto 2^bitsPerAxis cells.  Axes with no extent get a
+* scale of 0 so every position lands in cell 0 instead of dividing by zero.
+* \return (cells / extent) for x, y, z and w
+*/
+inline XmmFloat Quantize::gridScale(const Vector4 &boundsMin, const Vector4 &boundsMax, int32_t bitsPerAxis)
+{
+	__m128 extent = _mm_sub_ps(boundsMax, boundsMin);
+	__m128 cells = _mm_cvtepi32_ps(_mm_set1_epi32(1 << bitsPerAxis));
+	__m128 hasExtent = _mm_cmpgt_ps(extent, _mm_setzero_ps());
+	return _mm_and_ps(_mm_div_ps(cells, extent), hasExtent);
+}
+
+/*!
+* Quantizes four values of one axis onto the grid, clamping to [0, maxCell]
+* \param value four coordinates of the same axis
+* \param axisMin the minimum bound of this axis in every lane
+* \param axisScale the gridScale of this axis in every lane
+* \param maxCell (2^bitsPerAxis - 1) in every lane
+*/
+inline XmmInt Quantize::toGridAxis(
+	const XmmFloat &value, const XmmFloat &axisMin, const XmmFloat &axisScale, const XmmInt &maxCell)
+{
+	__m128 scaled = _mm_mul_ps(_mm_sub_ps(value, axisMin), axisScale);
+	scaled = _mm_max_ps(scaled, _mm_setzero_ps()); // also clears NaN
+	return XmmInt::min(XmmInt::truncate(scaled), maxCell);
+}
+
+/*!
+* Spreads the low 10 bits of every lane so that there are two zero bits between each of them
+*/
+inline XmmInt Quantize::spreadBits3(const XmmInt &value)
+{
+	__m128i x = _mm_and_si128(value, _mm_set1_epi32(0x000003FF));
+	x = _mm_and_si128(_mm_or_si128(x, _mm_slli_epi32(x, 16)), _mm_set1_epi32(0x030000FF));
+	x = _mm_and_si128(_mm_or_si128(x, _mm_slli_epi32(x, 8)), _mm_set1_epi32(0x0300F00F));
+	x = _mm_and_si128(_mm_or_si128(x, _mm_slli_epi32(x, 4)), _mm_set1_epi32(0x030C30C3));
+	x = _mm_and_si128(_mm_or_si128(x, _mm_slli_epi32(x, 2)), _mm_set1_epi32(0x09249249));
+	return x;
+}
+
+/*!
+* Interleaves three 10 bit grid coordinates into a 30 bit morton code, x in the lowest bit
+*/
+inline XmmInt Quantize::mortonCombine3(const XmmInt &x, const XmmInt &y, const XmmInt &z)
+{
+	__m128i code = spreadBits3(x);
+	code = _mm_or_si128(code, _mm_slli_epi32(spreadBits3(y), 1));
+	return _mm_or_si128(code, _mm_slli_epi32(spreadBits3(z), 2));
+}
+
+/*!
+* Spreads the low 21 bits of both 64 bit lanes so that there are two zero bits between each of them
+*/
+inline XmmInt Quantize::spreadBits3Wide(const XmmInt &value)
+{
+	__m128i x = _mm_and_si128(value, _mm_set_epi32(0, 0x001FFFFF, 0, 0x001FFFFF));
+	x = _mm_and_si128(_mm_or_si128(x, _mm_slli_epi64(x, 32)), _mm_set_epi32(0x001F0000, 0x0000FFFF, 0x001F0000, 0x0000FFFF));
+	x = _mm_and_si128(_mm_or_si128(x, _mm_slli_epi64(x, 16)), _mm_set_epi32(0x001F0000, 0xFF0000FF, 0x001F0000, 0xFF0000FF));
+	x = _mm_and_si128(_mm_or_si128(x, _mm_slli_epi64(x, 8)), _mm_set_epi32(0x100F00F0, 0x0F00F00F, 0x100F00F0, 0x0F00F00F));
+	x = _mm_and_si128(_mm_or_si128(x, _mm_slli_epi64(x, 4)), _mm_set_epi32(0x10C30C30, 0xC30C30C3, 0x10C30C30, 0xC30C30C3));
+	x = _mm_and_si128(_mm_or_si128(x, _mm_slli_epi64(x, 2)), _mm_set_epi32(0x12492492, 0x49249249, 0x12492492, 0x49249249));
+	return x;
+}
+
+/*!
+* Interleaves three 21 bit grid coordinates, one per 64 bit lane, into 63 bit morton codes, x in the lowest bit
+*/
+inline XmmInt Quantize::mortonCombine3Wide(const XmmInt &x, const XmmInt &y, const XmmInt &z)
+{
+	__m128i code = spreadBits3Wide(x);
+	code = _mm_or_si128(code, _mm_slli_epi64(spreadBits3Wide(y), 1));
+	return _mm_or_si128(code, _mm_slli_epi64(spreadBits3Wide(z), 2));
+}
@@ -1,8 +1,103 @@
+/*!
+* \file Quaternion.cpp
+* \author Patrick Martin
+* \date 2010
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
 #include "stdafx.h"
 #include "Quaternion.h"
 
+#include "ParallelFor.h"
+
 const Quaternion::Container identity = {0.f, 0.f, 0.f, 1.f};
 const Quaternion::Container zero = {0.f, 0.f, 0.f, 0.f};
 
-const Quaternion IDENTITY (identity);
-const Quaternion ZERO (zero);
+const Quaternion Quaternion::IDENTITY (identity);
+const Quaternion Quaternion::ZERO (zero);
+
+/*!
+* The operands of rotationBetweenBatch (from, to) or lookAtBatch (forward, up)
+*/
+struct OrientationBatch
+{
+	const Vector4::Container *first;
+	const Vector4::Container *second;
+	Quaternion::Container *rotations;
+};
+
+static void rotationBetweenKernel(void *context, size_t, size_t begin, size_t end)
+{
+	OrientationBatch &batch = *static_cast<OrientationBatch*>(context);
+	for ( size_t i = begin; i < end; i++ )
+	{
+		Quaternion::rotationBetween(batch.first[i], batch.second[i]).get(batch.rotations[i]);
+	}
+}
+
+static void lookAtKernel(void *context, size_t, size_t begin, size_t end)
+{
+	OrientationBatch &batch = *static_cast<OrientationBatch*>(context);
+	for ( size_t i = begin; i < end; i++ )
+	{
+		Quaternion::lookAt(batch.first[i], batch.second[i]).get(batch.rotations[i]);
+	}
+}
+
+/*!
+* Shortest arc rotations between pairs of directions, see rotationBetween
+* \param from the directions to rotate from, w = 0
+* \param to the directions to rotate to, w = 0
+* \param rotations receives the unit quaternions
+* \param count the number of pairs
+* \param taskCount the number of tasks the batch is split into
+*/
+void Quaternion::rotationBetweenBatch(
+	const Vector4::Container *from, const Vector4::Container *to, Container *rotations, size_t count,
+	size_t taskCount)
+{
+	PATRICKMATH_TIME(ORIENTATION_BATCH);
+	OrientationBatch batch = {from, to, rotations};
+	ParallelFor::run(rotationBetweenKernel, &batch, count, taskCount);
+}
+
+/*!
+* Look at orientations, see lookAt
+* \param forwards the directions to look along, w = 0
+* \param ups the up directions, w = 0
+* \param rotations receives the unit quaternions
+* \param count the number of orientations
+* \param taskCount the number of tasks the batch is split into
+*/
+void Quaternion::lookAtBatch(
+	const Vector4::Container *forwards, const Vector4::Container *ups, Container *rotations, size_t count,
+	size_t taskCount)
+{
+	PATRICKMATH_TIME(ORIENTATION_BATCH);
+	OrientationBatch batch = {forwards, ups, rotations};
+	ParallelFor::run(lookAtKernel, &batch, count, taskCount);
+}
@@ -1,9 +1,48 @@
+/*!
+* \file Quaternion.h
+* \author Patrick Martin
+* \date 2010
+* \brief Rotation quaternions (x, y, z, w) held in an SSE register
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
 #pragma once
 
 #include <limits>
+#include <xmmintrin.h>
+
+#include "Instrumentation.h"
 #include "Vector4.h"
 #include "XmmFloat.h"
 
+/*!
+* A rotation quaternion stored x, y, z, w with w the scalar part so that it lines up with a Vector4 (the vector part is
+* in the same lanes as a direction)
+*/
 __declspec(align(16))
 class Quaternion
 {
@@ -23,9 +62,15 @@ public:
 	Quaternion();
 	Quaternion(const Quaternion &copy);
 	Quaternion(const Container &container);
-	Quaternion(const Vector4 &axis, const XmmFloat &angle);Quaternion(const Vector4 &axis, const XmmFloat &cosAngle, const XmmFloat &sinAngle);
+	Quaternion(const __m128 &copy);
+	Quaternion(const Vector4 &axis, const XmmFloat &angle);
+	Quaternion(const Vector4 &axis, const XmmFloat &cosHalfAngle, const XmmFloat &sinHalfAngle);
 	Quaternion(const Vector4::Container &axis, float angle);
 
+	// assignment operators
+	Quaternion &operator=(const Quaternion &copy);
+
+	// named
 	XmmFloat dotProduct(const Quaternion &rhs) const;
 	Quaternion add(const Quaternion &rhs) const;
 	Quaternion subtract(const Quaternion &rhs) const;
@@ -36,18 +81,38 @@ public:
 	Quaternion safeNormalize(const XmmFloat &epsilon = XmmFloat::EPSILON) const;
 	Quaternion safeNormalizeSq(const XmmFloat &epsilonSq = XmmFloat::EPSILON_SQ) const;
 
-	// do not confuse with normalize, this is the "norm" (length in R^3)
+	// do not confuse with normalize, this is the "norm" (length in R^4)
 	XmmFloat norm() const;
 	XmmFloat normSq() const;
 
 	XmmBool isEqual(const Quaternion &rhs) const;
 	XmmBool isEqual(const Quaternion &rhs, const XmmFloat &epsilon) const;
 
+	// operators
+	inline Quaternion operator+ (const Quaternion &rhs) const	{return add(rhs);}
+	inline Quaternion operator- (const Quaternion &rhs) const	{return subtract(rhs);}
+	inline Quaternion operator* (const Quaternion &rhs) const	{return multiply(rhs);}
+	inline Quaternion operator/ (const Quaternion &rhs) const	{return divide(rhs);}
+	inline Quaternion operator~ () const						{return normalize();}
+	inline XmmBool operator==(const Quaternion &rhs) const		{return isEqual(rhs);}
+
 	Container &get(Container &destination) const;
 	Quaternion &set(const Container &source);
 
 	Vector4 applyRotation(const Vector4 &rhs) const;
 
+	// orientations, the directions need w = 0 but not unit length
+	static Quaternion rotationBetween(const Vector4 &from, const Vector4 &to);
+	static Quaternion lookAt(const Vector4 &forward, const Vector4 &up);
+	static void rotationBetweenBatch(
+		const Vector4::Container *from, const Vector4::Container *to, Container *rotations, size_t count,
+		size_t taskCount = 1);
+	static void lookAtBatch(
+		const Vector4::Container *forwards, const Vector4::Container *ups, Container *rotations, size_t count,
+		size_t taskCount = 1);
+
+	operator __m128 () const;
+
 public:
 	static const Quaternion IDENTITY;
 	static const Quaternion ZERO;
@@ -56,12 +121,319 @@ private:
 	__m128 elements;
 };
 
-Quaternion::Quaternion()
+/*!
+* Default constructor initializes to the identity rotation (not zero like Vector4, a zero quaternion is not a rotation)
+*/
+inline Quaternion::Quaternion()
 {
-	elements = IDENTITY.elements;
+	elements = _mm_set_ps(1.f, 0.f, 0.f, 0.f);
 }
 
-Quaternion::Quaternion(const Quaternion &copy)
+inline Quaternion::Quaternion(const Quaternion &copy)
 {
 	elements = copy.elements;
 }
+
+/*!
+* Initializes a Quaternion from a Container
+* \param container the x, y, z, w values to load
+*/
+inline Quaternion::Quaternion(const Container &container)
+{
+	set(container);
+}
+
+/*!
+* Initializes a Quaternion with a __m128 to use as the elements
+* \param copy the __m128 to copy, x, y, z, w
+*/
+inline Quaternion::Quaternion(const __m128 &copy)
+{
+	elements = copy;
+}
+
+/*!
+* Builds a rotation around an axis
+* \param axis the unit axis to rotate around (w = 0)
+* \param angle the angle in radians, in every lane
+*/
+inline Quaternion::Quaternion(const Vector4 &axis, const XmmFloat &angle)
+{
+	XmmFloat sinHalf, cosHalf;
+	XmmFloat(_mm_mul_ps(angle, _mm_set1_ps(0.5f))).sinCos(sinHalf, cosHalf);
+	*this = Quaternion(axis, cosHalf, sinHalf);
+}
+
+/*!
+* Builds a rotation around an axis when the sine and cosine of half the angle are already known (no trig)
+* \param axis the unit axis to rotate around (w = 0)
+* \param cosHalfAngle the cosine of half the rotation angle, in every lane
+* \param sinHalfAngle the sine of half the rotation angle, in every lane
+*/
+inline Quaternion::Quaternion(const Vector4 &axis, const XmmFloat &cosHalfAngle, const XmmFloat &sinHalfAngle)
+{
+	__m128 vector = _mm_mul_ps(axis, sinHalfAngle); // x*s, y*s, z*s, ?
+	__m128 scalar = _mm_shuffle_ps(vector, cosHalfAngle, _MM_SHUFFLE(0,0,2,2)); // z*s, z*s, c, c
+	elements = _mm_shuffle_ps(vector, scalar, _MM_SHUFFLE(2,0,1,0)); // x*s, y*s, z*s, c
+}
+
+/*!
+* Builds a rotation around an axis given as plain floats
+* \param axis the unit axis to rotate around, w is ignored
+* \param angle the angle in radians
+*/
+inline Quaternion::Quaternion(const Vector4::Container &axis, float angle)
+{
+	Vector4::Container direction = {axis.x, axis.y, axis.z, 0.f};
+	*this = Quaternion(Vector4(direction), XmmFloat(angle));
+}
+
+inline Quaternion &Quaternion::operator=(const Quaternion &copy)
+{
+	elements = copy.elements;
+	return *this;
+}
+
+/*!
+* Four element dot product, the cosine of half the angle between two unit quaternions
+* \param rhs the right hand side of the dot product
+* \return the dot product in every lane
+*/
+inline XmmFloat Quaternion::dotProduct(const Quaternion &rhs) const
+{
+	__m128 r0, r1;
+	r0 = _mm_mul_ps(elements, rhs.elements); // 0, 1, 2, 3
+	r1 = _mm_shuffle_ps(r0, r0, _MM_SHUFFLE(0,1,2,3)); // 3, 2, 1, 0
+	r0 = _mm_add_ps(r0, r1); // 0+3, 1+2, 1+2, 0+3
+	r1 = _mm_shuffle_ps(r0, r0, _MM_SHUFFLE(1,0,3,2)); // 1+2, 0+3, 0+3, 1+2
+	return _mm_add_ps(r0, r1);
+}
+
+inline Quaternion Quaternion::add(const Quaternion &rhs) const
+{
+	return Quaternion(_mm_add_ps(elements, rhs.elements));
+}
+
+inline Quaternion Quaternion::subtract(const Quaternion &rhs) const
+{
+	return Quaternion(_mm_sub_ps(elements, rhs.elements));
+}
+
+/*!
+* Hamilton product, the result applies rhs first and then this
+* \param rhs the right hand side of the product
+* \return this * rhs
+*/
+inline Quaternion Quaternion::multiply(const Quaternion &rhs) const
+{
+	PATRICKMATH_COUNT(QUATERNION_MULTIPLY);
+	const __m128 signX = _mm_castsi128_ps(_mm_set_epi32(0x80000000, 0, 0x80000000, 0)); // +, -, +, -
+	const __m128 signY = _mm_castsi128_ps(_mm_set_epi32(0x80000000, 0x80000000, 0, 0)); // +, +, -, -
+	const __m128 signZ = _mm_castsi128_ps(_mm_set_epi32(0x80000000, 0, 0, 0x80000000)); // -, +, +, -
+
+	__m128 x = _mm_shuffle_ps(elements, elements, _MM_SHUFFLE(0,0,0,0));
+	__m128 y = _mm_shuffle_ps(elements, elements, _MM_SHUFFLE(1,1,1,1));
+	__m128 z = _mm_shuffle_ps(elements, elements, _MM_SHUFFLE(2,2,2,2));
+	__m128 w = _mm_shuffle_ps(elements, elements, _MM_SHUFFLE(3,3,3,3));
+
+	__m128 result = _mm_mul_ps(w, rhs.elements); // w*x', w*y', w*z', w*w'
+	__m128 term = _mm_shuffle_ps(rhs.elements, rhs.elements, _MM_SHUFFLE(0,1,2,3)); // w', z', y', x'
+	result = _mm_add_ps(result, _mm_xor_ps(_mm_mul_ps(x, term), signX));
+	term = _mm_shuffle_ps(rhs.elements, rhs.elements, _MM_SHUFFLE(1,0,3,2)); // z', w', x', y'
+	result = _mm_add_ps(result, _mm_xor_ps(_mm_mul_ps(y, term), signY));
+	term = _mm_shuffle_ps(rhs.elements, rhs.elements, _MM_SHUFFLE(2,3,0,1)); // y', x', w', z'
+	result = _mm_add_ps(result, _mm_xor_ps(_mm_mul_ps(z, term), signZ));
+	return Quaternion(result);
+}
+
+/*!
+* Multiplies by the inverse of rhs, rhs does not need to be a unit quaternion
+* \param rhs the right hand side
+* \return this * rhs^-1
+*/
+inline Quaternion Quaternion::divide(const Quaternion &rhs) const
+{
+	Quaternion inverse = rhs.conjugate();
+	inverse.elements = _mm_div_ps(inverse.elements, rhs.normSq());
+	return multiply(inverse);
+}
+
+/*!
+* Negates the vector part, for a unit quaternion this is the inverse rotation
+* \return the conjugate
+*/
+inline Quaternion Quaternion::conjugate() const
+{
+	const __m128 sign = _mm_castsi128_ps(_mm_set_epi32(0, 0x80000000, 0x80000000, 0x80000000));
+	return Quaternion(_mm_xor_ps(elements, sign));
+}
+
+/*!
+* Normalizes without a divide by zero check
+* \return the unit quaternion
+*/
+inline Quaternion Quaternion::normalize() const
+{
+	PATRICKMATH_COUNT(QUATERNION_NORMALIZE);
+	return Quaternion(_mm_div_ps(elements, _mm_sqrt_ps(normSq())));
+}
+
+/*!
+* Normalizes with an epsilon check, see Vector4::safeNormalize
+* \param epsilon the smallest norm that still gets normalized
+* \return the unit quaternion or zero if the norm is not greater than epsilon
+*/
+inline Quaternion Quaternion::safeNormalize(const XmmFloat &epsilon) const
+{
+	PATRICKMATH_COUNT(QUATERNION_NORMALIZE);
+	XmmFloat length = norm();
+	XmmBool epsilonMask = length > epsilon;
+	return Quaternion(_mm_and_ps(_mm_div_ps(elements, length), epsilonMask));
+}
+
+/*!
+* Normalizes with an epsilon check done on the squared norm, see Vector4::safeNormalizeSq
+* \param epsilonSq the chosen epsilon squared
+* \return the unit quaternion or zero if the squared norm is not greater than epsilonSq
+*/
+inline Quaternion Quaternion::safeNormalizeSq(const XmmFloat &epsilonSq) const
+{
+	PATRICKMATH_COUNT(QUATERNION_NORMALIZE);
+	XmmFloat lengthSq = normSq();
+	XmmBool epsilonMask = lengthSq > epsilonSq;
+	return Quaternion(_mm_and_ps(_mm_div_ps(elements, _mm_sqrt_ps(lengthSq)), epsilonMask));
+}
+
+inline XmmFloat Quaternion::norm() const
+{
+	return _mm_sqrt_ps(normSq());
+}
+
+inline XmmFloat Quaternion::normSq() const
+{
+	return dotProduct(*this);
+}
+
+/*!
+* Exact comparison, note that q and -q are the same rotation but are not equal here
+* \param rhs the right hand side of the comparison
+* \return all raised if equal, all low otherwise
+*/
+inline XmmBool Quaternion::isEqual(const Quaternion &rhs) const
+{
+	__m128 compare = _mm_cmpeq_ps(elements, rhs.elements); // a, b, c, d
+	__m128 cmpSwap = _mm_shuffle_ps(compare, compare, _MM_SHUFFLE(1,0,3,2)); // c, d, a, b
+	compare = _mm_and_ps(compare, cmpSwap); // a&c, b&d, a&c, b&d
+	cmpSwap = _mm_shuffle_ps(compare, compare, _MM_SHUFFLE(0,1,2,3)); // b&d, a&c, b&d, a&c
+	return XmmBool(_mm_and_ps(compare, cmpSwap));
+}
+
+/*!
+* Comparison within epsilon, every element must be within epsilon
+* \param rhs the right hand side of the comparison
+* \param epsilon the epsilon for the comparison
+* \return all high if equal within epsilon, all bits low otherwise
+*/
+inline XmmBool Quaternion::isEqual(const Quaternion &rhs, const XmmFloat &epsilon) const
+{
+	__m128 diff = _mm_sub_ps(elements, rhs.elements);
+	__m128 absDiff = _mm_max_ps(diff, _mm_sub_ps(_mm_setzero_ps(), diff)); // abs = max (x, 0-x))
+	__m128 compare = _mm_cmple_ps(absDiff, epsilon);
+	__m128 cmpSwap = _mm_shuffle_ps(compare, compare, _MM_SHUFFLE(1,0,3,2));
+	compare = _mm_and_ps(compare, cmpSwap);
+	cmpSwap = _mm_shuffle_ps(compare, compare, _MM_SHUFFLE(0,1,2,3));
+	return XmmBool(_mm_and_ps(compare, cmpSwap));
+}
+
+inline Quaternion::Container &Quaternion::get(Quaternion::Container &destination) const
+{
+	PATRICKMATH_COUNT(QUATERNION_GET);
+	_mm_store_ps(destination.elements, elements);
+	return destination;
+}
+
+inline Quaternion &Quaternion::set(const Quaternion::Container &source)
+{
+	PATRICKMATH_COUNT(QUATERNION_SET);
+	elements = _mm_load_ps(source.elements);
+	return *this;
+}
+
+/*!
+* Rotates a Vector4 by this unit quaternion using v + w*t + u x t with t = 2 (u x v), u the vector part.  This is
+* cheaper than the full q v q* product and leaves w untouched, so points and directions both work.
+* \param rhs the vector or point to rotate
+* \return the rotated Vector4
+*/
+inline Vector4 Quaternion::applyRotation(const Vector4 &rhs) const
+{
+	PATRICKMATH_COUNT(QUATERNION_ROTATE);
+	const __m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	Vector4 u (_mm_and_ps(elements, xyzMask));
+	__m128 w = _mm_shuffle_ps(elements, elements, _MM_SHUFFLE(3,3,3,3));
+
+	Vector4 t = u.crossProduct(rhs);
+	t = Vector4(_mm_add_ps(t, t));
+	return rhs + Vector4(_mm_mul_ps(w, t)) + u.crossProduct(t);
+}
+
+/*!
+* The shortest arc rotation taking one direction onto another, built without trig from the half angle identity: (a x b,
+* |a||b| + a . b) normalized.  When the directions are opposite every axis perpendicular to from is equally short, the
+* one perpendicular to x (or to y if from is along x) is used.
+* \param from the direction to rotate from
+* \param to the direction to rotate to
+* \return the unit quaternion, the identity if either direction is zero
+*/
+inline Quaternion Quaternion::rotationBetween(const Vector4 &from, const Vector4 &to)
+{
+	const __m128 unitW = _mm_set_ps(1.f, 0.f, 0.f, 0.f);
+	__m128 lengths = _mm_sqrt_ps(_mm_mul_ps(from.dotProduct(from), to.dotProduct(to)));
+	__m128 w = _mm_add_ps(lengths, to.dotProduct(from));
+
+	// a perpendicular axis for the half turn, w of the cross products is always 0
+	Vector4 perpendicular = from.crossProduct(Vector4::UNIT_X);
+	XmmBool alongX = _mm_cmple_ps(
+		perpendicular.dotProduct(perpendicular), _mm_mul_ps(from.dotProduct(from), _mm_set1_ps(1.0e-6f)));
+	perpendicular = alongX.select(from.crossProduct(Vector4::UNIT_Y), perpendicular);
+
+	XmmBool opposite = _mm_cmple_ps(w, _mm_mul_ps(lengths, _mm_set1_ps(1.0e-6f)));
+	__m128 result = opposite.select(perpendicular, _mm_add_ps(from.crossProduct(to), _mm_mul_ps(w, unitW)));
+	XmmBool degenerate = _mm_cmple_ps(lengths, _mm_setzero_ps());
+	return Quaternion(degenerate.select(unitW, result)).normalize();
+}
+
+/*!
+* The orientation whose local +z points along forward and whose local +y is as close to up as possible.  The shortest
+* arc from +z to forward is followed by a twist about forward taking the rotated +y onto up with its forward component
+* removed, the twist again from the half angle identity, so there is no matrix or trig in between.
+* \param forward the direction to look along
+* \param up the direction local +y should lean towards, when it is parallel to forward only the shortest arc is used
+* \return the unit quaternion
+*/
+inline Quaternion Quaternion::lookAt(const Vector4 &forward, const Vector4 &up)
+{
+	const __m128 unitW = _mm_set_ps(1.f, 0.f, 0.f, 0.f);
+	Vector4 direction = forward.normalize();
+	Quaternion arc = rotationBetween(Vector4::UNIT_Z, direction);
+	Vector4 arcUp = arc.applyRotation(Vector4::UNIT_Y);
+	Vector4 targetUp = up - Vector4(_mm_mul_ps(direction, up.dotProduct(direction)));
+
+	// arcUp and targetUp are both perpendicular to direction, so the twist is about direction
+	__m128 cosine = arcUp.dotProduct(targetUp);
+	__m128 sine = arcUp.crossProduct(targetUp).dotProduct(direction);
+	__m128 length = _mm_sqrt_ps(targetUp.dotProduct(targetUp));
+	__m128 w = _mm_add_ps(length, cosine);
+	__m128 twist = _mm_add_ps(_mm_mul_ps(direction, sine), _mm_mul_ps(w, unitW));
+
+	XmmBool opposite = _mm_cmple_ps(w, _mm_mul_ps(length, _mm_set1_ps(1.0e-6f)));
+	twist = opposite.select(direction, twist);
+	XmmBool degenerate = _mm_cmple_ps(length, _mm_mul_ps(_mm_sqrt_ps(up.dotProduct(up)), _mm_set1_ps(1.0e-6f)));
+	twist = degenerate.select(unitW, twist);
+	return Quaternion(twist).normalize().multiply(arc);
+}
+
+inline Quaternion::operator __m128 () const
+{
+	return elements;
+}
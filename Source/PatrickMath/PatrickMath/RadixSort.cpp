@@ -0,0 +1,387 @@
+/*!
+* \file RadixSort.cpp
+* \author Patrick Martin
+* \date 2010
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "stdafx.h"
+#include "RadixSort.h"
+
+#include <emmintrin.h>
+#include <malloc.h>
+#include <string.h>
+
+#include "Instrumentation.h"
+#include "ParallelFor.h"
+#include "Quantize.h"
+
+/*!
+* One digit pass from the source to the destination arrays.  histograms holds one row of DIGIT_COUNT counters per task,
+* turned into write positions by the prefix sum between counting and scattering.
+*/
+struct RadixPass
+{
+	const uint64_t *sourceKeys;
+	const uint32_t *sourceValues;
+	uint64_t *destinationKeys;
+	uint32_t *destinationValues;
+	uint32_t *histograms;
+	int32_t shift;
+	uint64_t mask;
+};
+
+struct PackBatch
+{
+	uint32_t *keys;
+	uint32_t *values;
+	uint64_t *packed;
+};
+
+struct MortonBatch
+{
+	const Vector4::Container *positions;
+	const Vector4 *boundsMin;
+	const Vector4 *boundsMax;
+	uint32_t *order;
+	uint32_t *codes;
+	uint64_t *wideCodes;
+};
+
+struct ReorderBatch
+{
+	const uint32_t *order;
+	const char *source;
+	char *destination;
+	size_t elementSize;
+};
+
+static void histogramKernel(void *context, size_t taskIndex, size_t begin, size_t end)
+{
+	RadixPass *pass = static_cast<RadixPass*>(context);
+	uint32_t *histogram = pass->histograms + taskIndex * RadixSort::DIGIT_COUNT;
+	memset(histogram, 0, RadixSort::DIGIT_COUNT * sizeof(uint32_t));
+	for ( size_t i = begin; i < end; i++ )
+	{
+		histogram[size_t((pass->sourceKeys[i] >> pass->shift) & pass->mask)]++;
+	}
+}
+
+static void scatterKernel(void *context, size_t taskIndex, size_t begin, size_t end)
+{
+	RadixPass *pass = static_cast<RadixPass*>(context);
+	uint32_t *positions = pass->histograms + taskIndex * RadixSort::DIGIT_COUNT;
+	if ( pass->sourceValues != NULL )
+	{
+		for ( size_t i = begin; i < end; i++ )
+		{
+			uint64_t key = pass->sourceKeys[i];
+			uint32_t position = positions[size_t((key >> pass->shift) & pass->mask)]++;
+			pass->destinationKeys[position] = key;
+			pass->destinationValues[position] = pass->sourceValues[i];
+		}
+	}
+	else
+	{
+		for ( size_t i = begin; i < end; i++ )
+		{
+			uint64_t key = pass->sourceKeys[i];
+			pass->destinationKeys[positions[size_t((key >> pass->shift) & pass->mask)]++] = key;
+		}
+	}
+}
+
+static void copyBackKernel(void *context, size_t, size_t begin, size_t end)
+{
+	RadixPass *pass = static_cast<RadixPass*>(context);
+	memcpy(pass->destinationKeys + begin, pass->sourceKeys + begin, (end - begin) * sizeof(uint64_t));
+	if ( pass->sourceValues != NULL )
+	{
+		memcpy(pass->destinationValues + begin, pass->sourceValues + begin, (end - begin) * sizeof(uint32_t));
+	}
+}
+
+static void packKernel(void *context, size_t, size_t begin, size_t end)
+{
+	PackBatch *batch = static_cast<PackBatch*>(context);
+	for ( size_t i = begin; i < end; i++ )
+	{
+		batch->packed[i] = (uint64_t(batch->keys[i]) << 32) | (batch->values != NULL ? batch->values[i] : 0);
+	}
+}
+
+static void unpackKernel(void *context, size_t, size_t begin, size_t end)
+{
+	PackBatch *batch = static_cast<PackBatch*>(context);
+	for ( size_t i = begin; i < end; i++ )
+	{
+		batch->keys[i] = uint32_t(batch->packed[i] >> 32);
+	}
+	if ( batch->values != NULL )
+	{
+		for ( size_t i = begin; i < end; i++ )
+		{
+			batch->values[i] = uint32_t(batch->packed[i]);
+		}
+	}
+}
+
+static void mortonKernel(void *context, size_t, size_t begin, size_t end)
+{
+	MortonBatch *batch = static_cast<MortonBatch*>(context);
+	if ( batch->codes != NULL )
+	{
+		Quantize::mortonEncode30(batch->positions + begin, *batch->boundsMin, *batch->boundsMax, batch->codes + begin,
+			end - begin);
+	}
+	else
+	{
+		Quantize::mortonEncode63(batch->positions + begin, *batch->boundsMin, *batch->boundsMax, batch->wideCodes + begin,
+			end - begin);
+	}
+	for ( size_t i = begin; i < end; i++ )
+	{
+		batch->order[i] = uint32_t(i);
+	}
+}
+
+static void gatherKernel(void *context, size_t, size_t begin, size_t end)
+{
+	ReorderBatch *batch = static_cast<ReorderBatch*>(context);
+	const size_t elementSize = batch->elementSize;
+	if ( elementSize == sizeof(Vector4::Container) )
+	{
+		for ( size_t i = begin; i < end; i++ )
+		{
+			__m128 element = _mm_loadu_ps(reinterpret_cast<const float*>(batch->source + batch->order[i] * elementSize));
+			_mm_store_ps(reinterpret_cast<float*>(batch->destination + i * elementSize), element);
+		}
+	}
+	else
+	{
+		for ( size_t i = begin; i < end; i++ )
+		{
+			memcpy(batch->destination + i * elementSize, batch->source + batch->order[i] * elementSize, elementSize);
+		}
+	}
+}
+
+static void copyKernel(void *context, size_t, size_t begin, size_t end)
+{
+	ReorderBatch *batch = static_cast<ReorderBatch*>(context);
+	memcpy(batch->destination + begin * batch->elementSize, batch->source + begin * batch->elementSize,
+		(end - begin) * batch->elementSize);
+}
+
+/*!
+* \return taskCount clamped the same way ParallelFor::run clamps it, so per task arrays can be sized to match
+*/
+static size_t clampTaskCount(size_t count, size_t taskCount)
+{
+	taskCount = taskCount < count ? taskCount : count;
+	taskCount = taskCount < ParallelFor::MAX_TASKS ? taskCount : ParallelFor::MAX_TASKS;
+	return taskCount > 0 ? taskCount : 1;
+}
+
+/*!
+* Turns the per task digit counts into write positions, digit major so that equal digits stay in task order.
+* \return false if every key has the same digit, the pass would not move anything
+*/
+static bool prefixSum(uint32_t *histograms, size_t taskCount, size_t count)
+{
+	uint32_t offset = 0;
+	for ( size_t digit = 0; digit < RadixSort::DIGIT_COUNT; digit++ )
+	{
+		uint32_t digitCount = 0;
+		for ( size_t task = 0; task < taskCount; task++ )
+		{
+			uint32_t &counter = histograms[task * RadixSort::DIGIT_COUNT + digit];
+			uint32_t taskDigitCount = counter;
+			counter = offset + digitCount;
+			digitCount += taskDigitCount;
+		}
+		if ( digitCount == count )
+		{
+			return false;
+		}
+		offset += digitCount;
+	}
+	return true;
+}
+
+/*!
+* Sorts keys by bits [firstBit, lastBit), ping ponging between the arrays and the scratch arrays.  The result always
+* ends up back in keys and values.
+*/
+static void sortBits(uint64_t *keys, uint32_t *values, size_t count, int32_t firstBit, int32_t lastBit, size_t taskCount)
+{
+	taskCount = clampTaskCount(count, taskCount);
+	uint64_t *scratchKeys = new uint64_t [count];
+	uint32_t *scratchValues = values != NULL ? new uint32_t [count] : NULL;
+	uint32_t *histograms = new uint32_t [taskCount * RadixSort::DIGIT_COUNT];
+
+	RadixPass pass = {keys, values, scratchKeys, scratchValues, histograms, 0, 0};
+	for ( int32_t shift = firstBit; shift < lastBit; shift += RadixSort::DIGIT_BITS )
+	{
+		int32_t digitBits = lastBit - shift < RadixSort::DIGIT_BITS ? lastBit - shift : RadixSort::DIGIT_BITS;
+		pass.shift = shift;
+		pass.mask = (uint64_t(1) << digitBits) - 1;
+		ParallelFor::run(histogramKernel, &pass, count, taskCount);
+		if ( !prefixSum(histograms, taskCount, count) )
+		{
+			continue;
+		}
+		ParallelFor::run(scatterKernel, &pass, count, taskCount);
+
+		const uint64_t *sortedKeys = pass.destinationKeys;
+		const uint32_t *sortedValues = pass.destinationValues;
+		pass.destinationKeys = const_cast<uint64_t*>(pass.sourceKeys);
+		pass.destinationValues = const_cast<uint32_t*>(pass.sourceValues);
+		pass.sourceKeys = sortedKeys;
+		pass.sourceValues = sortedValues;
+	}
+
+	if ( pass.sourceKeys != keys )
+	{
+		ParallelFor::run(copyBackKernel, &pass, count, taskCount);
+	}
+
+	delete [] scratchKeys;
+	delete [] scratchValues;
+	delete [] histograms;
+}
+
+/*!
+* Sorts 32 bit keys.  Keys and values are packed into one 64 bit word per element for the passes, so each element
+* moves with a single store.
+* \param keys the keys, sorted in place
+* \param values moved along with their keys, may be NULL
+* \param count the number of keys
+* \param keyBits the number of low bits to sort by, higher bits are ignored (but kept)
+* \param taskCount the number of tasks each pass is split into
+*/
+void RadixSort::sort(uint32_t *keys, uint32_t *values, size_t count, int32_t keyBits, size_t taskCount)
+{
+	PATRICKMATH_TIME(RADIX_SORT);
+	if ( count < 2 || keyBits <= 0 )
+	{
+		return;
+	}
+
+	uint64_t *packed = new uint64_t [count];
+	PackBatch batch = {keys, values, packed};
+	ParallelFor::run(packKernel, &batch, count, taskCount);
+	sortBits(packed, NULL, count, 32, 32 + (keyBits < 32 ? keyBits : 32), taskCount);
+	ParallelFor::run(unpackKernel, &batch, count, taskCount);
+	delete [] packed;
+}
+
+/*!
+* Sorts 64 bit keys.
+* \param keys the keys, sorted in place
+* \param values moved along with their keys, may be NULL
+* \param count the number of keys
+* \param keyBits the number of low bits to sort by, higher bits are ignored (but kept)
+* \param taskCount the number of tasks each pass is split into
+*/
+void RadixSort::sort(uint64_t *keys, uint32_t *values, size_t count, int32_t keyBits, size_t taskCount)
+{
+	PATRICKMATH_TIME(RADIX_SORT);
+	if ( count < 2 || keyBits <= 0 )
+	{
+		return;
+	}
+
+	sortBits(keys, values, count, 0, keyBits < 64 ? keyBits : 64, taskCount);
+}
+
+/*!
+* Computes 30 bit morton codes (Quantize::mortonEncode30) and sorts the position indices by them.  Positions close in
+* space end up close in the order, which makes it a good build order for spatial structures and a good layout for
+* vertex and point buffers (see reorder).
+* \param positions the positions to order
+* \param boundsMin the minimum corner of the encoded volume
+* \param boundsMax the maximum corner of the encoded volume
+* \param order receives count position indices in morton order
+* \param codes receives the codes, sorted, so code i belongs to position order[i]
+* \param count the number of positions
+* \param taskCount the number of tasks encoding and sorting are split into
+*/
+void RadixSort::mortonOrder30(
+	const Vector4::Container *positions, const Vector4 &boundsMin, const Vector4 &boundsMax, uint32_t *order,
+	uint32_t *codes, size_t count, size_t taskCount)
+{
+	MortonBatch batch = {positions, &boundsMin, &boundsMax, order, codes, NULL};
+	ParallelFor::run(mortonKernel, &batch, count, taskCount);
+	sort(codes, order, count, 30, taskCount);
+}
+
+/*!
+* mortonOrder30 with 63 bit codes (21 bits per axis) for large or very unevenly spread point sets
+*/
+void RadixSort::mortonOrder63(
+	const Vector4::Container *positions, const Vector4 &boundsMin, const Vector4 &boundsMax, uint32_t *order,
+	uint64_t *codes, size_t count, size_t taskCount)
+{
+	MortonBatch batch = {positions, &boundsMin, &boundsMax, order, NULL, codes};
+	ParallelFor::run(mortonKernel, &batch, count, taskCount);
+	sort(codes, order, count, 63, taskCount);
+}
+
+/*!
+* Applies an order to Vector4 data, see the general reorder
+*/
+void RadixSort::reorder(const uint32_t *order, Vector4::Container *data, size_t count, size_t taskCount)
+{
+	reorder(order, data, sizeof(Vector4::Container), count, taskCount);
+}
+
+/*!
+* Applies an order to an array of elements of any size: element i becomes the element at order[i].  The elements are
+* gathered into scratch space and copied back, both in parallel.  Reorder every array that belongs to the sorted
+* elements with the same order.
+* \param order the permutation, for example from mortonOrder30
+* \param data the elements, reordered in place
+* \param elementSize the size of one element in bytes
+* \param count the number of elements
+* \param taskCount the number of tasks the gather and the copy are split into
+*/
+void RadixSort::reorder(const uint32_t *order, void *data, size_t elementSize, size_t count, size_t taskCount)
+{
+	PATRICKMATH_TIME(RADIX_SORT);
+	if ( count == 0 )
+	{
+		return;
+	}
+
+	char *scratch = static_cast<char*>(_aligned_malloc(count * elementSize, 16));
+	ReorderBatch gather = {order, static_cast<const char*>(data), scratch, elementSize};
+	ParallelFor::run(gatherKernel, &gather, count, taskCount);
+	ReorderBatch copy = {NULL, scratch, static_cast<char*>(data), elementSize};
+	ParallelFor::run(copyKernel, &copy, count, taskCount);
+	_aligned_free(scratch);
+}
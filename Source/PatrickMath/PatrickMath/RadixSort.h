@@ -0,0 +1,70 @@
+/*!
+* \file RadixSort.h
+* \author Patrick Martin
+* \date 2010
+* \brief Parallel LSD radix sort and morton ordering of positions
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Vector4.h"
+
+/*!
+* Parallel LSD radix sort for integer keys, and morton ordering of positions built on it.  Each pass sorts one 11 bit
+* digit: every task counts the digits of its range, a prefix sum over (digit, task) gives every task its own write
+* position per digit, and the tasks scatter their ranges in order, which keeps the sort stable.  Passes whose digit is
+* the same for every key are skipped, so sorting 30 bit morton codes takes at most three passes.
+*
+* Sorting allocates scratch space for one copy of the keys and values.  Values are uint32_t, usually the index of the
+* element a key belongs to, so that one sort can then reorder any number of arrays.
+*/
+class RadixSort
+{
+public:
+	static const int32_t DIGIT_BITS = 11;
+	static const size_t DIGIT_COUNT = size_t(1) << DIGIT_BITS;
+
+	// ascending and stable, values may be NULL; only the low keyBits of each key are compared
+	static void sort(uint32_t *keys, uint32_t *values, size_t count, int32_t keyBits = 32, size_t taskCount = 1);
+	static void sort(uint64_t *keys, uint32_t *values, size_t count, int32_t keyBits = 64, size_t taskCount = 1);
+
+	// position indices sorted by morton code, codes receives the sorted codes
+	static void mortonOrder30(
+		const Vector4::Container *positions, const Vector4 &boundsMin, const Vector4 &boundsMax, uint32_t *order,
+		uint32_t *codes, size_t count, size_t taskCount = 1);
+	static void mortonOrder63(
+		const Vector4::Container *positions, const Vector4 &boundsMin, const Vector4 &boundsMax, uint32_t *order,
+		uint64_t *codes, size_t count, size_t taskCount = 1);
+
+	// data[i] = data[order[i]] for every i, order must be a permutation
+	static void reorder(const uint32_t *order, Vector4::Container *data, size_t count, size_t taskCount = 1);
+	static void reorder(const uint32_t *order, void *data, size_t elementSize, size_t count, size_t taskCount = 1);
+};
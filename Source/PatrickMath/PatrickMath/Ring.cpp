@@ -0,0 +1,417 @@
+/*!
+* \file Ring.cpp
+* \author Patrick Martin
+* \date 2010
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "stdafx.h"
+#include "Ring.h"
+
+#include <emmintrin.h>
+#include <intrin.h>
+#include <malloc.h>
+#include <windows.h>
+
+/*
+* Positions count up forever and wrap, so they are added and compared as unsigned longs; the ring index is the
+* position masked by slotCount - 1.  The rings rely on x86 ordering: a volatile store is not reordered with the stores
+* before it and a volatile load not with the loads after it, so filling a slot and then publishing a position (or
+* reading a position and then the slot) only needs _ReadWriteBarrier to stop the compiler moving things across.
+*/
+
+static inline long advance(long position, size_t step)
+{
+	return long(static_cast<unsigned long>(position) + static_cast<unsigned long>(step));
+}
+
+static inline long difference(long lhs, long rhs)
+{
+	return long(static_cast<unsigned long>(lhs) - static_cast<unsigned long>(rhs));
+}
+
+static inline size_t roundUpToPowerOfTwo(size_t value)
+{
+	size_t result = 1;
+	while ( result < value )
+	{
+		result <<= 1;
+	}
+	return result;
+}
+
+/*!
+* Spins briefly then gives the rest of the time slice away, so a waiting side does not starve the one it is waiting on
+* when there are more threads than cores
+* \param attempt the number of failed attempts so far, incremented
+*/
+static inline void backOff(size_t &attempt)
+{
+	if ( attempt < 16 )
+	{
+		_mm_pause();
+	}
+	else
+	{
+		SwitchToThread();
+	}
+	attempt++;
+}
+
+/*!
+* \return the number of elements to step from one slot to the next, slotSize rounded up to a whole number of lines
+*/
+static inline size_t slotStride(size_t slotSize)
+{
+	const size_t perLine = SpscRing::CACHE_LINE / sizeof(Vector4::Container);
+	return (slotSize + perLine - 1) / perLine * perLine;
+}
+
+SpscRing::SpscRing()
+:	m_slots(NULL), m_counts(NULL), m_slotCount(0), m_slotSize(0), m_slotStride(0), m_writePosition(0),
+	m_cachedReadPosition(0), m_readPosition(0), m_cachedWritePosition(0)
+{
+}
+
+SpscRing::~SpscRing()
+{
+	clear();
+}
+
+/*!
+* Allocates the slots, any previous ones are freed.  Not thread safe, neither side may be using the ring.
+* \param slotCount the number of slots, rounded up to a power of two
+* \param slotSize the number of Vector4::Containers in a slot
+* \return false if either is 0 or the slots could not be allocated
+*/
+bool SpscRing::create(size_t slotCount, size_t slotSize)
+{
+	clear();
+	if ( slotCount == 0 || slotSize == 0 )
+	{
+		return false;
+	}
+
+	slotCount = roundUpToPowerOfTwo(slotCount);
+	size_t stride = slotStride(slotSize);
+	m_slots = static_cast<Vector4::Container*>(
+		_aligned_malloc(slotCount * stride * sizeof(Vector4::Container), CACHE_LINE));
+	if ( m_slots == NULL )
+	{
+		return false;
+	}
+	m_counts = new size_t [slotCount];
+	m_slotCount = slotCount;
+	m_slotSize = slotSize;
+	m_slotStride = stride;
+	return true;
+}
+
+void SpscRing::clear()
+{
+	_aligned_free(m_slots);
+	delete [] m_counts;
+	m_slots = NULL;
+	m_counts = NULL;
+	m_slotCount = 0;
+	m_slotSize = 0;
+	m_slotStride = 0;
+	m_writePosition = 0;
+	m_cachedReadPosition = 0;
+	m_readPosition = 0;
+	m_cachedWritePosition = 0;
+}
+
+/*!
+* \return the next slot to fill, or NULL if every slot is still waiting to be read
+*/
+Vector4::Container *SpscRing::tryAcquireWrite()
+{
+	long position = m_writePosition;
+	if ( static_cast<size_t>(difference(position, m_cachedReadPosition)) == m_slotCount )
+	{
+		m_cachedReadPosition = m_readPosition;
+		_ReadWriteBarrier();
+		if ( static_cast<size_t>(difference(position, m_cachedReadPosition)) == m_slotCount )
+		{
+			return NULL;
+		}
+	}
+	return m_slots + (static_cast<size_t>(position) & (m_slotCount - 1)) * m_slotStride;
+}
+
+/*!
+* \return the next slot to fill, waiting for the consumer if the ring is full
+*/
+Vector4::Container *SpscRing::acquireWrite()
+{
+	Vector4::Container *slot;
+	for ( size_t attempt = 0; (slot = tryAcquireWrite()) == NULL; )
+	{
+		backOff(attempt);
+	}
+	return slot;
+}
+
+/*!
+* Hands the slot from the last acquireWrite to the consumer
+* \param count the number of elements written to it
+*/
+void SpscRing::commitWrite(size_t count)
+{
+	long position = m_writePosition;
+	m_counts[static_cast<size_t>(position) & (m_slotCount - 1)] = count;
+	_ReadWriteBarrier();
+	m_writePosition = advance(position, 1);
+}
+
+/*!
+* \param count receives the number of elements in the slot
+* \return the oldest committed slot, or NULL if there is none
+*/
+const Vector4::Container *SpscRing::tryAcquireRead(size_t &count)
+{
+	long position = m_readPosition;
+	if ( position == m_cachedWritePosition )
+	{
+		m_cachedWritePosition = m_writePosition;
+		_ReadWriteBarrier();
+		if ( position == m_cachedWritePosition )
+		{
+			return NULL;
+		}
+	}
+	size_t index = static_cast<size_t>(position) & (m_slotCount - 1);
+	count = m_counts[index];
+	return m_slots + index * m_slotStride;
+}
+
+/*!
+* \param count receives the number of elements in the slot
+* \return the oldest committed slot, waiting for the producer if the ring is empty
+*/
+const Vector4::Container *SpscRing::acquireRead(size_t &count)
+{
+	const Vector4::Container *slot;
+	for ( size_t attempt = 0; (slot = tryAcquireRead(count)) == NULL; )
+	{
+		backOff(attempt);
+	}
+	return slot;
+}
+
+/*!
+* Hands the slot from the last acquireRead back to the producer, it must not be read after this
+*/
+void SpscRing::commitRead()
+{
+	_ReadWriteBarrier();
+	m_readPosition = advance(m_readPosition, 1);
+}
+
+MpmcRing::MpmcRing()
+:	m_slots(NULL), m_states(NULL), m_slotCount(0), m_slotSize(0), m_slotStride(0), m_writePosition(0),
+	m_readPosition(0)
+{
+}
+
+MpmcRing::~MpmcRing()
+{
+	clear();
+}
+
+/*!
+* Allocates the slots, any previous ones are freed.  Not thread safe, nothing may be using the ring.
+* \param slotCount the number of slots, rounded up to a power of two and at least 2
+* \param slotSize the number of Vector4::Containers in a slot
+* \return false if either is 0 or the slots could not be allocated
+*/
+bool MpmcRing::create(size_t slotCount, size_t slotSize)
+{
+	clear();
+	if ( slotCount == 0 || slotSize == 0 )
+	{
+		return false;
+	}
+
+	slotCount = roundUpToPowerOfTwo(slotCount < 2 ? 2 : slotCount);
+	size_t stride = slotStride(slotSize);
+	m_slots = static_cast<Vector4::Container*>(
+		_aligned_malloc(slotCount * stride * sizeof(Vector4::Container), CACHE_LINE));
+	m_states = static_cast<SlotState*>(_aligned_malloc(slotCount * sizeof(SlotState), CACHE_LINE));
+	if ( m_slots == NULL || m_states == NULL )
+	{
+		clear();
+		return false;
+	}
+	for ( size_t i = 0; i < slotCount; i++ )
+	{
+		m_states[i].count = 0;
+		m_states[i].sequence = long(i);
+	}
+	m_slotCount = slotCount;
+	m_slotSize = slotSize;
+	m_slotStride = stride;
+	return true;
+}
+
+void MpmcRing::clear()
+{
+	_aligned_free(m_slots);
+	_aligned_free(m_states);
+	m_slots = NULL;
+	m_states = NULL;
+	m_slotCount = 0;
+	m_slotSize = 0;
+	m_slotStride = 0;
+	m_writePosition = 0;
+	m_readPosition = 0;
+}
+
+/*!
+* A slot is free for the write at position when its sequence equals position; a smaller one means it still holds the
+* data from a lap ago and the ring is full, a larger one that another producer got there first.
+* \param ticket receives the ticket to pass to commitWrite
+* \return the slot to fill, or NULL if the ring is full
+*/
+Vector4::Container *MpmcRing::tryAcquireWrite(long &ticket)
+{
+	long position = m_writePosition;
+	for ( ;; )
+	{
+		size_t index = static_cast<size_t>(position) & (m_slotCount - 1);
+		long lag = difference(m_states[index].sequence, position);
+		_ReadWriteBarrier();
+		if ( lag == 0 )
+		{
+			long previous = _InterlockedCompareExchange(&m_writePosition, advance(position, 1), position);
+			if ( previous == position )
+			{
+				ticket = position;
+				return m_slots + index * m_slotStride;
+			}
+			position = previous;
+		}
+		else if ( lag < 0 )
+		{
+			return NULL;
+		}
+		else
+		{
+			position = m_writePosition;
+		}
+	}
+}
+
+/*!
+* \param ticket receives the ticket to pass to commitWrite
+* \return the slot to fill, waiting for the consumers if the ring is full
+*/
+Vector4::Container *MpmcRing::acquireWrite(long &ticket)
+{
+	Vector4::Container *slot;
+	for ( size_t attempt = 0; (slot = tryAcquireWrite(ticket)) == NULL; )
+	{
+		backOff(attempt);
+	}
+	return slot;
+}
+
+/*!
+* Hands a filled slot to the consumers
+* \param ticket the ticket from acquireWrite
+* \param count the number of elements written to the slot
+*/
+void MpmcRing::commitWrite(long ticket, size_t count)
+{
+	SlotState &state = m_states[static_cast<size_t>(ticket) & (m_slotCount - 1)];
+	state.count = count;
+	_ReadWriteBarrier();
+	state.sequence = advance(ticket, 1);
+}
+
+/*!
+* A slot holds the data for the read at position when its sequence equals position + 1
+* \param ticket receives the ticket to pass to commitRead
+* \param count receives the number of elements in the slot
+* \return the slot to read, or NULL if the ring is empty (or the next slot is acquired but not yet committed)
+*/
+const Vector4::Container *MpmcRing::tryAcquireRead(long &ticket, size_t &count)
+{
+	long position = m_readPosition;
+	for ( ;; )
+	{
+		size_t index = static_cast<size_t>(position) & (m_slotCount - 1);
+		long lag = difference(m_states[index].sequence, advance(position, 1));
+		_ReadWriteBarrier();
+		if ( lag == 0 )
+		{
+			long previous = _InterlockedCompareExchange(&m_readPosition, advance(position, 1), position);
+			if ( previous == position )
+			{
+				ticket = position;
+				count = m_states[index].count;
+				return m_slots + index * m_slotStride;
+			}
+			position = previous;
+		}
+		else if ( lag < 0 )
+		{
+			return NULL;
+		}
+		else
+		{
+			position = m_readPosition;
+		}
+	}
+}
+
+/*!
+* \param ticket receives the ticket to pass to commitRead
+* \param count receives the number of elements in the slot
+* \return the slot to read, waiting for the producers if the ring is empty
+*/
+const Vector4::Container *MpmcRing::acquireRead(long &ticket, size_t &count)
+{
+	const Vector4::Container *slot;
+	for ( size_t attempt = 0; (slot = tryAcquireRead(ticket, count)) == NULL; )
+	{
+		backOff(attempt);
+	}
+	return slot;
+}
+
+/*!
+* Hands a slot back to the producers, it must not be read after this
+* \param ticket the ticket from acquireRead
+*/
+void MpmcRing::commitRead(long ticket)
+{
+	SlotState &state = m_states[static_cast<size_t>(ticket) & (m_slotCount - 1)];
+	_ReadWriteBarrier();
+	state.sequence = advance(ticket, m_slotCount);
+}
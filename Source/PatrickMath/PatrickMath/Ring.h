@@ -0,0 +1,192 @@
+/*!
+* \file Ring.h
+* \author Patrick Martin
+* \date 2010
+* \brief Lock-free single and multiple producer rings of aligned Vector4 batches
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include "Vector4.h"
+
+/*!
+* Lock-free rings of batches for handing Vector4 (or Quaternion, or Matrix4) data between the stages of a pipeline on
+* different threads.  A slot is a 64 byte aligned block of slotSize Vector4::Containers, so a whole SIMD batch moves
+* per handoff and the cost of the synchronization is spread over it.  Nothing is copied: a producer acquires a free
+* slot, fills it in place and commits it with the number of elements it used, and a consumer acquires a committed slot,
+* reads it in place and commits it back to the free list.  Quaternion and Matrix4 containers have the same layout and
+* alignment, so their batches can be handed over with a reinterpret_cast of the slot (four slot elements per matrix).
+*
+* The try functions never block and return NULL when the ring is full (writes) or empty (reads).  The others spin,
+* pausing and then yielding the processor, until they succeed, so a consumer that has to stop needs to be told through
+* the data; committing 0 elements is allowed and is the usual end marker.
+*
+* The positions that producers and consumers update are on separate cache lines from each other and from the slots,
+* so the two sides only share a line when one of them is actually waiting on the other.
+*/
+
+/*!
+* Single producer, single consumer.  Each side keeps a private copy of the other's position and only reads the shared
+* one when the copy says the ring is full (or empty), so a steady stream costs one shared read per lap of the ring
+* rather than one per slot.  Slots come out in the order they were committed.
+*/
+class SpscRing
+{
+public:
+	static const size_t CACHE_LINE = 64;
+
+	SpscRing();
+	~SpscRing();
+
+	// slotCount is rounded up to a power of two, slotSize is in elements
+	bool create(size_t slotCount, size_t slotSize);
+	void clear();
+
+	// producer side, count is the number of elements of the slot that were written (at most slotSize)
+	Vector4::Container *tryAcquireWrite();
+	Vector4::Container *acquireWrite();
+	void commitWrite(size_t count);
+
+	// consumer side, count receives the number of elements the producer committed
+	const Vector4::Container *tryAcquireRead(size_t &count);
+	const Vector4::Container *acquireRead(size_t &count);
+	void commitRead();
+
+	size_t slotCount() const;
+	size_t slotSize() const;
+
+private:
+	// not copyable, the slots are owned
+	SpscRing(const SpscRing &);
+	SpscRing &operator=(const SpscRing &);
+
+	Vector4::Container *m_slots;
+	size_t *m_counts;
+	size_t m_slotCount;
+	size_t m_slotSize;
+	size_t m_slotStride;
+	char m_padding0 [CACHE_LINE];
+
+	// written by the producer
+	volatile long m_writePosition;
+	long m_cachedReadPosition;
+	char m_padding1 [CACHE_LINE];
+
+	// written by the consumer
+	volatile long m_readPosition;
+	long m_cachedWritePosition;
+	char m_padding2 [CACHE_LINE];
+};
+
+/*!
+* Multiple producers, multiple consumers, after Vyukov's bounded queue: every slot carries a sequence number that says
+* whether it is free for the write at a given position or holds the data for the read at it, so producers (and
+* consumers) only contend on one compare and swap of their shared position and never wait on each other while they
+* fill (or drain) their slots.  The ticket from an acquire goes back to the matching commit.  Slots are committed in
+* any order; a slot is only handed to a consumer once it is committed, and a producer that is slow to commit holds up
+* the ring from its slot on once the others have gone round.
+*/
+class MpmcRing
+{
+public:
+	static const size_t CACHE_LINE = 64;
+
+	MpmcRing();
+	~MpmcRing();
+
+	// slotCount is rounded up to a power of two (at least 2), slotSize is in elements
+	bool create(size_t slotCount, size_t slotSize);
+	void clear();
+
+	// producer side
+	Vector4::Container *tryAcquireWrite(long &ticket);
+	Vector4::Container *acquireWrite(long &ticket);
+	void commitWrite(long ticket, size_t count);
+
+	// consumer side
+	const Vector4::Container *tryAcquireRead(long &ticket, size_t &count);
+	const Vector4::Container *acquireRead(long &ticket, size_t &count);
+	void commitRead(long ticket);
+
+	size_t slotCount() const;
+	size_t slotSize() const;
+
+private:
+	// one per slot, a line each so neighbouring slots do not share
+	struct SlotState
+	{
+		size_t count;
+		volatile long sequence;
+		char padding [CACHE_LINE - sizeof(size_t) - sizeof(long)];
+	};
+
+	// not copyable, the slots are owned
+	MpmcRing(const MpmcRing &);
+	MpmcRing &operator=(const MpmcRing &);
+
+	Vector4::Container *m_slots;
+	SlotState *m_states;
+	size_t m_slotCount;
+	size_t m_slotSize;
+	size_t m_slotStride;
+	char m_padding0 [CACHE_LINE];
+
+	volatile long m_writePosition;
+	char m_padding1 [CACHE_LINE];
+
+	volatile long m_readPosition;
+	char m_padding2 [CACHE_LINE];
+};
+
+inline size_t SpscRing::slotCount() const
+{
+	return m_slotCount;
+}
+
+/*!
+* \return the number of elements in a slot
+*/
+inline size_t SpscRing::slotSize() const
+{
+	return m_slotSize;
+}
+
+inline size_t MpmcRing::slotCount() const
+{
+	return m_slotCount;
+}
+
+/*!
+* \return the number of elements in a slot
+*/
+inline size_t MpmcRing::slotSize() const
+{
+	return m_slotSize;
+}
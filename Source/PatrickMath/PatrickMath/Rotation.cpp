@@ -0,0 +1,337 @@
+/*!
+* \file Rotation.cpp
+* \author Patrick Martin
+* \date 2010
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "stdafx.h"
+#include "Rotation.h"
+
+#include <float.h>
+
+#include "Instrumentation.h"
+#include "ParallelFor.h"
+#include "Soa.h"
+#include "XmmBool.h"
+
+/*!
+* The operands of a conversion, unused ones are NULL.  All the containers are four floats (or 16 for matrices), so
+* they are passed as float arrays with a stride.
+*/
+struct RotationBatch
+{
+	const float *source;
+	const float *sourceAngles;
+	float *destination;
+	float *destinationAngles;
+};
+
+static void quaternionsToMatricesKernel(void *context, size_t, size_t begin, size_t end)
+{
+	RotationBatch &batch = *static_cast<RotationBatch*>(context);
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 zero = _mm_setzero_ps();
+	for ( size_t i = begin; i < end; i += 4 )
+	{
+		__m128 q [4];
+		Soa::loadTransposed(batch.source, 4, i, end, q);
+		__m128 x2 = _mm_add_ps(q[0], q[0]), y2 = _mm_add_ps(q[1], q[1]), z2 = _mm_add_ps(q[2], q[2]);
+		__m128 xx = _mm_mul_ps(q[0], x2), yy = _mm_mul_ps(q[1], y2), zz = _mm_mul_ps(q[2], z2);
+		__m128 xy = _mm_mul_ps(q[0], y2), xz = _mm_mul_ps(q[0], z2), yz = _mm_mul_ps(q[1], z2);
+		__m128 wx = _mm_mul_ps(q[3], x2), wy = _mm_mul_ps(q[3], y2), wz = _mm_mul_ps(q[3], z2);
+
+		__m128 column0 [4] = {_mm_sub_ps(one, _mm_add_ps(yy, zz)), _mm_add_ps(xy, wz), _mm_sub_ps(xz, wy), zero};
+		__m128 column1 [4] = {_mm_sub_ps(xy, wz), _mm_sub_ps(one, _mm_add_ps(xx, zz)), _mm_add_ps(yz, wx), zero};
+		__m128 column2 [4] = {_mm_add_ps(xz, wy), _mm_sub_ps(yz, wx), _mm_sub_ps(one, _mm_add_ps(xx, yy)), zero};
+		__m128 column3 [4] = {zero, zero, zero, one};
+		Soa::storeTransposed(batch.destination, 16, i, end, column0);
+		Soa::storeTransposed(batch.destination + 4, 16, i, end, column1);
+		Soa::storeTransposed(batch.destination + 8, 16, i, end, column2);
+		Soa::storeTransposed(batch.destination + 12, 16, i, end, column3);
+	}
+}
+
+/*!
+* Each of 4w^2, 4x^2, 4y^2 and 4z^2 is one plus a signed sum of the diagonal.  The largest is the safest to take the
+* square root of, and the other three components come from sums and differences of the off diagonal pairs divided by
+* it.  All four candidates are built and the largest one selected per lane.
+*/
+static void matricesToQuaternionsKernel(void *context, size_t, size_t begin, size_t end)
+{
+	RotationBatch &batch = *static_cast<RotationBatch*>(context);
+	const __m128 one = _mm_set1_ps(1.f);
+	for ( size_t i = begin; i < end; i += 4 )
+	{
+		// c0[r] is row r of column 0 for four matrices, and so on
+		__m128 c0 [4], c1 [4], c2 [4];
+		Soa::loadTransposed(batch.source, 16, i, end, c0);
+		Soa::loadTransposed(batch.source + 4, 16, i, end, c1);
+		Soa::loadTransposed(batch.source + 8, 16, i, end, c2);
+		__m128 m00 = c0[0], m10 = c0[1], m20 = c0[2];
+		__m128 m01 = c1[0], m11 = c1[1], m21 = c1[2];
+		__m128 m02 = c2[0], m12 = c2[1], m22 = c2[2];
+
+		__m128 tw = _mm_add_ps(_mm_add_ps(one, m00), _mm_add_ps(m11, m22));
+		__m128 tx = _mm_sub_ps(_mm_add_ps(one, m00), _mm_add_ps(m11, m22));
+		__m128 ty = _mm_sub_ps(_mm_add_ps(one, m11), _mm_add_ps(m00, m22));
+		__m128 tz = _mm_sub_ps(_mm_add_ps(one, m22), _mm_add_ps(m00, m11));
+		__m128 sum01 = _mm_add_ps(m01, m10), sum02 = _mm_add_ps(m02, m20), sum12 = _mm_add_ps(m12, m21);
+		__m128 difference21 = _mm_sub_ps(m21, m12);
+		__m128 difference02 = _mm_sub_ps(m02, m20);
+		__m128 difference10 = _mm_sub_ps(m10, m01);
+
+		// start from the w case and let larger candidates take over
+		__m128 q [4] = {difference21, difference02, difference10, tw};
+		__m128 largest = tw;
+		XmmBool pick = _mm_cmpgt_ps(tx, largest);
+		q[0] = pick.select(tx, q[0]);
+		q[1] = pick.select(sum01, q[1]);
+		q[2] = pick.select(sum02, q[2]);
+		q[3] = pick.select(difference21, q[3]);
+		largest = _mm_max_ps(largest, tx);
+		pick = _mm_cmpgt_ps(ty, largest);
+		q[0] = pick.select(sum01, q[0]);
+		q[1] = pick.select(ty, q[1]);
+		q[2] = pick.select(sum12, q[2]);
+		q[3] = pick.select(difference02, q[3]);
+		largest = _mm_max_ps(largest, ty);
+		pick = _mm_cmpgt_ps(tz, largest);
+		q[0] = pick.select(sum02, q[0]);
+		q[1] = pick.select(sum12, q[1]);
+		q[2] = pick.select(tz, q[2]);
+		q[3] = pick.select(difference10, q[3]);
+		largest = _mm_max_ps(largest, tz);
+
+		// 0.5 / sqrt(t), with the sign chosen so that w >= 0
+		__m128 scale = _mm_div_ps(_mm_set1_ps(0.5f), _mm_sqrt_ps(_mm_max_ps(largest, _mm_set1_ps(FLT_MIN))));
+		scale = _mm_xor_ps(scale, _mm_and_ps(q[3], _mm_set1_ps(-0.f)));
+		for ( int component = 0; component < 4; component++ )
+		{
+			q[component] = _mm_mul_ps(q[component], scale);
+		}
+		Soa::storeTransposed(batch.destination, 4, i, end, q);
+	}
+}
+
+static void axisAnglesToQuaternionsKernel(void *context, size_t, size_t begin, size_t end)
+{
+	RotationBatch &batch = *static_cast<RotationBatch*>(context);
+	for ( size_t i = begin; i < end; i += 4 )
+	{
+		__m128 q [4];
+		Soa::loadTransposed(batch.source, 4, i, end, q);
+		XmmFloat sinHalf, cosHalf;
+		XmmFloat(_mm_mul_ps(Soa::loadLanes(batch.sourceAngles, i, end), _mm_set1_ps(0.5f))).sinCos(sinHalf, cosHalf);
+		q[0] = _mm_mul_ps(q[0], sinHalf);
+		q[1] = _mm_mul_ps(q[1], sinHalf);
+		q[2] = _mm_mul_ps(q[2], sinHalf);
+		q[3] = cosHalf;
+		Soa::storeTransposed(batch.destination, 4, i, end, q);
+	}
+}
+
+/*!
+* angle = 2 atan2(|v|, w) stays accurate for small angles where 2 acos(w) would not
+*/
+static void quaternionsToAxisAnglesKernel(void *context, size_t, size_t begin, size_t end)
+{
+	RotationBatch &batch = *static_cast<RotationBatch*>(context);
+	const __m128 tiny = _mm_set1_ps(1.0e-20f);
+	for ( size_t i = begin; i < end; i += 4 )
+	{
+		__m128 q [4];
+		Soa::loadTransposed(batch.source, 4, i, end, q);
+		Soa::Vector vector = {q[0], q[1], q[2]};
+		__m128 lengthSq = Soa::lengthSq(vector);
+		__m128 length = _mm_sqrt_ps(lengthSq);
+		__m128 angles = _mm_mul_ps(XmmFloat::atan2(length, q[3]), _mm_set1_ps(2.f));
+
+		XmmBool hasAxis = _mm_cmpgt_ps(lengthSq, tiny);
+		Soa::Vector unit = Soa::multiply(vector, _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(_mm_max_ps(lengthSq, tiny))));
+		__m128 axis [4] = {
+			hasAxis.select(unit.x, _mm_set1_ps(1.f)), _mm_and_ps(hasAxis, unit.y), _mm_and_ps(hasAxis, unit.z),
+			_mm_setzero_ps()};
+		Soa::storeTransposed(batch.destination, 4, i, end, axis);
+		Soa::storeLanes(batch.destinationAngles, i, end, _mm_and_ps(hasAxis, angles));
+	}
+}
+
+static void eulerToQuaternionsKernel(void *context, size_t, size_t begin, size_t end)
+{
+	RotationBatch &batch = *static_cast<RotationBatch*>(context);
+	const __m128 half = _mm_set1_ps(0.5f);
+	for ( size_t i = begin; i < end; i += 4 )
+	{
+		__m128 angles [4];
+		Soa::loadTransposed(batch.source, 4, i, end, angles);
+		XmmFloat sx, cx, sy, cy, sz, cz;
+		XmmFloat(_mm_mul_ps(angles[0], half)).sinCos(sx, cx);
+		XmmFloat(_mm_mul_ps(angles[1], half)).sinCos(sy, cy);
+		XmmFloat(_mm_mul_ps(angles[2], half)).sinCos(sz, cz);
+
+		// qz * qy * qx expanded
+		__m128 cycz = _mm_mul_ps(cy, cz), sysz = _mm_mul_ps(sy, sz);
+		__m128 sycz = _mm_mul_ps(sy, cz), cysz = _mm_mul_ps(cy, sz);
+		__m128 q [4] = {
+			_mm_sub_ps(_mm_mul_ps(sx, cycz), _mm_mul_ps(cx, sysz)),
+			_mm_add_ps(_mm_mul_ps(cx, sycz), _mm_mul_ps(sx, cysz)),
+			_mm_sub_ps(_mm_mul_ps(cx, cysz), _mm_mul_ps(sx, sycz)),
+			_mm_add_ps(_mm_mul_ps(cx, cycz), _mm_mul_ps(sx, sysz))};
+		Soa::storeTransposed(batch.destination, 4, i, end, q);
+	}
+}
+
+/*!
+* The pitch is asin(2 (wy - zx)) computed as an atan2 against its cosine, clamped so that rounding just past the
+* poles does not produce NaN
+*/
+static void quaternionsToEulerKernel(void *context, size_t, size_t begin, size_t end)
+{
+	RotationBatch &batch = *static_cast<RotationBatch*>(context);
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 two = _mm_set1_ps(2.f);
+	for ( size_t i = begin; i < end; i += 4 )
+	{
+		__m128 q [4];
+		Soa::loadTransposed(batch.source, 4, i, end, q);
+		__m128 x = q[0], y = q[1], z = q[2], w = q[3];
+		__m128 yy = _mm_mul_ps(y, y);
+
+		__m128 rollY = _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(w, x), _mm_mul_ps(y, z)));
+		__m128 rollX = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(x, x), yy)));
+		__m128 sinPitch = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(w, y), _mm_mul_ps(z, x)));
+		sinPitch = _mm_min_ps(_mm_max_ps(sinPitch, _mm_set1_ps(-1.f)), one);
+		__m128 cosPitch = _mm_sqrt_ps(_mm_sub_ps(one, _mm_mul_ps(sinPitch, sinPitch)));
+		__m128 yawY = _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(w, z), _mm_mul_ps(x, y)));
+		__m128 yawX = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, _mm_mul_ps(z, z))));
+
+		__m128 angles [4] = {
+			XmmFloat::atan2(rollY, rollX), XmmFloat::atan2(sinPitch, cosPitch), XmmFloat::atan2(yawY, yawX),
+			_mm_setzero_ps()};
+		Soa::storeTransposed(batch.destination, 4, i, end, angles);
+	}
+}
+
+/*!
+* Rotation matrices of unit quaternions
+* \param rotations the unit quaternions
+* \param matrices receives the matrices
+* \param count the number of rotations
+* \param taskCount the number of tasks the batch is split into
+*/
+void Rotation::quaternionsToMatrices(
+	const Quaternion::Container *rotations, Matrix4::Container *matrices, size_t count, size_t taskCount)
+{
+	PATRICKMATH_TIME(ROTATION_CONVERT);
+	RotationBatch batch = {
+		reinterpret_cast<const float*>(rotations), NULL, reinterpret_cast<float*>(matrices), NULL};
+	ParallelFor::run(quaternionsToMatricesKernel, &batch, count, taskCount);
+}
+
+/*!
+* Unit quaternions of rotation matrices
+* \param matrices the rotation matrices, only the upper 3x3 is read
+* \param rotations receives the quaternions
+* \param count the number of rotations
+* \param taskCount the number of tasks the batch is split into
+*/
+void Rotation::matricesToQuaternions(
+	const Matrix4::Container *matrices, Quaternion::Container *rotations, size_t count, size_t taskCount)
+{
+	PATRICKMATH_TIME(ROTATION_CONVERT);
+	RotationBatch batch = {
+		reinterpret_cast<const float*>(matrices), NULL, reinterpret_cast<float*>(rotations), NULL};
+	ParallelFor::run(matricesToQuaternionsKernel, &batch, count, taskCount);
+}
+
+/*!
+* Quaternions of rotations about axes
+* \param axes the unit axes, w is ignored
+* \param angles the angles in radians
+* \param rotations receives the quaternions
+* \param count the number of rotations
+* \param taskCount the number of tasks the batch is split into
+*/
+void Rotation::axisAnglesToQuaternions(
+	const Vector4::Container *axes, const float *angles, Quaternion::Container *rotations, size_t count,
+	size_t taskCount)
+{
+	PATRICKMATH_TIME(ROTATION_CONVERT);
+	RotationBatch batch = {
+		reinterpret_cast<const float*>(axes), angles, reinterpret_cast<float*>(rotations), NULL};
+	ParallelFor::run(axisAnglesToQuaternionsKernel, &batch, count, taskCount);
+}
+
+/*!
+* Axes and angles of unit quaternions
+* \param rotations the unit quaternions
+* \param axes receives the unit axes
+* \param angles receives the angles in radians
+* \param count the number of rotations
+* \param taskCount the number of tasks the batch is split into
+*/
+void Rotation::quaternionsToAxisAngles(
+	const Quaternion::Container *rotations, Vector4::Container *axes, float *angles, size_t count, size_t taskCount)
+{
+	PATRICKMATH_TIME(ROTATION_CONVERT);
+	RotationBatch batch = {
+		reinterpret_cast<const float*>(rotations), NULL, reinterpret_cast<float*>(axes), angles};
+	ParallelFor::run(quaternionsToAxisAnglesKernel, &batch, count, taskCount);
+}
+
+/*!
+* Quaternions of Euler angles
+* \param angles the x, y and z angles in radians, w is ignored
+* \param rotations receives the quaternions
+* \param count the number of rotations
+* \param taskCount the number of tasks the batch is split into
+*/
+void Rotation::eulerToQuaternions(
+	const Vector4::Container *angles, Quaternion::Container *rotations, size_t count, size_t taskCount)
+{
+	PATRICKMATH_TIME(ROTATION_CONVERT);
+	RotationBatch batch = {
+		reinterpret_cast<const float*>(angles), NULL, reinterpret_cast<float*>(rotations), NULL};
+	ParallelFor::run(eulerToQuaternionsKernel, &batch, count, taskCount);
+}
+
+/*!
+* Euler angles of unit quaternions, at the poles (y = +/-pi/2) the split between x and z is arbitrary
+* \param rotations the unit quaternions
+* \param angles receives the x, y and z angles in radians
+* \param count the number of rotations
+* \param taskCount the number of tasks the batch is split into
+*/
+void Rotation::quaternionsToEuler(
+	const Quaternion::Container *rotations, Vector4::Container *angles, size_t count, size_t taskCount)
+{
+	PATRICKMATH_TIME(ROTATION_CONVERT);
+	RotationBatch batch = {
+		reinterpret_cast<const float*>(rotations), NULL, reinterpret_cast<float*>(angles), NULL};
+	ParallelFor::run(quaternionsToEulerKernel, &batch, count, taskCount);
+}
@@ -0,0 +1,76 @@
+/*!
+* \file Rotation.h
+* \author Patrick Martin
+* \date 2010
+* \brief Batched conversions between quaternions, rotation matrices, axis angle and Euler angles
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include "Matrix4.h"
+#include "Quaternion.h"
+#include "Vector4.h"
+
+/*!
+* Batched conversions between rotation representations.  Every kernel transposes four elements into x, y, z and w
+* registers and works on four rotations at once, with selects instead of branches and XmmFloat::sinCos and
+* XmmFloat::atan2 for the trig, so nothing leaves SSE registers.
+*
+* Matrices are pure rotations: the upper 3x3 of a Matrix4 with a zero translation and a (0, 0, 0, 1) bottom row.  Euler
+* angles are (x, y, z, 0) in radians and mean rotating about x first, then y, then z (fixed axes; yaw z, pitch y and
+* roll x), so q = qz * qy * qx.  Axis angle pairs are a unit axis (w = 0) and an angle in radians.
+*/
+class Rotation
+{
+public:
+	static void quaternionsToMatrices(
+		const Quaternion::Container *rotations, Matrix4::Container *matrices, size_t count, size_t taskCount = 1);
+
+	// branchless Shepperd, the largest of |w|, |x|, |y|, |z| is found from the diagonal and the others from it; results
+	// have w >= 0
+	static void matricesToQuaternions(
+		const Matrix4::Container *matrices, Quaternion::Container *rotations, size_t count, size_t taskCount = 1);
+
+	static void axisAnglesToQuaternions(
+		const Vector4::Container *axes, const float *angles, Quaternion::Container *rotations, size_t count,
+		size_t taskCount = 1);
+
+	// angles in [0, 2 pi], rotations without an axis (the identity) give the x axis and angle 0
+	static void quaternionsToAxisAngles(
+		const Quaternion::Container *rotations, Vector4::Container *axes, float *angles, size_t count,
+		size_t taskCount = 1);
+
+	static void eulerToQuaternions(
+		const Vector4::Container *angles, Quaternion::Container *rotations, size_t count, size_t taskCount = 1);
+
+	// x and z in [-pi, pi] and y in [-pi/2, pi/2]
+	static void quaternionsToEuler(
+		const Quaternion::Container *rotations, Vector4::Container *angles, size_t count, size_t taskCount = 1);
+};
@@ -0,0 +1,147 @@
+/*!
+* \file Sampling.cpp
+* \author Patrick Martin
+* \date 2010
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "stdafx.h"
+#include "Sampling.h"
+#include "Soa.h"
+
+/*!
+* Turns a z coordinate and a uniform [0, 1) value into a unit direction: the azimuth is 2 pi u and x, y are scaled to
+* the radius left over by z.
+*/
+static void aroundZ(const __m128 &z, const XmmFloat &u, __m128 &x, __m128 &y)
+{
+	__m128 radius = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(1.f), _mm_mul_ps(z, z)), _mm_setzero_ps()));
+	XmmFloat sinPhi, cosPhi;
+	XmmFloat(_mm_mul_ps(u, XmmFloat::_2PI)).sinCos(sinPhi, cosPhi);
+	x = _mm_mul_ps(radius, cosPhi);
+	y = _mm_mul_ps(radius, sinPhi);
+}
+
+/*!
+* Uniform directions over the whole sphere (Archimedes: z is uniform in [-1, 1])
+* \param random the generator to draw from
+* \param destination receives count unit directions
+* \param count the number of samples
+*/
+void Sampling::unitSphere(XmmRandom &random, Vector4::Container *destination, size_t count)
+{
+	PATRICKMATH_TIME(SAMPLING);
+	for ( size_t i = 0; i < count; i += 4 )
+	{
+		__m128 v [4];
+		v[2] = random.nextFloat(XmmFloat(_mm_set1_ps(-1.f)), XmmFloat(_mm_set1_ps(1.f)));
+		v[3] = _mm_setzero_ps();
+		aroundZ(v[2], random.nextFloat(), v[0], v[1]);
+		Soa::storeTransposed(destination, i, count, v);
+	}
+}
+
+/*!
+* Uniform directions over the hemisphere around +z
+* \param random the generator to draw from
+* \param destination receives count unit directions with z >= 0
+* \param count the number of samples
+*/
+void Sampling::hemisphere(XmmRandom &random, Vector4::Container *destination, size_t count)
+{
+	PATRICKMATH_TIME(SAMPLING);
+	for ( size_t i = 0; i < count; i += 4 )
+	{
+		__m128 v [4];
+		v[2] = _mm_sub_ps(_mm_set1_ps(1.f), random.nextFloat()); // (0, 1], never exactly tangent
+		v[3] = _mm_setzero_ps();
+		aroundZ(v[2], random.nextFloat(), v[0], v[1]);
+		Soa::storeTransposed(destination, i, count, v);
+	}
+}
+
+/*!
+* Cosine weighted directions over the hemisphere around +z (Malley's method: a uniform disk sample lifted onto the
+* hemisphere), the usual importance sampling for diffuse lighting
+* \param random the generator to draw from
+* \param destination receives count unit directions with z >= 0
+* \param count the number of samples
+*/
+void Sampling::cosineHemisphere(XmmRandom &random, Vector4::Container *destination, size_t count)
+{
+	PATRICKMATH_TIME(SAMPLING);
+	for ( size_t i = 0; i < count; i += 4 )
+	{
+		__m128 radiusSq = random.nextFloat();
+		__m128 v [4];
+		v[2] = _mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.f), radiusSq));
+		v[3] = _mm_setzero_ps();
+		aroundZ(v[2], random.nextFloat(), v[0], v[1]);
+		Soa::storeTransposed(destination, i, count, v);
+	}
+}
+
+/*!
+* Uniform directions inside a cone around +z
+* \param random the generator to draw from
+* \param cosMaxAngle the cosine of the cone's half angle in every lane
+* \param destination receives count unit directions with z >= cosMaxAngle
+* \param count the number of samples
+*/
+void Sampling::cone(XmmRandom &random, const XmmFloat &cosMaxAngle, Vector4::Container *destination, size_t count)
+{
+	PATRICKMATH_TIME(SAMPLING);
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 zRange = _mm_sub_ps(one, cosMaxAngle);
+	for ( size_t i = 0; i < count; i += 4 )
+	{
+		__m128 v [4];
+		v[2] = _mm_sub_ps(one, _mm_mul_ps(random.nextFloat(), zRange));
+		v[3] = _mm_setzero_ps();
+		aroundZ(v[2], random.nextFloat(), v[0], v[1]);
+		Soa::storeTransposed(destination, i, count, v);
+	}
+}
+
+/*!
+* Uniform offsets inside the unit disk in the xy plane (radius is the square root of a uniform value)
+* \param random the generator to draw from
+* \param destination receives count offsets with z = 0 and length <= 1
+* \param count the number of samples
+*/
+void Sampling::unitDisk(XmmRandom &random, Vector4::Container *destination, size_t count)
+{
+	PATRICKMATH_TIME(SAMPLING);
+	for ( size_t i = 0; i < count; i += 4 )
+	{
+		__m128 radius = _mm_sqrt_ps(random.nextFloat());
+		XmmFloat sinPhi, cosPhi;
+		XmmFloat(_mm_mul_ps(random.nextFloat(), XmmFloat::_2PI)).sinCos(sinPhi, cosPhi);
+		__m128 v [4] = {_mm_mul_ps(radius, cosPhi), _mm_mul_ps(radius, sinPhi), _mm_setzero_ps(), _mm_setzero_ps()};
+		Soa::storeTransposed(destination, i, count, v);
+	}
+}
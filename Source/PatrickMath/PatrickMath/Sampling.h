@@ -0,0 +1,57 @@
+/*!
+* \file Sampling.h
+* \author Patrick Martin
+* \date 2010
+* \brief Batch samplers for uniformly distributed directions and offsets
+*
+* Every sampler draws four samples at a time from an XmmRandom, transposes them and writes Vector4 containers.  No
+* rejection sampling is used, so each group of four samples consumes a fixed number of random values and a given
+* (seed, stream) always produces the same samples.  All results are offset vectors (w = 0): directions are unit length
+* and point around +z where an axis is implied, disk samples lie in the xy plane.  Rotate them onto your own frame.
+*
+* This project is governed by the MIT licence:
+*
+*  Copyright (c) 2010 Patrick Martin
+*
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+*
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include "Vector4.h"
+#include "XmmFloat.h"
+#include "XmmRandom.h"
+
+class Sampling
+{
+public:
+	// directions
+	static void unitSphere(XmmRandom &random, Vector4::Container *destination, size_t count);
+	static void hemisphere(XmmRandom &random, Vector4::Container *destination, size_t count);
+	static void cosineHemisphere(XmmRandom &random, Vector4::Container *destination, size_t count);
+	static void cone(XmmRandom &random, const XmmFloat &cosMaxAngle, Vector4::Container *destination, size_t count);
+
+	// offsets
+	static void unitDisk(XmmRandom &random, Vector4::Container *destination, size_t count);
+};
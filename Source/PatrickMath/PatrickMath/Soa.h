@@ -0,0 +1,251 @@
+/*!
+* \file Soa.h
+* \author Patrick Martin
+* \date 2010
+* \brief Shared loads, stores and vector math for four wide batch kernels
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <emmintrin.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Vector4.h"
+
+/*!
+* \class Soa
+* \brief loads, stores and vector math for the batch kernels that work on four elements at a time in structure of
+* arrays form
+*
+* Not part of the public interface, the batch kernels of the library share it so they all handle the end of a range
+* the same way.  Every load and store takes the element index of the first lane and end, one past the last element
+* that may be touched.  Loads past end repeat the last element, so a tail shorter than four goes through the same code
+* as a full group and its extra lanes only compute copies of the last result, and stores write just the lanes before
+* end.  Nothing is read or written past end, so end can be the end of a ParallelFor range as well as of the array.
+*
+* Vector holds the x, y and z of four vectors, one register per component, and the math below works lane by lane on
+* those three components only, the same as Vector4's does on vectors with w = 0.  w is left to the kernel, loadVector
+* hands it back and storeVector takes it.
+*/
+class Soa
+{
+public:
+	struct Vector
+	{
+		__m128 x;
+		__m128 y;
+		__m128 z;
+	};
+
+	static void loadTransposed(const Vector4::Container *source, size_t index, size_t end, __m128 v [4]);
+	static void loadTransposed(const float *source, size_t stride, size_t index, size_t end, __m128 v [4]);
+	static void storeTransposed(Vector4::Container *destination, size_t index, size_t end, __m128 v [4]);
+	static void storeTransposed(float *destination, size_t stride, size_t index, size_t end, __m128 v [4]);
+
+	static __m128 loadLanes(const float *source, size_t index, size_t end);
+	static void storeLanes(float *destination, size_t index, size_t end, const __m128 &values);
+	static void storeLanes(uint32_t *destination, size_t index, size_t end, const __m128i &values);
+
+	static __m128 loadVector(const Vector4::Container *source, size_t index, size_t end, Vector &vector);
+	static void storeVector(
+		Vector4::Container *destination, size_t index, size_t end, const Vector &vector, const __m128 &w);
+
+	static Vector subtract(const Vector &lhs, const Vector &rhs);
+	static Vector multiply(const Vector &vector, const __m128 &scale);
+	static Vector multiplyAdd(const Vector &direction, const __m128 &scale, const Vector &base);
+	static __m128 dot(const Vector &lhs, const Vector &rhs);
+	static Vector cross(const Vector &lhs, const Vector &rhs);
+	static __m128 lengthSq(const Vector &vector);
+};
+
+/*!
+* Loads four containers and transposes them, so v receives the x, y, z and w of the four lanes
+*/
+inline void Soa::loadTransposed(const Vector4::Container *source, size_t index, size_t end, __m128 v [4])
+{
+	loadTransposed(source->elements, 4, index, end, v);
+}
+
+/*!
+* Loads four elements of four floats, stride floats apart and aligned, and transposes them
+* \param source the first float of element 0
+* \param stride the distance in floats from one element to the next
+* \param index the element of the first lane
+* \param end one past the last element
+* \param v receives one register per float of the elements
+*/
+inline void Soa::loadTransposed(const float *source, size_t stride, size_t index, size_t end, __m128 v [4])
+{
+	size_t last = end - 1;
+	for ( size_t lane = 0; lane < 4; lane++ )
+	{
+		v[lane] = _mm_load_ps(source + (index + lane <= last ? index + lane : last) * stride);
+	}
+	_MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]);
+}
+
+/*!
+* Transposes v in place back into four containers and writes them
+*/
+inline void Soa::storeTransposed(Vector4::Container *destination, size_t index, size_t end, __m128 v [4])
+{
+	storeTransposed(destination->elements, 4, index, end, v);
+}
+
+/*!
+* Transposes v in place back into four elements and writes them, see loadTransposed
+*/
+inline void Soa::storeTransposed(float *destination, size_t stride, size_t index, size_t end, __m128 v [4])
+{
+	_MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]);
+	for ( size_t lane = 0; lane < 4 && index + lane < end; lane++ )
+	{
+		_mm_store_ps(destination + (index + lane) * stride, v[lane]);
+	}
+}
+
+/*!
+* \return four consecutive floats from source + index, no alignment required
+*/
+inline __m128 Soa::loadLanes(const float *source, size_t index, size_t end)
+{
+	if ( index + 4 <= end )
+	{
+		return _mm_loadu_ps(source + index);
+	}
+	__declspec(align(16)) float lanes [4];
+	for ( size_t lane = 0; lane < 4; lane++ )
+	{
+		lanes[lane] = source[index + lane < end ? index + lane : end - 1];
+	}
+	return _mm_load_ps(lanes);
+}
+
+/*!
+* Writes four consecutive floats to destination + index, no alignment required
+*/
+inline void Soa::storeLanes(float *destination, size_t index, size_t end, const __m128 &values)
+{
+	if ( index + 4 <= end )
+	{
+		_mm_storeu_ps(destination + index, values);
+		return;
+	}
+	__declspec(align(16)) float lanes [4];
+	_mm_store_ps(lanes, values);
+	for ( size_t lane = 0; index + lane < end; lane++ )
+	{
+		destination[index + lane] = lanes[lane];
+	}
+}
+
+/*!
+* Writes four consecutive 32 bit integers to destination + index, no alignment required
+*/
+inline void Soa::storeLanes(uint32_t *destination, size_t index, size_t end, const __m128i &values)
+{
+	if ( index + 4 <= end )
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + index), values);
+		return;
+	}
+	__declspec(align(16)) uint32_t lanes [4];
+	_mm_store_si128(reinterpret_cast<__m128i*>(lanes), values);
+	for ( size_t lane = 0; index + lane < end; lane++ )
+	{
+		destination[index + lane] = lanes[lane];
+	}
+}
+
+/*!
+* loadTransposed into the x, y and z of vector
+* \return w of the four containers
+*/
+inline __m128 Soa::loadVector(const Vector4::Container *source, size_t index, size_t end, Vector &vector)
+{
+	__m128 v [4];
+	loadTransposed(source, index, end, v);
+	vector.x = v[0];
+	vector.y = v[1];
+	vector.z = v[2];
+	return v[3];
+}
+
+/*!
+* storeTransposed of vector with w as the fourth component
+*/
+inline void Soa::storeVector(
+	Vector4::Container *destination, size_t index, size_t end, const Vector &vector, const __m128 &w)
+{
+	__m128 v [4] = {vector.x, vector.y, vector.z, w};
+	storeTransposed(destination, index, end, v);
+}
+
+inline Soa::Vector Soa::subtract(const Vector &lhs, const Vector &rhs)
+{
+	Vector result = {_mm_sub_ps(lhs.x, rhs.x), _mm_sub_ps(lhs.y, rhs.y), _mm_sub_ps(lhs.z, rhs.z)};
+	return result;
+}
+
+inline Soa::Vector Soa::multiply(const Vector &vector, const __m128 &scale)
+{
+	Vector result = {_mm_mul_ps(vector.x, scale), _mm_mul_ps(vector.y, scale), _mm_mul_ps(vector.z, scale)};
+	return result;
+}
+
+/*!
+* \return base + direction * scale
+*/
+inline Soa::Vector Soa::multiplyAdd(const Vector &direction, const __m128 &scale, const Vector &base)
+{
+	Vector result = {
+		_mm_add_ps(_mm_mul_ps(direction.x, scale), base.x),
+		_mm_add_ps(_mm_mul_ps(direction.y, scale), base.y),
+		_mm_add_ps(_mm_mul_ps(direction.z, scale), base.z)};
+	return result;
+}
+
+inline __m128 Soa::dot(const Vector &lhs, const Vector &rhs)
+{
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(lhs.x, rhs.x), _mm_mul_ps(lhs.y, rhs.y)), _mm_mul_ps(lhs.z, rhs.z));
+}
+
+inline Soa::Vector Soa::cross(const Vector &lhs, const Vector &rhs)
+{
+	Vector result = {
+		_mm_sub_ps(_mm_mul_ps(lhs.y, rhs.z), _mm_mul_ps(lhs.z, rhs.y)),
+		_mm_sub_ps(_mm_mul_ps(lhs.z, rhs.x), _mm_mul_ps(lhs.x, rhs.z)),
+		_mm_sub_ps(_mm_mul_ps(lhs.x, rhs.y), _mm_mul_ps(lhs.y, rhs.x))};
+	return result;
+}
+
+inline __m128 Soa::lengthSq(const Vector &vector)
+{
+	return dot(vector, vector);
+}
@@ -0,0 +1,366 @@
+/*!
+* \file Stream.cpp
+* \author Patrick Martin
+* \date 2010
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "stdafx.h"
+#include "Stream.h"
+
+#include <intrin.h>
+#include <malloc.h>
+#include <windows.h>
+
+#include "Affine3x4.h"
+#include "Instrumentation.h"
+#include "ParallelFor.h"
+#include "Quantize.h"
+#include "Soa.h"
+#include "XmmBool.h"
+
+/*!
+* The state shared by the three sides of one run.  Chunk i lives in buffer i % bufferCount and every side walks the
+* buffers in that order, so three semaphores counting the free, read and processed buffers are all the
+* synchronization needed; a count of 0 marks the end of the data.
+*/
+struct StreamRun
+{
+	Vector4::Container *buffers;
+	size_t chunkSize;
+	size_t bufferCount;
+	size_t counts [Stream::MAX_BUFFERS];
+
+	Stream::Reader reader;
+	void *readerContext;
+	Stream::Writer writer;
+	void *writerContext;
+
+	HANDLE freeBuffers;
+	HANDLE readBuffers;
+	HANDLE processedBuffers;
+
+	volatile LONG failed;
+	uint64_t elementCount;
+};
+
+static DWORD WINAPI streamReaderEntry(LPVOID parameter)
+{
+	StreamRun &run = *static_cast<StreamRun*>(parameter);
+	for ( size_t buffer = 0; ; buffer = (buffer + 1) % run.bufferCount )
+	{
+		WaitForSingleObject(run.freeBuffers, INFINITE);
+		size_t count = 0;
+		if ( run.failed == 0 )
+		{
+			PATRICKMATH_TIME(STREAM_READ);
+			count = run.reader(run.readerContext, run.buffers + buffer * run.chunkSize, run.chunkSize);
+			if ( count == Stream::READ_ERROR )
+			{
+				// the end of the data as far as the other threads go, with the flag set so run reports it
+				_InterlockedExchange(&run.failed, 1);
+				count = 0;
+			}
+			count = count < run.chunkSize ? count : run.chunkSize;
+		}
+		run.counts[buffer] = count;
+		ReleaseSemaphore(run.readBuffers, 1, NULL);
+		if ( count == 0 )
+		{
+			return 0;
+		}
+	}
+}
+
+static DWORD WINAPI streamWriterEntry(LPVOID parameter)
+{
+	StreamRun &run = *static_cast<StreamRun*>(parameter);
+	for ( size_t buffer = 0; ; buffer = (buffer + 1) % run.bufferCount )
+	{
+		WaitForSingleObject(run.processedBuffers, INFINITE);
+		size_t count = run.counts[buffer];
+		if ( count == 0 )
+		{
+			return 0;
+		}
+
+		// after a failure the remaining chunks are only drained, so that the reader sees the flag and stops
+		if ( run.failed == 0 )
+		{
+			PATRICKMATH_TIME(STREAM_WRITE);
+			if ( run.writer(run.writerContext, run.buffers + buffer * run.chunkSize, count) )
+			{
+				run.elementCount += count;
+			}
+			else
+			{
+				_InterlockedExchange(&run.failed, 1);
+			}
+		}
+		ReleaseSemaphore(run.freeBuffers, 1, NULL);
+	}
+}
+
+Stream::Stream()
+:	m_buffers(NULL), m_chunkSize(0), m_bufferCount(0), m_taskCount(1), m_stageCount(0), m_elementCount(0)
+{
+}
+
+Stream::~Stream()
+{
+	clear();
+}
+
+/*!
+* Allocates the buffer ring, any previous buffers are freed; the stages are kept
+* \param chunkSize the number of elements per chunk, the unit of every read, stage call and write
+* \param bufferCount the number of chunks in flight, clamped to [1, MAX_BUFFERS]
+* \param taskCount passed to every stage
+* \return false if chunkSize is 0 or the buffers could not be allocated
+*/
+bool Stream::create(size_t chunkSize, size_t bufferCount, size_t taskCount)
+{
+	_aligned_free(m_buffers);
+	m_buffers = NULL;
+	m_chunkSize = 0;
+	m_bufferCount = 0;
+	if ( chunkSize == 0 )
+	{
+		return false;
+	}
+
+	bufferCount = bufferCount < 1 ? 1 : (bufferCount > MAX_BUFFERS ? MAX_BUFFERS : bufferCount);
+	m_buffers = static_cast<Vector4::Container*>(
+		_aligned_malloc(chunkSize * bufferCount * sizeof(Vector4::Container), 16));
+	if ( m_buffers == NULL )
+	{
+		return false;
+	}
+	m_chunkSize = chunkSize;
+	m_bufferCount = bufferCount;
+	m_taskCount = taskCount < 1 ? 1 : taskCount;
+	return true;
+}
+
+void Stream::clear()
+{
+	_aligned_free(m_buffers);
+	m_buffers = NULL;
+	m_chunkSize = 0;
+	m_bufferCount = 0;
+	m_taskCount = 1;
+	m_stageCount = 0;
+	m_elementCount = 0;
+}
+
+/*!
+* Appends a stage
+* \param stage the function to run on every chunk
+* \param context passed through to every call
+* \return false if there are already MAX_STAGES stages
+*/
+bool Stream::addStage(Stage stage, void *context)
+{
+	if ( m_stageCount == MAX_STAGES )
+	{
+		return false;
+	}
+	m_stages[m_stageCount] = stage;
+	m_stageContexts[m_stageCount] = context;
+	m_stageCount++;
+	return true;
+}
+
+void Stream::clearStages()
+{
+	m_stageCount = 0;
+}
+
+/*!
+* Streams everything the reader returns through the stages to the writer.  The reader and the writer run on their own
+* threads and the stages on the calling thread, and the call returns once the last chunk is written.
+* \param reader fills a chunk, returns 0 at the end of the data or READ_ERROR on failure
+* \param readerContext passed through to every reader call
+* \param writer writes a processed chunk, returns false on failure
+* \param writerContext passed through to every writer call
+* \return false if the stream was not created, a thread could not be started, or the reader or the writer failed
+*/
+bool Stream::run(Reader reader, void *readerContext, Writer writer, void *writerContext)
+{
+	m_elementCount = 0;
+	if ( m_buffers == NULL )
+	{
+		return false;
+	}
+
+	StreamRun run;
+	run.buffers = m_buffers;
+	run.chunkSize = m_chunkSize;
+	run.bufferCount = m_bufferCount;
+	run.reader = reader;
+	run.readerContext = readerContext;
+	run.writer = writer;
+	run.writerContext = writerContext;
+	run.freeBuffers = CreateSemaphore(NULL, LONG(m_bufferCount), LONG(m_bufferCount), NULL);
+	run.readBuffers = CreateSemaphore(NULL, 0, LONG(m_bufferCount), NULL);
+	run.processedBuffers = CreateSemaphore(NULL, 0, LONG(m_bufferCount), NULL);
+	run.failed = 0;
+	run.elementCount = 0;
+
+	HANDLE writerThread = NULL;
+	HANDLE readerThread = NULL;
+	if ( run.freeBuffers != NULL && run.readBuffers != NULL && run.processedBuffers != NULL )
+	{
+		writerThread = CreateThread(NULL, 0, streamWriterEntry, &run, 0, NULL);
+	}
+	if ( writerThread != NULL )
+	{
+		readerThread = CreateThread(NULL, 0, streamReaderEntry, &run, 0, NULL);
+		if ( readerThread == NULL )
+		{
+			// nothing was read, hand the writer the end of the data
+			run.counts[0] = 0;
+			ReleaseSemaphore(run.processedBuffers, 1, NULL);
+		}
+	}
+
+	if ( readerThread != NULL )
+	{
+		for ( size_t buffer = 0; ; buffer = (buffer + 1) % m_bufferCount )
+		{
+			WaitForSingleObject(run.readBuffers, INFINITE);
+			size_t count = run.counts[buffer];
+			if ( count > 0 && run.failed == 0 )
+			{
+				PATRICKMATH_TIME(STREAM_STAGE);
+				Vector4::Container *chunk = m_buffers + buffer * m_chunkSize;
+				for ( size_t stage = 0; stage < m_stageCount; stage++ )
+				{
+					m_stages[stage](m_stageContexts[stage], chunk, count, m_taskCount);
+				}
+			}
+			ReleaseSemaphore(run.processedBuffers, 1, NULL);
+			if ( count == 0 )
+			{
+				break;
+			}
+		}
+		WaitForSingleObject(readerThread, INFINITE);
+		CloseHandle(readerThread);
+	}
+	if ( writerThread != NULL )
+	{
+		WaitForSingleObject(writerThread, INFINITE);
+		CloseHandle(writerThread);
+	}
+
+	HANDLE semaphores [3] = {run.freeBuffers, run.readBuffers, run.processedBuffers};
+	for ( int i = 0; i < 3; i++ )
+	{
+		if ( semaphores[i] != NULL )
+		{
+			CloseHandle(semaphores[i]);
+		}
+	}
+
+	m_elementCount = run.elementCount;
+	return readerThread != NULL && run.failed == 0;
+}
+
+/*!
+* Transforms the chunk in place by the Affine3x4 the context points to, see Affine3x4::transformBatch
+*/
+void Stream::transformStage(void *context, Vector4::Container *chunk, size_t count, size_t taskCount)
+{
+	Affine3x4::transformBatch(*static_cast<const Affine3x4*>(context), chunk, chunk, count, taskCount);
+}
+
+static void normalizeKernel(void *context, size_t, size_t begin, size_t end)
+{
+	Vector4::Container *chunk = static_cast<Vector4::Container*>(context);
+	const __m128 one = _mm_set1_ps(1.f);
+	for ( size_t i = begin; i < end; i += 4 )
+	{
+		Soa::Vector v;
+		__m128 w = Soa::loadVector(chunk, i, end, v);
+		__m128 lengthSq = Soa::lengthSq(v);
+		XmmBool epsilonMask = _mm_cmpgt_ps(lengthSq, XmmFloat::EPSILON_SQ);
+		__m128 inverseLength = _mm_and_ps(epsilonMask, _mm_div_ps(one, _mm_sqrt_ps(lengthSq)));
+		Soa::storeVector(chunk, i, end, Soa::multiply(v, inverseLength), w);
+	}
+}
+
+/*!
+* Normalizes x, y and z of every element in place, w is kept so points stay points.  Like Vector4::safeNormalizeSq
+* with its default epsilon, elements whose squared length is not above XmmFloat::EPSILON_SQ come out as zero.
+*/
+void Stream::normalizeStage(void *, Vector4::Container *chunk, size_t count, size_t taskCount)
+{
+	ParallelFor::run(normalizeKernel, chunk, count, taskCount);
+}
+
+/*!
+* Reads up to capacity raw containers from the FILE * in context
+* \return the number of whole containers read, 0 at the end of the file, READ_ERROR if the read failed
+*/
+size_t Stream::readFile(void *context, Vector4::Container *destination, size_t capacity)
+{
+	FILE *file = static_cast<FILE*>(context);
+	size_t count = fread(destination, sizeof(Vector4::Container), capacity, file);
+	return count < capacity && ferror(file) ? READ_ERROR : count;
+}
+
+/*!
+* Writes count raw containers to the FILE * in context
+* \return false if the write failed
+*/
+bool Stream::writeFile(void *context, const Vector4::Container *source, size_t count)
+{
+	return fwrite(source, sizeof(Vector4::Container), count, static_cast<FILE*>(context)) == count;
+}
+
+/*!
+* Writes the 63 bit morton codes of count positions to the file of the MortonFile in context, encoded a block at a
+* time so that no chunk sized scratch array is needed
+* \return false if the write failed
+*/
+bool Stream::writeMortonFile(void *context, const Vector4::Container *source, size_t count)
+{
+	const MortonFile &morton = *static_cast<const MortonFile*>(context);
+	const size_t BLOCK_SIZE = 256;
+	uint64_t codes [BLOCK_SIZE];
+	for ( size_t i = 0; i < count; i += BLOCK_SIZE )
+	{
+		size_t blockCount = count - i < BLOCK_SIZE ? count - i : BLOCK_SIZE;
+		Quantize::mortonEncode63(source + i, morton.boundsMin, morton.boundsMax, codes, blockCount);
+		if ( fwrite(codes, sizeof(uint64_t), blockCount, morton.file) != blockCount )
+		{
+			return false;
+		}
+	}
+	return true;
+}
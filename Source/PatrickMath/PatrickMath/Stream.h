@@ -0,0 +1,120 @@
+/*!
+* \file Stream.h
+* \author Patrick Martin
+* \date 2010
+* \brief Streaming read, compute, write pipeline with bounded buffering
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "Vector4.h"
+
+/*!
+* A read, compute, write pipeline over Vector4 data that never holds more than a few chunks in memory, for datasets
+* too big to load.  A reader thread fills chunks, the calling thread runs every stage over a chunk in place (each stage
+* is free to use ParallelFor with the stream's taskCount), and a writer thread drains them.  The chunks cycle through
+* a ring of bufferCount buffers, so with the default of three the read of chunk i + 1 and the write of chunk i - 1
+* overlap the compute of chunk i, and a slow side only stalls the others once the ring is full.
+*
+* Readers, stages and writers are plain functions with a context pointer like ParallelFor kernels.  A reader returns
+* the number of elements it read, 0 at the end of the data or READ_ERROR on failure; a writer returns false on failure.
+* Either failure stops the stream and makes run return false.  Chunks are processed and written in the order they were
+* read.
+*/
+class Stream
+{
+public:
+	typedef size_t (*Reader)(void *context, Vector4::Container *destination, size_t capacity);
+	typedef void (*Stage)(void *context, Vector4::Container *chunk, size_t count, size_t taskCount);
+	typedef bool (*Writer)(void *context, const Vector4::Container *source, size_t count);
+
+	static const size_t READ_ERROR = ~size_t(0);
+	static const size_t MAX_STAGES = 16;
+	static const size_t MAX_BUFFERS = 8;
+
+	// context of writeMortonFile, the codes use 21 bits per axis within the bounds
+	struct MortonFile
+	{
+		FILE *file;
+		Vector4::Container boundsMin;
+		Vector4::Container boundsMax;
+	};
+
+	Stream();
+	~Stream();
+
+	// bufferCount is clamped to [1, MAX_BUFFERS], 2 for double buffering and 3 (the default) for triple
+	bool create(size_t chunkSize, size_t bufferCount = 3, size_t taskCount = 1);
+	void clear();
+
+	// stages run in the order they were added
+	bool addStage(Stage stage, void *context);
+	void clearStages();
+
+	bool run(Reader reader, void *readerContext, Writer writer, void *writerContext);
+	uint64_t elementCount() const;
+
+	// stages: transformStage takes a const Affine3x4 *, normalizeStage normalizes x, y, z and keeps w
+	static void transformStage(void *context, Vector4::Container *chunk, size_t count, size_t taskCount);
+	static void normalizeStage(void *context, Vector4::Container *chunk, size_t count, size_t taskCount);
+
+	// raw Vector4::Container files, the context is the FILE *
+	static size_t readFile(void *context, Vector4::Container *destination, size_t capacity);
+	static bool writeFile(void *context, const Vector4::Container *source, size_t count);
+
+	// 63 bit morton codes, 8 bytes per element instead of 16, the context is a MortonFile *
+	static bool writeMortonFile(void *context, const Vector4::Container *source, size_t count);
+
+private:
+	// not copyable, the buffers are owned
+	Stream(const Stream &);
+	Stream &operator=(const Stream &);
+
+	Vector4::Container *m_buffers;
+	size_t m_chunkSize;
+	size_t m_bufferCount;
+	size_t m_taskCount;
+
+	Stage m_stages [MAX_STAGES];
+	void *m_stageContexts [MAX_STAGES];
+	size_t m_stageCount;
+
+	uint64_t m_elementCount;
+};
+
+/*!
+* \return the number of elements the last run wrote (or, if it failed, handed to the writer)
+*/
+inline uint64_t Stream::elementCount() const
+{
+	return m_elementCount;
+}
@@ -0,0 +1,328 @@
+/*!
+* \file TransformHierarchy.cpp
+* \author Patrick Martin
+* \date 2010
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "stdafx.h"
+#include "TransformHierarchy.h"
+
+#include <emmintrin.h>
+#include <malloc.h>
+#include <string.h>
+
+#include "ParallelFor.h"
+
+struct HierarchyLevel
+{
+	const Vector4::Container *translations;
+	const Quaternion::Container *rotations;
+	const Vector4::Container *scales;
+	Matrix4::Container *worlds;
+	const uint32_t *parents;
+	uint8_t *dirty;
+	size_t offset;
+	size_t updated [ParallelFor::MAX_TASKS];
+};
+
+/*!
+* \return true if any flag in [begin, end) is raised, sixteen at a time
+*/
+static bool anyRaised(const uint8_t *flags, size_t begin, size_t end)
+{
+	const __m128i zero = _mm_setzero_si128();
+	for ( ; begin + 16 <= end; begin += 16 )
+	{
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(flags + begin));
+		if ( _mm_movemask_epi8(_mm_cmpeq_epi8(block, zero)) != 0xffff )
+		{
+			return true;
+		}
+	}
+	for ( ; begin < end; begin++ )
+	{
+		if ( flags[begin] )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/*!
+* Updates one range of one level.  The parents are a level up and already final, so the nodes of a level can be split
+* between tasks freely.  A node is recomputed if it is dirty or its parent is, and it then raises its own flag so the
+* next level sees it.
+*/
+static void hierarchyKernel(void *context, size_t taskIndex, size_t begin, size_t end)
+{
+	HierarchyLevel *level = static_cast<HierarchyLevel*>(context);
+	const uint32_t *parents = level->parents;
+	uint8_t *dirty = level->dirty;
+	size_t updated = 0;
+
+	begin += level->offset;
+	end += level->offset;
+	for ( size_t block = begin; block < end; block += 16 )
+	{
+		size_t blockEnd = block + 16 < end ? block + 16 : end;
+
+		// breadth first order keeps the parents of a block sorted and usually adjacent, test them as one range
+		if ( !anyRaised(dirty, block, blockEnd) )
+		{
+			uint32_t first = parents[block];
+			uint32_t last = parents[blockEnd - 1];
+			if ( first == TransformHierarchy::NO_PARENT || !anyRaised(dirty, first, size_t(last) + 1) )
+			{
+				continue;
+			}
+		}
+
+		for ( size_t i = block; i < blockEnd; i++ )
+		{
+			uint32_t parent = parents[i];
+			bool parentDirty = parent != TransformHierarchy::NO_PARENT && dirty[parent];
+			if ( !dirty[i] && !parentDirty )
+			{
+				continue;
+			}
+
+			Matrix4 world = Matrix4::fromTransform(
+				Vector4(level->translations[i]), Quaternion(level->rotations[i]), Vector4(level->scales[i]));
+			if ( parent != TransformHierarchy::NO_PARENT )
+			{
+				world = Matrix4(level->worlds[parent]).multiply(world);
+			}
+			world.get(level->worlds[i]);
+			dirty[i] = 1;
+			PATRICKMATH_COUNT(TRANSFORM_NODE_UPDATE);
+			updated++;
+		}
+	}
+	level->updated[taskIndex] += updated;
+}
+
+TransformHierarchy::TransformHierarchy()
+:	m_translations(NULL), m_rotations(NULL), m_scales(NULL), m_worlds(NULL), m_parents(NULL), m_nodeIndices(NULL),
+	m_dirty(NULL), m_levelBegins(NULL), m_size(0), m_levelCount(0), m_firstDirty(0)
+{
+}
+
+TransformHierarchy::~TransformHierarchy()
+{
+	clear();
+}
+
+/*!
+* Frees every array, the hierarchy is then empty
+*/
+void TransformHierarchy::clear()
+{
+	_aligned_free(m_translations);
+	_aligned_free(m_rotations);
+	_aligned_free(m_scales);
+	_aligned_free(m_worlds);
+	delete [] m_parents;
+	delete [] m_nodeIndices;
+	delete [] m_dirty;
+	delete [] m_levelBegins;
+
+	m_translations = NULL;
+	m_rotations = NULL;
+	m_scales = NULL;
+	m_worlds = NULL;
+	m_parents = NULL;
+	m_nodeIndices = NULL;
+	m_dirty = NULL;
+	m_levelBegins = NULL;
+	m_size = 0;
+	m_levelCount = 0;
+	m_firstDirty = 0;
+}
+
+/*!
+* Lays out the hierarchy breadth first.  Every node starts with an identity local transform and dirty, so the first
+* update() computes every world matrix.
+* \param parents the parent of every node in build order, NO_PARENT for roots.  A parent must come before its children
+* (parents[i] < i) which also rules out cycles.
+* \param count the number of nodes
+* \return false if the parents are not ordered, the hierarchy is then empty
+*/
+bool TransformHierarchy::build(const uint32_t *parents, size_t count)
+{
+	clear();
+	for ( size_t i = 0; i < count; i++ )
+	{
+		if ( parents[i] != NO_PARENT && parents[i] >= i )
+		{
+			return false;
+		}
+	}
+
+	// children of every node in build order, as offsets into one list
+	uint32_t *childBegins = new uint32_t [count + 1];
+	uint32_t *children = new uint32_t [count];
+	memset(childBegins, 0, (count + 1) * sizeof(uint32_t));
+	for ( size_t i = 0; i < count; i++ )
+	{
+		if ( parents[i] != NO_PARENT )
+		{
+			childBegins[parents[i] + 1]++;
+		}
+	}
+	for ( size_t i = 0; i < count; i++ )
+	{
+		childBegins[i + 1] += childBegins[i];
+	}
+	uint32_t *childEnds = new uint32_t [count];
+	memcpy(childEnds, childBegins, count * sizeof(uint32_t));
+	for ( size_t i = 0; i < count; i++ )
+	{
+		if ( parents[i] != NO_PARENT )
+		{
+			children[childEnds[parents[i]]++] = uint32_t(i);
+		}
+	}
+	delete [] childEnds;
+
+	// breadth first: roots in build order, then the children of each stored node in turn
+	uint32_t *order = new uint32_t [count];
+	uint32_t *depths = new uint32_t [count];
+	m_nodeIndices = new uint32_t [count];
+	size_t stored = 0;
+	for ( size_t i = 0; i < count; i++ )
+	{
+		if ( parents[i] == NO_PARENT )
+		{
+			m_nodeIndices[i] = uint32_t(stored);
+			depths[stored] = 0;
+			order[stored++] = uint32_t(i);
+		}
+	}
+	for ( size_t next = 0; next < stored; next++ )
+	{
+		uint32_t node = order[next];
+		for ( uint32_t child = childBegins[node]; child < childBegins[node + 1]; child++ )
+		{
+			m_nodeIndices[children[child]] = uint32_t(stored);
+			depths[stored] = depths[next] + 1;
+			order[stored++] = children[child];
+		}
+	}
+	delete [] childBegins;
+	delete [] children;
+
+	m_size = count;
+	m_levelCount = count > 0 ? depths[count - 1] + 1 : 0;
+	m_levelBegins = new size_t [m_levelCount + 1];
+	for ( size_t i = 0, level = 0; i < count; i++ )
+	{
+		if ( i == 0 || depths[i] != depths[i - 1] )
+		{
+			m_levelBegins[level++] = i;
+		}
+	}
+	m_levelBegins[m_levelCount] = count;
+	delete [] depths;
+
+	m_parents = new uint32_t [count];
+	for ( size_t i = 0; i < count; i++ )
+	{
+		uint32_t parent = parents[order[i]];
+		m_parents[i] = parent == NO_PARENT ? NO_PARENT : m_nodeIndices[parent];
+	}
+	delete [] order;
+
+	m_translations = static_cast<Vector4::Container*>(_aligned_malloc(count * sizeof(Vector4::Container), 16));
+	m_rotations = static_cast<Quaternion::Container*>(_aligned_malloc(count * sizeof(Quaternion::Container), 16));
+	m_scales = static_cast<Vector4::Container*>(_aligned_malloc(count * sizeof(Vector4::Container), 16));
+	m_worlds = static_cast<Matrix4::Container*>(_aligned_malloc(count * sizeof(Matrix4::Container), 16));
+	m_dirty = new uint8_t [count];
+
+	Vector4::Container zero = {0.f, 0.f, 0.f, 1.f};
+	Vector4::Container one = {1.f, 1.f, 1.f, 0.f};
+	Quaternion::Container identity;
+	Quaternion::IDENTITY.get(identity);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		m_translations[i] = zero;
+		m_rotations[i] = identity;
+		m_scales[i] = one;
+	}
+	memset(m_dirty, 1, count);
+	m_firstDirty = 0;
+	return true;
+}
+
+/*!
+* Recomputes the world matrix of every dirty node and of everything below it, one level at a time.  Levels before the
+* first dirty node are not touched at all.
+* \param taskCount the number of threads to split large levels over
+* \return the number of world matrices recomputed
+*/
+size_t TransformHierarchy::update(size_t taskCount)
+{
+	PATRICKMATH_TIME(TRANSFORM_UPDATE);
+	if ( m_firstDirty >= m_size )
+	{
+		return 0;
+	}
+
+	size_t firstLevel = 0;
+	while ( m_levelBegins[firstLevel + 1] <= m_firstDirty )
+	{
+		firstLevel++;
+	}
+
+	HierarchyLevel level;
+	level.translations = m_translations;
+	level.rotations = m_rotations;
+	level.scales = m_scales;
+	level.worlds = m_worlds;
+	level.parents = m_parents;
+	level.dirty = m_dirty;
+	memset(level.updated, 0, sizeof(level.updated));
+
+	for ( size_t depth = firstLevel; depth < m_levelCount; depth++ )
+	{
+		size_t count = m_levelBegins[depth + 1] - m_levelBegins[depth];
+		level.offset = m_levelBegins[depth];
+		ParallelFor::run(hierarchyKernel, &level, count, count >= MIN_PARALLEL_LEVEL ? taskCount : 1);
+	}
+
+	size_t cleared = m_levelBegins[firstLevel];
+	memset(m_dirty + cleared, 0, m_size - cleared);
+	m_firstDirty = m_size;
+
+	size_t updated = 0;
+	for ( size_t i = 0; i < ParallelFor::MAX_TASKS; i++ )
+	{
+		updated += level.updated[i];
+	}
+	return updated;
+}
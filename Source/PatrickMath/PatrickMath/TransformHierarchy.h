@@ -0,0 +1,216 @@
+/*!
+* \file TransformHierarchy.h
+* \author Patrick Martin
+* \date 2010
+* \brief A flattened, breadth first transform hierarchy with dirty propagation
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Matrix4.h"
+#include "Quaternion.h"
+#include "Vector4.h"
+
+/*!
+* A flattened scene graph.  Nodes are stored breadth first so every level of the tree is one contiguous range and every
+* parent comes before its children.  Local translation, rotation and scale live in separate arrays, setters only raise
+* a dirty flag, and update() walks the levels in order recomputing the world matrix of dirty nodes and of every node
+* whose parent was recomputed.  Clean stretches are skipped sixteen flags at a time, so a frame where a few percent of
+* the nodes move costs little more than those nodes.
+*
+* Nodes are addressed by their storage index, use nodeIndex() to map the index used when building.
+*/
+class TransformHierarchy
+{
+public:
+	static const uint32_t NO_PARENT = 0xffffffff;
+
+	// levels smaller than this are updated on the calling thread, starting threads costs more than the matrices
+	static const size_t MIN_PARALLEL_LEVEL = 4096;
+
+	TransformHierarchy();
+	~TransformHierarchy();
+
+	// building
+	bool build(const uint32_t *parents, size_t count);
+	void clear();
+
+	// layout
+	size_t size() const;
+	size_t levelCount() const;
+	size_t levelBegin(size_t level) const;
+	uint32_t nodeIndex(uint32_t buildIndex) const;
+	uint32_t parent(uint32_t node) const;
+
+	// local transforms, every setter marks the node dirty
+	void setLocal(uint32_t node, const Vector4 &translation, const Quaternion &rotation, const Vector4 &scale);
+	void setTranslation(uint32_t node, const Vector4 &translation);
+	void setRotation(uint32_t node, const Quaternion &rotation);
+	void setScale(uint32_t node, const Vector4 &scale);
+
+	Vector4 translation(uint32_t node) const;
+	Quaternion rotation(uint32_t node) const;
+	Vector4 scale(uint32_t node) const;
+	bool isDirty(uint32_t node) const;
+
+	// world transforms, valid after update()
+	Matrix4 world(uint32_t node) const;
+	const Matrix4::Container *worlds() const;
+
+	size_t update(size_t taskCount = 1);
+
+private:
+	// not copyable, the arrays are owned
+	TransformHierarchy(const TransformHierarchy &);
+	TransformHierarchy &operator=(const TransformHierarchy &);
+
+	void markDirty(uint32_t node);
+
+	Vector4::Container *m_translations;
+	Quaternion::Container *m_rotations;
+	Vector4::Container *m_scales;
+	Matrix4::Container *m_worlds;
+	uint32_t *m_parents;
+	uint32_t *m_nodeIndices;
+	uint8_t *m_dirty;
+	size_t *m_levelBegins;
+	size_t m_size;
+	size_t m_levelCount;
+	size_t m_firstDirty;
+};
+
+inline size_t TransformHierarchy::size() const
+{
+	return m_size;
+}
+
+inline size_t TransformHierarchy::levelCount() const
+{
+	return m_levelCount;
+}
+
+/*!
+* \param level a depth in [0, levelCount()], levelBegin(levelCount()) is size()
+* \return the storage index of the first node at that depth
+*/
+inline size_t TransformHierarchy::levelBegin(size_t level) const
+{
+	return m_levelBegins[level];
+}
+
+/*!
+* \param buildIndex the index the node had in the parents array given to build()
+* \return the node's storage index
+*/
+inline uint32_t TransformHierarchy::nodeIndex(uint32_t buildIndex) const
+{
+	return m_nodeIndices[buildIndex];
+}
+
+/*!
+* \return the storage index of the node's parent or NO_PARENT for roots
+*/
+inline uint32_t TransformHierarchy::parent(uint32_t node) const
+{
+	return m_parents[node];
+}
+
+inline void TransformHierarchy::markDirty(uint32_t node)
+{
+	m_dirty[node] = 1;
+	if ( node < m_firstDirty )
+	{
+		m_firstDirty = node;
+	}
+}
+
+inline void TransformHierarchy::setLocal(
+	uint32_t node, const Vector4 &translation, const Quaternion &rotation, const Vector4 &scale)
+{
+	translation.get(m_translations[node]);
+	rotation.get(m_rotations[node]);
+	scale.get(m_scales[node]);
+	markDirty(node);
+}
+
+inline void TransformHierarchy::setTranslation(uint32_t node, const Vector4 &translation)
+{
+	translation.get(m_translations[node]);
+	markDirty(node);
+}
+
+inline void TransformHierarchy::setRotation(uint32_t node, const Quaternion &rotation)
+{
+	rotation.get(m_rotations[node]);
+	markDirty(node);
+}
+
+inline void TransformHierarchy::setScale(uint32_t node, const Vector4 &scale)
+{
+	scale.get(m_scales[node]);
+	markDirty(node);
+}
+
+inline Vector4 TransformHierarchy::translation(uint32_t node) const
+{
+	return Vector4(m_translations[node]);
+}
+
+inline Quaternion TransformHierarchy::rotation(uint32_t node) const
+{
+	return Quaternion(m_rotations[node]);
+}
+
+inline Vector4 TransformHierarchy::scale(uint32_t node) const
+{
+	return Vector4(m_scales[node]);
+}
+
+/*!
+* \return true if the node's local transform changed since the last update (its world matrix is stale)
+*/
+inline bool TransformHierarchy::isDirty(uint32_t node) const
+{
+	return m_dirty[node] != 0;
+}
+
+inline Matrix4 TransformHierarchy::world(uint32_t node) const
+{
+	return Matrix4(m_worlds[node]);
+}
+
+/*!
+* \return every world matrix in storage order, for uploading or batch processing
+*/
+inline const Matrix4::Container *TransformHierarchy::worlds() const
+{
+	return m_worlds;
+}
@@ -32,6 +32,9 @@
 #include "stdafx.h"
 #include "Vector4.h"
 
+#include "ParallelFor.h"
+#include "Soa.h"
+
 const Vector4::Container unitX = {1,0,0,0};
 const Vector4::Container unitY = {0,1,0,0};
 const Vector4::Container unitZ = {0,0,1,0};
@@ -44,3 +47,204 @@ const Vector4 Vector4::UNIT_X = unitX;
 const Vector4 Vector4::UNIT_Y = unitY;
 const Vector4 Vector4::UNIT_Z = unitZ;
 const Vector4 Vector4::UNIT_W = unitW;
+
+static inline const float *stridedElement(const float *base, size_t stride, size_t index)
+{
+	return reinterpret_cast<const float*>(reinterpret_cast<const char*>(base) + index * stride);
+}
+
+static inline float *stridedElement(float *base, size_t stride, size_t index)
+{
+	return reinterpret_cast<float*>(reinterpret_cast<char*>(base) + index * stride);
+}
+
+/*!
+* Loads four float3s starting at source.  Tightly packed ones are three unaligned loads covering exactly the 48 bytes
+* and four shuffles, anything else is gathered one element at a time.
+*/
+static inline void loadFloat3Block(const float *source, size_t stride, float w, __m128 vectors [4])
+{
+	if ( stride == 3 * sizeof(float) )
+	{
+		__m128 a = _mm_loadu_ps(source); // x0, y0, z0, x1
+		__m128 b = _mm_loadu_ps(source + 4); // y1, z1, x2, y2
+		__m128 c = _mm_loadu_ps(source + 8); // z2, x3, y3, z3
+		__m128 ws = _mm_set1_ps(w);
+		vectors[0] = _mm_shuffle_ps(a, _mm_shuffle_ps(a, ws, _MM_SHUFFLE(0,0,2,2)), _MM_SHUFFLE(2,0,1,0));
+		vectors[1] = _mm_shuffle_ps(
+			_mm_shuffle_ps(a, b, _MM_SHUFFLE(0,0,3,3)), _mm_shuffle_ps(b, ws, _MM_SHUFFLE(0,0,1,1)), _MM_SHUFFLE(2,0,2,0));
+		vectors[2] = _mm_shuffle_ps(b, _mm_shuffle_ps(c, ws, _MM_SHUFFLE(0,0,0,0)), _MM_SHUFFLE(2,0,3,2));
+		vectors[3] = _mm_shuffle_ps(c, _mm_shuffle_ps(c, ws, _MM_SHUFFLE(0,0,3,3)), _MM_SHUFFLE(2,0,2,1));
+		return;
+	}
+	for ( size_t i = 0; i < 4; i++ )
+	{
+		vectors[i] = Vector4::loadFloat3(stridedElement(source, stride, i), w);
+	}
+}
+
+/*!
+* Writes x, y and z of four vectors as float3s starting at destination, the reverse of loadFloat3Block; whatever lies
+* between strided elements is left alone
+*/
+static inline void storeFloat3Block(const __m128 vectors [4], float *destination, size_t stride)
+{
+	if ( stride == 3 * sizeof(float) )
+	{
+		__m128 v0 = vectors[0], v1 = vectors[1], v2 = vectors[2], v3 = vectors[3];
+		_mm_storeu_ps(destination, _mm_shuffle_ps(v0, _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(0,0,2,2)), _MM_SHUFFLE(2,0,1,0)));
+		_mm_storeu_ps(destination + 4, _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(1,0,2,1)));
+		_mm_storeu_ps(destination + 8, _mm_shuffle_ps(_mm_shuffle_ps(v2, v3, _MM_SHUFFLE(0,0,2,2)), v3, _MM_SHUFFLE(2,1,2,0)));
+		return;
+	}
+	for ( size_t i = 0; i < 4; i++ )
+	{
+		Vector4(vectors[i]).storeFloat3(stridedElement(destination, stride, i));
+	}
+}
+
+/*!
+* Widens float3s (a packed array or one member of an interleaved vertex struct) to Vector4 containers
+* \param source the x of the first float3, no alignment requirement
+* \param stride the distance in bytes from one float3 to the next
+* \param w the w of every result, 1 for points and 0 for directions
+* \param destination the containers to write
+* \param count the number of elements
+*/
+void Vector4::fromFloat3Batch(const float *source, size_t stride, float w, Container *destination, size_t count)
+{
+	PATRICKMATH_TIME(FLOAT3_CONVERT);
+	size_t i = 0;
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		__m128 vectors [4];
+		loadFloat3Block(stridedElement(source, stride, i), stride, w, vectors);
+		_mm_store_ps(destination[i].elements, vectors[0]);
+		_mm_store_ps(destination[i + 1].elements, vectors[1]);
+		_mm_store_ps(destination[i + 2].elements, vectors[2]);
+		_mm_store_ps(destination[i + 3].elements, vectors[3]);
+	}
+	for ( ; i < count; i++ )
+	{
+		_mm_store_ps(destination[i].elements, loadFloat3(stridedElement(source, stride, i), w));
+	}
+}
+
+/*!
+* Narrows Vector4 containers to float3s, w is dropped
+* \param source the containers to read
+* \param destination the x of the first float3, no alignment requirement
+* \param stride the distance in bytes from one float3 to the next
+* \param count the number of elements
+*/
+void Vector4::toFloat3Batch(const Container *source, float *destination, size_t stride, size_t count)
+{
+	PATRICKMATH_TIME(FLOAT3_CONVERT);
+	size_t i = 0;
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		__m128 vectors [4] = {
+			_mm_load_ps(source[i].elements), _mm_load_ps(source[i + 1].elements),
+			_mm_load_ps(source[i + 2].elements), _mm_load_ps(source[i + 3].elements)};
+		storeFloat3Block(vectors, stridedElement(destination, stride, i), stride);
+	}
+	for ( ; i < count; i++ )
+	{
+		Vector4(source[i]).storeFloat3(stridedElement(destination, stride, i));
+	}
+}
+
+/*!
+* Splits float3s into one array per component, four elements per transpose
+* \param source the x of the first float3, no alignment requirement
+* \param stride the distance in bytes from one float3 to the next
+* \param x receives the x components, no alignment requirement (likewise y and z)
+* \param count the number of elements
+*/
+void Vector4::float3ToSoa(const float *source, size_t stride, float *x, float *y, float *z, size_t count)
+{
+	PATRICKMATH_TIME(FLOAT3_CONVERT);
+	size_t i = 0;
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		__m128 v [4];
+		loadFloat3Block(stridedElement(source, stride, i), stride, 0.f, v);
+		_MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]);
+		_mm_storeu_ps(x + i, v[0]);
+		_mm_storeu_ps(y + i, v[1]);
+		_mm_storeu_ps(z + i, v[2]);
+	}
+	for ( ; i < count; i++ )
+	{
+		const float *element = stridedElement(source, stride, i);
+		x[i] = element[0];
+		y[i] = element[1];
+		z[i] = element[2];
+	}
+}
+
+/*!
+* Interleaves component arrays back into float3s
+* \param x the x components, no alignment requirement (likewise y and z)
+* \param destination the x of the first float3, no alignment requirement
+* \param stride the distance in bytes from one float3 to the next
+* \param count the number of elements
+*/
+void Vector4::soaToFloat3(
+	const float *x, const float *y, const float *z, float *destination, size_t stride, size_t count)
+{
+	PATRICKMATH_TIME(FLOAT3_CONVERT);
+	size_t i = 0;
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		__m128 v [4] = {_mm_loadu_ps(x + i), _mm_loadu_ps(y + i), _mm_loadu_ps(z + i), _mm_setzero_ps()};
+		_MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]);
+		storeFloat3Block(v, stridedElement(destination, stride, i), stride);
+	}
+	for ( ; i < count; i++ )
+	{
+		float *element = stridedElement(destination, stride, i);
+		element[0] = x[i];
+		element[1] = y[i];
+		element[2] = z[i];
+	}
+}
+
+struct AngleBatch
+{
+	const Vector4::Container *lhs;
+	const Vector4::Container *rhs;
+	float *angles;
+};
+
+/*!
+* Transposes four pairs so the cross and dot products work on four lanes at once
+*/
+static void angleBetweenKernel(void *context, size_t, size_t begin, size_t end)
+{
+	AngleBatch &batch = *static_cast<AngleBatch*>(context);
+	for ( size_t i = begin; i < end; i += 4 )
+	{
+		Soa::Vector a, b;
+		Soa::loadVector(batch.lhs, i, end, a);
+		Soa::loadVector(batch.rhs, i, end, b);
+		__m128 crossLength = _mm_sqrt_ps(Soa::lengthSq(Soa::cross(a, b)));
+		Soa::storeLanes(batch.angles, i, end, XmmFloat::atan2(crossLength, Soa::dot(a, b)));
+	}
+}
+
+/*!
+* Angles between pairs of directions, see angleBetween
+* \param lhs the first directions, w = 0
+* \param rhs the second directions, w = 0
+* \param angles receives the angles in [0, pi]
+* \param count the number of pairs
+* \param taskCount the number of tasks the batch is split into
+*/
+void Vector4::angleBetweenBatch(
+	const Container *lhs, const Container *rhs, float *angles, size_t count, size_t taskCount)
+{
+	PATRICKMATH_TIME(ORIENTATION_BATCH);
+	AngleBatch batch = {lhs, rhs, angles};
+	ParallelFor::run(angleBetweenKernel, &batch, count, taskCount);
+}
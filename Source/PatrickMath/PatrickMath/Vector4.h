@@ -38,8 +38,10 @@
 #pragma once
 
 #include <limits>
+#include <stddef.h>
 #include <xmmintrin.h>
 
+#include "Instrumentation.h"
 #include "XmmFloat.h"
 
 __declspec(align(16))
@@ -75,6 +77,7 @@ public:
 	Vector4 subtract(const Vector4 &rhs) const;
 	Vector4 negate() const;
 	Vector4 crossProduct(const Vector4 &rhs) const;
+	XmmFloat angleBetween(const Vector4 &rhs) const;
 	Vector4 normalize() const;
 	Vector4 safeNormalize(const XmmFloat &epsilon = XmmFloat::EPSILON) const;
 	Vector4 safeNormalizeSq(const XmmFloat &epsilonSq = XmmFloat::EPSILON_SQ) const;
@@ -93,9 +96,26 @@ public:
 
 	// reads
 	Container &get(Container &destination) const;
+	float *storeUnaligned(float *destination) const;
+	float *storeFloat3(float *destination) const;
 
 	// writes
 	Vector4 &set(const Container &source);
+	static Vector4 loadUnaligned(const float *source);
+	static Vector4 loadFloat3(const float *source, float w);
+
+	operator __m128 () const;
+
+	// batch conversions with float3 arrays, strides are in bytes (12 for tightly packed, the vertex size for interleaved)
+	static void fromFloat3Batch(const float *source, size_t stride, float w, Container *destination, size_t count);
+	static void toFloat3Batch(const Container *source, float *destination, size_t stride, size_t count);
+	static void float3ToSoa(const float *source, size_t stride, float *x, float *y, float *z, size_t count);
+	static void soaToFloat3(
+		const float *x, const float *y, const float *z, float *destination, size_t stride, size_t count);
+
+	// angles[i] = lhs[i].angleBetween(rhs[i]), four at a time with one atan2 per four
+	static void angleBetweenBatch(
+		const Container *lhs, const Container *rhs, float *angles, size_t count, size_t taskCount = 1);
 
 	/*
 	* TODO:
@@ -175,6 +195,7 @@ inline Vector4 &Vector4::operator=(const Vector4::Container &copy)
 */
 inline XmmFloat Vector4::dotProduct(const Vector4 &rhs) const
 {
+	PATRICKMATH_COUNT(VECTOR4_DOT_PRODUCT);
 	__m128 r0, r1;
 	r0 = _mm_mul_ps(elements, rhs.elements); // l0*r0, l1*r1, l2*r2, l3*r3; 0, 1, 2, 3
 	r1 = _mm_shuffle_ps(r0, r0, _MM_SHUFFLE(0,1,2,3)); // 3, 2, 1, 0
@@ -226,6 +247,7 @@ inline Vector4 Vector4::negate() const
 */
 inline Vector4 Vector4::crossProduct(const Vector4 &rhs) const
 {
+	PATRICKMATH_COUNT(VECTOR4_CROSS_PRODUCT);
 	Vector4 result;
 	__m128 temp1 = _mm_shuffle_ps(elements, elements, _MM_SHUFFLE(3,0,2,1));
 	__m128 temp2 = _mm_shuffle_ps(rhs.elements, rhs.elements, _MM_SHUFFLE(3,1,0,2));
@@ -242,6 +264,18 @@ inline Vector4 Vector4::crossProduct(const Vector4 &rhs) const
 	return result;
 }
 
+/*!
+* The angle between two directions as atan2(|a x b|, a . b).  Unlike acos of the normalized dot product this needs no
+* normalization and stays accurate for nearly parallel and nearly opposite directions, where acos loses half its bits.
+* \param rhs the other direction, neither needs to be unit length but both need w = 0
+* \return the angle in [0, pi] in all four elements, 0 if either direction is zero
+*/
+inline XmmFloat Vector4::angleBetween(const Vector4 &rhs) const
+{
+	Vector4 cross = crossProduct(rhs);
+	return XmmFloat::atan2(_mm_sqrt_ps(cross.dotProduct(cross)), dotProduct(rhs));
+}
+
 /*!
 * Normalizes a Vector4, does not perform a divide by zero check, does not verify that the 4th elment (w) is 0
 * Normalizing a point has no value, so I choose to ignore this.  Also could be useful if extended to a Quaternion class
@@ -249,6 +283,7 @@ inline Vector4 Vector4::crossProduct(const Vector4 &rhs) const
 */
 inline Vector4 Vector4::normalize() const
 {
+	PATRICKMATH_COUNT(VECTOR4_NORMALIZE);
 	Vector4 result;
 	__m128 length = _mm_sqrt_ps(dotProduct(*this));
 	result.elements = _mm_div_ps(elements, length);
@@ -265,6 +300,7 @@ inline Vector4 Vector4::normalize() const
 */
 inline Vector4 Vector4::safeNormalize(const XmmFloat &epsilon) const
 {
+	PATRICKMATH_COUNT(VECTOR4_NORMALIZE);
 	Vector4 result;
 	XmmFloat length = _mm_sqrt_ps(dotProduct(*this));
 	XmmBool epsilonMask = length > epsilon;
@@ -283,6 +319,7 @@ inline Vector4 Vector4::safeNormalize(const XmmFloat &epsilon) const
 */
 inline Vector4 Vector4::safeNormalizeSq(const XmmFloat &epsilonSq) const
 {
+	PATRICKMATH_COUNT(VECTOR4_NORMALIZE);
 	Vector4 result;
 	XmmFloat lengthSq = dotProduct(*this);
 	XmmBool epsilonMask = lengthSq > epsilonSq;
@@ -299,6 +336,7 @@ inline Vector4 Vector4::safeNormalizeSq(const XmmFloat &epsilonSq) const
 */
 inline XmmBool Vector4::isEqual(const Vector4 &rhs) const
 {
+	PATRICKMATH_COUNT(VECTOR4_COMPARE);
 	__m128 compare = _mm_cmpeq_ps(elements, rhs.elements); // a, b, c, d
 	__m128 cmpSwap = _mm_shuffle_ps(compare,compare,_MM_SHUFFLE(1,0,3,2)); // c, d, a, b
 	compare = _mm_and_ps(compare, cmpSwap); // a&c, b&d, a&c, b&d
@@ -314,9 +352,10 @@ inline XmmBool Vector4::isEqual(const Vector4 &rhs) const
 */
 inline XmmBool Vector4::isEqual(const Vector4 &rhs, const XmmFloat &epsilon) const
 {
+	PATRICKMATH_COUNT(VECTOR4_COMPARE);
 	__m128 diff = _mm_sub_ps(elements, rhs.elements);
 	__m128 absDiff = _mm_max_ps(diff, _mm_sub_ps(_mm_setzero_ps(), diff)); // abs = max (x, 0-x))
-	__m128 compare = _mm_cmple_ps(diff, epsilon); // is diff <= epsilon? then raise bits::a, b, c, d
+	__m128 compare = _mm_cmple_ps(absDiff, epsilon); // is |diff| <= epsilon? then raise bits::a, b, c, d
 	__m128 cmpSwap = _mm_shuffle_ps(compare,compare,_MM_SHUFFLE(1,0,3,2)); // c, d, a, b
 	compare = _mm_and_ps(compare, cmpSwap); // a&c, b&d, a&c, b&d
 	cmpSwap = _mm_shuffle_ps(compare, compare, _MM_SHUFFLE(0,1,2,3)); // b&d, a&c, b&d, a&c
@@ -330,6 +369,7 @@ inline XmmBool Vector4::isEqual(const Vector4 &rhs, const XmmFloat &epsilon) con
 */
 inline Vector4::Container &Vector4::get(Vector4::Container &destination) const
 {
+	PATRICKMATH_COUNT(VECTOR4_GET);
 	_mm_store_ps(destination.elements, elements);
 	return destination;
 }
@@ -341,6 +381,67 @@ inline Vector4::Container &Vector4::get(Vector4::Container &destination) const
 */
 inline Vector4 &Vector4::set(const Vector4::Container &source)
 {
+	PATRICKMATH_COUNT(VECTOR4_SET);
 	elements = _mm_load_ps(source.elements);
 	return *this;
 }
+
+/*!
+* Writes the elements to four floats without any alignment requirement
+* \param destination the four floats to write
+* \return destination
+*/
+inline float *Vector4::storeUnaligned(float *destination) const
+{
+	PATRICKMATH_COUNT(VECTOR4_GET);
+	_mm_storeu_ps(destination, elements);
+	return destination;
+}
+
+/*!
+* Writes x, y and z to three floats, nothing past them is touched
+* \param destination the three floats to write, no alignment requirement
+* \return destination
+*/
+inline float *Vector4::storeFloat3(float *destination) const
+{
+	PATRICKMATH_COUNT(VECTOR4_GET);
+	_mm_storel_pi(reinterpret_cast<__m64*>(destination), elements);
+	_mm_store_ss(destination + 2, _mm_movehl_ps(elements, elements));
+	return destination;
+}
+
+/*!
+* Loads four floats without any alignment requirement
+* \param source the four floats to read
+* \return the loaded Vector4
+*/
+inline Vector4 Vector4::loadUnaligned(const float *source)
+{
+	PATRICKMATH_COUNT(VECTOR4_SET);
+	return Vector4(_mm_loadu_ps(source));
+}
+
+/*!
+* Loads x, y and z from three floats, nothing past them is read so this is safe at the end of a buffer
+* \param source the three floats to read, no alignment requirement
+* \param w the w to fill in, 1 for points and 0 for directions
+* \return the loaded Vector4
+*/
+inline Vector4 Vector4::loadFloat3(const float *source, float w)
+{
+	PATRICKMATH_COUNT(VECTOR4_SET);
+	__m128 xy = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(source));
+	__m128 zw = _mm_unpacklo_ps(_mm_load_ss(source + 2), _mm_set_ss(w));
+	return Vector4(_mm_movelh_ps(xy, zw));
+}
+
+/*!
+* Same caveats as XmmFloat's conversion operator, this exists so other types and batch kernels can hand the register to
+* intrinsics without a round trip through a Container
+* \return the __m128 representing this Vector4
+*/
+inline Vector4::operator __m128 () const
+{
+	return elements;
+}
@@ -0,0 +1,128 @@
+/*!
+* \file Vector4d.cpp
+* \author Patrick Martin
+* \date 2010
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "stdafx.h"
+#include "Vector4d.h"
+
+const Vector4d::Container unitXd = {1,0,0,0};
+const Vector4d::Container unitYd = {0,1,0,0};
+const Vector4d::Container unitZd = {0,0,1,0};
+const Vector4d::Container unitWd = {0,0,0,1};
+
+const Vector4d Vector4d::ZERO = Vector4d();
+const Vector4d Vector4d::ZERO_VECTOR = Vector4d();
+const Vector4d Vector4d::ZERO_POINT = unitWd;
+const Vector4d Vector4d::UNIT_X = unitXd;
+const Vector4d Vector4d::UNIT_Y = unitYd;
+const Vector4d Vector4d::UNIT_Z = unitZd;
+const Vector4d Vector4d::UNIT_W = unitWd;
+
+/*!
+* Widens an array of Vector4 containers to Vector4d containers.  Two elements are converted per iteration so the loads
+* of the next element can overlap the conversion of the current one.
+* \param source the float containers to read
+* \param destination the double containers to write, may not alias source
+* \param count the number of elements in both arrays
+*/
+void Vector4d::convertBatch(const Vector4::Container *source, Vector4d::Container *destination, size_t count)
+{
+	PATRICKMATH_TIME(VECTOR4D_CONVERT);
+	size_t i = 0;
+	for ( ; i + 2 <= count; i += 2 )
+	{
+		__m128 r0 = _mm_load_ps(source[i].elements);
+		__m128 r1 = _mm_load_ps(source[i + 1].elements);
+#ifdef PATRICKMATH_USE_AVX
+		_mm256_store_pd(destination[i].elements, _mm256_cvtps_pd(r0));
+		_mm256_store_pd(destination[i + 1].elements, _mm256_cvtps_pd(r1));
+#else
+		_mm_store_pd(destination[i].elements, _mm_cvtps_pd(r0));
+		_mm_store_pd(destination[i].elements + 2, _mm_cvtps_pd(_mm_movehl_ps(r0, r0)));
+		_mm_store_pd(destination[i + 1].elements, _mm_cvtps_pd(r1));
+		_mm_store_pd(destination[i + 1].elements + 2, _mm_cvtps_pd(_mm_movehl_ps(r1, r1)));
+#endif
+	}
+
+	for ( ; i < count; i++ )
+	{
+		Vector4d(Vector4(source[i])).get(destination[i]);
+	}
+}
+
+/*!
+* Narrows an array of Vector4d containers to Vector4 containers, rounding to the nearest float
+* \param source the double containers to read
+* \param destination the float containers to write, may not alias source
+* \param count the number of elements in both arrays
+*/
+void Vector4d::convertBatch(const Vector4d::Container *source, Vector4::Container *destination, size_t count)
+{
+	PATRICKMATH_TIME(VECTOR4D_CONVERT);
+	size_t i = 0;
+	for ( ; i + 2 <= count; i += 2 )
+	{
+#ifdef PATRICKMATH_USE_AVX
+		__m128 r0 = _mm256_cvtpd_ps(_mm256_load_pd(source[i].elements));
+		__m128 r1 = _mm256_cvtpd_ps(_mm256_load_pd(source[i + 1].elements));
+#else
+		__m128 r0 = _mm_movelh_ps(
+			_mm_cvtpd_ps(_mm_load_pd(source[i].elements)), _mm_cvtpd_ps(_mm_load_pd(source[i].elements + 2)));
+		__m128 r1 = _mm_movelh_ps(
+			_mm_cvtpd_ps(_mm_load_pd(source[i + 1].elements)), _mm_cvtpd_ps(_mm_load_pd(source[i + 1].elements + 2)));
+#endif
+		_mm_store_ps(destination[i].elements, r0);
+		_mm_store_ps(destination[i + 1].elements, r1);
+	}
+
+	for ( ; i < count; i++ )
+	{
+		Vector4d(source[i]).toVector4().get(destination[i]);
+	}
+}
+
+/*!
+* Narrows an array of Vector4d containers to Vector4 containers after subtracting origin in double precision.  This is
+* the usual way to bring large world coordinates back into float range: pick an origin near the data (the camera, the
+* centre of a tile) and everything relative to it keeps full float precision.
+* \param source the double containers to read
+* \param origin the origin to subtract before narrowing, its w should be 0 unless you want to change w as well
+* \param destination the float containers to write, may not alias source
+* \param count the number of elements in both arrays
+*/
+void Vector4d::convertBatch(
+	const Vector4d::Container *source, const Vector4d &origin, Vector4::Container *destination, size_t count)
+{
+	PATRICKMATH_TIME(VECTOR4D_CONVERT);
+	for ( size_t i = 0; i < count; i++ )
+	{
+		Vector4d(source[i]).subtract(origin).toVector4().get(destination[i]);
+	}
+}
@@ -0,0 +1,441 @@
+/*!
+* \file Vector4d.h
+* \author Patrick Martin
+* \date 2010
+* \brief The double precision counterpart to Vector4
+*
+* Same affine conventions as Vector4: offset vectors have a fourth coordinate of 0 and points have a fourth coordinate
+* of 1.  With PATRICKMATH_USE_AVX the four lanes live in one __m256d, otherwise they are split into an xy and a zw
+* __m128d.  Use this where float precision runs out (large world coordinates) and narrow to Vector4 relative to a
+* local origin for everything else, convertBatch does that in bulk.
+*
+* This project is governed by the MIT licence:
+*
+*  Copyright (c) 2010 Patrick Martin
+*
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+*
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include "Instrumentation.h"
+#include "Vector4.h"
+#include "XmmDouble.h"
+
+__declspec(align(32))
+class Vector4d
+{
+public:
+	__declspec(align(32))
+	struct Container
+	{
+		union
+		{
+			struct { double x, y, z, w; };
+			double elements [4];
+		};
+	};
+
+public:
+	// constructors
+	Vector4d ();
+	Vector4d (const Vector4d &copy);
+	Vector4d (const Container &container);
+	explicit Vector4d (const Vector4 &copy);
+
+	// assignment operators
+	Vector4d &operator=(const Vector4d &copy);
+	Vector4d &operator=(const Container &copy);
+
+	// named
+	XmmDouble dotProduct(const Vector4d &rhs) const;
+	Vector4d add(const Vector4d &rhs) const;
+	Vector4d subtract(const Vector4d &rhs) const;
+	Vector4d negate() const;
+	Vector4d crossProduct(const Vector4d &rhs) const;
+	Vector4d normalize() const;
+	Vector4d safeNormalize(const XmmDouble &epsilon = XmmDouble::EPSILON) const;
+	Vector4d safeNormalizeSq(const XmmDouble &epsilonSq = XmmDouble::EPSILON_SQ) const;
+
+	XmmBool isEqual(const Vector4d &rhs) const;
+	XmmBool isEqual(const Vector4d &rhs, const XmmDouble &epsilon) const;
+
+	// narrowing, rounds every lane to the nearest float
+	Vector4 toVector4() const;
+
+	// operators
+	inline XmmDouble operator* (const Vector4d &rhs) const	{return dotProduct(rhs);}
+	inline Vector4d operator+ (const Vector4d &rhs) const	{return add(rhs);}
+	inline Vector4d operator- (const Vector4d &rhs) const	{return subtract(rhs);}
+	inline Vector4d operator- () const						{return negate();}
+	inline Vector4d operator^ (const Vector4d &rhs) const	{return crossProduct(rhs);}
+	inline Vector4d operator~ () const						{return normalize();}
+	inline XmmBool operator==(const Vector4d &rhs) const	{return isEqual(rhs);}
+
+	// reads
+	Container &get(Container &destination) const;
+
+	// writes
+	Vector4d &set(const Container &source);
+
+	// batch conversions
+	static void convertBatch(const Vector4::Container *source, Container *destination, size_t count);
+	static void convertBatch(const Container *source, Vector4::Container *destination, size_t count);
+	static void convertBatch(
+		const Container *source, const Vector4d &origin, Vector4::Container *destination, size_t count);
+
+public:
+	static const Vector4d ZERO;
+	static const Vector4d ZERO_VECTOR;
+	static const Vector4d ZERO_POINT;
+	static const Vector4d UNIT_X;
+	static const Vector4d UNIT_Y;
+	static const Vector4d UNIT_Z;
+	static const Vector4d UNIT_W;
+
+private:
+#ifdef PATRICKMATH_USE_AVX
+	__m256d elements;
+#else
+	__m128d elementsXY;
+	__m128d elementsZW;
+#endif
+};
+
+inline Vector4d::Vector4d()
+{
+#ifdef PATRICKMATH_USE_AVX
+	elements = _mm256_setzero_pd();
+#else
+	elementsXY = _mm_setzero_pd();
+	elementsZW = _mm_setzero_pd();
+#endif
+}
+
+/*!
+* Initializes a Vector4d with another Vector4d
+*/
+inline Vector4d::Vector4d(const Vector4d &copy)
+{
+#ifdef PATRICKMATH_USE_AVX
+	elements = copy.elements;
+#else
+	elementsXY = copy.elementsXY;
+	elementsZW = copy.elementsZW;
+#endif
+}
+
+/*!
+* Initializes a Vector4d with a Vector4d::Container holding the initial data to load to the registers
+* \param container the container containing four doubles to load
+*/
+inline Vector4d::Vector4d(const Vector4d::Container &container)
+{
+	set(container);
+}
+
+/*!
+* Widens a Vector4, this never leaves the simd registers
+* \param copy the Vector4 to widen
+*/
+inline Vector4d::Vector4d(const Vector4 &copy)
+{
+	__m128 source = copy;
+#ifdef PATRICKMATH_USE_AVX
+	elements = _mm256_cvtps_pd(source);
+#else
+	elementsXY = _mm_cvtps_pd(source);
+	elementsZW = _mm_cvtps_pd(_mm_movehl_ps(source, source));
+#endif
+}
+
+/*!
+* Assignment operator
+* \param copy the Vector4d to copy
+* \return a reference to this Vector4d
+*/
+inline Vector4d &Vector4d::operator=(const Vector4d &copy)
+{
+#ifdef PATRICKMATH_USE_AVX
+	elements = copy.elements;
+#else
+	elementsXY = copy.elementsXY;
+	elementsZW = copy.elementsZW;
+#endif
+	return *this;
+}
+
+/*!
+* Performs an assignment to a container, caution this is slow
+* \param copy the container to load
+* \return a reference to this
+*/
+inline Vector4d &Vector4d::operator=(const Vector4d::Container &copy)
+{
+	set(copy);
+	return *this;
+}
+
+/*!
+* Perform the dot product between two Vector4d's
+* \param rhs the right hand side of the dot product
+* \return an XmmDouble where every lane is the dot product
+*/
+inline XmmDouble Vector4d::dotProduct(const Vector4d &rhs) const
+{
+#ifdef PATRICKMATH_USE_AVX
+	__m256d r0 = _mm256_mul_pd(elements, rhs.elements); // 0, 1, 2, 3
+	r0 = _mm256_add_pd(r0, _mm256_permute_pd(r0, 0x5)); // 0+1, 0+1, 2+3, 2+3
+	return _mm256_add_pd(r0, _mm256_permute2f128_pd(r0, r0, 0x01)); // 0+1+2+3 in every lane
+#else
+	__m128d r0 = _mm_mul_pd(elementsXY, rhs.elementsXY); // 0, 1
+	r0 = _mm_add_pd(r0, _mm_mul_pd(elementsZW, rhs.elementsZW)); // 0+2, 1+3
+	return _mm_add_pd(r0, _mm_shuffle_pd(r0, r0, 0x1)); // 0+1+2+3 in both lanes
+#endif
+}
+
+/*!
+* Adds two Vector4d's
+* \param rhs the right hand side of the equation
+* \return the resulting Vector4d
+*/
+inline Vector4d Vector4d::add(const Vector4d &rhs) const
+{
+	Vector4d result;
+#ifdef PATRICKMATH_USE_AVX
+	result.elements = _mm256_add_pd(elements, rhs.elements);
+#else
+	result.elementsXY = _mm_add_pd(elementsXY, rhs.elementsXY);
+	result.elementsZW = _mm_add_pd(elementsZW, rhs.elementsZW);
+#endif
+	return result;
+}
+
+/*!
+* Subtracts two Vector4d's
+* \param rhs the right hand side of the equation
+* \return the resulting Vector4d
+*/
+inline Vector4d Vector4d::subtract(const Vector4d &rhs) const
+{
+	Vector4d result;
+#ifdef PATRICKMATH_USE_AVX
+	result.elements = _mm256_sub_pd(elements, rhs.elements);
+#else
+	result.elementsXY = _mm_sub_pd(elementsXY, rhs.elementsXY);
+	result.elementsZW = _mm_sub_pd(elementsZW, rhs.elementsZW);
+#endif
+	return result;
+}
+
+/*!
+* Negate this Vector4d
+* \return the resulting Vector4d
+*/
+inline Vector4d Vector4d::negate() const
+{
+	return Vector4d().subtract(*this);
+}
+
+/*!
+* Cross two Vector4d's, assume the first 3 elements of each are properly filled and the final element is 0
+* \param rhs the right hand side of the equation
+* \return the resulting Vector4d
+*/
+inline Vector4d Vector4d::crossProduct(const Vector4d &rhs) const
+{
+	Vector4d result;
+#ifdef PATRICKMATH_USE_AVX
+	// AVX has no cross lane double shuffle, so build y,z,x,w and z,x,y,w out of the swapped halves
+	__m256d lhsSwap = _mm256_permute2f128_pd(elements, elements, 0x01); // z, w, x, y
+	__m256d rhsSwap = _mm256_permute2f128_pd(rhs.elements, rhs.elements, 0x01);
+	__m256d lhsYZX = _mm256_permute_pd(_mm256_shuffle_pd(elements, lhsSwap, 0x5), 0x6); // y, z, x, w
+	__m256d lhsZXY = _mm256_shuffle_pd(lhsSwap, elements, 0xC); // z, x, y, w
+	__m256d rhsYZX = _mm256_permute_pd(_mm256_shuffle_pd(rhs.elements, rhsSwap, 0x5), 0x6);
+	__m256d rhsZXY = _mm256_shuffle_pd(rhsSwap, rhs.elements, 0xC);
+
+	result.elements = _mm256_sub_pd(_mm256_mul_pd(lhsYZX, rhsZXY), _mm256_mul_pd(lhsZXY, rhsYZX));
+#else
+	__m128d lhsYZ = _mm_shuffle_pd(elementsXY, elementsZW, 0x1);
+	__m128d lhsXW = _mm_shuffle_pd(elementsXY, elementsZW, 0x2);
+	__m128d lhsZX = _mm_shuffle_pd(elementsZW, elementsXY, 0x0);
+	__m128d lhsYW = _mm_shuffle_pd(elementsXY, elementsZW, 0x3);
+	__m128d rhsYZ = _mm_shuffle_pd(rhs.elementsXY, rhs.elementsZW, 0x1);
+	__m128d rhsXW = _mm_shuffle_pd(rhs.elementsXY, rhs.elementsZW, 0x2);
+	__m128d rhsZX = _mm_shuffle_pd(rhs.elementsZW, rhs.elementsXY, 0x0);
+	__m128d rhsYW = _mm_shuffle_pd(rhs.elementsXY, rhs.elementsZW, 0x3);
+
+	result.elementsXY = _mm_sub_pd(_mm_mul_pd(lhsYZ, rhsZX), _mm_mul_pd(lhsZX, rhsYZ));
+	result.elementsZW = _mm_sub_pd(_mm_mul_pd(lhsXW, rhsYW), _mm_mul_pd(lhsYW, rhsXW));
+#endif
+	return result;
+}
+
+/*!
+* Normalizes a Vector4d, does not perform a divide by zero check, does not verify that the 4th elment (w) is 0
+* \return the resulting Vector4d
+*/
+inline Vector4d Vector4d::normalize() const
+{
+	Vector4d result;
+	XmmDouble length = dotProduct(*this).sqrt();
+#ifdef PATRICKMATH_USE_AVX
+	result.elements = _mm256_div_pd(elements, length);
+#else
+	result.elementsXY = _mm_div_pd(elementsXY, length);
+	result.elementsZW = _mm_div_pd(elementsZW, length);
+#endif
+	return result;
+}
+
+/*!
+* Normalizes a Vector4d, setting the result to zero if the length is not larger than epsilon.  Like
+* Vector4::safeNormalize this is done with a mask rather than a branch.
+* \param epsilon the epsilon value to use to check.  If not specified, this will use double epsilon.
+* \return the normalized vector or zero if the length of the vector is less than epsilon
+*/
+inline Vector4d Vector4d::safeNormalize(const XmmDouble &epsilon) const
+{
+	Vector4d result;
+	XmmDouble length = dotProduct(*this).sqrt();
+#ifdef PATRICKMATH_USE_AVX
+	__m256d epsilonMask = _mm256_cmp_pd(length, epsilon, _CMP_GT_OQ);
+	result.elements = _mm256_and_pd(_mm256_div_pd(elements, length), epsilonMask);
+#else
+	__m128d epsilonMask = _mm_cmpgt_pd(length, epsilon);
+	result.elementsXY = _mm_and_pd(_mm_div_pd(elementsXY, length), epsilonMask);
+	result.elementsZW = _mm_and_pd(_mm_div_pd(elementsZW, length), epsilonMask);
+#endif
+	return result;
+}
+
+/*!
+* Same as safeNormalize but compares the squared length against a squared epsilon
+* \param epsilonSq the chosen epsilon squared
+* \return the normalized vector or zero if the length squared is less than epsilon squared
+*/
+inline Vector4d Vector4d::safeNormalizeSq(const XmmDouble &epsilonSq) const
+{
+	Vector4d result;
+	XmmDouble lengthSq = dotProduct(*this);
+	XmmDouble length = lengthSq.sqrt();
+#ifdef PATRICKMATH_USE_AVX
+	__m256d epsilonMask = _mm256_cmp_pd(lengthSq, epsilonSq, _CMP_GT_OQ);
+	result.elements = _mm256_and_pd(_mm256_div_pd(elements, length), epsilonMask);
+#else
+	__m128d epsilonMask = _mm_cmpgt_pd(lengthSq, epsilonSq);
+	result.elementsXY = _mm_and_pd(_mm_div_pd(elementsXY, length), epsilonMask);
+	result.elementsZW = _mm_and_pd(_mm_div_pd(elementsZW, length), epsilonMask);
+#endif
+	return result;
+}
+
+/*!
+* Generates a mask that's all high if equal or all low if not equal.
+* \param rhs the right hand side of the comparison
+* \return all raised if equal, all low otherwise
+*/
+inline XmmBool Vector4d::isEqual(const Vector4d &rhs) const
+{
+#ifdef PATRICKMATH_USE_AVX
+	__m256d compare = _mm256_cmp_pd(elements, rhs.elements, _CMP_EQ_OQ); // a, b, c, d
+	compare = _mm256_and_pd(compare, _mm256_permute_pd(compare, 0x5)); // a&b, a&b, c&d, c&d
+	__m128d result = _mm_and_pd(_mm256_castpd256_pd128(compare), _mm256_extractf128_pd(compare, 1));
+#else
+	__m128d compare = _mm_and_pd(
+		_mm_cmpeq_pd(elementsXY, rhs.elementsXY), _mm_cmpeq_pd(elementsZW, rhs.elementsZW)); // a&c, b&d
+	__m128d result = _mm_and_pd(compare, _mm_shuffle_pd(compare, compare, 0x1)); // a&b&c&d, a&b&c&d
+#endif
+	return XmmBool(_mm_castpd_ps(result));
+}
+
+/*!
+* Generates a mask that's all high if every element is equal within epsilon, or all low otherwise
+* \param rhs the right hand side of the comparison
+* \param epsilon the epsilon for the comparison
+* \return all high if equal within epsilon, all bits low otherwise
+*/
+inline XmmBool Vector4d::isEqual(const Vector4d &rhs, const XmmDouble &epsilon) const
+{
+	XmmDouble::Register absMask = XmmDouble::_DOUBLE_ABS_MASK;
+#ifdef PATRICKMATH_USE_AVX
+	__m256d absDiff = _mm256_and_pd(_mm256_sub_pd(elements, rhs.elements), absMask);
+	__m256d compare = _mm256_cmp_pd(absDiff, epsilon, _CMP_LE_OQ); // a, b, c, d
+	compare = _mm256_and_pd(compare, _mm256_permute_pd(compare, 0x5)); // a&b, a&b, c&d, c&d
+	__m128d result = _mm_and_pd(_mm256_castpd256_pd128(compare), _mm256_extractf128_pd(compare, 1));
+#else
+	__m128d absDiffXY = _mm_and_pd(_mm_sub_pd(elementsXY, rhs.elementsXY), absMask);
+	__m128d absDiffZW = _mm_and_pd(_mm_sub_pd(elementsZW, rhs.elementsZW), absMask);
+	__m128d compare = _mm_and_pd(_mm_cmple_pd(absDiffXY, epsilon), _mm_cmple_pd(absDiffZW, epsilon)); // a&c, b&d
+	__m128d result = _mm_and_pd(compare, _mm_shuffle_pd(compare, compare, 0x1)); // a&b&c&d, a&b&c&d
+#endif
+	return XmmBool(_mm_castpd_ps(result));
+}
+
+/*!
+* Narrows to a Vector4 without leaving the simd registers
+* \return the Vector4 with every element rounded to the nearest float
+*/
+inline Vector4 Vector4d::toVector4() const
+{
+#ifdef PATRICKMATH_USE_AVX
+	return Vector4(_mm256_cvtpd_ps(elements));
+#else
+	return Vector4(_mm_movelh_ps(_mm_cvtpd_ps(elementsXY), _mm_cvtpd_ps(elementsZW)));
+#endif
+}
+
+/*!
+* Writes the elements out to a Container (slow: reading from simd registers)
+* \param destination the Container to store the result
+* \return a reference to the Container filled
+*/
+inline Vector4d::Container &Vector4d::get(Vector4d::Container &destination) const
+{
+	PATRICKMATH_COUNT(VECTOR4D_GET);
+#ifdef PATRICKMATH_USE_AVX
+	_mm256_store_pd(destination.elements, elements);
+#else
+	_mm_store_pd(destination.elements, elementsXY);
+	_mm_store_pd(destination.elements + 2, elementsZW);
+#endif
+	return destination;
+}
+
+/*!
+* Sets this Vector4d given a Container
+* \param source the source container to set from
+* \return a reference to this Vector4d
+*/
+inline Vector4d &Vector4d::set(const Vector4d::Container &source)
+{
+	PATRICKMATH_COUNT(VECTOR4D_SET);
+#ifdef PATRICKMATH_USE_AVX
+	elements = _mm256_load_pd(source.elements);
+#else
+	elementsXY = _mm_load_pd(source.elements);
+	elementsZW = _mm_load_pd(source.elements + 2);
+#endif
+	return *this;
+}
@@ -37,6 +37,8 @@
 
 #include <xmmintrin.h>
 
+#include "Instrumentation.h"
+
 /*!
 * An XmmBool stores the result of a logical operation.  You cannot use this in a traditional granch unless you read the
 * value into a traditional bool (or int).  Correct values are only all bits 0 or all bit 1, in this way an XmmBool can
@@ -44,13 +46,32 @@
 */
 class XmmBool
 {
-	// TODO: finish
 public:
 	XmmBool();
 	XmmBool(const XmmBool &copy);
 	XmmBool(const __m128 &copy);
 	explicit XmmBool(bool copy);
 
+	// operator overloads, these are bitwise on the masks so both sides are always evaluated
+	inline XmmBool operator&(const XmmBool &rhs) const	{return logicalAnd(rhs);}
+	inline XmmBool operator|(const XmmBool &rhs) const	{return logicalOr(rhs);}
+	inline XmmBool operator^(const XmmBool &rhs) const	{return logicalXor(rhs);}
+	inline XmmBool operator!() const					{return logicalNot();}
+
+	// named logic operations
+	XmmBool logicalAnd(const XmmBool &rhs) const;
+	XmmBool logicalOr(const XmmBool &rhs) const;
+	XmmBool logicalXor(const XmmBool &rhs) const;
+	XmmBool logicalNot() const;
+
+	// picks ifTrue where this is raised and ifFalse elsewhere, per lane
+	__m128 select(const __m128 &ifTrue, const __m128 &ifFalse) const;
+
+	// per lane queries, for masks whose lanes differ (batch code)
+	int laneMask() const;
+	bool anyTrue() const;
+	bool allTrue() const;
+
 	bool getValue() const;
 
 	operator __m128() const;
@@ -73,8 +94,71 @@ inline XmmBool::XmmBool(const __m128 &copy)
 	m_value = copy;
 }
 
+/*!
+* Loads a bool into every lane (slow: loading from normal registers)
+* \param copy the value to broadcast
+*/
+inline XmmBool::XmmBool(bool copy)
+{
+	m_value = copy ? _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps()) : _mm_setzero_ps();
+}
+
+inline XmmBool XmmBool::logicalAnd(const XmmBool &rhs) const
+{
+	return _mm_and_ps(m_value, rhs.m_value);
+}
+
+inline XmmBool XmmBool::logicalOr(const XmmBool &rhs) const
+{
+	return _mm_or_ps(m_value, rhs.m_value);
+}
+
+inline XmmBool XmmBool::logicalXor(const XmmBool &rhs) const
+{
+	return _mm_xor_ps(m_value, rhs.m_value);
+}
+
+inline XmmBool XmmBool::logicalNot() const
+{
+	return _mm_xor_ps(m_value, _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps()));
+}
+
+/*!
+* Branch free per lane selection, this is how an if/else on XmmBool should be written.  Works with anything that
+* converts to __m128 (XmmFloat, Vector4) and the result converts back.
+* \param ifTrue the value to take where the mask is raised
+* \param ifFalse the value to take where the mask is low
+* \return the blended register
+*/
+inline __m128 XmmBool::select(const __m128 &ifTrue, const __m128 &ifFalse) const
+{
+	return _mm_or_ps(_mm_and_ps(m_value, ifTrue), _mm_andnot_ps(m_value, ifFalse));
+}
+
+/*!
+* \return one bit per lane, lane 0 in bit 0 (this reads back from the SSE registers)
+*/
+inline int XmmBool::laneMask() const
+{
+	PATRICKMATH_COUNT(XMMBOOL_LANE_MASK);
+	return _mm_movemask_ps(m_value);
+}
+
+inline bool XmmBool::anyTrue() const
+{
+	PATRICKMATH_COUNT(XMMBOOL_LANE_MASK);
+	return _mm_movemask_ps(m_value) != 0;
+}
+
+inline bool XmmBool::allTrue() const
+{
+	PATRICKMATH_COUNT(XMMBOOL_LANE_MASK);
+	return _mm_movemask_ps(m_value) == 0xF;
+}
+
 inline bool XmmBool::getValue() const
 {
+	PATRICKMATH_COUNT(XMMBOOL_GET_VALUE);
 	float destination;
 	_mm_store_ss(&destination, m_value);
 
@@ -82,7 +166,7 @@ inline bool XmmBool::getValue() const
 }
 
 /*!
-* TODO: finish writing boolean operations so this isn't necessary
+* Still needed to hand masks to intrinsics, the same caveats as XmmFloat's conversion operator apply
 */
 inline XmmBool::operator __m128 () const
 {
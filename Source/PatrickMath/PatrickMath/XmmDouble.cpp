@@ -0,0 +1,15 @@
+#include "stdafx.h"
+
+#include "XmmDouble.h"
+#include <limits>
+#include <stdint.h>
+
+const XmmDouble XmmDouble::EPSILON = XmmDouble(std::numeric_limits<double>::epsilon());
+const XmmDouble XmmDouble::EPSILON_SQ = XmmDouble::EPSILON * XmmDouble::EPSILON;
+
+union intdouble
+{
+	int64_t intPart;
+	double doublePart;
+} const doubleMask = { 0x7FFFFFFFFFFFFFFFLL };
+const XmmDouble XmmDouble::_DOUBLE_ABS_MASK = XmmDouble(doubleMask.doublePart);
@@ -0,0 +1,381 @@
+/*!
+* \file XmmDouble.h
+* \author Patrick Martin
+* \date 2010
+* \brief Double precision values represented via SIMD registers.  Every 64 bits should be identical
+*
+* This is the double precision counterpart to XmmFloat.  When PATRICKMATH_USE_AVX is defined (or the compiler is
+* building with /arch:AVX) the value lives in a single __m256d so that it lines up with the four lanes of a Vector4d,
+* otherwise it lives in a single SSE2 __m128d and Vector4d splits its lanes across two of them.
+*
+* This project is governed by the MIT licence:
+*
+*  Copyright (c) 2010 Patrick Martin
+*
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+*
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#if !defined(PATRICKMATH_USE_AVX) && defined(__AVX__)
+#define PATRICKMATH_USE_AVX
+#endif
+
+#include <emmintrin.h>
+#ifdef PATRICKMATH_USE_AVX
+#include <immintrin.h>
+#endif
+
+#include "Instrumentation.h"
+#include "XmmBool.h"
+#include "XmmFloat.h"
+
+/*!
+* \class XmmDouble
+* \brief provides a wrapper for common double precision operations on simd registers
+*
+* Like XmmFloat this is a very shallow wrapper.  Comparisons return an XmmBool so that the same masks can be used
+* against both float and double data: since every lane holds the same value, the low 128 bits of a double comparison
+* are a valid all high or all low XmmBool.
+*/
+__declspec(align(32))
+class XmmDouble
+{
+public:
+#ifdef PATRICKMATH_USE_AVX
+	typedef __m256d Register;
+#else
+	typedef __m128d Register;
+#endif
+
+public:
+	XmmDouble();
+	XmmDouble(const XmmDouble &copy);
+	XmmDouble(const Register &value);
+	explicit XmmDouble(const double &value);
+	explicit XmmDouble(const XmmFloat &value);
+
+	// operator overloads
+	inline XmmDouble operator-() const						{return negate();}
+	inline XmmDouble operator+(const XmmDouble &rhs) const	{return add(rhs);}
+	inline XmmDouble operator-(const XmmDouble &rhs) const	{return subtract(rhs);}
+	inline XmmDouble operator/(const XmmDouble &rhs) const	{return divide(rhs);}
+	inline XmmDouble operator*(const XmmDouble &rhs) const	{return multiply(rhs);}
+
+	// caution: these logical operations do not return a value usable in an if statement (do not return a bool)
+	inline XmmBool operator==(const XmmDouble &rhs) const	{return isEqual(rhs);}
+	inline XmmBool operator> (const XmmDouble &rhs) const	{return isGreaterThan(rhs);}
+	inline XmmBool operator>=(const XmmDouble &rhs) const	{return isGreaterThanOrEqual(rhs);}
+	inline XmmBool operator< (const XmmDouble &rhs) const	{return isLessThan(rhs);}
+	inline XmmBool operator<=(const XmmDouble &rhs) const	{return isLessThanOrEqual(rhs);}
+	inline XmmBool operator!=(const XmmDouble &rhs) const	{return isNotEqual(rhs);}
+
+	// named arithmetic operations
+	XmmDouble sqrt() const;
+	XmmDouble inverse() const;
+
+	XmmDouble negate() const;
+	XmmDouble add(const XmmDouble &rhs) const;
+	XmmDouble subtract(const XmmDouble &rhs) const;
+	XmmDouble divide(const XmmDouble &rhs) const;
+	XmmDouble multiply(const XmmDouble &rhs) const;
+	XmmDouble abs() const;
+
+	// logic operations
+	XmmBool isEqual(const XmmDouble &cmp) const;
+	XmmBool isLessThan(const XmmDouble &cmp) const;
+	XmmBool isLessThanOrEqual(const XmmDouble &cmp) const;
+	XmmBool isGreaterThan(const XmmDouble &cmp) const;
+	XmmBool isGreaterThanOrEqual(const XmmDouble &cmp) const;
+	XmmBool isNotEqual(const XmmDouble &cmp) const;
+
+	static XmmDouble min(const XmmDouble &lhs, const XmmDouble &rhs);
+	static XmmDouble max(const XmmDouble &lhs, const XmmDouble &rhs);
+
+	// conversion, rounds to the nearest float
+	XmmFloat toXmmFloat() const;
+
+	// read/write
+	double &get(double &destination) const;
+	XmmDouble &set(double source);
+
+	operator Register () const;
+
+	static const XmmDouble EPSILON;
+	static const XmmDouble EPSILON_SQ;
+	static const XmmDouble _DOUBLE_ABS_MASK;
+
+private:
+	static XmmBool toXmmBool(const Register &mask);
+
+	Register m_value;
+};
+
+/*!
+* Default constructor will initialize to 0
+*/
+inline XmmDouble::XmmDouble()
+{
+#ifdef PATRICKMATH_USE_AVX
+	m_value = _mm256_setzero_pd();
+#else
+	m_value = _mm_setzero_pd();
+#endif
+}
+
+inline XmmDouble::XmmDouble(const XmmDouble &copy)
+{
+	m_value = copy.m_value;
+}
+
+inline XmmDouble::XmmDouble(const Register &value)
+{
+	m_value = value;
+}
+
+/*!
+* Require an explicit conversion from double, keep user informed that this is an expensive copy
+* \param value the value to store in every lane
+*/
+inline XmmDouble::XmmDouble(const double &value)
+{
+	set(value);
+}
+
+/*!
+* Widens an XmmFloat, this never leaves the simd registers
+* \param value the XmmFloat to widen
+*/
+inline XmmDouble::XmmDouble(const XmmFloat &value)
+{
+#ifdef PATRICKMATH_USE_AVX
+	m_value = _mm256_cvtps_pd(value);
+#else
+	m_value = _mm_cvtps_pd(value);
+#endif
+}
+
+inline XmmDouble XmmDouble::sqrt() const
+{
+#ifdef PATRICKMATH_USE_AVX
+	return _mm256_sqrt_pd(m_value);
+#else
+	return _mm_sqrt_pd(m_value);
+#endif
+}
+
+/*!
+* There is no double precision reciprocal estimate, so this is a full divide
+*/
+inline XmmDouble XmmDouble::inverse() const
+{
+#ifdef PATRICKMATH_USE_AVX
+	return _mm256_div_pd(_mm256_set1_pd(1.0), m_value);
+#else
+	return _mm_div_pd(_mm_set1_pd(1.0), m_value);
+#endif
+}
+
+inline XmmDouble XmmDouble::negate() const
+{
+#ifdef PATRICKMATH_USE_AVX
+	return _mm256_sub_pd(_mm256_setzero_pd(), m_value);
+#else
+	return _mm_sub_pd(_mm_setzero_pd(), m_value);
+#endif
+}
+
+inline XmmDouble XmmDouble::add(const XmmDouble &rhs) const
+{
+#ifdef PATRICKMATH_USE_AVX
+	return _mm256_add_pd(m_value, rhs.m_value);
+#else
+	return _mm_add_pd(m_value, rhs.m_value);
+#endif
+}
+
+inline XmmDouble XmmDouble::subtract(const XmmDouble &rhs) const
+{
+#ifdef PATRICKMATH_USE_AVX
+	return _mm256_sub_pd(m_value, rhs.m_value);
+#else
+	return _mm_sub_pd(m_value, rhs.m_value);
+#endif
+}
+
+inline XmmDouble XmmDouble::divide(const XmmDouble &rhs) const
+{
+#ifdef PATRICKMATH_USE_AVX
+	return _mm256_div_pd(m_value, rhs.m_value);
+#else
+	return _mm_div_pd(m_value, rhs.m_value);
+#endif
+}
+
+inline XmmDouble XmmDouble::multiply(const XmmDouble &rhs) const
+{
+#ifdef PATRICKMATH_USE_AVX
+	return _mm256_mul_pd(m_value, rhs.m_value);
+#else
+	return _mm_mul_pd(m_value, rhs.m_value);
+#endif
+}
+
+inline XmmDouble XmmDouble::abs() const
+{
+#ifdef PATRICKMATH_USE_AVX
+	return _mm256_and_pd(m_value, _DOUBLE_ABS_MASK.m_value);
+#else
+	return _mm_and_pd(m_value, _DOUBLE_ABS_MASK.m_value);
+#endif
+}
+
+/*!
+* Every lane of a comparison holds the same mask, so the low 128 bits are already a valid XmmBool
+* \param mask the result of a double comparison
+* \return the mask reinterpreted as an XmmBool
+*/
+inline XmmBool XmmDouble::toXmmBool(const Register &mask)
+{
+#ifdef PATRICKMATH_USE_AVX
+	return XmmBool(_mm_castpd_ps(_mm256_castpd256_pd128(mask)));
+#else
+	return XmmBool(_mm_castpd_ps(mask));
+#endif
+}
+
+inline XmmBool XmmDouble::isEqual(const XmmDouble &cmp) const
+{
+#ifdef PATRICKMATH_USE_AVX
+	return toXmmBool(_mm256_cmp_pd(m_value, cmp.m_value, _CMP_EQ_OQ));
+#else
+	return toXmmBool(_mm_cmpeq_pd(m_value, cmp.m_value));
+#endif
+}
+
+inline XmmBool XmmDouble::isLessThan(const XmmDouble &cmp) const
+{
+#ifdef PATRICKMATH_USE_AVX
+	return toXmmBool(_mm256_cmp_pd(m_value, cmp.m_value, _CMP_LT_OQ));
+#else
+	return toXmmBool(_mm_cmplt_pd(m_value, cmp.m_value));
+#endif
+}
+
+inline XmmBool XmmDouble::isLessThanOrEqual(const XmmDouble &cmp) const
+{
+#ifdef PATRICKMATH_USE_AVX
+	return toXmmBool(_mm256_cmp_pd(m_value, cmp.m_value, _CMP_LE_OQ));
+#else
+	return toXmmBool(_mm_cmple_pd(m_value, cmp.m_value));
+#endif
+}
+
+inline XmmBool XmmDouble::isGreaterThan(const XmmDouble &cmp) const
+{
+#ifdef PATRICKMATH_USE_AVX
+	return toXmmBool(_mm256_cmp_pd(m_value, cmp.m_value, _CMP_GT_OQ));
+#else
+	return toXmmBool(_mm_cmpgt_pd(m_value, cmp.m_value));
+#endif
+}
+
+inline XmmBool XmmDouble::isGreaterThanOrEqual(const XmmDouble &cmp) const
+{
+#ifdef PATRICKMATH_USE_AVX
+	return toXmmBool(_mm256_cmp_pd(m_value, cmp.m_value, _CMP_GE_OQ));
+#else
+	return toXmmBool(_mm_cmpge_pd(m_value, cmp.m_value));
+#endif
+}
+
+inline XmmBool XmmDouble::isNotEqual(const XmmDouble &cmp) const
+{
+#ifdef PATRICKMATH_USE_AVX
+	return toXmmBool(_mm256_cmp_pd(m_value, cmp.m_value, _CMP_NEQ_UQ));
+#else
+	return toXmmBool(_mm_cmpneq_pd(m_value, cmp.m_value));
+#endif
+}
+
+inline XmmDouble XmmDouble::min(const XmmDouble &lhs, const XmmDouble &rhs)
+{
+#ifdef PATRICKMATH_USE_AVX
+	return _mm256_min_pd(lhs.m_value, rhs.m_value);
+#else
+	return _mm_min_pd(lhs.m_value, rhs.m_value);
+#endif
+}
+
+inline XmmDouble XmmDouble::max(const XmmDouble &lhs, const XmmDouble &rhs)
+{
+#ifdef PATRICKMATH_USE_AVX
+	return _mm256_max_pd(lhs.m_value, rhs.m_value);
+#else
+	return _mm_max_pd(lhs.m_value, rhs.m_value);
+#endif
+}
+
+/*!
+* Narrows to an XmmFloat without leaving the simd registers
+* \return the value rounded to float in every lane
+*/
+inline XmmFloat XmmDouble::toXmmFloat() const
+{
+#ifdef PATRICKMATH_USE_AVX
+	return _mm256_cvtpd_ps(m_value);
+#else
+	__m128 narrow = _mm_cvtpd_ps(m_value);
+	return _mm_movelh_ps(narrow, narrow);
+#endif
+}
+
+inline double &XmmDouble::get(double &destination) const
+{
+	PATRICKMATH_COUNT(XMMDOUBLE_GET);
+#ifdef PATRICKMATH_USE_AVX
+	_mm_store_sd(&destination, _mm256_castpd256_pd128(m_value));
+#else
+	_mm_store_sd(&destination, m_value);
+#endif
+	return destination;
+}
+
+inline XmmDouble &XmmDouble::set(double source)
+{
+	PATRICKMATH_COUNT(XMMDOUBLE_SET);
+#ifdef PATRICKMATH_USE_AVX
+	m_value = _mm256_broadcast_sd(&source);
+#else
+	m_value = _mm_load1_pd(&source);
+#endif
+	return *this;
+}
+
+/*!
+* Same caveats as XmmFloat's conversion operator, this exists so the value can be handed to intrinsics
+* \return the register representing this object
+*/
+inline XmmDouble::operator Register () const
+{
+	return m_value;
+}
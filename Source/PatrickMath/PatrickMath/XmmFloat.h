@@ -35,8 +35,11 @@
 
 #pragma once
 
+#include <float.h>
 #include <xmmintrin.h>
+#include <emmintrin.h>
 
+#include "Instrumentation.h"
 #include "XmmBool.h"
 
 /*!
@@ -85,6 +88,8 @@ public:
 	// trig functions
 	XmmFloat cos() const;
 	XmmFloat sin() const;
+	void sinCos(XmmFloat &sinResult, XmmFloat &cosResult) const;
+	static XmmFloat atan2(const XmmFloat &y, const XmmFloat &x);
 
 	// logic operations
 	XmmBool isEqual(const XmmFloat &cmp) const;
@@ -124,7 +129,7 @@ private:
 */
 inline XmmFloat::XmmFloat()
 {
-	_mm_setzero_ps();
+	m_value = _mm_setzero_ps();
 }
 
 inline XmmFloat::XmmFloat(const XmmFloat &copy)
@@ -148,16 +153,19 @@ inline XmmFloat::XmmFloat(const float &value)
 
 inline XmmFloat XmmFloat::sqrt() const
 {
+	PATRICKMATH_COUNT(XMMFLOAT_SQRT);
 	return _mm_sqrt_ps(m_value);
 }
 
 inline XmmFloat XmmFloat::invSqrt() const
 {
+	PATRICKMATH_COUNT(XMMFLOAT_SQRT);
 	return _mm_rsqrt_ps(m_value);
 }
 
 inline XmmFloat XmmFloat::inverse() const
 {
+	PATRICKMATH_COUNT(XMMFLOAT_DIVIDE);
 	return _mm_rcp_ps(m_value);
 }
 
@@ -178,12 +186,13 @@ inline XmmFloat XmmFloat::subtract(const XmmFloat &rhs) const
 
 inline XmmFloat XmmFloat::divide(const XmmFloat &rhs) const
 {
+	PATRICKMATH_COUNT(XMMFLOAT_DIVIDE);
 	return _mm_div_ps(m_value, rhs.m_value);
 }
 
 inline XmmFloat XmmFloat::multiply(const XmmFloat &rhs) const
 {
-	return _mm_div_ps(m_value, rhs.m_value);
+	return _mm_mul_ps(m_value, rhs.m_value);
 }
 
 inline XmmFloat XmmFloat::abs() const
@@ -197,11 +206,10 @@ inline XmmFloat XmmFloat::abs() const
 */
 inline XmmFloat XmmFloat::cos() const
 {
-	__m128 result = m_value;
-	_mm_add_ps(result, _PI_2.m_value);
+	__m128 result = _mm_add_ps(m_value, _PI_2.m_value);
 	__m128 greaterThanPi = _mm_cmpgt_ps(result, _PI.m_value);
 	greaterThanPi = _mm_and_ps(greaterThanPi, _2PI.m_value);
-	_mm_sub_ps(result, greaterThanPi);
+	result = _mm_sub_ps(result, greaterThanPi);
 	return XmmFloat(result).sin();
 }
 
@@ -211,6 +219,7 @@ inline XmmFloat XmmFloat::cos() const
 */
 inline XmmFloat XmmFloat::sin() const
 {
+	PATRICKMATH_COUNT(XMMFLOAT_TRIG);
 	const XmmFloat B = XmmFloat(4.f) / XmmFloat::_PI;
 	const XmmFloat C = XmmFloat(-4.f) / (XmmFloat::_PI * XmmFloat::_PI);
 	XmmFloat result = B * (*this) + C * (*this) * abs();
@@ -222,6 +231,90 @@ inline XmmFloat XmmFloat::sin() const
 	return result;
 }
 
+/*!
+* Computes the sine and cosine of every lane at once.  Unlike sin() and cos() this is accurate to a couple of ulp over
+* the full range up to about +/-8192 radians: the angle is reduced to an octant with the Cephes three part pi/4 and the
+* two minimax polynomials are blended per lane, so there is no branching.
+* \param sinResult receives the sine of each lane
+* \param cosResult receives the cosine of each lane
+*/
+inline void XmmFloat::sinCos(XmmFloat &sinResult, XmmFloat &cosResult) const
+{
+	PATRICKMATH_COUNT(XMMFLOAT_TRIG);
+	__m128 x = _mm_and_ps(m_value, _FLOAT_ABS_MASK.m_value);
+	__m128 sinSign = _mm_andnot_ps(_FLOAT_ABS_MASK.m_value, m_value);
+
+	// octant j, rounded up to even so the reduced angle lies in [-pi/4, pi/4]
+	__m128i octant = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.27323954473516f))); // 4 / pi
+	octant = _mm_and_si128(_mm_add_epi32(octant, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+	__m128 y = _mm_cvtepi32_ps(octant);
+
+	sinSign = _mm_xor_ps(sinSign, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(octant, _mm_set1_epi32(4)), 29)));
+	__m128 cosSign = _mm_castsi128_ps(
+		_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(octant, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+	__m128 useCosPolynomial = _mm_castsi128_ps(
+		_mm_cmpeq_epi32(_mm_and_si128(octant, _mm_set1_epi32(2)), _mm_setzero_si128()));
+
+	// x - y * pi/4 in three parts so the reduction stays exact
+	x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-0.78515625f)));
+	x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-2.4187564849853515625e-4f)));
+	x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-3.77489497744594108e-8f)));
+	__m128 z = _mm_mul_ps(x, x);
+
+	__m128 cosPoly = _mm_set1_ps(2.443315711809948e-5f);
+	cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, z), _mm_set1_ps(-1.388731625493765e-3f));
+	cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, z), _mm_set1_ps(4.166664568298827e-2f));
+	cosPoly = _mm_mul_ps(_mm_mul_ps(cosPoly, z), z);
+	cosPoly = _mm_add_ps(_mm_sub_ps(cosPoly, _mm_mul_ps(z, _mm_set1_ps(0.5f))), _mm_set1_ps(1.f));
+
+	__m128 sinPoly = _mm_set1_ps(-1.9515295891e-4f);
+	sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, z), _mm_set1_ps(8.3321608736e-3f));
+	sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, z), _mm_set1_ps(-1.6666654611e-1f));
+	sinPoly = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sinPoly, z), x), x);
+
+	__m128 sinValue = _mm_or_ps(_mm_and_ps(useCosPolynomial, sinPoly), _mm_andnot_ps(useCosPolynomial, cosPoly));
+	__m128 cosValue = _mm_or_ps(_mm_and_ps(useCosPolynomial, cosPoly), _mm_andnot_ps(useCosPolynomial, sinPoly));
+	sinResult = _mm_xor_ps(sinValue, sinSign);
+	cosResult = _mm_xor_ps(cosValue, cosSign);
+}
+
+/*!
+* Four quadrant arctangent of y / x in every lane, accurate to a few ulp and without branches.  The ratio of the smaller
+* to the larger magnitude is reduced to [0, tan(pi/8)] (Cephes atanf), and the octant is restored with selects.
+* Signed zeros follow the C library: the quadrant comes from the sign bit of x, so atan2(0, -0) is pi and atan2(0, 0)
+* is 0, and the sign of y is kept so atan2(-0, -1) is -pi.
+* \param y the sine side
+* \param x the cosine side
+* \return the angle in [-pi, pi]
+*/
+inline XmmFloat XmmFloat::atan2(const XmmFloat &y, const XmmFloat &x)
+{
+	PATRICKMATH_COUNT(XMMFLOAT_TRIG);
+	__m128 absY = _mm_and_ps(y.m_value, _FLOAT_ABS_MASK.m_value);
+	__m128 absX = _mm_and_ps(x.m_value, _FLOAT_ABS_MASK.m_value);
+	__m128 steep = _mm_cmpgt_ps(absY, absX);
+	__m128 t = _mm_div_ps(_mm_min_ps(absX, absY), _mm_max_ps(_mm_max_ps(absX, absY), _mm_set1_ps(FLT_MIN)));
+
+	// above tan(pi/8) use atan(t) = pi/4 + atan((t - 1) / (t + 1))
+	__m128 reduce = _mm_cmpgt_ps(t, _mm_set1_ps(0.414213562373095f));
+	__m128 reduced = _mm_div_ps(_mm_sub_ps(t, _mm_set1_ps(1.f)), _mm_add_ps(t, _mm_set1_ps(1.f)));
+	t = _mm_or_ps(_mm_and_ps(reduce, reduced), _mm_andnot_ps(reduce, t));
+	__m128 offset = _mm_and_ps(reduce, _mm_set1_ps(0.785398163397448f));
+
+	__m128 z = _mm_mul_ps(t, t);
+	__m128 p = _mm_set1_ps(8.05374449538e-2f);
+	p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(-1.38776856032e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(1.99777106478e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(-3.33329491539e-1f));
+	__m128 result = _mm_add_ps(offset, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, z), t), t));
+
+	// back to the octant: pi/2 - r above the diagonal, pi - r for negative x, then the sign of y
+	result = _mm_or_ps(_mm_and_ps(steep, _mm_sub_ps(_PI_2.m_value, result)), _mm_andnot_ps(steep, result));
+	__m128 negativeX = _mm_castsi128_ps(_mm_srai_epi32(_mm_castps_si128(x.m_value), 31));
+	result = _mm_or_ps(_mm_and_ps(negativeX, _mm_sub_ps(_PI.m_value, result)), _mm_andnot_ps(negativeX, result));
+	return _mm_or_ps(result, _mm_andnot_ps(_FLOAT_ABS_MASK.m_value, y.m_value));
+}
+
 inline XmmBool XmmFloat::isEqual(const XmmFloat &cmp) const
 {
 	return _mm_cmpeq_ps(m_value, cmp.m_value);
@@ -284,12 +377,14 @@ inline XmmFloat XmmFloat::max(const XmmFloat &lhs, const XmmFloat &rhs)
 
 inline float &XmmFloat::get(float &destination) const
 {
+	PATRICKMATH_COUNT(XMMFLOAT_GET);
 	_mm_store_ss(&destination, m_value);
 	return destination;
 }
 
 inline XmmFloat &XmmFloat::set(float source)
 {
+	PATRICKMATH_COUNT(XMMFLOAT_SET);
 	m_value = _mm_load1_ps(&source);
 	return *this;
 }
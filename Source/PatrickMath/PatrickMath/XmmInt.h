@@ -0,0 +1,354 @@
+/*!
+* \file XmmInt.h
+* \author Patrick Martin
+* \date 2010
+* \brief 32 bit integer values represented via XMM registers
+*
+* This is a class for storing and operating on four 32 bit integers in an SSE2 register.  Unlike XmmFloat the lanes are
+* not expected to be identical: integer work (quantization, morton codes, hashing) is almost always done four elements
+* at a time, so each lane usually belongs to a different element.  Use a Container to load or read back individual
+* lanes, and as always, try not to.
+*
+* This project is governed by the MIT licence:
+*
+*  Copyright (c) 2010 Patrick Martin
+*
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+*
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <emmintrin.h>
+#include <stdint.h>
+
+#include "Instrumentation.h"
+#include "XmmBool.h"
+#include "XmmFloat.h"
+
+/*!
+* \class XmmInt
+* \brief provides a wrapper for common integer operations on sse registers
+*
+* Only SSE2 is assumed, so the operations that SSE4.1 added (32 bit multiply, min and max) are emulated.  They are
+* still far cheaper than moving the lanes out to general purpose registers.
+*/
+__declspec(align(16))
+class XmmInt
+{
+public:
+	__declspec(align(16))
+	struct Container
+	{
+		int32_t elements [4];
+	};
+
+public:
+	XmmInt();
+	XmmInt(const XmmInt &copy);
+	XmmInt(const __m128i &value);
+	explicit XmmInt(const int32_t &value);
+	explicit XmmInt(const Container &container);
+
+	// operator overloads
+	inline XmmInt operator-() const						{return negate();}
+	inline XmmInt operator+(const XmmInt &rhs) const	{return add(rhs);}
+	inline XmmInt operator-(const XmmInt &rhs) const	{return subtract(rhs);}
+	inline XmmInt operator*(const XmmInt &rhs) const	{return multiply(rhs);}
+	inline XmmInt operator&(const XmmInt &rhs) const	{return bitwiseAnd(rhs);}
+	inline XmmInt operator|(const XmmInt &rhs) const	{return bitwiseOr(rhs);}
+	inline XmmInt operator^(const XmmInt &rhs) const	{return bitwiseXor(rhs);}
+	inline XmmInt operator<<(int count) const			{return shiftLeft(count);}
+	inline XmmInt operator>>(int count) const			{return shiftRightArithmetic(count);}
+
+	// caution: these logical operations do not return a value usable in an if statement (do not return a bool)
+	inline XmmBool operator==(const XmmInt &rhs) const	{return isEqual(rhs);}
+	inline XmmBool operator> (const XmmInt &rhs) const	{return isGreaterThan(rhs);}
+	inline XmmBool operator< (const XmmInt &rhs) const	{return isLessThan(rhs);}
+
+	// named arithmetic operations
+	XmmInt negate() const;
+	XmmInt add(const XmmInt &rhs) const;
+	XmmInt subtract(const XmmInt &rhs) const;
+	XmmInt multiply(const XmmInt &rhs) const;
+	XmmInt abs() const;
+
+	// bit operations
+	XmmInt bitwiseAnd(const XmmInt &rhs) const;
+	XmmInt bitwiseOr(const XmmInt &rhs) const;
+	XmmInt bitwiseXor(const XmmInt &rhs) const;
+	XmmInt bitwiseAndNot(const XmmInt &rhs) const;
+	XmmInt shiftLeft(int count) const;
+	XmmInt shiftRightLogical(int count) const;
+	XmmInt shiftRightArithmetic(int count) const;
+
+	// logic operations
+	XmmBool isEqual(const XmmInt &cmp) const;
+	XmmBool isLessThan(const XmmInt &cmp) const;
+	XmmBool isGreaterThan(const XmmInt &cmp) const;
+
+	static XmmInt min(const XmmInt &lhs, const XmmInt &rhs);
+	static XmmInt max(const XmmInt &lhs, const XmmInt &rhs);
+
+	// conversions
+	XmmFloat toXmmFloat() const;
+	static XmmInt round(const XmmFloat &value);
+	static XmmInt truncate(const XmmFloat &value);
+	static XmmInt floor(const XmmFloat &value);
+	static XmmInt bitCast(const XmmFloat &value);
+	XmmFloat bitCastToXmmFloat() const;
+
+	// read/write
+	int32_t &get(int32_t &destination) const;
+	Container &get(Container &destination) const;
+	XmmInt &set(int32_t source);
+	XmmInt &set(const Container &source);
+
+	operator __m128i () const;
+
+private:
+	__m128i m_value;
+};
+
+/*!
+* Default constructor will initialize to 0
+*/
+inline XmmInt::XmmInt()
+{
+	m_value = _mm_setzero_si128();
+}
+
+inline XmmInt::XmmInt(const XmmInt &copy)
+{
+	m_value = copy.m_value;
+}
+
+inline XmmInt::XmmInt(const __m128i &value)
+{
+	m_value = value;
+}
+
+/*!
+* Require an explicit conversion from int, keep user informed that this is an expensive copy
+* \param value the value to store in every lane
+*/
+inline XmmInt::XmmInt(const int32_t &value)
+{
+	set(value);
+}
+
+/*!
+* Loads four different values, one per lane
+* \param container the values to load
+*/
+inline XmmInt::XmmInt(const Container &container)
+{
+	set(container);
+}
+
+inline XmmInt XmmInt::negate() const
+{
+	return _mm_sub_epi32(_mm_setzero_si128(), m_value);
+}
+
+inline XmmInt XmmInt::add(const XmmInt &rhs) const
+{
+	return _mm_add_epi32(m_value, rhs.m_value);
+}
+
+inline XmmInt XmmInt::subtract(const XmmInt &rhs) const
+{
+	return _mm_sub_epi32(m_value, rhs.m_value);
+}
+
+/*!
+* Keeps the low 32 bits of each product (wraps on overflow like normal int math).  SSE2 only multiplies the even lanes,
+* so the odd lanes are shifted down, multiplied, and interleaved back in.
+*/
+inline XmmInt XmmInt::multiply(const XmmInt &rhs) const
+{
+	__m128i even = _mm_mul_epu32(m_value, rhs.m_value); // 0, 2 as 64 bit products
+	__m128i odd = _mm_mul_epu32(_mm_srli_si128(m_value, 4), _mm_srli_si128(rhs.m_value, 4)); // 1, 3
+	return _mm_unpacklo_epi32(
+		_mm_shuffle_epi32(even, _MM_SHUFFLE(0,0,2,0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0,0,2,0)));
+}
+
+inline XmmInt XmmInt::abs() const
+{
+	__m128i sign = _mm_srai_epi32(m_value, 31);
+	return _mm_sub_epi32(_mm_xor_si128(m_value, sign), sign);
+}
+
+inline XmmInt XmmInt::bitwiseAnd(const XmmInt &rhs) const
+{
+	return _mm_and_si128(m_value, rhs.m_value);
+}
+
+inline XmmInt XmmInt::bitwiseOr(const XmmInt &rhs) const
+{
+	return _mm_or_si128(m_value, rhs.m_value);
+}
+
+inline XmmInt XmmInt::bitwiseXor(const XmmInt &rhs) const
+{
+	return _mm_xor_si128(m_value, rhs.m_value);
+}
+
+/*!
+* \return ~this & rhs, the same operand order as _mm_andnot_si128
+*/
+inline XmmInt XmmInt::bitwiseAndNot(const XmmInt &rhs) const
+{
+	return _mm_andnot_si128(m_value, rhs.m_value);
+}
+
+inline XmmInt XmmInt::shiftLeft(int count) const
+{
+	return _mm_sll_epi32(m_value, _mm_cvtsi32_si128(count));
+}
+
+inline XmmInt XmmInt::shiftRightLogical(int count) const
+{
+	return _mm_srl_epi32(m_value, _mm_cvtsi32_si128(count));
+}
+
+inline XmmInt XmmInt::shiftRightArithmetic(int count) const
+{
+	return _mm_sra_epi32(m_value, _mm_cvtsi32_si128(count));
+}
+
+inline XmmBool XmmInt::isEqual(const XmmInt &cmp) const
+{
+	return _mm_castsi128_ps(_mm_cmpeq_epi32(m_value, cmp.m_value));
+}
+
+inline XmmBool XmmInt::isLessThan(const XmmInt &cmp) const
+{
+	return _mm_castsi128_ps(_mm_cmplt_epi32(m_value, cmp.m_value));
+}
+
+inline XmmBool XmmInt::isGreaterThan(const XmmInt &cmp) const
+{
+	return _mm_castsi128_ps(_mm_cmpgt_epi32(m_value, cmp.m_value));
+}
+
+inline XmmInt XmmInt::min(const XmmInt &lhs, const XmmInt &rhs)
+{
+	__m128i lhsGreater = _mm_cmpgt_epi32(lhs.m_value, rhs.m_value);
+	return _mm_or_si128(_mm_and_si128(lhsGreater, rhs.m_value), _mm_andnot_si128(lhsGreater, lhs.m_value));
+}
+
+inline XmmInt XmmInt::max(const XmmInt &lhs, const XmmInt &rhs)
+{
+	__m128i lhsGreater = _mm_cmpgt_epi32(lhs.m_value, rhs.m_value);
+	return _mm_or_si128(_mm_and_si128(lhsGreater, lhs.m_value), _mm_andnot_si128(lhsGreater, rhs.m_value));
+}
+
+inline XmmFloat XmmInt::toXmmFloat() const
+{
+	return _mm_cvtepi32_ps(m_value);
+}
+
+/*!
+* Converts using the current rounding mode (round to nearest even unless someone has changed MXCSR).  Values outside
+* of int32 range become 0x80000000.
+*/
+inline XmmInt XmmInt::round(const XmmFloat &value)
+{
+	return _mm_cvtps_epi32(value);
+}
+
+/*!
+* Converts rounding toward zero, the same as a C cast
+*/
+inline XmmInt XmmInt::truncate(const XmmFloat &value)
+{
+	return _mm_cvttps_epi32(value);
+}
+
+/*!
+* Converts rounding toward negative infinity.  SSE2 has no floor, so truncate and step down wherever that rounded up.
+*/
+inline XmmInt XmmInt::floor(const XmmFloat &value)
+{
+	__m128i truncated = _mm_cvttps_epi32(value);
+	__m128 roundedUp = _mm_cmpgt_ps(_mm_cvtepi32_ps(truncated), value);
+	return _mm_add_epi32(truncated, _mm_castps_si128(roundedUp)); // the mask is -1 where we rounded up
+}
+
+/*!
+* Reinterprets the bits of an XmmFloat, no conversion is performed
+*/
+inline XmmInt XmmInt::bitCast(const XmmFloat &value)
+{
+	return _mm_castps_si128(value);
+}
+
+/*!
+* Reinterprets the bits as an XmmFloat, no conversion is performed
+*/
+inline XmmFloat XmmInt::bitCastToXmmFloat() const
+{
+	return _mm_castsi128_ps(m_value);
+}
+
+/*!
+* Reads the first lane (slow: reading from SSE registers)
+*/
+inline int32_t &XmmInt::get(int32_t &destination) const
+{
+	PATRICKMATH_COUNT(XMMINT_GET);
+	destination = _mm_cvtsi128_si32(m_value);
+	return destination;
+}
+
+/*!
+* Writes every lane out to a Container (slow: reading from SSE registers)
+*/
+inline XmmInt::Container &XmmInt::get(XmmInt::Container &destination) const
+{
+	PATRICKMATH_COUNT(XMMINT_GET);
+	_mm_store_si128(reinterpret_cast<__m128i*>(destination.elements), m_value);
+	return destination;
+}
+
+inline XmmInt &XmmInt::set(int32_t source)
+{
+	PATRICKMATH_COUNT(XMMINT_SET);
+	m_value = _mm_set1_epi32(source);
+	return *this;
+}
+
+inline XmmInt &XmmInt::set(const XmmInt::Container &source)
+{
+	PATRICKMATH_COUNT(XMMINT_SET);
+	m_value = _mm_load_si128(reinterpret_cast<const __m128i*>(source.elements));
+	return *this;
+}
+
+/*!
+* Same caveats as XmmFloat's conversion operator, this exists so the value can be handed to intrinsics
+* \return the __m128i representing this object
+*/
+inline XmmInt::operator __m128i () const
+{
+	return m_value;
+}
@@ -0,0 +1,70 @@
+/*!
+* \file XmmRandom.cpp
+* \author Patrick Martin
+* \date 2010
+*
+* This project is governed by the MIT licence:
+* 
+*  Copyright (c) 2010 Patrick Martin
+* 
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+* 
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+* 
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "stdafx.h"
+#include "XmmRandom.h"
+
+/*!
+* splitmix64, used only to expand the seed into well mixed, never all zero, generator state
+*/
+static uint64_t splitMix64(uint64_t &state)
+{
+	uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+/*!
+* Resets the generator.  The sixteen state words are drawn from a splitmix64 sequence keyed on both seed and stream,
+* so (seed, stream) pairs produce unrelated sequences and the same pair always reproduces the same one.
+* \param seed the seed shared by every generator in a run
+* \param stream selects an independent sequence for this seed, typically the thread or job index
+*/
+void XmmRandom::seed(uint64_t seed, uint32_t stream)
+{
+	uint64_t mix = seed ^ (uint64_t(stream) * 0xD1342543DE82EF95ULL);
+	XmmInt::Container state[4];
+	for ( int word = 0; word < 4; word++ )
+	{
+		for ( int lane = 0; lane < 4; lane += 2 )
+		{
+			uint64_t bits = splitMix64(mix);
+			state[word].elements[lane] = int32_t(uint32_t(bits));
+			state[word].elements[lane + 1] = int32_t(uint32_t(bits >> 32));
+		}
+	}
+
+	m_state0 = XmmInt(state[0]);
+	m_state1 = XmmInt(state[1]);
+	m_state2 = XmmInt(state[2]);
+	m_state3 = XmmInt(state[3]);
+}
@@ -0,0 +1,107 @@
+/*!
+* \file XmmRandom.h
+* \author Patrick Martin
+* \date 2010
+* \brief A four lane pseudo random number generator that produces XmmFloat and XmmInt values directly
+*
+* Each lane runs its own xoshiro128+ generator (Blackman and Vigna), which only needs 32 bit adds, shifts and xors so
+* it maps directly onto SSE2.  A generator is fully determined by its seed and stream: give every thread the same seed
+* and a different stream and the results are reproducible no matter how the work is scheduled.  A generator must not
+* be shared between threads.
+*
+* This project is governed by the MIT licence:
+*
+*  Copyright (c) 2010 Patrick Martin
+*
+*  Permission is hereby granted, free of charge, to any person
+*  obtaining a copy of this software and associated documentation
+*  files (the "Software"), to deal in the Software without
+*  restriction, including without limitation the rights to use,
+*  copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the
+*  Software is furnished to do so, subject to the following
+*  conditions:
+*
+*  The above copyright notice and this permission notice shall be
+*  included in all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+*  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+*  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <emmintrin.h>
+#include <stdint.h>
+
+#include "XmmFloat.h"
+#include "XmmInt.h"
+
+__declspec(align(16))
+class XmmRandom
+{
+public:
+	explicit XmmRandom(uint64_t seed, uint32_t stream = 0);
+
+	void seed(uint64_t seed, uint32_t stream);
+
+	// four independent values per call
+	XmmInt nextInt();
+	XmmFloat nextFloat();
+	XmmFloat nextFloat(const XmmFloat &low, const XmmFloat &high);
+
+private:
+	__m128i m_state0;
+	__m128i m_state1;
+	__m128i m_state2;
+	__m128i m_state3;
+};
+
+inline XmmRandom::XmmRandom(uint64_t seed, uint32_t stream)
+{
+	this->seed(seed, stream);
+}
+
+/*!
+* Advances every lane and returns 32 random bits per lane.  The lowest bits of xoshiro128+ are its weakest, prefer
+* nextFloat or the high bits when that matters.
+*/
+inline XmmInt XmmRandom::nextInt()
+{
+	__m128i result = _mm_add_epi32(m_state0, m_state3);
+	__m128i t = _mm_slli_epi32(m_state1, 9);
+
+	m_state2 = _mm_xor_si128(m_state2, m_state0);
+	m_state3 = _mm_xor_si128(m_state3, m_state1);
+	m_state1 = _mm_xor_si128(m_state1, m_state2);
+	m_state0 = _mm_xor_si128(m_state0, m_state3);
+	m_state2 = _mm_xor_si128(m_state2, t);
+	m_state3 = _mm_or_si128(_mm_slli_epi32(m_state3, 11), _mm_srli_epi32(m_state3, 21)); // rotl(s3, 11)
+
+	return result;
+}
+
+/*!
+* Four uniform floats in [0, 1).  The top 23 bits become the mantissa of a float in [1, 2), so every representable
+* step of 2^-23 is equally likely.
+*/
+inline XmmFloat XmmRandom::nextFloat()
+{
+	__m128i mantissa = _mm_srli_epi32(nextInt(), 9);
+	__m128 oneToTwo = _mm_castsi128_ps(_mm_or_si128(mantissa, _mm_set1_epi32(0x3F800000)));
+	return _mm_sub_ps(oneToTwo, _mm_set1_ps(1.f));
+}
+
+/*!
+* Four uniform floats in [low, high)
+*/
+inline XmmFloat XmmRandom::nextFloat(const XmmFloat &low, const XmmFloat &high)
+{
+	return _mm_add_ps(low, _mm_mul_ps(nextFloat(), _mm_sub_ps(high, low)));
+}